@@ -7,6 +7,9 @@ if( !Protobuf_FOUND )
   CPMAddPackage("gh:protocolbuffer/protobuf@27.4")
 endif()
 
+## ==== threads ====
+find_package(Threads REQUIRED)
+
 ## ==== Pytorch ====
 find_package(Torch REQUIRED)
 message("Torch cxx flags: ${TORCH_CXX_FLAGS}")
@@ -0,0 +1,63 @@
+#include <nuTens/fitting/curvature.hpp>
+
+namespace
+{
+// flatten a list of tensors into a single 1-d tensor
+Tensor flatten(const std::vector<Tensor> &tensors)
+{
+    std::vector<Tensor> flattened;
+    flattened.reserve(tensors.size());
+    for (const Tensor &tensor : tensors)
+    {
+        flattened.push_back(Tensor::reshape(tensor, {-1}));
+    }
+
+    return Tensor::cat(flattened);
+}
+} // namespace
+
+Tensor Curvature::hessian(const Tensor &value, const std::vector<Tensor> &params)
+{
+    NT_PROFILE();
+
+    // the gradient, recorded so that it can itself be differentiated
+    Tensor gradient = flatten(Tensor::gradients(value, params, Tensor(), /*retainGraph=*/true, /*createGraph=*/true));
+
+    const auto nParams = static_cast<long int>(gradient.getNumel());
+    Tensor ret = Tensor::zeros({nParams, nParams}, gradient.getDType(), gradient.getDevice(), /*requiresGrad=*/false);
+
+    // one row per backward pass through the gradient
+    for (long int p = 0; p < nParams; p++)
+    {
+        const Tensor::Index row({p});
+        ret.setValue(row, flatten(Tensor::gradients(gradient.getValues(row), params, Tensor(), /*retainGraph=*/true)));
+    }
+
+    return ret;
+}
+
+Tensor Curvature::fisher(const Tensor &jacobian, const Tensor &inverseVariances)
+{
+    NT_PROFILE();
+
+    const long int nParams = jacobian.getShape().back();
+    Tensor flatJacobian = Tensor::reshape(jacobian, {-1, nParams});
+    Tensor weightedJacobian = Tensor::mul(flatJacobian, Tensor::reshape(inverseVariances, {-1, 1}));
+
+    return Tensor::matmul(Tensor::transpose(weightedJacobian, 0, 1), flatJacobian);
+}
+
+Tensor Curvature::fisher(const Propagator &propagator, const Tensor &energies, const std::vector<Tensor> &params,
+                         const Tensor &inverseVariances)
+{
+    NT_PROFILE();
+
+    return fisher(propagator.jacobian(energies, params), inverseVariances);
+}
+
+Tensor Curvature::covariance(const Tensor &information)
+{
+    NT_PROFILE();
+
+    return Tensor::inverse(information);
+}
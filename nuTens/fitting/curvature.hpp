@@ -0,0 +1,70 @@
+#pragma once
+
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/*!
+ * @file curvature.hpp
+ * @brief Defines tools for getting the hessian and fisher information of a fit
+ */
+
+class Curvature
+{
+    /*!
+     * @class Curvature
+     * @brief Calculates hessians and fisher information matrices with respect to oscillation parameters
+     *
+     * These describe how well a measurement constrains the parameters, e.g. the expected uncertainties on the
+     * parameters are the square roots of the diagonal of the covariance matrix given by covariance().
+     *
+     * The fisher information of a sample of bins (or events) with predictions \f$ \mu_i(\theta) \f$ and uncertainties
+     * \f$ \sigma_i \f$ is
+     * \f{equation}
+     *   F_{pq} = \sum_i \frac{1}{\sigma_i^2} \frac{\partial \mu_i}{\partial \theta_p} \frac{\partial \mu_i}{\partial
+     * \theta_q} \f}
+     * which only needs the first derivatives of the predictions. These can be obtained for every energy at once using
+     * Propagator::jacobian(), so no finite differences or extra propagator calls are needed. For Poisson distributed
+     * counts, use \f$ \sigma_i^2 = \mu_i \f$.
+     *
+     * hessian() gives the exact matrix of second derivatives of any scalar built from the parameters (e.g. a
+     * likelihood), using one recorded backward pass followed by one backward pass through the gradient per parameter.
+     * Each pass covers every event at once.
+     * \code{.cpp}
+     *   Tensor fisher = Curvature::fisher(propagator, energies, {angles, massSplittings}, eventWeights);
+     *   Tensor expectedErrors = Tensor::diagonal(Curvature::covariance(fisher));
+     * \endcode
+     */
+
+  public:
+    /// @brief Get the hessian of a scalar with respect to some parameters
+    /// @param value The scalar, e.g. a log likelihood, calculated from the parameters with gradient tracking turned on
+    /// @param params The parameters, which should be real and require a gradient. Every element of each of them is
+    /// treated as a separate parameter.
+    /// @return Tensor with shape {nParams, nParams}
+    [[nodiscard]] static Tensor hessian(const Tensor &value, const std::vector<Tensor> &params);
+
+    /// @brief Get the fisher information from the derivatives of some predictions
+    /// @param jacobian The derivatives of the predictions with respect to the parameters, with the parameters along the
+    /// last dimension, e.g. from Propagator::jacobian()
+    /// @param inverseVariances One over the variance of each prediction, with the same shape as the jacobian minus the
+    /// last dimension
+    /// @return Tensor with shape {nParams, nParams}
+    [[nodiscard]] static Tensor fisher(const Tensor &jacobian, const Tensor &inverseVariances);
+
+    /// @brief Get the fisher information of a set of oscillation probabilities
+    /// @param propagator The propagator to calculate the probabilities with
+    /// @param energies The energies of the neutrinos, with shape {Nbatches, 1}
+    /// @param params The parameters, see Propagator::jacobian()
+    /// @param inverseVariances One over the variance of each probability, with shape {Nbatches, nGenerations,
+    /// nGenerations}. Any weights applied to the probabilities (e.g. flux times cross section) should be folded in
+    /// by multiplying these by the weight squared.
+    /// @return Tensor with shape {nParams, nParams}
+    [[nodiscard]] static Tensor fisher(const Propagator &propagator, const Tensor &energies,
+                                       const std::vector<Tensor> &params, const Tensor &inverseVariances);
+
+    /// @brief Get the covariance matrix of the parameters from a hessian of the negative log likelihood or a fisher
+    /// information matrix, i.e. its inverse
+    [[nodiscard]] static Tensor covariance(const Tensor &information);
+};
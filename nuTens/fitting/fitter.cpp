@@ -0,0 +1,54 @@
+#include <nuTens/fitting/fitter.hpp>
+#include <stdexcept>
+
+void Fitter::setData(const Tensor &energies, const Tensor &unoscillatedCounts, const Tensor &observedCounts)
+{
+    NT_PROFILE();
+
+    if (unoscillatedCounts.getShape() != observedCounts.getShape())
+    {
+        NT_ERROR("Shapes of unoscillated and observed counts don't match");
+        throw std::invalid_argument("Unoscillated and observed counts must have the same shape");
+    }
+
+    _energies = energies;
+    _unoscillatedCounts = unoscillatedCounts;
+    _likelihood.setData(observedCounts);
+}
+
+void Fitter::setPenalties(const Tensor &centres, const Tensor &widths)
+{
+    NT_PROFILE();
+
+    _penaltyCentres = centres;
+    _penaltyWidths = widths;
+    _hasPenalties = true;
+}
+
+Tensor Fitter::getPrediction(const Tensor &params)
+{
+    NT_PROFILE();
+
+    OscillationParameters::apply(params, _propagator);
+    return Tensor::mul(_unoscillatedCounts, _propagator.calculateProbs(_energies));
+}
+
+Tensor Fitter::negativeLogLikelihood(const Tensor &params)
+{
+    NT_PROFILE();
+
+    Tensor ret = _likelihood.negativeLogLikelihood(getPrediction(params));
+    if (_hasPenalties)
+    {
+        ret = ret + BinnedLikelihood::gaussianPenalty(params, _penaltyCentres, _penaltyWidths);
+    }
+
+    return ret;
+}
+
+Minimiser::Result Fitter::fit(const Minimiser &minimiser, const Tensor &start)
+{
+    NT_PROFILE();
+
+    return minimiser.minimise([this](const Tensor &params) { return negativeLogLikelihood(params); }, start);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <nuTens/fitting/likelihood.hpp>
+#include <nuTens/fitting/minimiser.hpp>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+
+/*!
+ * @file fitter.hpp
+ * @brief Defines a binned likelihood fit of the oscillation parameters
+ */
+
+class Fitter
+{
+    /*!
+     * @class Fitter
+     * @brief Fits the three flavour oscillation parameters (see OscillationParameters) to binned event counts
+     *
+     * The data are given as observed counts in energy bins for each oscillation channel, along with the counts that
+     * would be expected in each bin if there were no oscillations (i.e. flux x cross section x efficiency x exposure).
+     * The prediction in bin b of channel i -> j is then
+     * \f{equation}
+     *   \mu_{bij} = R_{bij} P_{ij}(E_b)
+     * \f}
+     * for unoscillated counts \f$ R \f$ and oscillation probabilities \f$ P \f$, and the fit minimises the Poisson
+     * negative log likelihood
+     * \f{equation}
+     *   -\ln L = \sum_{bij} \mu_{bij} - n_{bij} + n_{bij} \ln \frac{n_{bij}}{\mu_{bij}}
+     * \f}
+     * for observed counts \f$ n \f$. This is shifted by a constant so that it is 0 when the prediction matches the
+     * data exactly, which stops the value near the minimum getting lost in floating point rounding. Channels that
+     * aren't measured can just have zero unoscillated counts. The likelihood is calculated by a BinnedLikelihood,
+     * which can be got using getLikelihood() to use a different test statistic. Gaussian penalties on the parameters,
+     * e.g. from external measurements, can be added using setPenalties(). The gradient of the likelihood comes from
+     * the propagator's backward pass, so the whole fit runs in c++.
+     *
+     * The fitter works on its own copy of the propagator, so any matter solver etc. should be set up before it is
+     * made. It is not thread safe, as evaluating the likelihood changes the parameters of that copy.
+     * \code{.cpp}
+     *   Fitter fitter(propagator);
+     *   fitter.setData(energies, unoscillatedCounts, observedCounts);
+     *
+     *   LBFGSMinimiser minimiser;
+     *   minimiser.setBounds(OscillationParameters::getDefaultLowerBounds(),
+     *                       OscillationParameters::getDefaultUpperBounds());
+     *   Minimiser::Result result = fitter.fit(minimiser, startingParameters);
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param propagator The propagator to calculate the probabilities with, which gets copied
+    explicit Fitter(const Propagator &propagator) : _propagator(propagator.clone())
+    {
+    }
+
+    /// @brief Set the data to fit to
+    /// @param energies The energy of each bin, with shape {nBins, 1}
+    /// @param unoscillatedCounts The expected counts without oscillations, with shape {nBins, 3, 3}, where [b, i, j]
+    /// is for neutrinos produced as flavour i and detected as flavour j
+    /// @param observedCounts The observed counts, with the same shape as unoscillatedCounts
+    void setData(const Tensor &energies, const Tensor &unoscillatedCounts, const Tensor &observedCounts);
+
+    /// @brief Add gaussian penalties on the parameters
+    /// @param centres The central value of each parameter
+    /// @param widths The width of each penalty, which can be infinite to leave a parameter unconstrained
+    void setPenalties(const Tensor &centres, const Tensor &widths);
+
+    /// @brief Get the likelihood used to compare the prediction to the data, e.g. to change the test statistic
+    [[nodiscard]] inline BinnedLikelihood &getLikelihood()
+    {
+        return _likelihood;
+    }
+
+    /// @brief Get the expected counts for some parameters
+    /// @param params The oscillation parameters
+    /// @return Tensor with the same shape as the unoscillated counts
+    [[nodiscard]] Tensor getPrediction(const Tensor &params);
+
+    /// @brief Get the negative log likelihood of the data for some parameters
+    /// @param params The oscillation parameters, which should require a gradient to be able to get its gradient
+    [[nodiscard]] Tensor negativeLogLikelihood(const Tensor &params);
+
+    /// @brief Find the parameters that best fit the data
+    /// @param minimiser The minimiser to use, with any bounds already set
+    /// @param start The parameters to start the minimiser from
+    [[nodiscard]] Minimiser::Result fit(const Minimiser &minimiser, const Tensor &start);
+
+  private:
+    Propagator _propagator;
+    Tensor _energies;
+    Tensor _unoscillatedCounts;
+    BinnedLikelihood _likelihood;
+
+    bool _hasPenalties = false;
+    Tensor _penaltyCentres;
+    Tensor _penaltyWidths;
+};
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <nuTens/fitting/grid-scan.hpp>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+bool isMassParameter(OscillationParameters::Index parameter)
+{
+    return parameter == OscillationParameters::kDm2_21 || parameter == OscillationParameters::kDm2_31;
+}
+
+// the number of combinations of the values of some of the axes
+long int countCombinations(const std::vector<GridScan::Axis> &axes, const std::vector<size_t> &subset)
+{
+    long int ret = 1;
+    for (size_t axis : subset)
+    {
+        ret *= static_cast<long int>(axes[axis].values.size());
+    }
+    return ret;
+}
+
+// write the values of some of the axes for one of their combinations (in row-major order) into a full set of
+// parameters, and the index along each of those axes into the index of a full grid point
+void setCombination(const std::vector<GridScan::Axis> &axes, const std::vector<size_t> &subset, long int combination,
+                    std::vector<float> &parameters, std::vector<long int> &gridIndex)
+{
+    for (auto axis = subset.rbegin(); axis != subset.rend(); ++axis)
+    {
+        const auto nValues = static_cast<long int>(axes[*axis].values.size());
+        const long int index = combination % nValues;
+        combination /= nValues;
+
+        parameters[axes[*axis].parameter] = axes[*axis].values[index];
+        gridIndex[*axis] = index;
+    }
+}
+} // namespace
+
+GridScan::GridScan(const Propagator &propagator, std::vector<Axis> axes)
+    : _propagator(propagator.clone()), _axes(std::move(axes))
+{
+    NT_PROFILE();
+
+    if (_axes.empty())
+    {
+        NT_ERROR("GridScan needs at least one axis");
+        throw std::invalid_argument("No axes passed to GridScan");
+    }
+
+    std::vector<bool> scanned(OscillationParameters::kNParams, false);
+    for (size_t axis = 0; axis < _axes.size(); axis++)
+    {
+        const OscillationParameters::Index parameter = _axes[axis].parameter;
+        if (parameter < 0 || parameter >= OscillationParameters::kNParams || scanned[parameter])
+        {
+            NT_ERROR("Axis {} of GridScan has an unknown or repeated parameter {}", axis, static_cast<int>(parameter));
+            throw std::invalid_argument("Bad parameter for an axis of GridScan");
+        }
+        if (_axes[axis].values.empty())
+        {
+            NT_ERROR("Axis {} of GridScan has no values", axis);
+            throw std::invalid_argument("Axis of GridScan has no values");
+        }
+        scanned[parameter] = true;
+
+        if (isMassParameter(parameter))
+        {
+            _massAxes.push_back(axis);
+        }
+        else
+        {
+            _mixingAxes.push_back(axis);
+        }
+    }
+
+    // the batched masses are only used by the analytic pass, and each copy of the energies in a batch goes with
+    // different masses so they mustn't be merged
+    _propagator.setAnalyticGradients(true);
+    _propagator.setDeduplicateEnergies(false);
+}
+
+void GridScan::setData(const Tensor &energies, const Tensor &unoscillatedCounts, const Tensor &observedCounts)
+{
+    NT_PROFILE();
+
+    if (unoscillatedCounts.getShape() != observedCounts.getShape())
+    {
+        NT_ERROR("Shapes of unoscillated and observed counts don't match");
+        throw std::invalid_argument("Unoscillated and observed counts must have the same shape");
+    }
+
+    _energies = energies;
+    _unoscillatedCounts = unoscillatedCounts;
+    _likelihood.setData(observedCounts);
+    _hasData = true;
+}
+
+std::vector<long int> GridScan::getShape() const
+{
+    std::vector<long int> ret;
+    for (const Axis &axis : _axes)
+    {
+        ret.push_back(static_cast<long int>(axis.values.size()));
+    }
+    return ret;
+}
+
+Tensor GridScan::scan(const Tensor &nominal) const
+{
+    NT_PROFILE();
+
+    if (!_hasData)
+    {
+        NT_ERROR("GridScan::setData() must be called before scan()");
+        throw std::logic_error("No data set for GridScan");
+    }
+
+    const std::vector<float> nominalValues = nominal.toVector<float>();
+    if (nominalValues.size() != OscillationParameters::kNParams)
+    {
+        NT_ERROR("GridScan::scan() needs {} nominal parameters, got {}",
+                 static_cast<int>(OscillationParameters::kNParams), nominalValues.size());
+        throw std::invalid_argument("Wrong number of nominal parameters passed to GridScan::scan()");
+    }
+
+    Tensor::NoGradGuard noGrad;
+
+    const std::vector<long int> shape = getShape();
+    std::vector<long int> gridStrides(shape.size(), 1);
+    for (size_t axis = shape.size() - 1; axis > 0; axis--)
+    {
+        gridStrides[axis - 1] = gridStrides[axis] * shape[axis];
+    }
+
+    // everything that only depends on the mixing axes, or only on the mass axes, is worked out once up front
+    const long int nMixings = countCombinations(_axes, _mixingAxes);
+    const long int nMasses = countCombinations(_axes, _massAxes);
+
+    std::vector<Tensor> mixingPMNS;
+    std::vector<long int> mixingOffsets;
+    for (long int mixing = 0; mixing < nMixings; mixing++)
+    {
+        std::vector<float> parameters = nominalValues;
+        std::vector<long int> gridIndex(shape.size(), 0);
+        setCombination(_axes, _mixingAxes, mixing, parameters, gridIndex);
+
+        mixingPMNS.push_back(
+            OscillationParameters::buildPMNS(Tensor(parameters, NTdtypes::kFloat, NTdtypes::kCPU, false)));
+        mixingOffsets.push_back(std::inner_product(gridIndex.begin(), gridIndex.end(), gridStrides.begin(), 0L));
+    }
+
+    std::vector<Tensor> masses;
+    std::vector<long int> massOffsets;
+    for (long int mass = 0; mass < nMasses; mass++)
+    {
+        std::vector<float> parameters = nominalValues;
+        std::vector<long int> gridIndex(shape.size(), 0);
+        setCombination(_axes, _massAxes, mass, parameters, gridIndex);
+
+        masses.push_back(
+            OscillationParameters::buildMasses(Tensor(parameters, NTdtypes::kFloat, NTdtypes::kCPU, false)));
+        massOffsets.push_back(std::inner_product(gridIndex.begin(), gridIndex.end(), gridStrides.begin(), 0L));
+    }
+    const Tensor massTable = Tensor::cat(masses, 0);
+
+    // solvers without the analytic pass only look at the first row of the masses, so can't be batched
+    const std::shared_ptr<const BaseMatterSolver> solver = _propagator.getMatterSolver();
+    long int batchSize = 1;
+    if (solver == nullptr || solver->supportsAnalyticGradients())
+    {
+        batchSize = (_batchSize > 0) ? std::min(_batchSize, nMasses) : nMasses;
+    }
+    const long int nBatches = (nMasses + batchSize - 1) / batchSize;
+
+    // a copy of the energies for each point of a batch, next to its masses
+    const auto nBins = static_cast<int>(_energies.getShape()[0]);
+    std::vector<Tensor> batchEnergies;
+    std::vector<Tensor> batchMasses;
+    for (long int batch = 0; batch < nBatches; batch++)
+    {
+        const long int firstMass = batch * batchSize;
+        const long int lastMass = std::min(firstMass + batchSize, nMasses);
+
+        std::vector<int> energyIndices;
+        std::vector<int> massIndices;
+        for (long int mass = firstMass; mass < lastMass; mass++)
+        {
+            for (int bin = 0; bin < nBins; bin++)
+            {
+                energyIndices.push_back(bin);
+                massIndices.push_back(static_cast<int>(mass));
+            }
+        }
+
+        batchEnergies.push_back(Tensor::indexSelect(_energies, 0, Tensor::fromVector(energyIndices)));
+        batchMasses.push_back(Tensor::indexSelect(massTable, 0, Tensor::fromVector(massIndices)).hasBatchDim(true));
+    }
+
+    std::vector<long int> countShape = {1};
+    for (int dimSize : _unoscillatedCounts.getShape())
+    {
+        countShape.push_back(dimSize);
+    }
+    const Tensor unoscillatedCounts = Tensor::reshape(_unoscillatedCounts, countShape);
+
+    std::vector<float> results(static_cast<size_t>(nMixings * nMasses));
+
+    // each task does one batch of masses for one PMNS matrix, and writes to its own part of the results
+    auto runTask = [&](size_t task) {
+        Tensor::NoGradGuard taskNoGrad;
+
+        const long int mixing = static_cast<long int>(task) / nBatches;
+        const long int batch = static_cast<long int>(task) % nBatches;
+        const long int firstMass = batch * batchSize;
+        const long int nPoints = std::min(batchSize, nMasses - firstMass);
+
+        Propagator propagator = _propagator.clone();
+        Tensor PMNS = mixingPMNS[mixing];
+        Tensor pointMasses = batchMasses[batch];
+        propagator.setPMNS(PMNS);
+        propagator.setMasses(pointMasses);
+
+        std::vector<long int> probsShape = {nPoints};
+        for (size_t dim = 1; dim < countShape.size(); dim++)
+        {
+            probsShape.push_back(countShape[dim]);
+        }
+        Tensor predictions = Tensor::mul(
+            Tensor::reshape(propagator.calculateProbs(batchEnergies[batch]), probsShape), unoscillatedCounts);
+
+        for (long int point = 0; point < nPoints; point++)
+        {
+            const Tensor prediction = predictions.getValues(Tensor::Index({point}));
+            results[mixingOffsets[mixing] + massOffsets[firstMass + point]] =
+                _likelihood.negativeLogLikelihood(prediction).toVector<float>()[0];
+        }
+    };
+
+    const auto nTasks = static_cast<size_t>(nMixings * nBatches);
+    if (_threadPool != nullptr)
+    {
+        _threadPool->parallelFor(nTasks, runTask);
+    }
+    else
+    {
+        for (size_t task = 0; task < nTasks; task++)
+        {
+            runTask(task);
+        }
+    }
+
+    return Tensor::reshape(Tensor(results, NTdtypes::kFloat, NTdtypes::kCPU, false), shape);
+}
+
+Tensor GridScan::toDeltaChi2(const Tensor &negativeLogLikelihoods)
+{
+    NT_PROFILE();
+
+    std::vector<float> values = negativeLogLikelihoods.toVector<float>();
+    const float minimum = *std::min_element(values.begin(), values.end());
+    for (float &value : values)
+    {
+        value = 2.0F * (value - minimum);
+    }
+
+    std::vector<long int> shape;
+    for (int dimSize : negativeLogLikelihoods.getShape())
+    {
+        shape.push_back(dimSize);
+    }
+    return Tensor::reshape(Tensor(values, NTdtypes::kFloat, NTdtypes::kCPU, false), shape);
+}
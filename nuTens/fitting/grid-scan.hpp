@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/fitting/likelihood.hpp>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <nuTens/utils/thread-pool.hpp>
+#include <vector>
+
+/*!
+ * @file grid-scan.hpp
+ * @brief Defines a scan of the likelihood over a grid of oscillation parameters
+ */
+
+class GridScan
+{
+    /*!
+     * @class GridScan
+     * @brief Evaluates a binned likelihood at every point of a grid of oscillation parameters, e.g. for sensitivities
+     * and contours
+     *
+     * Each axis of the grid is one of the parameters of OscillationParameters with a list of values to take. The
+     * parameters that aren't scanned are held at the nominal values passed to scan(). The data are given in the same
+     * way as to a Fitter, and the likelihood of each point is calculated by a BinnedLikelihood, which can be got using
+     * getLikelihood() to change the test statistic.
+     *
+     * The axes are split into the mixing axes (angles and CP phase), which only change the PMNS matrix, and the mass
+     * axes (mass splittings), which only change the masses. The PMNS matrix of each combination of mixing values and
+     * the masses of each combination of mass values are built once at the start and reused for every point that
+     * shares them. Points with the same PMNS matrix are then sent through the propagator together: the masses of up
+     * to getBatchSize() points are stacked along the batch dimension, next to a copy of the energies for each, so a
+     * whole slice of the grid along the mass axes costs a single call to Propagator::calculateProbs(). The stacked
+     * energies and masses are the same for every PMNS matrix so are also only built once.
+     *
+     * Each batch is a separate task, and if a ThreadPool is set the tasks are split between its threads, each working
+     * on its own copy of the propagator. Batching needs the propagator's analytic pass (see
+     * Propagator::setAnalyticGradients()), which the scan turns on for its copy, along with turning off energy
+     * deduplication; with a matter solver that doesn't support it each point is calculated on its own instead. The
+     * likelihood is never differentiated, so nothing is recorded for gradients.
+     * \code{.cpp}
+     *   GridScan scan(propagator, {{OscillationParameters::kDm2_31, dm2Values},
+     *                              {OscillationParameters::kTheta23, theta23Values},
+     *                              {OscillationParameters::kDeltaCP, deltaCPValues}});
+     *   scan.setData(energies, unoscillatedCounts, observedCounts);
+     *   scan.setThreadPool(std::make_shared<ThreadPool>());
+     *   Tensor deltaChi2 = GridScan::toDeltaChi2(scan.scan(nominalParameters));
+     * \endcode
+     */
+
+  public:
+    /// @brief One axis of the grid
+    struct Axis
+    {
+        OscillationParameters::Index parameter; //!< Which parameter the axis scans
+        std::vector<float> values;              //!< The values the parameter takes, in any order
+    };
+
+    /// @brief Constructor
+    /// @param propagator The propagator to calculate the probabilities with, which gets copied
+    /// @param axes The axes of the grid, each of a different parameter
+    GridScan(const Propagator &propagator, std::vector<Axis> axes);
+
+    /// @brief Set the data to compare to, see Fitter::setData()
+    /// @param energies The energy of each bin, with shape {nBins, 1}
+    /// @param unoscillatedCounts The expected counts without oscillations, with shape {nBins, 3, 3}
+    /// @param observedCounts The observed counts, with the same shape as unoscillatedCounts
+    void setData(const Tensor &energies, const Tensor &unoscillatedCounts, const Tensor &observedCounts);
+
+    /// @brief Calculate the negative log likelihood at every point of the grid
+    /// @param nominal The values of the parameters that aren't scanned, as a 1-d tensor in the order of
+    /// OscillationParameters::Index. The values of the scanned parameters are ignored.
+    /// @return Tensor with shape {number of values of axis 0, number of values of axis 1, ...}
+    [[nodiscard]] Tensor scan(const Tensor &nominal) const;
+
+    /// @brief Convert the negative log likelihoods from scan() into the chi squared difference to the best point,
+    /// 2 (-ln L + ln L_max), as used to draw contours
+    [[nodiscard]] static Tensor toDeltaChi2(const Tensor &negativeLogLikelihoods);
+
+    /// @brief Get the likelihood used to compare the prediction to the data, e.g. to change the test statistic
+    [[nodiscard]] inline BinnedLikelihood &getLikelihood()
+    {
+        return _likelihood;
+    }
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set a thread pool to split the batches of points between
+    /// @details If not set, scan() runs on the calling thread
+    inline void setThreadPool(std::shared_ptr<ThreadPool> threadPool)
+    {
+        _threadPool = std::move(threadPool);
+    }
+
+    /// @brief Set the most grid points to send through the propagator in one call
+    /// @details Bigger batches mean fewer calls, but each needs memory for batchSize x nBins probability matrices.
+    /// 0 puts every combination of the mass axes into one batch.
+    inline void setBatchSize(long int batchSize)
+    {
+        _batchSize = batchSize;
+    }
+
+    /// @}
+
+    /// @name Getters
+    /// @{
+
+    [[nodiscard]] inline const std::vector<Axis> &getAxes() const
+    {
+        return _axes;
+    }
+
+    /// @brief Get the number of values along each axis
+    [[nodiscard]] std::vector<long int> getShape() const;
+
+    [[nodiscard]] inline long int getBatchSize() const
+    {
+        return _batchSize;
+    }
+
+    /// @}
+
+  private:
+    Propagator _propagator;
+    std::vector<Axis> _axes;
+
+    // positions in _axes of the axes that change the PMNS matrix and of those that change the masses
+    std::vector<size_t> _mixingAxes;
+    std::vector<size_t> _massAxes;
+
+    bool _hasData = false;
+    Tensor _energies;
+    Tensor _unoscillatedCounts;
+    BinnedLikelihood _likelihood;
+
+    long int _batchSize = 0;
+    std::shared_ptr<ThreadPool> _threadPool;
+};
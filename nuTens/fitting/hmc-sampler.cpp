@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cmath>
+#include <nuTens/fitting/hmc-sampler.hpp>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+// step size tuning using dual averaging, with the settings recommended in the NUTS paper
+class DualAveraging
+{
+  public:
+    explicit DualAveraging(double stepSize)
+    {
+        restart(stepSize);
+    }
+
+    void restart(double stepSize)
+    {
+        _mu = std::log(10.0 * stepSize);
+        _meanError = 0.0;
+        _logAveragedStepSize = 0.0;
+        _iteration = 0;
+    }
+
+    // update using the acceptance probability of the last trajectory, returns the step size to use next
+    double update(double acceptance, double targetAcceptance)
+    {
+        _iteration++;
+        const double iteration = static_cast<double>(_iteration);
+        const double weight = 1.0 / (iteration + _t0);
+        _meanError = (1.0 - weight) * _meanError + weight * (targetAcceptance - acceptance);
+
+        const double logStepSize = _mu - std::sqrt(iteration) / _gamma * _meanError;
+        const double averageWeight = std::pow(iteration, -_kappa);
+        _logAveragedStepSize = averageWeight * logStepSize + (1.0 - averageWeight) * _logAveragedStepSize;
+
+        return std::exp(logStepSize);
+    }
+
+    // the step size to use once tuning is finished
+    [[nodiscard]] double getAveragedStepSize() const
+    {
+        return std::exp(_logAveragedStepSize);
+    }
+
+  private:
+    double _mu;
+    double _meanError;
+    double _logAveragedStepSize;
+    int _iteration;
+
+    const double _gamma = 0.05;
+    const double _t0 = 10.0;
+    const double _kappa = 0.75;
+};
+
+// evaluates the log density of all of the chains and its gradient
+class BatchedDensity
+{
+  public:
+    BatchedDensity(const HMCSampler::logDensityFnType &logDensity, const Tensor &initialStates)
+        : _logDensity(logDensity), _dType(initialStates.getDType()), _device(initialStates.getDevice()),
+          _nChains(initialStates.getShape()[0]), _nParams(initialStates.getShape()[1])
+    {
+    }
+
+    void evaluate(const std::vector<double> &states, std::vector<double> &logDensities,
+                  std::vector<double> &gradients)
+    {
+        NT_PROFILE();
+
+        Tensor params = toTensor(states, {_nChains, _nParams}).requiresGrad(true);
+        Tensor logDensity = _logDensity(params);
+
+        // the chains are independent, so the gradient of the sum gives the gradient of each chain's log density
+        gradients = Tensor::gradients(logDensity.sum(), {params})[0].toVector<double>();
+        logDensities = logDensity.toVector<double>();
+        nEvaluations++;
+    }
+
+    [[nodiscard]] Tensor toTensor(const std::vector<double> &values, const std::vector<long int> &shape) const
+    {
+        std::vector<float> floatValues(values.begin(), values.end());
+        return Tensor::reshape(Tensor(floatValues, _dType, _device, /*requiresGrad=*/false), shape).clone();
+    }
+
+    int nEvaluations = 0;
+
+  private:
+    const HMCSampler::logDensityFnType &_logDensity;
+    NTdtypes::scalarType _dType;
+    NTdtypes::deviceType _device;
+    long int _nChains;
+    long int _nParams;
+};
+} // namespace
+
+HMCSampler::Result HMCSampler::sample(const Tensor &initialStates, int nWarmup, int nSamples) const
+{
+    NT_PROFILE();
+
+    if (initialStates.getNdim() != 2 || initialStates.getShape()[1] != _nParams)
+    {
+        NT_ERROR("Initial states should have shape {{nChains, {}}}", _nParams);
+        throw std::invalid_argument("Initial states of HMCSampler have the wrong shape");
+    }
+
+    const auto nChains = static_cast<size_t>(initialStates.getShape()[0]);
+    const auto nParams = static_cast<size_t>(_nParams);
+
+    BatchedDensity density(_logDensity, initialStates);
+    std::mt19937_64 generator(_seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // current state of each chain, flattened as [chain * nParams + param]
+    std::vector<double> states = initialStates.toVector<double>();
+    std::vector<double> logDensities;
+    std::vector<double> gradients;
+    density.evaluate(states, logDensities, gradients);
+
+    std::vector<double> stepSizes(nChains, _initialStepSize);
+    std::vector<DualAveraging> stepSizeTuners(nChains, DualAveraging(_initialStepSize));
+    std::vector<double> inverseMassMatrix(nParams, 1.0);
+
+    // the mass matrix is estimated from the middle of the warmup, after the chains have found the typical set and
+    // leaving time to tune the step sizes to it afterwards
+    const int massWindowStart = (nWarmup * 15) / 100;
+    const int massWindowEnd = (nWarmup * 90) / 100;
+    int nMassSamples = 0;
+    std::vector<double> paramMeans(nParams, 0.0);
+    std::vector<double> paramSumSquares(nParams, 0.0);
+
+    std::vector<float> samples;
+    std::vector<float> sampleLogDensities;
+    samples.reserve(static_cast<size_t>(nSamples) * nChains * nParams);
+    sampleLogDensities.reserve(static_cast<size_t>(nSamples) * nChains);
+    std::vector<int> nAccepted(nChains, 0);
+
+    std::vector<double> momenta(nChains * nParams);
+    std::vector<double> newStates;
+    std::vector<double> newLogDensities;
+    std::vector<double> newGradients;
+    for (int iteration = 0; iteration < nWarmup + nSamples; iteration++)
+    {
+        const bool warmup = iteration < nWarmup;
+
+        // momenta drawn from N(0, M), for the diagonal mass matrix M
+        std::vector<double> initialKinetic(nChains, 0.0);
+        for (size_t chain = 0; chain < nChains; chain++)
+        {
+            for (size_t param = 0; param < nParams; param++)
+            {
+                const size_t i = chain * nParams + param;
+                momenta[i] = normal(generator) / std::sqrt(inverseMassMatrix[param]);
+                initialKinetic[chain] += 0.5 * momenta[i] * momenta[i] * inverseMassMatrix[param];
+            }
+        }
+
+        // leapfrog integration of all chains at once, each with its own step size
+        newStates = states;
+        newGradients = gradients;
+        newLogDensities = logDensities;
+        for (int step = 0; step < _nLeapfrogSteps; step++)
+        {
+            for (size_t i = 0; i < momenta.size(); i++)
+            {
+                const double stepSize = stepSizes[i / nParams];
+                momenta[i] += 0.5 * stepSize * newGradients[i];
+                newStates[i] += stepSize * inverseMassMatrix[i % nParams] * momenta[i];
+            }
+
+            density.evaluate(newStates, newLogDensities, newGradients);
+
+            for (size_t i = 0; i < momenta.size(); i++)
+            {
+                momenta[i] += 0.5 * stepSizes[i / nParams] * newGradients[i];
+            }
+        }
+
+        // metropolis accept / reject, where the hamiltonian is the negative log density plus the kinetic energy
+        for (size_t chain = 0; chain < nChains; chain++)
+        {
+            double finalKinetic = 0.0;
+            for (size_t param = 0; param < nParams; param++)
+            {
+                const size_t i = chain * nParams + param;
+                finalKinetic += 0.5 * momenta[i] * momenta[i] * inverseMassMatrix[param];
+            }
+
+            const double energyChange =
+                (-newLogDensities[chain] + finalKinetic) - (-logDensities[chain] + initialKinetic[chain]);
+            const double acceptance = std::isfinite(energyChange) ? std::min(1.0, std::exp(-energyChange)) : 0.0;
+
+            if (uniform(generator) < acceptance)
+            {
+                std::copy_n(newStates.begin() + chain * nParams, nParams, states.begin() + chain * nParams);
+                std::copy_n(newGradients.begin() + chain * nParams, nParams, gradients.begin() + chain * nParams);
+                logDensities[chain] = newLogDensities[chain];
+                nAccepted[chain] += warmup ? 0 : 1;
+            }
+
+            if (warmup)
+            {
+                stepSizes[chain] = stepSizeTuners[chain].update(acceptance, _targetAcceptance);
+            }
+        }
+
+        if (warmup && _adaptMassMatrix && iteration >= massWindowStart && iteration < massWindowEnd)
+        {
+            // Welford's running variance, pooling all of the chains
+            for (size_t chain = 0; chain < nChains; chain++)
+            {
+                nMassSamples++;
+                for (size_t param = 0; param < nParams; param++)
+                {
+                    const double value = states[chain * nParams + param];
+                    const double delta = value - paramMeans[param];
+                    paramMeans[param] += delta / nMassSamples;
+                    paramSumSquares[param] += delta * (value - paramMeans[param]);
+                }
+            }
+
+            if (iteration == massWindowEnd - 1 && nMassSamples > 1)
+            {
+                // shrink towards a small value, as in Stan, so a poor estimate from few samples isn't too extreme
+                const double nSamplesMass = nMassSamples;
+                for (size_t param = 0; param < nParams; param++)
+                {
+                    const double variance = paramSumSquares[param] / (nSamplesMass - 1.0);
+                    inverseMassMatrix[param] =
+                        (nSamplesMass / (nSamplesMass + 5.0)) * variance + 1e-3 * (5.0 / (nSamplesMass + 5.0));
+                }
+
+                // the best step size is different with the new mass matrix
+                for (size_t chain = 0; chain < nChains; chain++)
+                {
+                    stepSizeTuners[chain].restart(stepSizes[chain]);
+                }
+            }
+        }
+
+        if (iteration == nWarmup - 1)
+        {
+            for (size_t chain = 0; chain < nChains; chain++)
+            {
+                stepSizes[chain] = stepSizeTuners[chain].getAveragedStepSize();
+            }
+        }
+
+        if (!warmup)
+        {
+            samples.insert(samples.end(), states.begin(), states.end());
+            sampleLogDensities.insert(sampleLogDensities.end(), logDensities.begin(), logDensities.end());
+        }
+    }
+
+    Result result;
+    const auto nChainsLong = static_cast<long int>(nChains);
+    result.samples = Tensor::reshape(
+        Tensor(samples, initialStates.getDType(), initialStates.getDevice(), /*requiresGrad=*/false),
+        {nSamples, nChainsLong, static_cast<long int>(nParams)});
+    result.logDensities = Tensor::reshape(
+        Tensor(sampleLogDensities, initialStates.getDType(), initialStates.getDevice(), /*requiresGrad=*/false),
+        {nSamples, nChainsLong});
+    result.acceptanceRates.resize(nChains);
+    for (size_t chain = 0; chain < nChains; chain++)
+    {
+        result.acceptanceRates[chain] = nSamples > 0 ? static_cast<double>(nAccepted[chain]) / nSamples : 0.0;
+    }
+    result.stepSizes = stepSizes;
+    result.inverseMassMatrix = inverseMassMatrix;
+    result.nEvaluations = density.nEvaluations;
+
+    return result;
+}
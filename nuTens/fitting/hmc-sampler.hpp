@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/*!
+ * @file hmc-sampler.hpp
+ * @brief Defines a hamiltonian monte carlo sampler which runs many chains at once
+ */
+
+class HMCSampler
+{
+    /*!
+     * @class HMCSampler
+     * @brief Draws samples from a distribution using hamiltonian monte carlo (\cite HMC), with many chains at once
+     *
+     * Each iteration gives every chain a random momentum and then follows the hamiltonian dynamics defined by the
+     * log density for a number of leapfrog steps, before accepting or rejecting the end point. Because the gradient of
+     * the log density steers the chains towards likely regions, far fewer evaluations are needed than for a random
+     * walk Metropolis sampler, especially with many parameters.
+     *
+     * The states of all the chains are held in a single tensor of shape {nChains, nParams}, and the log density is
+     * evaluated for all of them at once, so a single backward pass gives the gradients for every chain. The log
+     * density function should return a tensor of shape {nChains}. If it can't be vectorised over the chains it can
+     * work out each row separately and join the results up using Tensor::cat(), which still only needs one backward
+     * pass. It may return -infinity (or NaN) outside of the allowed region, e.g. for a prior with bounds, and any
+     * trajectory which ends up there is rejected.
+     *
+     * During warmup, the step size of each chain is tuned using dual averaging (\cite NUTS) to get the target
+     * acceptance rate, and a diagonal mass matrix is estimated from the variance of the samples of all chains in the
+     * middle part of the warmup, which takes care of parameters with very different scales. The step sizes are then
+     * tuned again for the new mass matrix.
+     * \code{.cpp}
+     *   HMCSampler sampler(logDensity, nParams);
+     *   sampler.setNLeapfrogSteps(20);
+     *   HMCSampler::Result result = sampler.sample(initialStates, 1000, 1000);
+     * \endcode
+     */
+
+  public:
+    /// The log of the (unnormalised) probability density, given {nChains, nParams} parameters returns {nChains}
+    using logDensityFnType = std::function<Tensor(const Tensor &params)>;
+
+    /// @struct Result
+    /// @brief The samples drawn and the tuning that was found during warmup
+    struct Result
+    {
+        /// The samples, with shape {nSamples, nChains, nParams}
+        Tensor samples;
+        /// The log density of each sample, with shape {nSamples, nChains}
+        Tensor logDensities;
+        /// The fraction of proposals accepted after warmup, for each chain
+        std::vector<double> acceptanceRates;
+        /// The tuned step size of each chain
+        std::vector<double> stepSizes;
+        /// The diagonal of the inverse mass matrix, i.e. the estimated variance of each parameter
+        std::vector<double> inverseMassMatrix;
+        /// The number of times the log density was evaluated (for all chains at once)
+        int nEvaluations;
+    };
+
+    /// @brief Constructor
+    /// @param logDensity The log density to sample from
+    /// @param nParams The number of parameters
+    HMCSampler(logDensityFnType logDensity, int nParams) : _logDensity(std::move(logDensity)), _nParams(nParams)
+    {
+    }
+
+    /// @brief Run the chains
+    /// @param initialStates Where to start each chain, with shape {nChains, nParams}. Starting the chains at different
+    /// points makes it easier to spot when they haven't converged.
+    /// @param nWarmup The number of warmup iterations, which are thrown away
+    /// @param nSamples The number of samples to draw from each chain after warmup
+    [[nodiscard]] Result sample(const Tensor &initialStates, int nWarmup, int nSamples) const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the number of leapfrog steps in each trajectory
+    inline void setNLeapfrogSteps(int nLeapfrogSteps)
+    {
+        _nLeapfrogSteps = nLeapfrogSteps;
+    }
+
+    /// @brief Set the step size that each chain starts warmup with
+    inline void setInitialStepSize(double initialStepSize)
+    {
+        _initialStepSize = initialStepSize;
+    }
+
+    /// @brief Set the acceptance rate that the step sizes are tuned to get
+    inline void setTargetAcceptance(double targetAcceptance)
+    {
+        _targetAcceptance = targetAcceptance;
+    }
+
+    /// @brief Set whether to estimate the mass matrix during warmup
+    /// @details If not, the identity is used, so the parameters should be scaled to have similar variances
+    inline void setAdaptMassMatrix(bool adaptMassMatrix)
+    {
+        _adaptMassMatrix = adaptMassMatrix;
+    }
+
+    /// @brief Set the seed of the random number generator
+    inline void setSeed(uint64_t seed)
+    {
+        _seed = seed;
+    }
+
+    /// @}
+
+  private:
+    logDensityFnType _logDensity;
+    int _nParams;
+    int _nLeapfrogSteps = 10;
+    double _initialStepSize = 0.1;
+    double _targetAcceptance = 0.8;
+    bool _adaptMassMatrix = true;
+    uint64_t _seed = 12345;
+};
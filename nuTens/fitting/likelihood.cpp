@@ -0,0 +1,126 @@
+#include <limits>
+#include <nuTens/fitting/likelihood.hpp>
+#include <stdexcept>
+
+void BinnedLikelihood::setData(const Tensor &observedCounts)
+{
+    NT_PROFILE();
+
+    _observedCounts = observedCounts;
+
+    _minCount = Tensor({std::numeric_limits<float>::min()}, observedCounts.getDType(), observedCounts.getDevice(),
+                       /*requiresGrad=*/false);
+    _maxCount = Tensor({std::numeric_limits<float>::infinity()}, observedCounts.getDType(),
+                       observedCounts.getDevice(), /*requiresGrad=*/false);
+
+    _logObservedCounts = Tensor::log(Tensor::clamp(observedCounts, _minCount, _maxCount));
+    _hasData = true;
+}
+
+void BinnedLikelihood::setMCVariances(const Tensor &variances)
+{
+    NT_PROFILE();
+
+    _mcVariances = variances;
+    _hasMCVariances = true;
+}
+
+Tensor BinnedLikelihood::negativeLogLikelihood(const Tensor &prediction) const
+{
+    NT_PROFILE();
+
+    if (!_hasData)
+    {
+        NT_ERROR("BinnedLikelihood::setData() must be called before calculating the likelihood");
+        throw std::logic_error("No data set in BinnedLikelihood");
+    }
+
+    if (prediction.getShape() != _observedCounts.getShape())
+    {
+        NT_ERROR("Shapes of the prediction and the observed counts don't match");
+        throw std::invalid_argument("Prediction must have the same shape as the observed counts");
+    }
+
+    if (_statistic == kBarlowBeestonLite && !_hasMCVariances)
+    {
+        NT_ERROR("BinnedLikelihood::setMCVariances() must be called to use kBarlowBeestonLite");
+        throw std::logic_error("No MC variances set in BinnedLikelihood");
+    }
+
+    // copied into the forward and backward functions, as the backward one can outlive this likelihood
+    const Statistic statistic = _statistic;
+    const Tensor observed = _observedCounts;
+    const Tensor logObserved = _logObservedCounts;
+    const Tensor minCount = _minCount;
+    const Tensor maxCount = _maxCount;
+    const Tensor one = Tensor({1.0}, observed.getDType(), observed.getDevice(), /*requiresGrad=*/false);
+    const Tensor variances = _hasMCVariances ? _mcVariances
+                                             : Tensor({0.0}, observed.getDType(), observed.getDevice(),
+                                                      /*requiresGrad=*/false);
+
+    // saves the derivative of the likelihood with respect to each predicted count
+    auto forward = [=](const std::vector<Tensor> &in, std::vector<Tensor> &saved) -> std::vector<Tensor> {
+        Tensor mu = Tensor::clamp(in[0], minCount, maxCount);
+        Tensor residuals = observed - mu;
+
+        Tensor values;
+        Tensor gradients;
+        switch (statistic)
+        {
+        case kPoisson: {
+            values = Tensor::mul(observed, logObserved - Tensor::log(mu)) - residuals;
+            gradients = Tensor::div(-residuals, mu);
+            break;
+        }
+
+        case kBarlowBeestonLite: {
+            // the beta that minimises the likelihood is a root of a quadratic, written so that beta - 1 doesn't lose
+            // precision when V is small: beta - 1 = 2 V (n - mu) / (mu^2 s) with
+            // s = 1 + V / mu + sqrt((1 - V / mu)^2 + 4 n V / mu^2)
+            Tensor muSq = Tensor::mul(mu, mu);
+            Tensor ratios = Tensor::div(variances, mu);
+            Tensor discriminants = Tensor::pow(one - ratios, 2.0F) +
+                                   Tensor::div(Tensor::scale(Tensor::mul(observed, variances), 4.0), muSq);
+            Tensor s = one + ratios + Tensor::pow(discriminants, 0.5F);
+            Tensor betaMinusOne =
+                Tensor::div(Tensor::scale(Tensor::mul(variances, residuals), 2.0), Tensor::mul(muSq, s));
+
+            // the constraint (beta - 1)^2 mu^2 / 2V, which simplifies to (beta - 1)(n - mu) / s so V can be 0
+            Tensor constraints = Tensor::div(Tensor::mul(betaMinusOne, residuals), s);
+            Tensor scaledMu = Tensor::clamp(mu + Tensor::mul(betaMinusOne, mu), minCount, maxCount);
+            values = scaledMu - observed + Tensor::mul(observed, logObserved - Tensor::log(scaledMu)) + constraints;
+
+            // beta is at a minimum, so only the explicit dependence on mu is left:
+            // beta - n / mu + (beta - 1)^2 mu / V
+            gradients =
+                one + betaMinusOne - Tensor::div(observed, mu) + Tensor::div(Tensor::scale(constraints, 2.0), mu);
+            break;
+        }
+
+        case kChi2: {
+            Tensor totalVariances = mu + variances;
+            values = Tensor::div(Tensor::mul(residuals, residuals), Tensor::scale(totalVariances, 2.0));
+            gradients = -Tensor::div(residuals + values, totalVariances);
+            break;
+        }
+        }
+
+        saved = {gradients};
+        return {values.sum()};
+    };
+
+    auto backward = [](const std::vector<Tensor> &saved,
+                       const std::vector<Tensor> &gradOutputs) -> std::vector<Tensor> {
+        return {Tensor::mul(gradOutputs[0], saved[0])};
+    };
+
+    return Tensor::customGrad({prediction}, forward, backward)[0];
+}
+
+Tensor BinnedLikelihood::gaussianPenalty(const Tensor &values, const Tensor &centres, const Tensor &widths)
+{
+    NT_PROFILE();
+
+    Tensor pulls = Tensor::div(values - centres, widths);
+    return Tensor::scale(Tensor::mul(pulls, pulls).sum(), 0.5);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+
+/*!
+ * @file likelihood.hpp
+ * @brief Defines binned likelihoods comparing predicted and observed counts
+ */
+
+class BinnedLikelihood
+{
+    /*!
+     * @class BinnedLikelihood
+     * @brief Calculates the negative log likelihood of observed counts given predicted counts, with a fused gradient
+     *
+     * The available test statistics, for predicted counts \f$ \mu_i \f$ and observed counts \f$ n_i \f$, are
+     *  - kPoisson: the Poisson likelihood, shifted by a constant so that it is 0 when the prediction matches the data
+     *  exactly (twice this is the Baker-Cousins chi squared)
+     *    \f{equation}
+     *      -\ln L = \sum_i \mu_i - n_i + n_i \ln \frac{n_i}{\mu_i}
+     *    \f}
+     *  - kBarlowBeestonLite: the Poisson likelihood where the prediction in each bin can be scaled by \f$ \beta_i \f$
+     *  to account for the limited size of the simulation the prediction was made from, with a gaussian constraint on
+     *  \f$ \beta_i \f$ of width \f$ \sqrt{V_i} / \mu_i \f$, for \f$ V_i \f$ the sum of the squared weights of the
+     *  simulated events in the bin (see setMCVariances()). Each \f$ \beta_i \f$ is profiled out analytically (\cite
+     *  BarlowBeeston, \cite BarlowBeestonLite), so this costs little more than kPoisson.
+     *  - kChi2: the gaussian approximation, halved so it is on the same scale as the others
+     *    \f{equation}
+     *      -\ln L = \sum_i \frac{(n_i - \mu_i)^2}{2 (\mu_i + V_i)}
+     *    \f}
+     *
+     * The derivative of the likelihood with respect to each predicted count is worked out along with the value, and
+     * is all that is kept for the backward pass, so none of the intermediate tensors are recorded. Bins with no
+     * observed counts are allowed, but predictions should be positive.
+     * \code{.cpp}
+     *   BinnedLikelihood likelihood(BinnedLikelihood::kBarlowBeestonLite);
+     *   likelihood.setData(observedCounts);
+     *   likelihood.setMCVariances(sumSquaredWeights);
+     *   Tensor nll = likelihood.negativeLogLikelihood(prediction) + BinnedLikelihood::gaussianPenalty(...);
+     * \endcode
+     */
+
+  public:
+    /// The test statistic to use
+    enum Statistic
+    {
+        kPoisson,
+        kBarlowBeestonLite,
+        kChi2,
+    };
+
+    /// @brief Constructor
+    /// @param statistic The test statistic to calculate
+    explicit BinnedLikelihood(Statistic statistic = kPoisson) : _statistic(statistic)
+    {
+    }
+
+    /// @brief Get the negative log likelihood of the data
+    /// @param prediction The predicted counts, with the same shape as the observed counts
+    /// @return Scalar tensor
+    [[nodiscard]] Tensor negativeLogLikelihood(const Tensor &prediction) const;
+
+    /// @brief Get a gaussian penalty on some values, i.e. sum_i (x_i - c_i)^2 / 2 sigma_i^2
+    /// @param values The values, e.g. some nuisance parameters
+    /// @param centres The central value of each, broadcastable to the shape of values
+    /// @param widths The width of each, broadcastable to the shape of values
+    /// @return Scalar tensor
+    [[nodiscard]] static Tensor gaussianPenalty(const Tensor &values, const Tensor &centres, const Tensor &widths);
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the observed counts
+    void setData(const Tensor &observedCounts);
+
+    /// @brief Set the variance of the predicted counts due to the limited size of the simulation
+    /// @details Usually the sum of the squared weights of the simulated events in each bin. Needed for
+    /// kBarlowBeestonLite, and added to the variance of kChi2 if set. Treated as a constant.
+    /// @param variances The variances, with the same shape as the observed counts
+    void setMCVariances(const Tensor &variances);
+
+    inline void setStatistic(Statistic statistic)
+    {
+        _statistic = statistic;
+    }
+
+    /// @}
+
+    /// @name Getters
+    /// @{
+
+    [[nodiscard]] inline Statistic getStatistic() const
+    {
+        return _statistic;
+    }
+
+    [[nodiscard]] inline const Tensor &getData() const
+    {
+        return _observedCounts;
+    }
+
+    /// @}
+
+  private:
+    Statistic _statistic;
+
+    bool _hasData = false;
+    Tensor _observedCounts;
+    Tensor _logObservedCounts;
+
+    bool _hasMCVariances = false;
+    Tensor _mcVariances;
+
+    // counts are kept between these in the logs so that empty bins are allowed
+    Tensor _minCount;
+    Tensor _maxCount;
+};
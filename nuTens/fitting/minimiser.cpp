@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <nuTens/fitting/minimiser.hpp>
+#include <stdexcept>
+
+namespace
+{
+double dot(const std::vector<double> &a, const std::vector<double> &b)
+{
+    double ret = 0.0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        ret += a[i] * b[i];
+    }
+    return ret;
+}
+
+double maxAbs(const std::vector<double> &a)
+{
+    double ret = 0.0;
+    for (double value : a)
+    {
+        ret = std::max(ret, std::abs(value));
+    }
+    return ret;
+}
+
+// get the values of a 1-d tensor, or fill with a default if it hasn't been set
+std::vector<double> getValuesOr(const Tensor &tensor, size_t size, double fill)
+{
+    if (tensor.getDType() == NTdtypes::kUninitScalar)
+    {
+        return std::vector<double>(size, fill);
+    }
+
+    std::vector<double> ret = tensor.toVector<double>();
+    if (ret.size() != size)
+    {
+        NT_ERROR("Minimiser setting has {} values but there are {} parameters", ret.size(), size);
+        throw std::invalid_argument("Minimiser bounds and scales must have one value per parameter");
+    }
+    return ret;
+}
+} // namespace
+
+void Minimiser::setBounds(const Tensor &lower, const Tensor &upper)
+{
+    NT_PROFILE();
+
+    if (lower.getNumel() != upper.getNumel())
+    {
+        NT_ERROR("Got {} lower bounds but {} upper bounds", lower.getNumel(), upper.getNumel());
+        throw std::invalid_argument("Need the same number of lower and upper bounds");
+    }
+
+    _lower = lower;
+    _upper = upper;
+}
+
+void Minimiser::setScales(const Tensor &scales)
+{
+    NT_PROFILE();
+
+    _scales = scales;
+}
+
+bool Minimiser::valueConverged(double oldValue, double newValue) const
+{
+    return std::abs(oldValue - newValue) <= _valueTolerance * std::max({std::abs(oldValue), std::abs(newValue), 1.0});
+}
+
+Minimiser::Problem::Problem(const Minimiser &minimiser, const objectiveFnType &objective, const Tensor &start)
+    : objective(objective), dType(start.getDType()), device(start.getDevice()),
+      bestValue(std::numeric_limits<double>::infinity())
+{
+    NT_PROFILE();
+
+    const size_t nParams = start.getNumel();
+    scales = getValuesOr(minimiser._scales, nParams, 1.0);
+    lower = getValuesOr(minimiser._lower, nParams, -std::numeric_limits<double>::infinity());
+    upper = getValuesOr(minimiser._upper, nParams, std::numeric_limits<double>::infinity());
+
+    // work with the parameters divided by their scales
+    this->start = start.toVector<double>();
+    for (size_t i = 0; i < nParams; i++)
+    {
+        this->start[i] /= scales[i];
+        lower[i] /= scales[i];
+        upper[i] /= scales[i];
+    }
+    project(this->start);
+    best = this->start;
+}
+
+double Minimiser::Problem::evaluate(const std::vector<double> &x, std::vector<double> &gradient)
+{
+    NT_PROFILE();
+
+    Tensor params = toParams(x).requiresGrad(true);
+    Tensor value = objective(params);
+
+    gradient = Tensor::gradients(value, {params})[0].toVector<double>();
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        gradient[i] *= scales[i];
+    }
+
+    nEvaluations++;
+    const double ret = value.toVector<double>()[0];
+    if (ret < bestValue)
+    {
+        bestValue = ret;
+        best = x;
+    }
+
+    return ret;
+}
+
+void Minimiser::Problem::project(std::vector<double> &x) const
+{
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] = std::clamp(x[i], lower[i], upper[i]);
+    }
+}
+
+std::vector<double> Minimiser::Problem::projectGradient(const std::vector<double> &x,
+                                                        const std::vector<double> &gradient) const
+{
+    std::vector<double> ret = gradient;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        if ((x[i] <= lower[i] && gradient[i] > 0.0) || (x[i] >= upper[i] && gradient[i] < 0.0))
+        {
+            ret[i] = 0.0;
+        }
+    }
+    return ret;
+}
+
+Tensor Minimiser::Problem::toParams(const std::vector<double> &x) const
+{
+    std::vector<double> values(x.size());
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        values[i] = x[i] * scales[i];
+    }
+
+    // only rounded if the starting parameters were single precision
+    return Tensor::fromVector(values, device).dType(dType);
+}
+
+Minimiser::Result Minimiser::Problem::getResult(int nIterations, bool converged) const
+{
+    return {toParams(best), bestValue, nIterations, nEvaluations, converged};
+}
+
+Minimiser::Result AdamMinimiser::minimise(const objectiveFnType &objective, const Tensor &start) const
+{
+    NT_PROFILE();
+
+    Problem problem(*this, objective, start);
+    std::vector<double> x = problem.start;
+    std::vector<double> gradient;
+    std::vector<double> firstMoment(x.size(), 0.0);
+    std::vector<double> secondMoment(x.size(), 0.0);
+
+    double beta1Power = 1.0;
+    double beta2Power = 1.0;
+    for (int iteration = 0; iteration < _maxIterations; iteration++)
+    {
+        problem.evaluate(x, gradient);
+        if (maxAbs(problem.projectGradient(x, gradient)) < _gradientTolerance)
+        {
+            return problem.getResult(iteration, true);
+        }
+
+        beta1Power *= _beta1;
+        beta2Power *= _beta2;
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            firstMoment[i] = _beta1 * firstMoment[i] + (1.0 - _beta1) * gradient[i];
+            secondMoment[i] = _beta2 * secondMoment[i] + (1.0 - _beta2) * gradient[i] * gradient[i];
+
+            // correct for the averages starting off at 0
+            const double firstMomentHat = firstMoment[i] / (1.0 - beta1Power);
+            const double secondMomentHat = secondMoment[i] / (1.0 - beta2Power);
+            x[i] -= _learningRate * firstMomentHat / (std::sqrt(secondMomentHat) + _epsilon);
+        }
+        problem.project(x);
+    }
+
+    return problem.getResult(_maxIterations, false);
+}
+
+Minimiser::Result LBFGSMinimiser::minimise(const objectiveFnType &objective, const Tensor &start) const
+{
+    NT_PROFILE();
+
+    Problem problem(*this, objective, start);
+    std::vector<double> x = problem.start;
+    std::vector<double> gradient;
+    double value = problem.evaluate(x, gradient);
+
+    // the changes in x and the gradient over the last few iterations
+    std::deque<std::vector<double>> xSteps;
+    std::deque<std::vector<double>> gradientSteps;
+
+    for (int iteration = 0; iteration < _maxIterations; iteration++)
+    {
+        const std::vector<double> projectedGradient = problem.projectGradient(x, gradient);
+        if (maxAbs(projectedGradient) < _gradientTolerance)
+        {
+            return problem.getResult(iteration, true);
+        }
+
+        // two loop recursion to apply the approximate inverse hessian to the gradient, ignoring parameters that are
+        // held on their bounds
+        std::vector<double> direction = projectedGradient;
+        std::vector<double> alphas(xSteps.size());
+        for (size_t k = xSteps.size(); k-- > 0;)
+        {
+            alphas[k] = dot(xSteps[k], direction) / dot(gradientSteps[k], xSteps[k]);
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                direction[i] -= alphas[k] * gradientSteps[k][i];
+            }
+        }
+
+        double initialStep = 1.0;
+        if (xSteps.empty())
+        {
+            // no idea of the curvature yet so don't move any parameter by more than about its scale
+            initialStep = std::min(1.0, 1.0 / maxAbs(direction));
+        }
+        else
+        {
+            const double gamma = dot(xSteps.back(), gradientSteps.back()) /
+                                 dot(gradientSteps.back(), gradientSteps.back());
+            for (double &component : direction)
+            {
+                component *= gamma;
+            }
+        }
+
+        for (size_t k = 0; k < xSteps.size(); k++)
+        {
+            const double beta = dot(gradientSteps[k], direction) / dot(gradientSteps[k], xSteps[k]);
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                direction[i] += xSteps[k][i] * (alphas[k] - beta);
+            }
+        }
+
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            direction[i] = (projectedGradient[i] == 0.0) ? 0.0 : -direction[i];
+        }
+
+        // not a descent direction, the history is no good so start again from steepest descent
+        if (dot(direction, projectedGradient) >= 0.0)
+        {
+            xSteps.clear();
+            gradientSteps.clear();
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                direction[i] = -projectedGradient[i];
+            }
+            initialStep = std::min(1.0, 1.0 / maxAbs(direction));
+        }
+
+        // backtracking line search along the projected path until the value goes down enough
+        std::vector<double> newX(x.size());
+        std::vector<double> newGradient;
+        double newValue = value;
+        bool foundStep = false;
+        double step = initialStep;
+        for (int lineSearchStep = 0; lineSearchStep < _maxLineSearchSteps; lineSearchStep++)
+        {
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                newX[i] = x[i] + step * direction[i];
+            }
+            problem.project(newX);
+
+            std::vector<double> change(x.size());
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                change[i] = newX[i] - x[i];
+            }
+
+            newValue = problem.evaluate(newX, newGradient);
+            if (std::isfinite(newValue) && newValue <= value + 1e-4 * dot(gradient, change))
+            {
+                foundStep = true;
+                break;
+            }
+            step *= 0.5;
+        }
+
+        if (!foundStep)
+        {
+            // can't even go downhill along the gradient, at the precision the function is calculated to this is the
+            // minimum
+            if (xSteps.empty())
+            {
+                return problem.getResult(iteration + 1, true);
+            }
+
+            // otherwise the approximate hessian is no good, so start again from steepest descent
+            xSteps.clear();
+            gradientSteps.clear();
+            continue;
+        }
+
+        std::vector<double> xStep(x.size());
+        std::vector<double> gradientStep(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            xStep[i] = newX[i] - x[i];
+            gradientStep[i] = newGradient[i] - gradient[i];
+        }
+
+        // only keep steps which keep the approximate hessian positive definite
+        if (dot(xStep, gradientStep) > 1e-10 * dot(gradientStep, gradientStep))
+        {
+            xSteps.push_back(xStep);
+            gradientSteps.push_back(gradientStep);
+            if (static_cast<int>(xSteps.size()) > _historySize)
+            {
+                xSteps.pop_front();
+                gradientSteps.pop_front();
+            }
+        }
+
+        const bool converged = valueConverged(value, newValue);
+        x = newX;
+        gradient = newGradient;
+        value = newValue;
+
+        if (converged)
+        {
+            return problem.getResult(iteration + 1, true);
+        }
+    }
+
+    return problem.getResult(_maxIterations, false);
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <functional>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/*!
+ * @file minimiser.hpp
+ * @brief Defines gradient based minimisers which run entirely in c++
+ */
+
+class Minimiser
+{
+    /*!
+     * @class Minimiser
+     * @brief Base class for minimisers of a scalar function of a 1-d parameter tensor, with optional box constraints
+     *
+     * The function is given the parameters as a tensor which requires a gradient, and should return a scalar tensor
+     * calculated from them, e.g. a negative log likelihood. Its gradient is then worked out by the tensor library, so
+     * the whole minimisation happens in c++ without any finite differences.
+     *
+     * Parameters can be kept between lower and upper bounds (see setBounds()). Setting the lower and upper bound of a
+     * parameter to the same value fixes it. Parameters on very different scales (e.g. mixing angles and mass
+     * splittings) should be given scales (see setScales()), which are roughly the size of a sensible step in each
+     * parameter. Internally the minimisers work with the parameters divided by their scales.
+     *
+     * The minimisers keep the parameters in double precision, but the function is given them with the type of the
+     * starting tensor. With single precision parameters, steps smaller than about 1e-7 of a parameter's value are
+     * lost, which can stop the line search of LBFGSMinimiser close to the minimum, so use double precision starting
+     * parameters (and a model that works in double precision) when a very tight convergence is needed.
+     */
+
+  public:
+    /// The function to minimise
+    using objectiveFnType = std::function<Tensor(const Tensor &params)>;
+
+    /// @struct Result
+    /// @brief The outcome of a minimisation
+    struct Result
+    {
+        /// The parameters with the lowest value found
+        Tensor params;
+        /// The lowest value found
+        double value;
+        /// The number of iterations run
+        int nIterations;
+        /// The number of times the function was evaluated
+        int nEvaluations;
+        /// Whether one of the convergence criteria was met, rather than running out of iterations
+        bool converged;
+    };
+
+    virtual ~Minimiser() = default;
+
+    /// @brief Find the minimum of a function
+    /// @param objective The function to minimise
+    /// @param start Where to start, a 1-d tensor. Moved inside the bounds if it isn't already.
+    [[nodiscard]] virtual Result minimise(const objectiveFnType &objective, const Tensor &start) const = 0;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set box constraints on the parameters
+    /// @param lower The lowest allowed value of each parameter, can be -infinity
+    /// @param upper The highest allowed value of each parameter, can be infinity
+    void setBounds(const Tensor &lower, const Tensor &upper);
+
+    /// @brief Set the typical size of a step in each parameter
+    void setScales(const Tensor &scales);
+
+    /// @brief Set the maximum number of iterations to run for
+    inline void setMaxIterations(int maxIterations)
+    {
+        _maxIterations = maxIterations;
+    }
+
+    /// @brief Stop once the largest component of the gradient (with respect to the scaled parameters), ignoring
+    /// components that point out of the bounds, falls below this
+    inline void setGradientTolerance(double gradientTolerance)
+    {
+        _gradientTolerance = gradientTolerance;
+    }
+
+    /// @brief Stop once a step changes the value by less than this fraction of the value
+    inline void setValueTolerance(double valueTolerance)
+    {
+        _valueTolerance = valueTolerance;
+    }
+
+    /// @}
+
+  protected:
+    // the state of a minimisation, in terms of the scaled parameters
+    struct Problem
+    {
+        Problem(const Minimiser &minimiser, const objectiveFnType &objective, const Tensor &start);
+
+        // evaluate the function at x, filling the gradient
+        double evaluate(const std::vector<double> &x, std::vector<double> &gradient);
+
+        // move x inside the bounds
+        void project(std::vector<double> &x) const;
+
+        // zero the components of the gradient that point out of the bounds at x
+        [[nodiscard]] std::vector<double> projectGradient(const std::vector<double> &x,
+                                                          const std::vector<double> &gradient) const;
+
+        // convert scaled parameters back into a tensor of real parameters
+        [[nodiscard]] Tensor toParams(const std::vector<double> &x) const;
+
+        [[nodiscard]] Result getResult(int nIterations, bool converged) const;
+
+        const objectiveFnType &objective;
+        NTdtypes::scalarType dType;
+        NTdtypes::deviceType device;
+        std::vector<double> scales;
+        std::vector<double> lower;
+        std::vector<double> upper;
+        std::vector<double> start;
+
+        std::vector<double> best;
+        double bestValue;
+        int nEvaluations = 0;
+    };
+
+    [[nodiscard]] bool valueConverged(double oldValue, double newValue) const;
+
+    int _maxIterations = 1000;
+    double _gradientTolerance = 1e-5;
+    double _valueTolerance = 1e-7;
+
+  private:
+    Tensor _lower;
+    Tensor _upper;
+    Tensor _scales;
+};
+
+class AdamMinimiser : public Minimiser
+{
+    /*!
+     * @class AdamMinimiser
+     * @brief Minimises using the Adam method (\cite Adam)
+     *
+     * Each scaled parameter is moved by roughly the learning rate per iteration, using running averages of the gradient
+     * and its square. This copes well with noisy functions, but needs many more iterations than LBFGSMinimiser to
+     * converge precisely. As the value can go up as well as down from one iteration to the next, only the gradient
+     * tolerance is used to decide when to stop.
+     */
+
+  public:
+    [[nodiscard]] Result minimise(const objectiveFnType &objective, const Tensor &start) const override;
+
+    /// @name Setters
+    /// @{
+
+    inline void setLearningRate(double learningRate)
+    {
+        _learningRate = learningRate;
+    }
+
+    /// @brief Set the decay rates of the running averages of the gradient and of its square
+    inline void setDecayRates(double beta1, double beta2)
+    {
+        _beta1 = beta1;
+        _beta2 = beta2;
+    }
+
+    /// @}
+
+  private:
+    double _learningRate = 0.01;
+    double _beta1 = 0.9;
+    double _beta2 = 0.999;
+    double _epsilon = 1e-8;
+};
+
+class LBFGSMinimiser : public Minimiser
+{
+    /*!
+     * @class LBFGSMinimiser
+     * @brief Minimises using the limited memory BFGS method, projected onto the bounds
+     *
+     * The inverse hessian is approximated from the changes in the parameters and gradient over the last few iterations
+     * (see setHistorySize()), which gives a step direction. A backtracking line search along this direction (bent at
+     * the bounds) then finds the next point. Parameters sitting on a bound with the gradient pushing them out are held
+     * fixed when working out the direction.
+     */
+
+  public:
+    [[nodiscard]] Result minimise(const objectiveFnType &objective, const Tensor &start) const override;
+
+    /// @brief Set the number of previous iterations used to approximate the inverse hessian
+    inline void setHistorySize(int historySize)
+    {
+        _historySize = historySize;
+    }
+
+  private:
+    int _historySize = 10;
+    int _maxLineSearchSteps = 30;
+};
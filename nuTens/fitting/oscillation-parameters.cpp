@@ -0,0 +1,78 @@
+#include <cmath>
+#include <limits>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+
+Tensor OscillationParameters::buildPMNS(const Tensor &params)
+{
+    NT_PROFILE();
+
+    Tensor sines = Tensor::sin(params);
+    Tensor cosines = Tensor::cos(params);
+    Tensor s12 = sines.getValues({kTheta12});
+    Tensor c12 = cosines.getValues({kTheta12});
+    Tensor s13 = sines.getValues({kTheta13});
+    Tensor c13 = cosines.getValues({kTheta13});
+    Tensor s23 = sines.getValues({kTheta23});
+    Tensor c23 = cosines.getValues({kTheta23});
+
+    // e^{i delta}
+    Tensor phase =
+        cosines.getValues({kDeltaCP}) + Tensor::scale(sines.getValues({kDeltaCP}), std::complex<float>(0.0, 1.0));
+    Tensor s13Phase = Tensor::mul(s13, phase);
+
+    Tensor PMNS = Tensor::zeros({1, 3, 3}, NTdtypes::kComplexFloat, params.getDevice(), /*requiresGrad=*/false);
+    PMNS.setValue(Tensor::Index({0, 0, 0}), Tensor::mul(c12, c13));
+    PMNS.setValue(Tensor::Index({0, 0, 1}), Tensor::mul(s12, c13));
+    PMNS.setValue(Tensor::Index({0, 0, 2}), Tensor::mul(s13, phase.conj()));
+    PMNS.setValue(Tensor::Index({0, 1, 0}), -Tensor::mul(s12, c23) - Tensor::mul(Tensor::mul(c12, s23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 1, 1}), Tensor::mul(c12, c23) - Tensor::mul(Tensor::mul(s12, s23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 1, 2}), Tensor::mul(s23, c13));
+    PMNS.setValue(Tensor::Index({0, 2, 0}), Tensor::mul(s12, s23) - Tensor::mul(Tensor::mul(c12, c23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 2, 1}), -Tensor::mul(c12, s23) - Tensor::mul(Tensor::mul(s12, c23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 2, 2}), Tensor::mul(c23, c13));
+
+    return PMNS;
+}
+
+Tensor OscillationParameters::buildMasses(const Tensor &params)
+{
+    NT_PROFILE();
+
+    Tensor dm2_21 = params.getValues({kDm2_21});
+    Tensor dm2_31 = params.getValues({kDm2_31});
+
+    // m1^2 = 2 |dm2_31| keeps every squared mass above 0 in either ordering, including the derivatives of the square
+    // roots
+    Tensor lightestSq = Tensor::scale(dm2_31.abs(), 2.0);
+
+    Tensor masses = Tensor::zeros({1, 3}, params.getDType(), params.getDevice(), /*requiresGrad=*/false);
+    masses.setValue(Tensor::Index({0, 0}), Tensor::pow(lightestSq, 0.5));
+    masses.setValue(Tensor::Index({0, 1}), Tensor::pow(lightestSq + dm2_21, 0.5));
+    masses.setValue(Tensor::Index({0, 2}), Tensor::pow(lightestSq + dm2_31, 0.5));
+
+    return masses.hasBatchDim(true);
+}
+
+void OscillationParameters::apply(const Tensor &params, Propagator &propagator)
+{
+    NT_PROFILE();
+
+    Tensor PMNS = buildPMNS(params);
+    Tensor masses = buildMasses(params);
+    propagator.setPMNS(PMNS);
+    propagator.setMasses(masses);
+}
+
+Tensor OscillationParameters::getDefaultLowerBounds()
+{
+    const auto infinity = std::numeric_limits<float>::infinity();
+    return Tensor({0.0, 0.0, 0.0, -M_PI, -infinity, -infinity}, NTdtypes::kFloat, NTdtypes::kCPU,
+                  /*requiresGrad=*/false);
+}
+
+Tensor OscillationParameters::getDefaultUpperBounds()
+{
+    const auto infinity = std::numeric_limits<float>::infinity();
+    return Tensor({M_PI / 2.0, M_PI / 2.0, M_PI / 2.0, M_PI, infinity, infinity}, NTdtypes::kFloat, NTdtypes::kCPU,
+                  /*requiresGrad=*/false);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+
+/*!
+ * @file oscillation-parameters.hpp
+ * @brief Defines the mapping from the standard three flavour oscillation parameters to the inputs of a Propagator
+ */
+
+class OscillationParameters
+{
+    /*!
+     * @class OscillationParameters
+     * @brief Builds the PMNS matrix and masses from a vector of three flavour oscillation parameters
+     *
+     * The parameters are held in a 1-d tensor, in the order given by the Index enum, i.e.
+     * {theta12, theta13, theta23, deltaCP, dm2_21, dm2_31}. Everything is built using differentiable tensor operations,
+     * so if the parameter tensor requires a gradient, so do the probabilities calculated by a propagator set up using
+     * apply(). The mass splittings should be in whatever units the propagator's baseline and energies are in.
+     *
+     * Only differences of the squared masses affect the probabilities, so the lightest mass is chosen to keep all of
+     * the squared masses positive, which allows either mass ordering (the sign of dm2_31).
+     */
+
+  public:
+    /// @brief The position of each parameter in the parameter tensor
+    enum Index : int
+    {
+        kTheta12 = 0,
+        kTheta13,
+        kTheta23,
+        kDeltaCP,
+        kDm2_21,
+        kDm2_31,
+        kNParams
+    };
+
+    /// @brief Build the PMNS matrix in the standard parameterisation
+    /// @param params The parameters
+    /// @return Complex tensor with shape {1, 3, 3}
+    [[nodiscard]] static Tensor buildPMNS(const Tensor &params);
+
+    /// @brief Build the neutrino masses
+    /// @param params The parameters
+    /// @return Tensor with shape {1, 3}, with a batch dimension
+    [[nodiscard]] static Tensor buildMasses(const Tensor &params);
+
+    /// @brief Set the PMNS matrix and masses of a propagator
+    /// @param params The parameters
+    /// @param propagator The propagator to set up
+    static void apply(const Tensor &params, Propagator &propagator);
+
+    /// @brief Get the default lower bounds to use when fitting
+    /// @details The angles are kept in [0, pi/2] and the CP phase in [-pi, pi]. The mass splittings are left free.
+    [[nodiscard]] static Tensor getDefaultLowerBounds();
+
+    /// @brief Get the default upper bounds to use when fitting, see getDefaultLowerBounds()
+    [[nodiscard]] static Tensor getDefaultUpperBounds();
+};
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <nuTens/io/event-file.hpp>
+#include <stdexcept>
+
+// See nuTens/io/README.md for a description of the file format
+
+namespace
+{
+
+constexpr char magic[8] = {'N', 'U', 'E', 'V', 'E', 'N', 'T', 'S'};
+constexpr uint32_t formatVersion = 1;
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+constexpr uint64_t headerSize = 64;
+constexpr uint64_t indexEntrySize = 40;
+
+// blocks and the columns inside them always start at a multiple of this
+constexpr uint64_t alignment = 64;
+
+// every column has 4 byte values
+constexpr uint64_t valueSize = 4;
+
+// the number of columns with one value per event, the weights come after these
+constexpr int nScalarColumns = 5;
+
+uint64_t align(uint64_t nBytes)
+{
+    return ((nBytes + alignment - 1) / alignment) * alignment;
+}
+
+// offset of a column from the start of its block, the weights being column nScalarColumns
+uint64_t columnOffset(int column, uint64_t nEvents)
+{
+    return static_cast<uint64_t>(column) * align(nEvents * valueSize);
+}
+
+uint64_t blockSize(uint64_t nEvents, uint64_t nWeights)
+{
+    return columnOffset(nScalarColumns, nEvents) + align(nEvents * nWeights * valueSize);
+}
+
+template <typename T> void writeValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> void appendValue(std::vector<char> &bytes, T value)
+{
+    const auto *begin = reinterpret_cast<const char *>(&value);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+
+template <typename T> T readValue(const char *bytes)
+{
+    T ret;
+    std::memcpy(&ret, bytes, sizeof(T));
+    return ret;
+}
+
+// write count values starting from first, followed by zeros up to the alignment
+template <typename T> void writeColumn(std::ostream &stream, const std::vector<T> &values, size_t first, size_t count)
+{
+    static_assert(sizeof(T) == valueSize);
+
+    const uint64_t nBytes = count * sizeof(T);
+    const std::vector<char> padding(align(nBytes) - nBytes, 0);
+    stream.write(reinterpret_cast<const char *>(values.data() + first), static_cast<std::streamsize>(nBytes));
+    stream.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+}
+
+template <typename T> void append(std::vector<T> &dst, const Tensor &src)
+{
+    const std::vector<T> values = src.toVector<T>();
+    dst.insert(dst.end(), values.begin(), values.end());
+}
+
+// whether a value is in the list, an empty list allowing everything
+bool contains(const std::vector<int> &values, int value)
+{
+    return values.empty() || std::find(values.begin(), values.end(), value) != values.end();
+}
+
+// whether any value in [min, max] is in the list, an empty list allowing everything
+bool overlaps(const std::vector<int> &values, int min, int max)
+{
+    return values.empty() ||
+           std::any_of(values.begin(), values.end(), [&](int value) { return value >= min && value <= max; });
+}
+
+// whether every value in [min, max] is in the list, an empty list allowing everything
+bool covers(const std::vector<int> &values, int min, int max)
+{
+    if (values.empty())
+    {
+        return true;
+    }
+
+    // can't cover a range with more values than are in the list
+    if (static_cast<int64_t>(max) - min + 1 > static_cast<int64_t>(values.size()))
+    {
+        return false;
+    }
+
+    for (int value = min; value <= max; value++)
+    {
+        if (!contains(values, value))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+[[noreturn]] void badFile(const std::string &path, const std::string &what)
+{
+    NT_ERROR("Bad event file {}: {}", path, what);
+    throw std::runtime_error("Bad event file " + path + ": " + what);
+}
+
+} // namespace
+
+EventFileWriter::EventFileWriter(const std::string &path, long int nWeights, long int blockSize)
+    : _path(path), _nWeights(nWeights), _blockSize(blockSize), _offset(headerSize)
+{
+    NT_PROFILE();
+
+    if (nWeights < 1 || blockSize < 1)
+    {
+        NT_ERROR("Event files need at least one weight and one event per block, got {} and {}", nWeights, blockSize);
+        throw std::invalid_argument("Bad number of weights or block size passed to EventFileWriter");
+    }
+
+    _file.open(path, std::ios::binary | std::ios::trunc);
+    if (!_file)
+    {
+        NT_ERROR("Could not open {} to write events", path);
+        throw std::runtime_error("Could not open file to write events: " + path);
+    }
+
+    // filled in properly by close()
+    const std::vector<char> header(headerSize, 0);
+    _file.write(header.data(), headerSize);
+}
+
+EventFileWriter::~EventFileWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &exception)
+    {
+        NT_ERROR("Failed to close event file {}: {}", _path, exception.what());
+    }
+}
+
+void EventFileWriter::write(const EventChunk &events)
+{
+    NT_PROFILE();
+
+    if (_closed)
+    {
+        NT_ERROR("Trying to write events to {} after it was closed", _path);
+        throw std::logic_error("EventFileWriter::write() called after close()");
+    }
+
+    const size_t nEvents = events.energies.getNumel();
+    if (events.cosZeniths.getNumel() != nEvents || events.initialFlavours.getNumel() != nEvents ||
+        events.finalFlavours.getNumel() != nEvents || events.samples.getNumel() != nEvents ||
+        events.weights.getNumel() != nEvents * _nWeights)
+    {
+        NT_ERROR("Columns passed to EventFileWriter::write() should all have {} events and {} weights per event",
+                 nEvents, _nWeights);
+        throw std::invalid_argument("Mismatched columns passed to EventFileWriter::write()");
+    }
+
+    append<float>(_energies, events.energies);
+    append<float>(_cosZeniths, events.cosZeniths);
+    append<int>(_initialFlavours, events.initialFlavours);
+    append<int>(_finalFlavours, events.finalFlavours);
+    append<int>(_samples, events.samples);
+    append<float>(_weights, events.weights);
+
+    while (static_cast<long int>(_energies.size() - _nFlushed) >= _blockSize)
+    {
+        flushBlock();
+    }
+
+    // get rid of the events that have been written once for the whole call, rather than once for every block
+    const auto nFlushed = static_cast<std::vector<int>::difference_type>(_nFlushed);
+    _energies.erase(_energies.begin(), _energies.begin() + nFlushed);
+    _cosZeniths.erase(_cosZeniths.begin(), _cosZeniths.begin() + nFlushed);
+    _initialFlavours.erase(_initialFlavours.begin(), _initialFlavours.begin() + nFlushed);
+    _finalFlavours.erase(_finalFlavours.begin(), _finalFlavours.begin() + nFlushed);
+    _samples.erase(_samples.begin(), _samples.begin() + nFlushed);
+    _weights.erase(_weights.begin(), _weights.begin() + nFlushed * _nWeights);
+    _nFlushed = 0;
+}
+
+void EventFileWriter::flushBlock()
+{
+    NT_PROFILE();
+
+    const size_t nEvents = std::min(_energies.size() - _nFlushed, static_cast<size_t>(_blockSize));
+    if (nEvents == 0)
+    {
+        return;
+    }
+
+    const auto first = static_cast<std::vector<int>::difference_type>(_nFlushed);
+    const auto last = first + static_cast<std::vector<int>::difference_type>(nEvents);
+    const auto [minInitial, maxInitial] =
+        std::minmax_element(_initialFlavours.begin() + first, _initialFlavours.begin() + last);
+    const auto [minFinal, maxFinal] =
+        std::minmax_element(_finalFlavours.begin() + first, _finalFlavours.begin() + last);
+    const auto [minSample, maxSample] = std::minmax_element(_samples.begin() + first, _samples.begin() + last);
+
+    appendValue<uint64_t>(_blockIndex, _offset);
+    appendValue<uint64_t>(_blockIndex, nEvents);
+    appendValue<int32_t>(_blockIndex, *minInitial);
+    appendValue<int32_t>(_blockIndex, *maxInitial);
+    appendValue<int32_t>(_blockIndex, *minFinal);
+    appendValue<int32_t>(_blockIndex, *maxFinal);
+    appendValue<int32_t>(_blockIndex, *minSample);
+    appendValue<int32_t>(_blockIndex, *maxSample);
+
+    writeColumn(_file, _energies, _nFlushed, nEvents);
+    writeColumn(_file, _cosZeniths, _nFlushed, nEvents);
+    writeColumn(_file, _initialFlavours, _nFlushed, nEvents);
+    writeColumn(_file, _finalFlavours, _nFlushed, nEvents);
+    writeColumn(_file, _samples, _nFlushed, nEvents);
+    writeColumn(_file, _weights, _nFlushed * _nWeights, nEvents * _nWeights);
+
+    if (!_file)
+    {
+        NT_ERROR("Failed to write events to {}", _path);
+        throw std::runtime_error("Failed to write events to file: " + _path);
+    }
+
+    _offset += blockSize(nEvents, _nWeights);
+    _nEvents += nEvents;
+    _nFlushed += nEvents;
+}
+
+void EventFileWriter::close()
+{
+    NT_PROFILE();
+
+    if (_closed)
+    {
+        return;
+    }
+    _closed = true;
+
+    while (_nFlushed < _energies.size())
+    {
+        flushBlock();
+    }
+
+    // blocks are always a multiple of the alignment so the index starts right after the last one
+    _file.write(_blockIndex.data(), static_cast<std::streamsize>(_blockIndex.size()));
+
+    _file.seekp(0);
+    _file.write(magic, sizeof(magic));
+    writeValue<uint32_t>(_file, formatVersion);
+    writeValue<uint32_t>(_file, byteOrderMark);
+    writeValue<uint32_t>(_file, static_cast<uint32_t>(_nWeights));
+    writeValue<uint32_t>(_file, 0);
+    writeValue<uint64_t>(_file, _blockSize);
+    writeValue<uint64_t>(_file, _nEvents);
+    writeValue<uint64_t>(_file, _blockIndex.size() / indexEntrySize);
+    writeValue<uint64_t>(_file, _offset);
+
+    _file.close();
+    if (!_file)
+    {
+        NT_ERROR("Failed to write the index of event file {}", _path);
+        throw std::runtime_error("Failed to write the index of event file: " + _path);
+    }
+}
+
+void EventFileWriter::abort()
+{
+    NT_PROFILE();
+
+    if (_closed)
+    {
+        return;
+    }
+    _closed = true;
+
+    _file.close();
+    if (std::remove(_path.c_str()) != 0)
+    {
+        NT_WARN("Could not remove partly written event file {}", _path);
+    }
+
+    _energies.clear();
+    _cosZeniths.clear();
+    _initialFlavours.clear();
+    _finalFlavours.clear();
+    _samples.clear();
+    _weights.clear();
+    _blockIndex.clear();
+    _nFlushed = 0;
+}
+
+EventFileReader::EventFileReader(const std::string &path) : _mappedFile(std::make_shared<MappedFile>(path))
+{
+    NT_PROFILE();
+
+    const char *bytes = static_cast<const char *>(_mappedFile->data());
+    const uint64_t fileSize = _mappedFile->size();
+
+    if (fileSize < headerSize || std::memcmp(bytes, magic, sizeof(magic)) != 0)
+    {
+        badFile(path, "not a nuTens event file");
+    }
+
+    const auto version = readValue<uint32_t>(bytes + 8);
+    if (version != formatVersion)
+    {
+        badFile(path, "unsupported format version " + std::to_string(version));
+    }
+
+    if (readValue<uint32_t>(bytes + 12) != byteOrderMark)
+    {
+        badFile(path, "written on a machine with a different byte order");
+    }
+
+    _nWeights = static_cast<long int>(readValue<uint32_t>(bytes + 16));
+    _blockSize = static_cast<long int>(readValue<uint64_t>(bytes + 24));
+    const auto nEvents = readValue<uint64_t>(bytes + 32);
+    const auto nBlocks = readValue<uint64_t>(bytes + 40);
+    const auto indexOffset = readValue<uint64_t>(bytes + 48);
+
+    if (indexOffset < headerSize || nBlocks > (fileSize - std::min(indexOffset, fileSize)) / indexEntrySize)
+    {
+        badFile(path, "index is truncated, the file may not have been closed properly");
+    }
+
+    uint64_t totalEvents = 0;
+    _blocks.reserve(nBlocks);
+    for (uint64_t block = 0; block < nBlocks; block++)
+    {
+        const char *entry = bytes + indexOffset + block * indexEntrySize;
+
+        BlockInfo info{};
+        info.offset = readValue<uint64_t>(entry);
+        const auto blockEvents = readValue<uint64_t>(entry + 8);
+        info.nEvents = static_cast<long int>(blockEvents);
+        info.minInitialFlavour = readValue<int32_t>(entry + 16);
+        info.maxInitialFlavour = readValue<int32_t>(entry + 20);
+        info.minFinalFlavour = readValue<int32_t>(entry + 24);
+        info.maxFinalFlavour = readValue<int32_t>(entry + 28);
+        info.minSample = readValue<int32_t>(entry + 32);
+        info.maxSample = readValue<int32_t>(entry + 36);
+
+        if (info.offset % alignment != 0 || info.offset < headerSize || blockEvents > indexOffset ||
+            info.offset + blockSize(blockEvents, _nWeights) > indexOffset)
+        {
+            badFile(path, "block " + std::to_string(block) + " is misaligned or truncated");
+        }
+
+        totalEvents += blockEvents;
+        _blocks.push_back(info);
+    }
+
+    if (totalEvents != nEvents)
+    {
+        badFile(path, "number of events in the blocks doesn't match the header");
+    }
+    _nEvents = static_cast<long int>(nEvents);
+}
+
+Tensor EventFileReader::column(uint64_t offset, const std::vector<long int> &shape, NTdtypes::scalarType type) const
+{
+    return Tensor::fromBuffer(static_cast<char *>(_mappedFile->data()) + offset, shape, {}, type,
+                              [mappedFile = _mappedFile](void * /*data*/) mutable { mappedFile.reset(); });
+}
+
+bool EventFileReader::mayBeSelected(const BlockInfo &info) const
+{
+    return overlaps(_selection.initialFlavours, info.minInitialFlavour, info.maxInitialFlavour) &&
+           overlaps(_selection.finalFlavours, info.minFinalFlavour, info.maxFinalFlavour) &&
+           overlaps(_selection.samples, info.minSample, info.maxSample);
+}
+
+bool EventFileReader::allSelected(const BlockInfo &info) const
+{
+    return covers(_selection.initialFlavours, info.minInitialFlavour, info.maxInitialFlavour) &&
+           covers(_selection.finalFlavours, info.minFinalFlavour, info.maxFinalFlavour) &&
+           covers(_selection.samples, info.minSample, info.maxSample);
+}
+
+EventChunk EventFileReader::readBlock(size_t block) const
+{
+    NT_PROFILE();
+
+    const BlockInfo &info = _blocks.at(block);
+    const auto nEvents = static_cast<uint64_t>(info.nEvents);
+
+    EventChunk ret;
+    ret.block = block;
+    ret.nEvents = info.nEvents;
+    ret.energies = column(info.offset + columnOffset(0, nEvents), {info.nEvents}, NTdtypes::kFloat);
+    ret.cosZeniths = column(info.offset + columnOffset(1, nEvents), {info.nEvents}, NTdtypes::kFloat);
+    ret.initialFlavours = column(info.offset + columnOffset(2, nEvents), {info.nEvents}, NTdtypes::kInt);
+    ret.finalFlavours = column(info.offset + columnOffset(3, nEvents), {info.nEvents}, NTdtypes::kInt);
+    ret.samples = column(info.offset + columnOffset(4, nEvents), {info.nEvents}, NTdtypes::kInt);
+    ret.weights = column(info.offset + columnOffset(nScalarColumns, nEvents), {info.nEvents, _nWeights},
+                         NTdtypes::kFloat);
+
+    if (allSelected(info))
+    {
+        return ret;
+    }
+
+    // find the selected events, only looking at the columns that are selected on
+    auto indices = std::make_shared<std::vector<int>>();
+    if (mayBeSelected(info))
+    {
+        // reserved so that the data is never null, even if nothing is selected
+        indices->reserve(nEvents);
+
+        const char *blockBytes = static_cast<const char *>(_mappedFile->data()) + info.offset;
+        const auto *initialFlavours = reinterpret_cast<const int32_t *>(blockBytes + columnOffset(2, nEvents));
+        const auto *finalFlavours = reinterpret_cast<const int32_t *>(blockBytes + columnOffset(3, nEvents));
+        const auto *samples = reinterpret_cast<const int32_t *>(blockBytes + columnOffset(4, nEvents));
+        for (uint64_t i = 0; i < nEvents; i++)
+        {
+            if (contains(_selection.initialFlavours, initialFlavours[i]) &&
+                contains(_selection.finalFlavours, finalFlavours[i]) && contains(_selection.samples, samples[i]))
+            {
+                indices->push_back(static_cast<int>(i));
+            }
+        }
+    }
+    else
+    {
+        indices->reserve(1);
+    }
+
+    Tensor indexTensor =
+        Tensor::fromBuffer(indices->data(), {static_cast<long int>(indices->size())}, {}, NTdtypes::kInt,
+                           [indices](void * /*data*/) mutable { indices.reset(); });
+
+    ret.nEvents = static_cast<long int>(indices->size());
+    ret.energies = Tensor::indexSelect(ret.energies, 0, indexTensor);
+    ret.cosZeniths = Tensor::indexSelect(ret.cosZeniths, 0, indexTensor);
+    ret.initialFlavours = Tensor::indexSelect(ret.initialFlavours, 0, indexTensor);
+    ret.finalFlavours = Tensor::indexSelect(ret.finalFlavours, 0, indexTensor);
+    ret.samples = Tensor::indexSelect(ret.samples, 0, indexTensor);
+    ret.weights = Tensor::indexSelect(ret.weights, 0, indexTensor);
+    return ret;
+}
+
+std::optional<EventChunk> EventFileReader::next()
+{
+    NT_PROFILE();
+
+    while (_nextBlock < _blocks.size())
+    {
+        const size_t block = _nextBlock++;
+        if (!mayBeSelected(_blocks[block]))
+        {
+            continue;
+        }
+
+        // the index only gives the range of values in a block, so it can still turn out to have nothing selected
+        EventChunk chunk = readBlock(block);
+        if (chunk.nEvents > 0)
+        {
+            return chunk;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::vector<size_t> EventFileReader::getSelectedBlocks() const
+{
+    NT_PROFILE();
+
+    std::vector<size_t> ret;
+    for (size_t block = 0; block < _blocks.size(); block++)
+    {
+        if (mayBeSelected(_blocks[block]))
+        {
+            ret.push_back(block);
+        }
+    }
+    return ret;
+}
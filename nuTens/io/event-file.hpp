@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <nuTens/utils/mapped-file.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*!
+ * @file event-file.hpp
+ * @brief Defines reading and writing of columnar files of simulated events
+ */
+
+/// @brief The columns of a set of events, as read from or written to an event file
+struct EventChunk
+{
+    /// The true neutrino energy of each event, kFloat with shape {nEvents}
+    Tensor energies;
+
+    /// The cosine of the true zenith angle of each event, kFloat with shape {nEvents}
+    Tensor cosZeniths;
+
+    /// The flavour each neutrino was produced as, kInt with shape {nEvents}
+    Tensor initialFlavours;
+
+    /// The flavour each neutrino interacted as, kInt with shape {nEvents}
+    Tensor finalFlavours;
+
+    /// The sample each event was selected into, kInt with shape {nEvents}
+    Tensor samples;
+
+    /// The weights of each event, kFloat with shape {nEvents, nWeights}
+    Tensor weights;
+
+    /// The block of the file the events came from
+    size_t block = 0;
+
+    /// The number of events in the chunk
+    long int nEvents = 0;
+};
+
+class EventFileWriter
+{
+    /*!
+     * @class EventFileWriter
+     * @brief Writes events to a file that can be read back by EventFileReader
+     *
+     * Events are buffered until there are enough to fill a block, which is then written out, so only one block ever
+     * has to be held in memory. The index of the blocks is written by close(), which is also called by the
+     * destructor, but should be called explicitly so that any errors can be caught. If something goes wrong part way
+     * through, abort() gets rid of the partly written file instead. See nuTens/io/README.md for a description of the
+     * format.
+     *
+     * Sorting the events by sample and flavour before writing them makes the selections of an EventFileReader much
+     * more effective, as then most blocks only hold one sample and flavour.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param path The file to write, any existing file is replaced
+    /// @param nWeights The number of weights stored for each event
+    /// @param blockSize The number of events in each block
+    explicit EventFileWriter(const std::string &path, long int nWeights = 1, long int blockSize = 1 << 20);
+
+    ~EventFileWriter();
+
+    EventFileWriter(const EventFileWriter &) = delete;
+    EventFileWriter &operator=(const EventFileWriter &) = delete;
+    EventFileWriter(EventFileWriter &&) = delete;
+    EventFileWriter &operator=(EventFileWriter &&) = delete;
+
+    /// @brief Add some events to the file
+    /// @details The columns of events are copied, so can be reused as soon as this returns. The block and nEvents
+    /// members are ignored.
+    /// @param events The events to add, all columns must have the same number of events
+    void write(const EventChunk &events);
+
+    /// @brief Write any buffered events and the index of the blocks, and close the file
+    void close();
+
+    /// @brief Stop writing and delete the file, without writing any buffered events or the index of the blocks
+    /// @details For when not all of the events could be written, so that a file missing some of them is never left
+    /// behind looking like a good one. Nothing more can be written afterwards, and the destructor does nothing.
+    void abort();
+
+  private:
+    // write the buffered events as a new block
+    void flushBlock();
+
+    std::string _path;
+    std::ofstream _file;
+    bool _closed = false;
+
+    long int _nWeights;
+    long int _blockSize;
+    uint64_t _nEvents = 0;
+
+    // the offset of the start of the next block
+    uint64_t _offset;
+
+    // the buffered events, the first _nFlushed of which have already been written
+    size_t _nFlushed = 0;
+    std::vector<float> _energies;
+    std::vector<float> _cosZeniths;
+    std::vector<int> _initialFlavours;
+    std::vector<int> _finalFlavours;
+    std::vector<int> _samples;
+    std::vector<float> _weights;
+
+    // raw bytes of the index entry of each block written so far
+    std::vector<char> _blockIndex;
+};
+
+class EventFileReader
+{
+    /*!
+     * @class EventFileReader
+     * @brief Reads a file of events written by EventFileWriter one block at a time, without copying
+     *
+     * The file is mapped into memory (see MappedFile) and the columns of each block are handed out as tensors that
+     * point straight into the mapping, so the operating system only reads each page from disk when a tensor is first
+     * used, and can drop it again under memory pressure once the tensors of the block are gone. This means files
+     * much larger than the memory of the machine can be streamed through a fit or reweighting job.
+     *
+     * A selection on the flavours and samples of the events can be set. The index of the file holds the range of
+     * flavours and samples in each block, so blocks with no selected events are skipped without any of their pages
+     * being touched. Blocks where every event is selected are returned without copying, and the remaining blocks
+     * only have their selected events copied out.
+     * \code{.cpp}
+     *   EventFileReader reader("mc.events");
+     *   EventFileReader::Selection selection;
+     *   selection.finalFlavours = {1};
+     *   selection.samples = {0, 2};
+     *   reader.setSelection(selection);
+     *   while (std::optional<EventChunk> chunk = reader.next())
+     *   {
+     *       calculator.setEvents(chunk->energies, chunk->initialFlavours, chunk->finalFlavours);
+     *       ...
+     *   }
+     * \endcode
+     */
+
+  public:
+    /// @brief The events to read, leaving a list empty selects every value
+    struct Selection
+    {
+        std::vector<int> initialFlavours;
+        std::vector<int> finalFlavours;
+        std::vector<int> samples;
+    };
+
+    /// @brief The summary of one block kept in the index of the file
+    struct BlockInfo
+    {
+        uint64_t offset;
+        long int nEvents;
+        int minInitialFlavour;
+        int maxInitialFlavour;
+        int minFinalFlavour;
+        int maxFinalFlavour;
+        int minSample;
+        int maxSample;
+    };
+
+    /// @brief Constructor
+    /// @param path The file to read
+    explicit EventFileReader(const std::string &path);
+
+    /// @brief Read the next block with any selected events, skipping those without
+    /// @return The selected events of the block, or nothing once every block has been read
+    [[nodiscard]] std::optional<EventChunk> next();
+
+    /// @brief Go back to the first block
+    inline void rewind()
+    {
+        _nextBlock = 0;
+    }
+
+    /// @brief Read the selected events of a particular block
+    /// @param block The index of the block
+    /// @return The selected events, which may be none
+    [[nodiscard]] EventChunk readBlock(size_t block) const;
+
+    /// @brief Get the blocks that hold at least one event that might be selected, according to the index
+    [[nodiscard]] std::vector<size_t> getSelectedBlocks() const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set which events to read
+    /// @details Also goes back to the first block
+    inline void setSelection(const Selection &selection)
+    {
+        _selection = selection;
+        rewind();
+    }
+
+    /// @}
+
+    /// @name Getters
+    /// @{
+
+    [[nodiscard]] inline const Selection &getSelection() const
+    {
+        return _selection;
+    }
+
+    /// @brief Get the total number of events in the file, ignoring the selection
+    [[nodiscard]] inline long int getNEvents() const
+    {
+        return _nEvents;
+    }
+
+    [[nodiscard]] inline long int getNWeights() const
+    {
+        return _nWeights;
+    }
+
+    /// @brief Get the largest number of events in a block
+    [[nodiscard]] inline long int getBlockSize() const
+    {
+        return _blockSize;
+    }
+
+    [[nodiscard]] inline size_t getNBlocks() const
+    {
+        return _blocks.size();
+    }
+
+    [[nodiscard]] inline const BlockInfo &getBlockInfo(size_t block) const
+    {
+        return _blocks.at(block);
+    }
+
+    /// @}
+
+  private:
+    // whether the index says that a block may hold some selected events
+    [[nodiscard]] bool mayBeSelected(const BlockInfo &info) const;
+
+    // whether the index says that every event in a block is selected
+    [[nodiscard]] bool allSelected(const BlockInfo &info) const;
+
+    // a tensor pointing into the mapped file, which keeps the mapping alive
+    [[nodiscard]] Tensor column(uint64_t offset, const std::vector<long int> &shape, NTdtypes::scalarType type) const;
+
+    std::shared_ptr<MappedFile> _mappedFile;
+
+    long int _nEvents = 0;
+    long int _nWeights = 0;
+    long int _blockSize = 0;
+    std::vector<BlockInfo> _blocks;
+
+    Selection _selection;
+    size_t _nextBlock = 0;
+};
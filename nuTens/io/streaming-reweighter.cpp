@@ -0,0 +1,207 @@
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <nuTens/io/streaming-reweighter.hpp>
+#include <nuTens/utils/bounded-queue.hpp>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+using clockType = std::chrono::steady_clock;
+
+double secondsSince(clockType::time_point start)
+{
+    return std::chrono::duration<double>(clockType::now() - start).count();
+}
+
+// read a byte from every page of a tensor so that the operating system loads it from disk now rather than when it is
+// first used. The columns of a block are contiguous on the CPU, so toBuffer() doesn't copy them.
+void touchPages(const Tensor &tensor)
+{
+    constexpr size_t pageSize = 4096;
+
+    const Tensor::Buffer buffer = tensor.toBuffer();
+    const size_t nBytes = tensor.getNumel() * NTdtypes::scalarTypeSize(buffer.type);
+    const auto *bytes = static_cast<const volatile char *>(buffer.data);
+    for (size_t offset = 0; offset < nBytes; offset += pageSize)
+    {
+        (void)bytes[offset];
+    }
+}
+
+// remembers the first exception thrown by any of the stages
+class FirstError
+{
+  public:
+    void set(std::exception_ptr error)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_error)
+        {
+            _error = std::move(error);
+        }
+    }
+
+    bool isSet()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return static_cast<bool>(_error);
+    }
+
+    void rethrow()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_error)
+        {
+            std::rethrow_exception(_error);
+        }
+    }
+
+  private:
+    std::mutex _mutex;
+    std::exception_ptr _error;
+};
+
+} // namespace
+
+StreamingReweighter::StreamingReweighter(std::shared_ptr<const Propagator> propagator)
+    : _propagator(std::move(propagator))
+{
+    NT_PROFILE();
+
+    if (!_propagator)
+    {
+        NT_ERROR("StreamingReweighter needs a propagator");
+        throw std::invalid_argument("Null propagator passed to StreamingReweighter");
+    }
+}
+
+StreamingReweighter::Stats StreamingReweighter::run(EventFileReader &reader, const std::string &outputPath) const
+{
+    NT_PROFILE();
+
+    const clockType::time_point start = clockType::now();
+
+    // opened before any threads are started so that a bad path is reported straight away
+    EventFileWriter writer(outputPath, reader.getNWeights(), reader.getBlockSize());
+
+    BoundedQueue<EventChunk> readQueue(_queueDepth);
+    BoundedQueue<EventChunk> writeQueue(_queueDepth);
+    FirstError error;
+    Stats ret;
+
+    // on failure every queue is closed, which stops all of the stages as soon as they next touch one
+    auto fail = [&](std::exception_ptr exception) {
+        error.set(std::move(exception));
+        readQueue.close();
+        writeQueue.close();
+    };
+
+    std::thread readerThread([&]() {
+        try
+        {
+            while (true)
+            {
+                const clockType::time_point readStart = clockType::now();
+                std::optional<EventChunk> chunk = reader.next();
+                if (chunk)
+                {
+                    touchPages(chunk->energies);
+                    touchPages(chunk->initialFlavours);
+                    touchPages(chunk->finalFlavours);
+                    touchPages(chunk->weights);
+                }
+                ret.readSeconds += secondsSince(readStart);
+
+                if (!chunk || !readQueue.push(std::move(*chunk)))
+                {
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+        readQueue.close();
+    });
+
+    std::thread writerThread([&]() {
+        try
+        {
+            while (std::optional<EventChunk> chunk = writeQueue.pop())
+            {
+                const clockType::time_point writeStart = clockType::now();
+                writer.write(*chunk);
+                ret.writeSeconds += secondsSince(writeStart);
+            }
+
+            // if another stage failed some events are missing, so the file gets thrown away rather than finished
+            if (error.isSet())
+            {
+                return;
+            }
+
+            const clockType::time_point closeStart = clockType::now();
+            writer.close();
+            ret.writeSeconds += secondsSince(closeStart);
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    });
+
+    try
+    {
+        Tensor::NoGradGuard noGrad;
+
+        while (true)
+        {
+            const clockType::time_point waitStart = clockType::now();
+            std::optional<EventChunk> chunk = readQueue.pop();
+            ret.waitSeconds += secondsSince(waitStart);
+            if (!chunk)
+            {
+                break;
+            }
+
+            const clockType::time_point propagateStart = clockType::now();
+            Tensor probs = _propagator->calculateChannelProbs(Tensor::reshape(chunk->energies, {chunk->nEvents, 1}),
+                                                              chunk->initialFlavours, chunk->finalFlavours);
+            probs.dType(chunk->weights.getDType());
+            chunk->weights = Tensor::mul(chunk->weights, Tensor::reshape(probs, {chunk->nEvents, 1}));
+            ret.propagateSeconds += secondsSince(propagateStart);
+
+            ret.nChunks++;
+            ret.nEvents += chunk->nEvents;
+            if (!writeQueue.push(std::move(*chunk)))
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+    writeQueue.close();
+
+    readerThread.join();
+    writerThread.join();
+
+    if (error.isSet())
+    {
+        writer.abort();
+        error.rethrow();
+    }
+
+    ret.totalSeconds = secondsSince(start);
+
+    NT_INFO("Reweighted {} events in {} blocks in {:.2f}s ({:.3g} events/s, {:.2f}s waiting for input)", ret.nEvents,
+            ret.nChunks, ret.totalSeconds, ret.getEventsPerSecond(), ret.waitSeconds);
+
+    return ret;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/io/event-file.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <string>
+
+/*!
+ * @file streaming-reweighter.hpp
+ * @brief Defines a pipeline that applies oscillation weights to a file of events too large to fit in memory
+ */
+
+class StreamingReweighter
+{
+    /*!
+     * @class StreamingReweighter
+     * @brief Multiplies the weights of every event in an event file by its oscillation probability, writing the
+     * reweighted events to a new event file
+     *
+     * The events are processed one block of the input file at a time, in three stages that run at the same time on
+     * different threads:
+     *  - a reader thread takes the next blocks from the EventFileReader and touches their pages, so that they are
+     *  read from disk ahead of when they are needed
+     *  - the calling thread works out the probability of each event using Propagator::calculateChannelProbs()
+     *  - a writer thread passes the reweighted blocks to an EventFileWriter
+     *
+     * The stages are joined by BoundedQueue s, so while block k is being propagated block k + 1 is being read and
+     * block k - 1 written, and neither the reader nor the writer can get more than setQueueDepth() blocks away from
+     * the propagation. Only a few blocks are ever in memory no matter how large the file is, and as long as the disk
+     * keeps up the whole run goes at the speed of the propagation.
+     *
+     * Every weight column is multiplied by the probability, and the other columns are copied unchanged, so the
+     * output can be read back with an EventFileReader. The selection of the reader is respected.
+     * \code{.cpp}
+     *   StreamingReweighter reweighter(propagator);
+     *   EventFileReader reader("unoscillated.events");
+     *   StreamingReweighter::Stats stats = reweighter.run(reader, "oscillated.events");
+     *   std::cout << stats.getEventsPerSecond() << std::endl;
+     * \endcode
+     */
+
+  public:
+    /// @brief Summary of how a run went
+    /// @details The times of the stages overlap, so their sum is usually more than totalSeconds. If waitSeconds is
+    /// large compared to propagateSeconds the run was held back by reading from disk.
+    struct Stats
+    {
+        long int nChunks = 0;          //!< The number of blocks processed
+        long int nEvents = 0;          //!< The number of events processed
+        double readSeconds = 0.0;      //!< Time spent by the reader thread getting blocks from the file
+        double propagateSeconds = 0.0; //!< Time spent working out and applying the probabilities
+        double waitSeconds = 0.0;      //!< Time spent by the propagation waiting for blocks to be read
+        double writeSeconds = 0.0;     //!< Time spent by the writer thread writing blocks to the output file
+        double totalSeconds = 0.0;     //!< Time taken by the whole run
+
+        /// @brief Get the number of events processed per second over the whole run
+        [[nodiscard]] inline double getEventsPerSecond() const
+        {
+            return totalSeconds > 0.0 ? static_cast<double>(nEvents) / totalSeconds : 0.0;
+        }
+    };
+
+    /// @brief Constructor
+    /// @param propagator The propagator used to work out the probabilities, which is shared so changes made to it
+    /// are seen by later runs
+    explicit StreamingReweighter(std::shared_ptr<const Propagator> propagator);
+
+    /// @brief Reweight the selected events of a file
+    /// @details Reads from the reader's current position to the end of the file. If any stage fails, the others are
+    /// stopped, the partly written output file is deleted (see EventFileWriter::abort()) and the exception is
+    /// rethrown here once all threads have finished.
+    /// @param reader The events to reweight
+    /// @param outputPath The event file to write the reweighted events to, with the same block size as the input
+    /// @return Stats of the run
+    Stats run(EventFileReader &reader, const std::string &outputPath) const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the number of blocks that can be waiting between each stage
+    /// @details Each block waiting in a queue holds onto its memory, so this limits how far the reader can get
+    /// ahead of the propagation, and the propagation ahead of the writer
+    inline void setQueueDepth(size_t queueDepth)
+    {
+        _queueDepth = queueDepth;
+    }
+
+    /// @}
+
+  private:
+    std::shared_ptr<const Propagator> _propagator;
+    size_t _queueDepth = 2;
+};
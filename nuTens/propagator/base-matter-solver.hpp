@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
 #include <nuTens/tensors/tensor.hpp>
 #include <nuTens/utils/instrumentation.hpp>
+#include <nuTens/utils/logging.hpp>
+#include <stdexcept>
+#include <vector>
 
 /// @file base-matter-solver.hpp
 
@@ -9,15 +13,90 @@ class BaseMatterSolver
 {
     /// @class BaseMatterSolver
     /// @brief Abstract base class for matter effect solvers
+    ///
+    /// Derived classes must make it safe for any number of threads to call the const methods (e.g.
+    /// calculateEigenvalues()) at the same time. Setters are not thread safe and must not be called while another
+    /// thread is using the solver.
 
   public:
+    virtual ~BaseMatterSolver() = default;
+
     /// @name Setters
     /// @{
     virtual void setPMNS(const Tensor &newPMNS) = 0;
 
     virtual void setMasses(const Tensor &newMasses) = 0;
 
-    virtual void calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors, Tensor &eigenvalues) = 0;
+    /// @}
+
+    virtual void calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors, Tensor &eigenvalues) const = 0;
+
+    /// @brief Get a copy of this solver which can be modified independently of this one
+    /// @details Tensors that only get replaced (never modified in place) by the setters can be shared with the copy, so
+    /// this should be cheap
+    [[nodiscard]] virtual std::shared_ptr<BaseMatterSolver> clone() const = 0;
+
+    /// @name Analytic gradients
+    /// Solvers which can write down their hamiltonian, and how it depends on its inputs, can be used with the analytic
+    /// backward pass of the Propagator (see Propagator::setAnalyticGradients()). The eigenvalues and eigenvectors of
+    /// the hamiltonian should be the ones that calculateEigenvalues() would give.
+    /// @{
+
+    /// @brief Whether this solver implements calculateHamiltonian(), hamiltonianBackward() and hamiltonianTangent()
+    [[nodiscard]] virtual bool supportsAnalyticGradients() const
+    {
+        return false;
+    }
+
+    /// @brief Get the tensors, other than the energies, masses and PMNS matrix, that the hamiltonian depends on
+    [[nodiscard]] virtual std::vector<Tensor> getParameters() const
+    {
+        return {};
+    }
+
+    /// @brief Calculate the (hermitian) hamiltonian
+    /// @param energies The energies of the neutrinos, with shape {Nbatches, 1}
+    /// @param masses The neutrino masses
+    /// @param PMNS The PMNS matrix
+    /// @param parameters The tensors returned by getParameters()
+    [[nodiscard]] virtual Tensor calculateHamiltonian([[maybe_unused]] const Tensor &energies,
+                                                      [[maybe_unused]] const Tensor &masses,
+                                                      [[maybe_unused]] const Tensor &PMNS,
+                                                      [[maybe_unused]] const std::vector<Tensor> &parameters) const
+    {
+        NT_ERROR("This matter solver does not support analytic gradients");
+        throw std::logic_error("calculateHamiltonian() is not implemented by this matter solver");
+    }
+
+    /// @brief Get the gradients of the inputs of calculateHamiltonian() from the gradient of the hamiltonian
+    /// @details Follows the same conventions as the backward function of Tensor::customGrad()
+    /// @param gradHamiltonian The gradient of the hamiltonian
+    /// @return The gradients of the energies, masses, PMNS matrix and then each of the parameters, in that order
+    [[nodiscard]] virtual std::vector<Tensor> hamiltonianBackward(
+        [[maybe_unused]] const Tensor &gradHamiltonian, [[maybe_unused]] const Tensor &energies,
+        [[maybe_unused]] const Tensor &masses, [[maybe_unused]] const Tensor &PMNS,
+        [[maybe_unused]] const std::vector<Tensor> &parameters) const
+    {
+        NT_ERROR("This matter solver does not support analytic gradients");
+        throw std::logic_error("hamiltonianBackward() is not implemented by this matter solver");
+    }
+
+    /// @brief Get the change in the hamiltonian caused by changes (tangents) of its inputs, i.e. forward mode
+    /// derivatives
+    /// @details The tangents have an extra leading dimension, one entry per direction being differentiated along, which
+    /// the returned tangent of the hamiltonian should also have. The energies are held fixed.
+    /// @param tangentMasses The tangents of the masses
+    /// @param tangentPMNS The tangents of the PMNS matrix
+    /// @param tangentParameters The tangents of each of the parameters
+    [[nodiscard]] virtual Tensor hamiltonianTangent(
+        [[maybe_unused]] const Tensor &energies, [[maybe_unused]] const Tensor &masses,
+        [[maybe_unused]] const Tensor &PMNS, [[maybe_unused]] const std::vector<Tensor> &parameters,
+        [[maybe_unused]] const Tensor &tangentMasses, [[maybe_unused]] const Tensor &tangentPMNS,
+        [[maybe_unused]] const std::vector<Tensor> &tangentParameters) const
+    {
+        NT_ERROR("This matter solver does not support analytic gradients");
+        throw std::logic_error("hamiltonianTangent() is not implemented by this matter solver");
+    }
 
     /// @}
 };
\ No newline at end of file
@@ -1,19 +1,87 @@
 #include <nuTens/propagator/const-density-solver.hpp>
 
-void ConstDensityMatterSolver::calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors, Tensor &eigenvalues)
+void ConstDensityMatterSolver::calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors,
+                                                    Tensor &eigenvalues) const
 {
     NT_PROFILE();
-    Tensor hamiltonian = Tensor::zeros({energies.getBatchDim(), nGenerations, nGenerations}, NTdtypes::kComplexFloat);
+    Tensor hamiltonian = Tensor::zeros({energies.getBatchDim(), nGenerations, nGenerations}, NTdtypes::kComplexFloat,
+                                       energies.getDevice(), /*requiresGrad=*/false);
 
     for (int i = 0; i < nGenerations; i++)
     {
         for (int j = 0; j < nGenerations; j++)
         {
-            hamiltonian.setValue({"...", i, j},
-                                 Tensor::div(diagMassMatrix.getValues({i, j}), energies.getValues({"...", 0})) -
-                                     electronOuter.getValues({i, j}));
+            const int index = i * nGenerations + j;
+            hamiltonian.setValue(hamiltonianIndices[index],
+                                 Tensor::div(diagMassMatrix.getValues(elementIndices[index]),
+                                             energies.getValues(energyIndex)) -
+                                     electronOuter.getValues(elementIndices[index]));
         }
     }
 
     Tensor::eig(hamiltonian, eigenvectors, eigenvalues);
-}
\ No newline at end of file
+}
+Tensor ConstDensityMatterSolver::calculateHamiltonian(const Tensor &energies, const Tensor &masses, const Tensor &PMNS,
+                                                      const std::vector<Tensor> &parameters) const
+{
+    NT_PROFILE();
+
+    Tensor electronRow = PMNS.getValues(electronRowIndex);
+    Tensor outer = Tensor::scale(Tensor::outer(electronRow, electronRow.conj()), Constants::Groot2);
+
+    // diag(m^2 / 2E) - sqrt(2) G N_e U_ei U_ej^*
+    Tensor massTerm = Tensor::diagEmbed(Tensor::div(Tensor::scale(Tensor::mul(masses, masses), 0.5), energies));
+    return massTerm - Tensor::mul(outer, parameters[0]);
+}
+
+std::vector<Tensor> ConstDensityMatterSolver::hamiltonianBackward(const Tensor &gradHamiltonian, const Tensor &energies,
+                                                                  const Tensor &masses, const Tensor &PMNS,
+                                                                  const std::vector<Tensor> &parameters) const
+{
+    NT_PROFILE();
+
+    // only the diagonal depends on the masses and energies
+    Tensor gradDiag = Tensor::diagonal(gradHamiltonian).real();
+    Tensor gradMasses = Tensor::mul(gradDiag, Tensor::div(masses, energies));
+    Tensor gradEnergies = Tensor::div(Tensor::mul(gradDiag, Tensor::scale(Tensor::mul(masses, masses), -0.5)),
+                                      Tensor::mul(energies, energies));
+
+    // the matter term only depends on the electron row u of the PMNS matrix, through -c u u^dagger
+    Tensor electronRow = PMNS.getValues(electronRowIndex);
+    Tensor outer = Tensor::scale(Tensor::outer(electronRow, electronRow.conj()), Constants::Groot2);
+    Tensor gradDensity = -Tensor::mul(gradHamiltonian.conj(), outer).sum().real();
+
+    Tensor gradOuter = Tensor::scale(Tensor::mul(gradHamiltonian, parameters[0]), -Constants::Groot2);
+    Tensor gradRow = Tensor::mul(gradOuter + Tensor::transpose(gradOuter.conj(), -2, -1), electronRow).sum({-1});
+
+    Tensor gradPMNS = Tensor::zeros({gradHamiltonian.getBatchDim(), nGenerations, nGenerations},
+                                    NTdtypes::kComplexFloat, gradHamiltonian.getDevice(), /*requiresGrad=*/false);
+    gradPMNS.setValue(batchedElectronRowIndex, gradRow);
+
+    return {gradEnergies, gradMasses, gradPMNS, gradDensity};
+}
+
+Tensor ConstDensityMatterSolver::hamiltonianTangent(const Tensor &energies, const Tensor &masses, const Tensor &PMNS,
+                                                    const std::vector<Tensor> &parameters,
+                                                    const Tensor &tangentMasses, const Tensor &tangentPMNS,
+                                                    const std::vector<Tensor> &tangentParameters) const
+{
+    NT_PROFILE();
+
+    // d(m^2 / 2E) = m dm / E
+    Tensor tangentMassTerm = Tensor::diagEmbed(Tensor::div(Tensor::mul(masses, tangentMasses), energies));
+
+    // d(u u^dagger) = du u^dagger + u du^dagger, with an extra dimension so it broadcasts over the energies
+    Tensor electronRow = PMNS.getValues(electronRowIndex);
+    Tensor tangentRow = tangentPMNS.getValues(tangentElectronRowIndex);
+    Tensor outer = Tensor::scale(Tensor::outer(electronRow, electronRow.conj()), Constants::Groot2);
+    Tensor tangentOuter =
+        Tensor::mul(Tensor::unsqueeze(tangentRow, -1), Tensor::unsqueeze(electronRow.conj(), -2)) +
+        Tensor::mul(Tensor::unsqueeze(electronRow, -1), Tensor::unsqueeze(tangentRow.conj(), -2));
+    tangentOuter = Tensor::unsqueeze(Tensor::scale(tangentOuter, Constants::Groot2), 1);
+
+    // and the density tangent needs to broadcast over both matrix dimensions
+    Tensor tangentDensity = Tensor::unsqueeze(Tensor::unsqueeze(tangentParameters[0], -1), -1);
+
+    return tangentMassTerm - Tensor::mul(tangentOuter, parameters[0]) - Tensor::mul(outer, tangentDensity);
+}
@@ -34,9 +34,22 @@ class ConstDensityMatterSolver : public BaseMatterSolver
     /// @arg nGenerations The number of neutrino generations this propagator
     /// should expect
     /// @arg density The electron density of the material to propagate in
-    ConstDensityMatterSolver(int nGenerations, float density) : nGenerations(nGenerations), density(density)
+    ConstDensityMatterSolver(int nGenerations, float density)
+        : nGenerations(nGenerations),
+          density(Tensor({density}, NTdtypes::kFloat, NTdtypes::kCPU, /*requiresGrad=*/false))
     {
-        diagMassMatrix = Tensor::zeros({1, nGenerations, nGenerations}, NTdtypes::kFloat);
+        diagMassMatrix =
+            Tensor::zeros({1, nGenerations, nGenerations}, NTdtypes::kFloat, NTdtypes::kCPU, /*requiresGrad=*/false);
+
+        // precompile the indices used to build up the hamiltonian so it doesn't have to be done on every call
+        for (int i = 0; i < nGenerations; i++)
+        {
+            for (int j = 0; j < nGenerations; j++)
+            {
+                elementIndices.push_back(Tensor::Index({i, j}));
+                hamiltonianIndices.push_back(Tensor::Index({Tensor::ellipsis, i, j}));
+            }
+        }
     };
 
     /// @name Setters
@@ -48,14 +61,22 @@ class ConstDensityMatterSolver : public BaseMatterSolver
     {
         NT_PROFILE();
         PMNS = newPMNS;
-
-        // construct the outer product of the electron neutrino row of the PMNS
-        // matrix used to construct the hamiltonian
-        electronOuter =
-            Tensor::scale(Tensor::outer(PMNS.getValues({0, 0, "..."}), PMNS.getValues({0, 0, "..."}).conj()),
-                          Constants::Groot2 * density);
+        calculateElectronOuter();
     };
 
+    /// @brief Set the electron density of the material
+    /// @details Set a tensor that requires a gradient to be able to get gradients with respect to the density
+    /// @param newDensity Tensor holding the single density value
+    inline void setDensity(const Tensor &newDensity)
+    {
+        NT_PROFILE();
+        density = newDensity;
+        if (PMNS.getDType() != NTdtypes::kUninitScalar)
+        {
+            calculateElectronOuter();
+        }
+    }
+
     /// @brief Set new mass eigenvalues for this solver
     /// @param newMasses The new masses
     inline void setMasses(const Tensor &newMasses) override
@@ -74,13 +95,64 @@ class ConstDensityMatterSolver : public BaseMatterSolver
 
     /// @}
 
+    /// @brief Get the tensor holding the electron density of the material
+    [[nodiscard]] inline const Tensor &getDensity() const
+    {
+        return density;
+    }
+
     /// @brief Set new mass eigenvalues for this solver
     /// @param[in] energies Tensor of energies, expected to have a batch
     /// dimension and two further dimensions to make casting unambiguous i.e.
     /// shape should look like {Nbatches, 1, 1}.
     /// @param[out] eigenvectors The returned eigenvectors
     /// @param[out] eigenvalues The corresponding eigenvalues
-    void calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors, Tensor &eigenvalues) override;
+    void calculateEigenvalues(const Tensor &energies, Tensor &eigenvectors, Tensor &eigenvalues) const override;
+
+    /// @brief Get a copy of this solver which can be modified independently of this one
+    /// @details The setters only ever replace the member tensors so they can safely be shared with the copy
+    [[nodiscard]] inline std::shared_ptr<BaseMatterSolver> clone() const override
+    {
+        return std::make_shared<ConstDensityMatterSolver>(*this);
+    }
+
+    /// @name Analytic gradients
+    /// The only parameter of the hamiltonian is the density
+    /// @{
+
+    [[nodiscard]] inline bool supportsAnalyticGradients() const override
+    {
+        return true;
+    }
+
+    [[nodiscard]] inline std::vector<Tensor> getParameters() const override
+    {
+        return {density};
+    }
+
+    [[nodiscard]] Tensor calculateHamiltonian(const Tensor &energies, const Tensor &masses, const Tensor &PMNS,
+                                              const std::vector<Tensor> &parameters) const override;
+
+    [[nodiscard]] std::vector<Tensor> hamiltonianBackward(const Tensor &gradHamiltonian, const Tensor &energies,
+                                                          const Tensor &masses, const Tensor &PMNS,
+                                                          const std::vector<Tensor> &parameters) const override;
+
+    [[nodiscard]] Tensor hamiltonianTangent(const Tensor &energies, const Tensor &masses, const Tensor &PMNS,
+                                            const std::vector<Tensor> &parameters, const Tensor &tangentMasses,
+                                            const Tensor &tangentPMNS,
+                                            const std::vector<Tensor> &tangentParameters) const override;
+
+    /// @}
+
+  private:
+    // construct the outer product of the electron neutrino row of the PMNS
+    // matrix used to construct the hamiltonian
+    inline void calculateElectronOuter()
+    {
+        Tensor electronRow = PMNS.getValues(electronRowIndex);
+        electronOuter =
+            Tensor::mul(Tensor::scale(Tensor::outer(electronRow, electronRow.conj()), Constants::Groot2), density);
+    }
 
   private:
     Tensor PMNS;
@@ -88,5 +160,14 @@ class ConstDensityMatterSolver : public BaseMatterSolver
     Tensor diagMassMatrix;
     Tensor electronOuter;
     int nGenerations;
-    float density;
+    Tensor density;
+
+    // precompiled indices: {i, j} and {..., i, j} (at [i * nGenerations + j]), {..., 0}, {0, 0, ...}, {:, 0, ...}
+    // and {:, 0, 0, ...}
+    std::vector<Tensor::Index> elementIndices;
+    std::vector<Tensor::Index> hamiltonianIndices;
+    Tensor::Index energyIndex = Tensor::Index({Tensor::ellipsis, 0});
+    Tensor::Index electronRowIndex = Tensor::Index({0, 0, Tensor::ellipsis});
+    Tensor::Index batchedElectronRowIndex = Tensor::Index({Tensor::Slice{}, 0, Tensor::ellipsis});
+    Tensor::Index tangentElectronRowIndex = Tensor::Index({Tensor::Slice{}, 0, 0, Tensor::ellipsis});
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <nuTens/propagator/layered-propagator.hpp>
+#include <stdexcept>
+
+namespace
+{
+// multiply the evolution operators of the given layers, in order, onto the end of evolution. The operator of a layer
+// is V^* diag(exp(-i lambda L)) V^T for eigenvalues lambda and eigenvectors V of its hamiltonian, which is the
+// convention used by the amplitudes in Propagator
+Tensor propagateLayers(const ConstDensityMatterSolver &solver, const Tensor &energies, const Tensor &masses,
+                       const Tensor &PMNS, const Tensor &densities, Tensor evolution, const std::vector<float> &lengths,
+                       int firstLayer)
+{
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        const Tensor density = densities.getValues(Tensor::Index({firstLayer + static_cast<int>(i)}));
+
+        Tensor eigenvalues;
+        Tensor eigenvectors;
+        Tensor::eigh(solver.calculateHamiltonian(energies, masses, PMNS, {density}), eigenvalues, eigenvectors);
+
+        Tensor weights = Tensor::exp(Tensor::scale(eigenvalues, std::complex<float>(-1.0J) * lengths[i]));
+        Tensor layerOperator = Tensor::matmul(Tensor::mul(eigenvectors.conj(), Tensor::unsqueeze(weights, -2)),
+                                              Tensor::transpose(eigenvectors, -2, -1));
+
+        evolution = Tensor::matmul(evolution, layerOperator);
+    }
+
+    return evolution;
+}
+} // namespace
+
+void LayeredPropagator::setLayers(const std::vector<float> &lengths, const Tensor &densities)
+{
+    NT_PROFILE();
+
+    if (densities.getNumel() != lengths.size())
+    {
+        NT_ERROR("Got {} layer lengths but {} densities", lengths.size(), densities.getNumel());
+        throw std::invalid_argument("Each layer needs both a length and a density");
+    }
+
+    _lengths = lengths;
+    _densities = densities;
+}
+
+Tensor LayeredPropagator::calculateProbs(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    const int nLayers = getNLayers();
+
+    // product of the operators of the layers crossed so far, in the mass basis
+    Tensor evolution =
+        Tensor::eye(_nGenerations, NTdtypes::kComplexFloat, energies.getDevice(), /*requiresGrad=*/false);
+
+    if (_checkpointInterval <= 0)
+    {
+        evolution = propagateLayers(*_hamiltonianSolver, energies, _masses, _pmnsMatrix, _densities, evolution,
+                                    _lengths, 0);
+    }
+    else
+    {
+        for (int first = 0; first < nLayers; first += _checkpointInterval)
+        {
+            const int last = std::min(first + _checkpointInterval, nLayers);
+
+            // copied into the segment as it can be re-run during the backward pass after this propagator is gone
+            std::shared_ptr<const ConstDensityMatterSolver> solver = _hamiltonianSolver;
+            std::vector<float> lengths(_lengths.begin() + first, _lengths.begin() + last);
+
+            auto segment = [solver, lengths, first](const std::vector<Tensor> &in) -> std::vector<Tensor> {
+                return {propagateLayers(*solver, in[0], in[1], in[2], in[3], in[4], lengths, first)};
+            };
+
+            evolution = Tensor::checkpoint({energies, _masses, _pmnsMatrix, _densities, evolution}, segment)[0];
+        }
+    }
+
+    // A = U^* evolution U^T and P = |A|^2
+    Tensor amplitudes =
+        Tensor::matmul(Tensor::matmul(_pmnsMatrix.conj(), evolution), Tensor::transpose(_pmnsMatrix, -2, -1));
+
+    return Tensor::mul(amplitudes.abs(), amplitudes.abs());
+}
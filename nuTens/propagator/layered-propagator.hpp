@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/// @file layered-propagator.hpp
+
+class LayeredPropagator
+{
+    /*!
+     * @class LayeredPropagator
+     * @brief Neutrino oscillation probability calculator for a path through a series of constant density layers
+     *
+     * Useful for e.g. neutrinos crossing the earth, where the density profile along the path is approximated by many
+     * slices. In each layer the hamiltonian (the same one used by ConstDensityMatterSolver) is diagonalised to get the
+     * evolution operator for that layer, and the operators of all the layers are multiplied together in the order
+     * that the neutrinos pass through them.
+     *
+     * Recording all of this for the backward pass keeps a few tensors of size {Nbatches, nGenerations, nGenerations}
+     * alive for every layer, so memory grows with the number of layers times the number of energies. To stop this
+     * limiting the batch size for profiles with many layers, the layers can be split into segments of
+     * setCheckpointInterval() layers. Only the product of the operators up to the start of each segment is then kept,
+     * and the inside of a segment is calculated again during the backward pass (see Tensor::checkpoint()). With N
+     * layers and a checkpoint interval of k, roughly N / k + k operators are kept instead of a few times N, at the
+     * cost of working out the forward pass twice. k around sqrt(N) keeps the least.
+     *
+     * Like Propagator, calculateProbs() only reads the parameters so can be called from many threads at once, but the
+     * setters are not thread safe.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param nGenerations The number of generations the propagator should expect
+    explicit LayeredPropagator(int nGenerations)
+        : _nGenerations(nGenerations),
+          _hamiltonianSolver(std::make_shared<const ConstDensityMatterSolver>(nGenerations, 0.0))
+    {
+    }
+
+    /// @brief Calculate the oscillation probabilities
+    /// @param energies The energies of the neutrinos, with shape {Nbatches, 1}
+    /// @return Tensor with shape {Nbatches, nGenerations, nGenerations} where [b, i, j] is the probability of going
+    /// from flavour i to flavour j
+    [[nodiscard]] Tensor calculateProbs(const Tensor &energies) const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the layers that the neutrinos pass through
+    /// @param lengths The length of each layer, in the order the neutrinos cross them
+    /// @param densities Tensor with shape {nLayers} holding the electron density of each layer. Set a tensor that
+    /// requires a gradient to be able to get gradients with respect to the densities.
+    void setLayers(const std::vector<float> &lengths, const Tensor &densities);
+
+    /// @brief Set the layers that the neutrinos pass through
+    /// @param lengths The length of each layer, in the order the neutrinos cross them
+    /// @param densities The electron density of each layer
+    inline void setLayers(const std::vector<float> &lengths, const std::vector<float> &densities)
+    {
+        setLayers(lengths, Tensor(densities, NTdtypes::kFloat, NTdtypes::kCPU, /*requiresGrad=*/false));
+    }
+
+    /// @brief Set the number of layers in each checkpointed segment
+    /// @details 0 (the default) turns checkpointing off, so every layer is recorded as normal
+    inline void setCheckpointInterval(int checkpointInterval)
+    {
+        _checkpointInterval = checkpointInterval;
+    }
+
+    /// @brief Set the masses corresponding to the vacuum hamiltonian eigenstates
+    /// @param newMasses The new masses, with shape {1, nGenerations}
+    inline void setMasses(const Tensor &newMasses)
+    {
+        _masses = newMasses;
+    }
+
+    /// @brief Set the PMNS matrix
+    /// @param newPMNS The new matrix, with shape {1, nGenerations, nGenerations}
+    inline void setPMNS(const Tensor &newPMNS)
+    {
+        _pmnsMatrix = newPMNS;
+    }
+
+    /// @}
+
+    /// @brief Get the number of layers
+    [[nodiscard]] inline int getNLayers() const
+    {
+        return static_cast<int>(_lengths.size());
+    }
+
+  private:
+    Tensor _pmnsMatrix;
+    Tensor _masses;
+    Tensor _densities;
+    std::vector<float> _lengths;
+    int _nGenerations;
+    int _checkpointInterval = 0;
+
+    // only used for its hamiltonian, which doesn't depend on the state of the solver. Shared so that checkpointed
+    // segments, which can be re-run after this propagator is gone, can keep hold of it
+    std::shared_ptr<const ConstDensityMatterSolver> _hamiltonianSolver;
+};
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <mutex>
+#include <nuTens/propagator/parallel-propagator.hpp>
+#include <nuTens/tensors/runtime-config.hpp>
+#include <stdexcept>
+#include <vector>
+
+Tensor ParallelPropagator::calculateProbs(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    if (_chunkSize <= 0)
+    {
+        NT_ERROR("Invalid chunk size {}", _chunkSize);
+        throw std::invalid_argument("ParallelPropagator chunk size must be positive");
+    }
+
+    const long int nEnergies = energies.getBatchDim();
+    const long int nChunks = (nEnergies + _chunkSize - 1) / _chunkSize;
+
+    // there would be no chunk to take the type and shape of the output from
+    if (nEnergies == 0)
+    {
+        const long int nGenerations = _propagator->getNGenerations();
+        return Tensor::zeros({0, nGenerations, nGenerations}, NTdtypes::kFloat, energies.getDevice(), false);
+    }
+
+    if (_threadPool->getNThreads() > 1 && RuntimeConfig::getIntraOpThreads() > 1)
+    {
+        static std::once_flag warned;
+        std::call_once(warned, []() {
+            NT_WARN("ParallelPropagator is running with {} intra-op threads per worker, which oversubscribes the "
+                    "cpus. Call RuntimeConfig::setIntraOpThreads(1) first.",
+                    RuntimeConfig::getIntraOpThreads());
+        });
+    }
+
+    // the type and shape of the probabilities aren't known until the first chunk is done, whichever chunk that is
+    // allocates the output
+    Tensor output;
+    std::once_flag outputAllocated;
+
+    _threadPool->parallelFor(nChunks, [&](size_t chunk) {
+        Tensor::NoGradGuard noGrad;
+
+        const long int start = static_cast<long int>(chunk) * _chunkSize;
+        const long int stop = std::min(start + _chunkSize, nEnergies);
+        const Tensor::Index chunkIndex({Tensor::Slice{start, stop}});
+
+        const Tensor probs = _propagator->calculateProbs(energies.getValues(chunkIndex));
+
+        std::call_once(outputAllocated, [&]() {
+            std::vector<long int> shape;
+            for (int dimSize : probs.getShape())
+            {
+                shape.push_back(dimSize);
+            }
+            shape[0] = nEnergies;
+            output = Tensor::zeros(shape, probs.getDType(), probs.getDevice(), false);
+        });
+
+        // chunks never overlap so writing them from different threads at once is fine
+        output.setValue(chunkIndex, probs);
+    });
+
+    return output;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/thread-pool.hpp>
+
+/// @file parallel-propagator.hpp
+
+class ParallelPropagator
+{
+    /*!
+     * @class ParallelPropagator
+     * @brief Calculates oscillation probabilities for very large numbers of energies using many threads
+     *
+     * The operations done by a Propagator on a {B, n, n} batch are individually too small for the tensor library to
+     * split them efficiently between many cores. A ParallelPropagator instead splits the energies into chunks, small
+     * enough that the temporary tensors for a chunk stay in cache, and hands the chunks out to a work-stealing
+     * ThreadPool. Each worker runs the ordinary Propagator::calculateProbs() on its chunks and writes the results
+     * straight into a single preallocated output tensor, on the same device as the probabilities.
+     *
+     * The tensor library would otherwise split each operation of every worker between its own intra-op threads as
+     * well, leaving far more busy threads than cores. The number of intra-op threads is global and can't safely be
+     * changed while other threads are using the library, so the caller should set it to 1 before using a
+     * ParallelPropagator with more than one worker, e.g. with RuntimeConfig::setIntraOpThreads(1). A warning is
+     * logged the first time this hasn't been done.
+     *
+     * \code{.cpp}
+     *   ParallelPropagator parallelProp(propagator);
+     *   Tensor probs = parallelProp.calculateProbs(energies); // energies has shape {1000000, 1}
+     * \endcode
+     *
+     * Gradient tracking is turned off for the calculation so the returned probabilities can't be used in backward().
+     * If you need gradients use the Propagator directly.
+     *
+     * The Propagator is shared, not copied, so changes made to it using its setters are seen by the
+     * ParallelPropagator. They must not be made while calculateProbs() is running.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param propagator The (configured) propagator to use to calculate the probabilities
+    /// @param threadPool The pool to run the chunks on. If not set, a pool with one thread per core is made.
+    /// @param chunkSize The number of energies in each chunk
+    explicit ParallelPropagator(std::shared_ptr<const Propagator> propagator,
+                                std::shared_ptr<ThreadPool> threadPool = nullptr, long int chunkSize = 1024)
+        : _propagator(std::move(propagator)), _threadPool(std::move(threadPool)), _chunkSize(chunkSize)
+    {
+        if (_threadPool == nullptr)
+        {
+            _threadPool = std::make_shared<ThreadPool>();
+        }
+    }
+
+    /// @brief Calculate the oscillation probabilities
+    /// @param energies The energies of the neutrinos, the first dimension gets split into chunks
+    [[nodiscard]] Tensor calculateProbs(const Tensor &energies) const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the number of energies in each chunk
+    /// @details Smaller chunks balance the load between threads better, bigger ones have less overhead. The default
+    /// keeps the temporary tensors of a three flavour calculation comfortably inside a typical L2 cache.
+    inline void setChunkSize(long int chunkSize)
+    {
+        _chunkSize = chunkSize;
+    }
+
+    /// @}
+
+    /// @name Getters
+    /// @{
+
+    [[nodiscard]] inline long int getChunkSize() const
+    {
+        return _chunkSize;
+    }
+
+    [[nodiscard]] inline const std::shared_ptr<ThreadPool> &getThreadPool() const
+    {
+        return _threadPool;
+    }
+
+    /// @}
+
+  private:
+    std::shared_ptr<const Propagator> _propagator;
+    std::shared_ptr<ThreadPool> _threadPool;
+    long int _chunkSize;
+};
@@ -0,0 +1,131 @@
+#include <nuTens/propagator/probability-cache.hpp>
+
+namespace
+{
+// 64 bit FNV-1a
+constexpr uint64_t fnvPrime = 1099511628211ULL;
+} // namespace
+
+uint64_t ProbabilityCache::fingerprint(uint64_t fingerprint, const void *data, size_t nBytes)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < nBytes; i++)
+    {
+        fingerprint = (fingerprint ^ bytes[i]) * fnvPrime;
+    }
+
+    return fingerprint;
+}
+
+uint64_t ProbabilityCache::fingerprint(uint64_t fingerprint, const Tensor &tensor)
+{
+    NT_PROFILE();
+
+    const Tensor::Buffer buffer = tensor.toBuffer();
+
+    size_t numel = 1;
+    for (long int dimSize : buffer.shape)
+    {
+        numel *= static_cast<size_t>(dimSize);
+    }
+
+    // the shape goes in too so that e.g. {N, 1} and {1, N} energies are told apart
+    const auto type = static_cast<int>(buffer.type);
+    fingerprint = ProbabilityCache::fingerprint(fingerprint, &type, sizeof(type));
+    fingerprint =
+        ProbabilityCache::fingerprint(fingerprint, buffer.shape.data(), buffer.shape.size() * sizeof(long int));
+    return ProbabilityCache::fingerprint(fingerprint, buffer.data, numel * NTdtypes::scalarTypeSize(buffer.type));
+}
+
+std::optional<Tensor> ProbabilityCache::find(const Key &key)
+{
+    NT_PROFILE();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _lookup.find(key);
+    if (found == _lookup.end())
+    {
+        _stats.misses++;
+        return std::nullopt;
+    }
+
+    _stats.hits++;
+    _entries.splice(_entries.begin(), _entries, found->second);
+    return found->second->probs;
+}
+
+void ProbabilityCache::insert(const Key &key, const Tensor &probs)
+{
+    NT_PROFILE();
+
+    const size_t bytes = probs.getNumel() * NTdtypes::scalarTypeSize(probs.getDType());
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // another thread may have got here first with the same calculation
+    auto found = _lookup.find(key);
+    if (found != _lookup.end())
+    {
+        _entries.splice(_entries.begin(), _entries, found->second);
+        return;
+    }
+
+    if (bytes > _maxBytes)
+    {
+        return;
+    }
+
+    evictTo(_maxBytes - bytes);
+
+    _entries.push_front(Entry{key, probs, bytes});
+    _lookup[key] = _entries.begin();
+    _stats.bytes += bytes;
+}
+
+void ProbabilityCache::recordBypass()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.bypassed++;
+}
+
+void ProbabilityCache::clear()
+{
+    NT_PROFILE();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _lookup.clear();
+    _stats.bytes = 0;
+}
+
+void ProbabilityCache::setMaxBytes(size_t maxBytes)
+{
+    NT_PROFILE();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _maxBytes = maxBytes;
+    evictTo(maxBytes);
+}
+
+ProbabilityCache::Stats ProbabilityCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Stats ret = _stats;
+    ret.nEntries = _entries.size();
+    ret.maxBytes = _maxBytes;
+    return ret;
+}
+
+void ProbabilityCache::evictTo(size_t maxBytes)
+{
+    while (!_entries.empty() && _stats.bytes > maxBytes)
+    {
+        const Entry &oldest = _entries.back();
+        _stats.bytes -= oldest.bytes;
+        _stats.evictions++;
+        _lookup.erase(oldest.key);
+        _entries.pop_back();
+    }
+}
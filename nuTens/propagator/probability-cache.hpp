@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+/*!
+ * @file probability-cache.hpp
+ * @brief Defines a least recently used cache of oscillation probabilities
+ */
+
+class ProbabilityCache
+{
+    /*!
+     * @class ProbabilityCache
+     * @brief Thread safe, memory bounded, least recently used store of probability tensors
+     *
+     * Used by Propagator::calculateProbs() (see Propagator::setCacheSize()) to skip calculations it has recently done.
+     * Results are looked up by a Key made of two fingerprints: one of everything about the propagator that the
+     * probabilities depend on, and one of the energies. Fingerprints are hashes of the values of the tensors, rather
+     * than of which tensors they are, so changes made in place (e.g. by Propagator::setPMNS() with an index) are
+     * noticed, and equal energies held in different tensors still hit the cache.
+     *
+     * When adding a result would take the total size of the stored tensors over the limit, the least recently used
+     * results are dropped to make room. Results bigger than the limit on their own are not stored at all.
+     */
+
+  public:
+    /// @brief Identifies a cached result
+    struct Key
+    {
+        uint64_t parameters = 0; //!< Fingerprint of the propagator configuration
+        uint64_t energies = 0;   //!< Fingerprint of the energies
+
+        [[nodiscard]] inline bool operator==(const Key &other) const
+        {
+            return parameters == other.parameters && energies == other.energies;
+        }
+    };
+
+    /// @struct Stats
+    /// @brief Counters describing how well the cache is doing, and how much memory it is using
+    struct Stats
+    {
+        size_t hits = 0;      //!< Number of lookups that found a stored result
+        size_t misses = 0;    //!< Number of lookups that had to be calculated
+        size_t bypassed = 0;  //!< Number of calculations that skipped the cache, because gradients were needed
+        size_t evictions = 0; //!< Number of results dropped to stay within the memory limit
+        size_t nEntries = 0;  //!< Number of results currently stored
+        size_t bytes = 0;     //!< Total size of the stored results
+        size_t maxBytes = 0;  //!< Most memory that the stored results are allowed to take up
+
+        /// @brief Get the fraction of lookups that found a stored result
+        [[nodiscard]] inline double getHitRate() const
+        {
+            return (hits + misses) > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        }
+    };
+
+    /// Starting value of a fingerprint which has nothing added to it yet
+    static constexpr uint64_t emptyFingerprint = 14695981039346656037ULL;
+
+    /// @brief Constructor
+    /// @param maxBytes The most memory that the stored results can take up
+    explicit ProbabilityCache(size_t maxBytes) : _maxBytes(maxBytes)
+    {
+    }
+
+    /// @brief Add some raw memory to a fingerprint
+    /// @param fingerprint The fingerprint so far
+    /// @param data The memory to add
+    /// @param nBytes The size of the memory in bytes
+    [[nodiscard]] static uint64_t fingerprint(uint64_t fingerprint, const void *data, size_t nBytes);
+
+    /// @brief Add the type, shape and values of a tensor to a fingerprint
+    /// @details The tensor gets copied to contiguous CPU memory first if it isn't already
+    [[nodiscard]] static uint64_t fingerprint(uint64_t fingerprint, const Tensor &tensor);
+
+    /// @brief Look up a result, marking it as the most recently used if found
+    [[nodiscard]] std::optional<Tensor> find(const Key &key);
+
+    /// @brief Store a result, dropping the least recently used ones if needed to stay within the memory limit
+    void insert(const Key &key, const Tensor &probs);
+
+    /// @brief Count a calculation that did not use the cache
+    void recordBypass();
+
+    /// @brief Drop all stored results, keeping the counters
+    void clear();
+
+    /// @brief Change the memory limit, dropping results if it has gone down
+    void setMaxBytes(size_t maxBytes);
+
+    /// @brief Get a snapshot of the counters
+    [[nodiscard]] Stats getStats() const;
+
+  private:
+    struct KeyHash
+    {
+        inline size_t operator()(const Key &key) const
+        {
+            return static_cast<size_t>(key.parameters ^ (key.energies * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        Tensor probs;
+        size_t bytes;
+    };
+
+    // must be called with the mutex locked
+    void evictTo(size_t maxBytes);
+
+    mutable std::mutex _mutex;
+    size_t _maxBytes;
+    Stats _stats;
+
+    // most recently used at the front
+    std::list<Entry> _entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _lookup;
+};
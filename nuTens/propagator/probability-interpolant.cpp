@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cmath>
+#include <nuTens/propagator/probability-interpolant.hpp>
+#include <stdexcept>
+
+namespace
+{
+
+// the grid and probabilities of one channel while the table is being built
+struct ChannelGrid
+{
+    std::vector<float> energies;
+    std::vector<float> values;
+
+    // whether each interval has met the tolerance
+    std::vector<bool> finished;
+};
+
+} // namespace
+
+ProbabilityInterpolant::ProbabilityInterpolant(const Propagator &propagator, float minEnergy, float maxEnergy,
+                                               float tolerance, int nInitialPoints, int maxPointsPerChannel)
+    : _minEnergy(minEnergy), _maxEnergy(maxEnergy), _tolerance(tolerance)
+{
+    NT_PROFILE();
+
+    if (!(minEnergy > 0.0) || !(maxEnergy > minEnergy) || !(tolerance > 0.0))
+    {
+        NT_ERROR("ProbabilityInterpolant needs 0 < minEnergy < maxEnergy and a positive tolerance, got {}, {} and {}",
+                 minEnergy, maxEnergy, tolerance);
+        throw std::invalid_argument("Bad energy range or tolerance passed to ProbabilityInterpolant");
+    }
+
+    if (nInitialPoints < 2 || maxPointsPerChannel < nInitialPoints)
+    {
+        NT_ERROR("ProbabilityInterpolant needs at least 2 initial points and no more than the maximum, got {} and {}",
+                 nInitialPoints, maxPointsPerChannel);
+        throw std::invalid_argument("Bad number of points passed to ProbabilityInterpolant");
+    }
+
+    Tensor::NoGradGuard noGrad;
+
+    // starting grid evenly spaced in log(energy)
+    std::vector<float> initialEnergies(nInitialPoints);
+    for (int i = 0; i < nInitialPoints; i++)
+    {
+        const double fraction = static_cast<double>(i) / (nInitialPoints - 1);
+        initialEnergies[i] = static_cast<float>(minEnergy * std::pow(maxEnergy / minEnergy, fraction));
+    }
+    initialEnergies.front() = minEnergy;
+    initialEnergies.back() = maxEnergy;
+
+    const Tensor initialProbs = propagator.calculateProbs(
+        Tensor::reshape(Tensor(initialEnergies, NTdtypes::kFloat, NTdtypes::kCPU, false), {nInitialPoints, 1}));
+    _nGenerations = initialProbs.getShape()[1];
+    const int nChannels = _nGenerations * _nGenerations;
+
+    std::vector<ChannelGrid> grids(nChannels);
+    {
+        const Tensor::Accessor<float> probs = initialProbs.getAccessor<float>();
+        for (int channel = 0; channel < nChannels; channel++)
+        {
+            ChannelGrid &grid = grids[channel];
+            grid.energies = initialEnergies;
+            grid.finished.assign(nInitialPoints - 1, false);
+            for (int i = 0; i < nInitialPoints; i++)
+            {
+                grid.values.push_back(probs(i, channel / _nGenerations, channel % _nGenerations));
+            }
+        }
+    }
+
+    while (true)
+    {
+        // the midpoint of every interval still to be checked, shared between channels
+        std::vector<float> midpoints;
+        for (ChannelGrid &grid : grids)
+        {
+            for (size_t i = 0; i < grid.finished.size(); i++)
+            {
+                if (grid.finished[i])
+                {
+                    continue;
+                }
+
+                // intervals too narrow to split any further in single precision are as good as they can get
+                const float midpoint = 0.5F * (grid.energies[i] + grid.energies[i + 1]);
+                if (midpoint <= grid.energies[i] || midpoint >= grid.energies[i + 1])
+                {
+                    grid.finished[i] = true;
+                    continue;
+                }
+                midpoints.push_back(midpoint);
+            }
+        }
+
+        if (midpoints.empty())
+        {
+            break;
+        }
+
+        std::sort(midpoints.begin(), midpoints.end());
+        midpoints.erase(std::unique(midpoints.begin(), midpoints.end()), midpoints.end());
+        const auto nMidpoints = static_cast<long int>(midpoints.size());
+
+        const Tensor::Accessor<float> probs =
+            propagator
+                .calculateProbs(
+                    Tensor::reshape(Tensor(midpoints, NTdtypes::kFloat, NTdtypes::kCPU, false), {nMidpoints, 1}))
+                .getAccessor<float>();
+
+        for (int channel = 0; channel < nChannels; channel++)
+        {
+            const ChannelGrid &grid = grids[channel];
+            ChannelGrid refined;
+            refined.energies.push_back(grid.energies.front());
+            refined.values.push_back(grid.values.front());
+
+            for (size_t i = 0; i < grid.finished.size(); i++)
+            {
+                bool split = false;
+                if (!grid.finished[i])
+                {
+                    const float midpoint = 0.5F * (grid.energies[i] + grid.energies[i + 1]);
+                    const auto index = std::lower_bound(midpoints.begin(), midpoints.end(), midpoint) -
+                                       midpoints.begin();
+                    const float value = probs(index, channel / _nGenerations, channel % _nGenerations);
+                    const float interpolated = 0.5F * (grid.values[i] + grid.values[i + 1]);
+
+                    if (std::abs(value - interpolated) > tolerance)
+                    {
+                        // points in the refined grid so far plus those of the old grid still to come
+                        const size_t nPoints = refined.energies.size() + (grid.energies.size() - i - 1);
+                        if (static_cast<int>(nPoints) < maxPointsPerChannel)
+                        {
+                            refined.energies.push_back(midpoint);
+                            refined.values.push_back(value);
+                            refined.finished.push_back(false);
+                            split = true;
+                        }
+                        else
+                        {
+                            _converged = false;
+                        }
+                    }
+                }
+
+                refined.energies.push_back(grid.energies[i + 1]);
+                refined.values.push_back(grid.values[i + 1]);
+                refined.finished.push_back(!split);
+            }
+
+            grids[channel] = std::move(refined);
+        }
+    }
+
+    if (!_converged)
+    {
+        NT_WARN("ProbabilityInterpolant reached the limit of {} points per channel before meeting the tolerance of {}",
+                maxPointsPerChannel, tolerance);
+    }
+
+    // lay the grids end to end, separated in key space so that no two channels overlap
+    _keySpan = 2.0 * (static_cast<double>(maxEnergy) - minEnergy);
+    std::vector<double> keys;
+    std::vector<double> gridEnergies;
+    std::vector<float> gridValues;
+    std::vector<double> firstIntervals;
+    std::vector<double> lastIntervals;
+    for (int channel = 0; channel < nChannels; channel++)
+    {
+        const ChannelGrid &grid = grids[channel];
+        const auto nPoints = static_cast<int>(grid.energies.size());
+
+        _nPoints.push_back(nPoints);
+        firstIntervals.push_back(static_cast<double>(gridEnergies.size()));
+        lastIntervals.push_back(static_cast<double>(gridEnergies.size() + nPoints - 2));
+
+        for (int i = 0; i < nPoints; i++)
+        {
+            keys.push_back(channel * _keySpan + (static_cast<double>(grid.energies[i]) - minEnergy));
+            gridEnergies.push_back(grid.energies[i]);
+            gridValues.push_back(grid.values[i]);
+        }
+    }
+
+    _keys = Tensor::fromVector(keys);
+    _gridEnergies = Tensor::fromVector(gridEnergies);
+    _gridValues = Tensor(gridValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    _firstIntervals = Tensor::fromVector(firstIntervals);
+    _lastIntervals = Tensor::fromVector(lastIntervals);
+    _minEnergyTensor = Tensor::fromVector(std::vector<double>{minEnergy});
+    _maxEnergyTensor = Tensor::fromVector(std::vector<double>{maxEnergy});
+    _one = Tensor::fromVector(std::vector<double>{1.0});
+}
+
+Tensor ProbabilityInterpolant::interpolate(const Tensor &energies, const Tensor &channels) const
+{
+    NT_PROFILE();
+
+    Tensor clamped = Tensor::clamp(energies, _minEnergyTensor, _maxEnergyTensor);
+    Tensor keys = Tensor::scale(channels, _keySpan) + clamped - _minEnergyTensor;
+
+    // the interval of each energy is the last grid point at or below it, kept inside its own channel
+    Tensor channelIndices = channels;
+    channelIndices.dType(NTdtypes::kInt);
+    Tensor intervals = Tensor::bucketize(keys, _keys, /*right=*/true);
+    intervals.dType(NTdtypes::kDouble);
+    intervals = Tensor::clamp(intervals - _one, Tensor::indexSelect(_firstIntervals, 0, channelIndices),
+                              Tensor::indexSelect(_lastIntervals, 0, channelIndices));
+
+    Tensor lower = intervals;
+    lower.dType(NTdtypes::kInt);
+    Tensor upper = intervals + _one;
+    upper.dType(NTdtypes::kInt);
+
+    Tensor lowerEnergies = Tensor::indexSelect(_gridEnergies, 0, lower);
+    Tensor fractions =
+        Tensor::div(clamped - lowerEnergies, Tensor::indexSelect(_gridEnergies, 0, upper) - lowerEnergies);
+    fractions.dType(NTdtypes::kFloat);
+
+    Tensor lowerValues = Tensor::indexSelect(_gridValues, 0, lower);
+    return lowerValues + Tensor::mul(fractions, Tensor::indexSelect(_gridValues, 0, upper) - lowerValues);
+}
+
+Tensor ProbabilityInterpolant::calculateProbs(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    const auto nEnergies = static_cast<long int>(energies.getNumel());
+    const long int nChannels = static_cast<long int>(_nGenerations) * _nGenerations;
+
+    std::vector<double> channelValues(nChannels);
+    for (long int channel = 0; channel < nChannels; channel++)
+    {
+        channelValues[channel] = static_cast<double>(channel);
+    }
+
+    // every energy paired with every channel, as {nEnergies, nChannels} flattened
+    Tensor doubleEnergies = Tensor::reshape(energies, {nEnergies, 1});
+    doubleEnergies.dType(NTdtypes::kDouble);
+    Tensor ones = Tensor::ones({1, nChannels}, NTdtypes::kDouble, NTdtypes::kCPU, /*requiresGrad=*/false);
+    Tensor pairedEnergies = Tensor::reshape(Tensor::mul(doubleEnergies, ones), {-1});
+    Tensor pairedChannels = Tensor::reshape(
+        Tensor::mul(Tensor::ones({nEnergies, 1}, NTdtypes::kDouble, NTdtypes::kCPU, /*requiresGrad=*/false),
+                    Tensor::reshape(Tensor::fromVector(channelValues), {1, nChannels})),
+        {-1});
+
+    return Tensor::reshape(interpolate(pairedEnergies, pairedChannels), {nEnergies, _nGenerations, _nGenerations});
+}
+
+Tensor ProbabilityInterpolant::calculateChannelProbs(const Tensor &energies, const Tensor &initialFlavours,
+                                                     const Tensor &finalFlavours) const
+{
+    NT_PROFILE();
+
+    const auto nEnergies = static_cast<long int>(energies.getNumel());
+
+    Tensor doubleEnergies = Tensor::reshape(energies, {nEnergies});
+    doubleEnergies.dType(NTdtypes::kDouble);
+    Tensor initial = Tensor::reshape(initialFlavours, {nEnergies});
+    initial.dType(NTdtypes::kDouble);
+    Tensor final = Tensor::reshape(finalFlavours, {nEnergies});
+    final.dType(NTdtypes::kDouble);
+
+    return interpolate(doubleEnergies, Tensor::scale(initial, static_cast<double>(_nGenerations)) + final);
+}
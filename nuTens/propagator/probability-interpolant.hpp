@@ -0,0 +1,129 @@
+#pragma once
+
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/*!
+ * @file probability-interpolant.hpp
+ * @brief Defines a table of oscillation probabilities on adaptively refined energy grids
+ */
+
+class ProbabilityInterpolant
+{
+    /*!
+     * @class ProbabilityInterpolant
+     * @brief Linearly interpolates the probabilities of a Propagator from a table, with a grid chosen separately for
+     * each channel so that the interpolation error is below some tolerance
+     *
+     * The table is built for the current configuration of the propagator, starting from a coarse grid evenly spaced
+     * in log(energy). Every interval of each channel's grid is checked by calculating the probability at its midpoint
+     * using Propagator::calculateProbs() and comparing it to the interpolated value. Intervals where they differ by
+     * more than the tolerance are split in two and checked again, until every interval passes or a channel reaches
+     * the maximum number of points. The midpoints needed by all channels are calculated together in one batch on each
+     * round. This puts points where the probability oscillates quickly, and hardly any where it is smooth.
+     *
+     * Looking up the probabilities is then a single vectorised bracket search (Tensor::bucketize()) over the grids of
+     * every channel, laid end to end, followed by a linear interpolation. This is much cheaper than calculating the
+     * probabilities, especially in matter, so is useful when the same oscillation parameters are used to reweight
+     * many events. The table does not follow later changes to the propagator, so has to be rebuilt when the
+     * parameters change, and is not differentiable with respect to them.
+     * \code{.cpp}
+     *   ProbabilityInterpolant interpolant(propagator, 0.1, 10.0, 1e-3);
+     *   Tensor probs = interpolant.calculateChannelProbs(energies, initialFlavours, finalFlavours);
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor, builds the table
+    /// @param propagator The propagator to calculate the probabilities with
+    /// @param minEnergy The lowest energy in the table, must be positive
+    /// @param maxEnergy The highest energy in the table
+    /// @param tolerance The largest difference allowed between the interpolated and calculated probabilities at the
+    /// middle of each interval
+    /// @param nInitialPoints The number of points in the starting grid, at least 2
+    /// @param maxPointsPerChannel The most points that the grid of any channel can have
+    ProbabilityInterpolant(const Propagator &propagator, float minEnergy, float maxEnergy, float tolerance,
+                           int nInitialPoints = 16, int maxPointsPerChannel = 4096);
+
+    /// @brief Interpolate the probabilities of every channel
+    /// @details Energies outside of the table get the probabilities at its nearest end
+    /// @param energies The energies of the neutrinos, with Nbatches values
+    /// @return Tensor with shape {Nbatches, nGenerations, nGenerations}, like Propagator::calculateProbs()
+    [[nodiscard]] Tensor calculateProbs(const Tensor &energies) const;
+
+    /// @brief Interpolate the probability of a single channel for each neutrino
+    /// @param energies The energies of the neutrinos, with Nbatches values
+    /// @param initialFlavours The flavour each neutrino was produced as, an integer tensor with shape {Nbatches}
+    /// @param finalFlavours The flavour each neutrino is detected as, an integer tensor with shape {Nbatches}
+    /// @return Tensor with shape {Nbatches}, like Propagator::calculateChannelProbs()
+    [[nodiscard]] Tensor calculateChannelProbs(const Tensor &energies, const Tensor &initialFlavours,
+                                               const Tensor &finalFlavours) const;
+
+    /// @name Getters
+    /// @{
+
+    /// @brief Get the number of points in the grid of one channel
+    [[nodiscard]] inline int getNPoints(int initialFlavour, int finalFlavour) const
+    {
+        return _nPoints.at(initialFlavour * _nGenerations + finalFlavour);
+    }
+
+    /// @brief Check whether every interval met the tolerance without any channel running out of points
+    [[nodiscard]] inline bool isConverged() const
+    {
+        return _converged;
+    }
+
+    [[nodiscard]] inline int getNGenerations() const
+    {
+        return _nGenerations;
+    }
+
+    [[nodiscard]] inline float getTolerance() const
+    {
+        return _tolerance;
+    }
+
+    [[nodiscard]] inline float getMinEnergy() const
+    {
+        return _minEnergy;
+    }
+
+    [[nodiscard]] inline float getMaxEnergy() const
+    {
+        return _maxEnergy;
+    }
+
+    /// @}
+
+  private:
+    // interpolate at some energies, each in its own channel (initialFlavour * nGenerations + finalFlavour), with both
+    // given as 1-d kDouble tensors
+    [[nodiscard]] Tensor interpolate(const Tensor &energies, const Tensor &channels) const;
+
+    int _nGenerations = 0;
+    float _minEnergy;
+    float _maxEnergy;
+    float _tolerance;
+    bool _converged = true;
+
+    // number of grid points of each channel
+    std::vector<int> _nPoints;
+
+    // the grids of every channel laid end to end. Keys are offset by channel * _keySpan so that they increase across
+    // the whole table and can be searched in one go
+    double _keySpan;
+    Tensor _keys;
+    Tensor _gridEnergies;
+    Tensor _gridValues;
+
+    // the first and last interval of each channel in the flattened table
+    Tensor _firstIntervals;
+    Tensor _lastIntervals;
+
+    Tensor _minEnergyTensor;
+    Tensor _maxEnergyTensor;
+    Tensor _one;
+};
@@ -1,14 +1,268 @@
 #include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor-arena.hpp>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+// each thread gets its own workspace so that threads sharing a propagator never touch each others temporaries
+thread_local TensorArena workspace;
+
+// used by calculateProbsAsync() when no executor has been set
+AsyncExecutor &getDefaultExecutor()
+{
+    static AsyncExecutor executor(1, 2);
+    return executor;
+}
+
+// find the distinct energies, and where each of the energies is in them. Returns false if the energies can't be
+// deduplicated (they need a gradient, or aren't {Nbatches, 1}), if any of the other inputs has more than one entry in
+// its batch dimension (each neutrino then has its own inputs, so can't share a result with others of the same energy)
+// or if there would be nothing to gain (they're all distinct)
+bool findUniqueEnergies(const Tensor &energies, const std::vector<Tensor> &inputs, Tensor &uniqueEnergies,
+                        Tensor &inverseIndices)
+{
+    NT_PROFILE();
+
+    if (energies.getRequiresGrad() || energies.getNdim() != 2 || energies.getShape()[1] != 1)
+    {
+        return false;
+    }
+
+    for (const Tensor &input : inputs)
+    {
+        if (input.getNdim() > 0 && input.getShape()[0] > 1)
+        {
+            return false;
+        }
+    }
+
+    uniqueEnergies = Tensor::unique(energies, inverseIndices);
+    if (uniqueEnergies.getNumel() == energies.getNumel())
+    {
+        return false;
+    }
+
+    uniqueEnergies = Tensor::reshape(uniqueEnergies, {-1, 1});
+    return true;
+}
+
+// amplitudes A_ab = sum_k L*_ak w_k R_bk for mixing matrices L and R (both the PMNS matrix U, except when working out
+// derivatives) and weights w
+Tensor getAmplitudes(const Tensor &left, const Tensor &weights, const Tensor &right)
+{
+    return Tensor::matmul(Tensor::mul(left.conj(), Tensor::unsqueeze(weights, -2)), Tensor::transpose(right, -2, -1));
+}
+
+// gaps[..., i, j] = lambda_j - lambda_i, with ones on the diagonal so that it can be divided by
+Tensor getEigenvalueGaps(const Tensor &eigenvalues)
+{
+    const int nGenerations = eigenvalues.getShape().back();
+    return Tensor::unsqueeze(eigenvalues, -2) - Tensor::unsqueeze(eigenvalues, -1) +
+           Tensor::eye(nGenerations, eigenvalues.getDType(), eigenvalues.getDevice(), /*requiresGrad=*/false);
+}
+
+// gradient of a hermitian matrix given the gradients of its eigenvalues and eigenvectors
+Tensor hermitianEigenBackward(const Tensor &eigenvalues, const Tensor &eigenvectors, const Tensor &gradEigenvalues,
+                              const Tensor &gradEigenvectors)
+{
+    Tensor eigenvectorsH = Tensor::transpose(eigenvectors.conj(), -2, -1);
+
+    // only the anti-hermitian part matters, the rest just changes the (arbitrary) phases of the eigenvectors
+    Tensor projected = Tensor::matmul(eigenvectorsH, gradEigenvectors);
+    Tensor skew = Tensor::scale(projected - Tensor::transpose(projected.conj(), -2, -1), 0.5);
+
+    // the diagonal is the Hellmann-Feynman part: d lambda_i = v_i^dagger dH v_i
+    Tensor inner = Tensor::div(skew, getEigenvalueGaps(eigenvalues)) - Tensor::diagEmbed(Tensor::diagonal(skew)) +
+                   Tensor::diagEmbed(gradEigenvalues);
+
+    return Tensor::matmul(eigenvectors, Tensor::matmul(inner, eigenvectorsH));
+}
+
+// flatten the gradients of one value with respect to each of the parameters into a single 1-d tensor
+Tensor flattenGradients(const std::vector<Tensor> &gradients, long int nParams)
+{
+    Tensor ret = Tensor::zeros({nParams}, gradients[0].getDType(), gradients[0].getDevice(), /*requiresGrad=*/false);
+
+    long int offset = 0;
+    for (const Tensor &gradient : gradients)
+    {
+        const auto numel = static_cast<long int>(gradient.getNumel());
+        ret.setValue(Tensor::Index({Tensor::Slice{offset, offset + numel}}), Tensor::reshape(gradient, {-1}));
+        offset += numel;
+    }
+
+    return ret;
+}
+
+// derivatives of every element of x with respect to every parameter, with shape {nParams, <shape of x>}
+Tensor getTangents(const Tensor &x, const std::vector<Tensor> &params, long int nParams)
+{
+    const bool isComplex = (x.getDType() == NTdtypes::kComplexFloat) || (x.getDType() == NTdtypes::kComplexDouble);
+
+    Tensor flat = Tensor::reshape(x, {-1});
+    const auto numel = static_cast<long int>(flat.getNumel());
+    Tensor tangents = Tensor::zeros({nParams, numel}, x.getDType(), x.getDevice(), /*requiresGrad=*/false);
+
+    // one backward pass per element (two if it's complex), x is small so this is cheap
+    for (long int i = 0; i < numel; i++)
+    {
+        const Tensor::Index element({i});
+
+        Tensor selector = Tensor::zeros({numel}, x.getDType(), x.getDevice(), /*requiresGrad=*/false);
+        selector.setValue(element, 1.0);
+        Tensor column = flattenGradients(Tensor::gradients(flat, params, selector, /*retainGraph=*/true), nParams);
+
+        if (isComplex)
+        {
+            selector.setValue(element, std::complex<float>(0.0, 1.0));
+            Tensor imagColumn =
+                flattenGradients(Tensor::gradients(flat, params, selector, /*retainGraph=*/true), nParams);
+            column = column + Tensor::scale(imagColumn, std::complex<float>(0.0, 1.0));
+        }
+
+        tangents.setValue(Tensor::Index({Tensor::Slice{}, i}), column);
+    }
+
+    std::vector<long int> tangentShape = {nParams};
+    for (int dimSize : x.getShape())
+    {
+        tangentShape.push_back(dimSize);
+    }
+
+    return Tensor::reshape(tangents, tangentShape);
+}
+} // namespace
 
 Tensor Propagator::calculateProbs(const Tensor &energies) const
 {
     NT_PROFILE();
 
+    std::optional<ProbabilityCache::Key> cacheKey;
+    if (_cache != nullptr)
+    {
+        if (_needsGradient(energies))
+        {
+            _cache->recordBypass();
+        }
+        else
+        {
+            cacheKey = _getCacheKey(energies);
+            if (std::optional<Tensor> cached = _cache->find(*cacheKey))
+            {
+                return *cached;
+            }
+        }
+    }
+
+    // respect any arena that the caller has set up
+    std::optional<TensorArena::Scope> workspaceScope;
+    if (_useWorkspace && TensorArena::getActive() == nullptr)
+    {
+        workspaceScope.emplace(workspace);
+    }
+
+    Tensor ret;
+    Tensor uniqueEnergies;
+    Tensor inverseIndices;
+    if (_deduplicateEnergies && findUniqueEnergies(energies, _getInputs(), uniqueEnergies, inverseIndices))
+    {
+        ret = Tensor::indexSelect(_calculateProbsDirect(uniqueEnergies), 0, inverseIndices);
+    }
+    else
+    {
+        ret = _calculateProbsDirect(energies);
+    }
+
+    if (cacheKey.has_value())
+    {
+        _cache->insert(*cacheKey, ret);
+    }
+
+    return ret;
+}
+
+bool Propagator::_needsGradient(const Tensor &energies) const
+{
+    if (!Tensor::isGradEnabled())
+    {
+        return false;
+    }
+
+    if (energies.getRequiresGrad() || _masses.getRequiresGrad() || _pmnsMatrix.getRequiresGrad())
+    {
+        return true;
+    }
+
+    if (_matterSolver != nullptr)
+    {
+        for (const Tensor &parameter : _matterSolver->getParameters())
+        {
+            if (parameter.getRequiresGrad())
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+std::vector<Tensor> Propagator::_getInputs() const
+{
+    std::vector<Tensor> ret = {_masses, _pmnsMatrix};
+    if (_matterSolver != nullptr)
+    {
+        for (const Tensor &parameter : _matterSolver->getParameters())
+        {
+            ret.push_back(parameter);
+        }
+    }
+    return ret;
+}
+
+ProbabilityCache::Key Propagator::_getCacheKey(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    ProbabilityCache::Key ret;
+
+    uint64_t parameters = ProbabilityCache::emptyFingerprint;
+    parameters = ProbabilityCache::fingerprint(parameters, &_nGenerations, sizeof(_nGenerations));
+    parameters = ProbabilityCache::fingerprint(parameters, &_baseline, sizeof(_baseline));
+    parameters = ProbabilityCache::fingerprint(parameters, _masses);
+    parameters = ProbabilityCache::fingerprint(parameters, _pmnsMatrix);
+
+    // which solver it is tells apart e.g. vacuum and matter, or different solvers with the same parameters
+    const BaseMatterSolver *solver = _matterSolver.get();
+    parameters = ProbabilityCache::fingerprint(parameters, static_cast<const void *>(&solver), sizeof(solver));
+    if (solver != nullptr)
+    {
+        for (const Tensor &parameter : solver->getParameters())
+        {
+            parameters = ProbabilityCache::fingerprint(parameters, parameter);
+        }
+    }
+
+    ret.parameters = parameters;
+    ret.energies = ProbabilityCache::fingerprint(ProbabilityCache::emptyFingerprint, energies);
+    return ret;
+}
+
+Tensor Propagator::_calculateProbsDirect(const Tensor &energies) const
+{
+    NT_PROFILE();
+
     Tensor ret;
 
+    if (_analyticGradients && (_matterSolver == nullptr || _matterSolver->supportsAnalyticGradients()))
+    {
+        ret = _calculateProbsAnalytic(energies);
+    }
+
     // if a matter solver was specified, use effective values for masses and PMNS
     // matrix, otherwise just use the "raw" ones
-    if (_matterSolver != nullptr)
+    else if (_matterSolver != nullptr)
     {
         Tensor eigenVals =
             Tensor::zeros({1, _nGenerations, _nGenerations}, NTdtypes::kComplexFloat).requiresGrad(false);
@@ -30,6 +284,94 @@ Tensor Propagator::calculateProbs(const Tensor &energies) const
     return ret;
 }
 
+Tensor Propagator::calculateChannelProbs(const Tensor &energies, const Tensor &initialFlavours,
+                                         const Tensor &finalFlavours) const
+{
+    NT_PROFILE();
+
+    std::optional<TensorArena::Scope> workspaceScope;
+    if (_useWorkspace && TensorArena::getActive() == nullptr)
+    {
+        workspaceScope.emplace(workspace);
+    }
+
+    Tensor initialRows;
+    Tensor finalRows;
+    if (_pmnsMatrix.getShape()[0] == 1)
+    {
+        Tensor PMNS = Tensor::reshape(_pmnsMatrix, {_nGenerations, _nGenerations});
+        initialRows = Tensor::indexSelect(PMNS, 0, initialFlavours);
+        finalRows = Tensor::indexSelect(PMNS, 0, finalFlavours);
+    }
+    else
+    {
+        // the hamiltonian of the matter solvers is only built from the first PMNS matrix
+        if (_matterSolver != nullptr)
+        {
+            NT_ERROR("calculateChannelProbs() in matter needs a PMNS matrix with a batch dimension of 1, got {}",
+                     _pmnsMatrix.getShape()[0]);
+            throw std::invalid_argument("Batched PMNS matrix passed to calculateChannelProbs() with a matter solver");
+        }
+
+        // each neutrino has its own PMNS matrix, so pick out its rows by multiplying by one-hot flavour vectors
+        const Tensor identity = Tensor::eye(_nGenerations, NTdtypes::kComplexFloat, _pmnsMatrix.getDevice(), false);
+        initialRows = Tensor::reshape(
+            Tensor::matmul(Tensor::unsqueeze(Tensor::indexSelect(identity, 0, initialFlavours), -2), _pmnsMatrix),
+            {-1, _nGenerations});
+        finalRows = Tensor::reshape(
+            Tensor::matmul(Tensor::unsqueeze(Tensor::indexSelect(identity, 0, finalFlavours), -2), _pmnsMatrix),
+            {-1, _nGenerations});
+    }
+
+    Tensor phases;
+    if (_matterSolver == nullptr)
+    {
+        // phi = m^2 L / 2E
+        phases = Tensor::div(Tensor::scale(Tensor::mul(_masses, _masses), 0.5 * _baseline), energies);
+    }
+    else
+    {
+        // the eigen decomposition only depends on the energy, so only needs doing once for each distinct energy
+        Tensor uniqueEnergies;
+        Tensor inverseIndices;
+        const bool deduplicate =
+            _deduplicateEnergies && findUniqueEnergies(energies, _getInputs(), uniqueEnergies, inverseIndices);
+        const Tensor &solverEnergies = deduplicate ? uniqueEnergies : energies;
+
+        Tensor eigenvalues;
+        Tensor eigenvectors;
+        if (_matterSolver->supportsAnalyticGradients())
+        {
+            Tensor::eigh(_matterSolver->calculateHamiltonian(solverEnergies, _masses, _pmnsMatrix,
+                                                             _matterSolver->getParameters()),
+                         eigenvalues, eigenvectors);
+        }
+        else
+        {
+            _matterSolver->calculateEigenvalues(solverEnergies, eigenvectors, eigenvalues);
+        }
+
+        if (deduplicate)
+        {
+            eigenvalues = Tensor::indexSelect(eigenvalues, 0, inverseIndices);
+            eigenvectors = Tensor::indexSelect(eigenvectors, 0, inverseIndices);
+        }
+
+        // phi = lambda L, and the rows of U' = U V that are needed
+        phases = Tensor::scale(eigenvalues, _baseline);
+        initialRows =
+            Tensor::reshape(Tensor::matmul(Tensor::unsqueeze(initialRows, -2), eigenvectors), {-1, _nGenerations});
+        finalRows =
+            Tensor::reshape(Tensor::matmul(Tensor::unsqueeze(finalRows, -2), eigenvectors), {-1, _nGenerations});
+    }
+
+    // A = sum_k U'*_ak w_k U'_bk and P = |A|^2
+    Tensor weights = Tensor::exp(Tensor::scale(phases, std::complex<float>(-1.0J)));
+    Tensor amplitudes = Tensor::mul(Tensor::mul(initialRows.conj(), weights), finalRows).sum({-1});
+
+    return Tensor::mul(amplitudes.abs(), amplitudes.abs());
+}
+
 Tensor Propagator::_calculateProbs(const Tensor &energies, const Tensor &massesSq, const Tensor &PMNS) const
 {
     NT_PROFILE();
@@ -44,7 +386,7 @@ Tensor Propagator::_calculateProbs(const Tensor &energies, const Tensor &massesS
     {
         for (int j = 0; j < _nGenerations; j++)
         {
-            weightMatrix.setValue({"...", i, j}, weightVector.getValues({"...", j}));
+            weightMatrix.setValue(_matrixIndices[i * _nGenerations + j], weightVector.getValues(_vectorIndices[j]));
         }
     }
     weightMatrix.requiresGrad(true);
@@ -53,3 +395,244 @@ Tensor Propagator::_calculateProbs(const Tensor &energies, const Tensor &massesS
 
     return Tensor::mul(sqrtProbabilities.abs(), sqrtProbabilities.abs());
 }
+
+Tensor Propagator::_calculateProbsAnalytic(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    // copied into the forward and backward functions, as the backward one can outlive this propagator
+    const float baseline = _baseline;
+    std::shared_ptr<const BaseMatterSolver> solver = _matterSolver;
+
+    std::vector<Tensor> inputs = {energies, _masses, _pmnsMatrix};
+    if (solver != nullptr)
+    {
+        for (const Tensor &parameter : solver->getParameters())
+        {
+            inputs.push_back(parameter);
+        }
+    }
+    const size_t nInputs = inputs.size();
+
+    // saves the inputs, then the weights and amplitudes, then (in matter) the eigenvalues and eigenvectors
+    auto forward = [=](const std::vector<Tensor> &in, std::vector<Tensor> &saved) -> std::vector<Tensor> {
+        const Tensor &energies = in[0];
+        const Tensor &masses = in[1];
+        const Tensor &PMNS = in[2];
+
+        Tensor phases;
+        Tensor effectivePMNS;
+        Tensor eigenvalues;
+        Tensor eigenvectors;
+        if (solver == nullptr)
+        {
+            phases = Tensor::div(Tensor::scale(Tensor::mul(masses, masses), 0.5 * baseline), energies);
+            effectivePMNS = PMNS;
+        }
+        else
+        {
+            const std::vector<Tensor> parameters(in.begin() + 3, in.end());
+            Tensor::eigh(solver->calculateHamiltonian(energies, masses, PMNS, parameters), eigenvalues, eigenvectors);
+            phases = Tensor::scale(eigenvalues, baseline);
+            effectivePMNS = Tensor::matmul(PMNS, eigenvectors);
+        }
+
+        Tensor weights = Tensor::exp(Tensor::scale(phases, std::complex<float>(-1.0J)));
+        Tensor amplitudes = getAmplitudes(effectivePMNS, weights, effectivePMNS);
+
+        saved = in;
+        saved.push_back(weights);
+        saved.push_back(amplitudes);
+        if (solver != nullptr)
+        {
+            saved.push_back(eigenvalues);
+            saved.push_back(eigenvectors);
+        }
+
+        return {Tensor::mul(amplitudes.abs(), amplitudes.abs())};
+    };
+
+    auto backward = [=](const std::vector<Tensor> &saved,
+                        const std::vector<Tensor> &gradOutputs) -> std::vector<Tensor> {
+        const Tensor &energies = saved[0];
+        const Tensor &masses = saved[1];
+        const Tensor &PMNS = saved[2];
+        const Tensor &weights = saved[nInputs];
+        const Tensor &amplitudes = saved[nInputs + 1];
+
+        Tensor effectivePMNS = (solver == nullptr) ? PMNS : Tensor::matmul(PMNS, saved[nInputs + 3]);
+
+        // P = |A|^2
+        Tensor gradAmplitudes = Tensor::scale(Tensor::mul(gradOutputs[0], amplitudes), 2.0);
+
+        // A = U'^* diag(w) U'^T
+        Tensor gradWeights =
+            Tensor::mul(effectivePMNS, Tensor::matmul(gradAmplitudes, effectivePMNS.conj())).sum({-2});
+        Tensor gradEffectivePMNS =
+            Tensor::mul(Tensor::matmul(Tensor::transpose(gradAmplitudes, -2, -1), effectivePMNS),
+                        Tensor::unsqueeze(weights.conj(), -2)) +
+            Tensor::mul(Tensor::matmul(gradAmplitudes.conj(), effectivePMNS), Tensor::unsqueeze(weights, -2));
+
+        // w = exp(-i phi)
+        Tensor gradPhases = Tensor::mul(gradWeights.conj(), weights).imag();
+
+        if (solver == nullptr)
+        {
+            // phi = m^2 L / 2E
+            Tensor gradEnergies = Tensor::mul(
+                gradPhases, Tensor::div(Tensor::scale(Tensor::mul(masses, masses), -0.5 * baseline),
+                                        Tensor::mul(energies, energies)));
+            Tensor gradMasses = Tensor::mul(gradPhases, Tensor::div(Tensor::scale(masses, baseline), energies));
+
+            return {gradEnergies, gradMasses, gradEffectivePMNS};
+        }
+
+        // phi = lambda L and U' = U V
+        const Tensor &eigenvalues = saved[nInputs + 2];
+        const Tensor &eigenvectors = saved[nInputs + 3];
+        Tensor gradPMNS = Tensor::matmul(gradEffectivePMNS, Tensor::transpose(eigenvectors.conj(), -2, -1));
+        Tensor gradEigenvectors = Tensor::matmul(Tensor::transpose(PMNS.conj(), -2, -1), gradEffectivePMNS);
+        Tensor gradHamiltonian = hermitianEigenBackward(eigenvalues, eigenvectors, Tensor::scale(gradPhases, baseline),
+                                                        gradEigenvectors);
+
+        const std::vector<Tensor> parameters(saved.begin() + 3, saved.begin() + static_cast<long>(nInputs));
+        std::vector<Tensor> ret = solver->hamiltonianBackward(gradHamiltonian, energies, masses, PMNS, parameters);
+        ret[2] = ret[2] + gradPMNS;
+        return ret;
+    };
+
+    return Tensor::customGrad(inputs, forward, backward)[0];
+}
+
+Tensor Propagator::jacobian(const Tensor &energies, const std::vector<Tensor> &params) const
+{
+    NT_PROFILE();
+
+    if (_matterSolver != nullptr && !_matterSolver->supportsAnalyticGradients())
+    {
+        NT_ERROR("Propagator::jacobian() needs a matter solver that supports analytic gradients");
+        throw std::logic_error("Matter solver does not support analytic gradients");
+    }
+
+    long int nParams = 0;
+    for (const Tensor &param : params)
+    {
+        nParams += static_cast<long int>(param.getNumel());
+    }
+
+    // derivatives of the inputs of the propagation, each with the parameters along a new leading dimension
+    Tensor tangentMasses = getTangents(_masses, params, nParams);
+    Tensor tangentPMNS = getTangents(_pmnsMatrix, params, nParams);
+    std::vector<Tensor> parameters;
+    std::vector<Tensor> tangentParameters;
+    if (_matterSolver != nullptr)
+    {
+        parameters = _matterSolver->getParameters();
+        for (const Tensor &parameter : parameters)
+        {
+            tangentParameters.push_back(getTangents(parameter, params, nParams));
+        }
+    }
+
+    // from here on everything is worked out by hand so nothing needs to be recorded
+    Tensor::NoGradGuard noGrad;
+
+    Tensor phases;
+    Tensor tangentPhases;
+    Tensor effectivePMNS;
+    Tensor tangentEffectivePMNS;
+    if (_matterSolver == nullptr)
+    {
+        // phi = m^2 L / 2E
+        phases = Tensor::div(Tensor::scale(Tensor::mul(_masses, _masses), 0.5 * _baseline), energies);
+        tangentPhases = Tensor::div(Tensor::scale(Tensor::mul(_masses, tangentMasses), _baseline), energies);
+        effectivePMNS = _pmnsMatrix;
+        tangentEffectivePMNS = tangentPMNS;
+    }
+    else
+    {
+        Tensor eigenvalues;
+        Tensor eigenvectors;
+        Tensor::eigh(_matterSolver->calculateHamiltonian(energies, _masses, _pmnsMatrix, parameters), eigenvalues,
+                     eigenvectors);
+        Tensor tangentHamiltonian = _matterSolver->hamiltonianTangent(energies, _masses, _pmnsMatrix, parameters,
+                                                                      tangentMasses, tangentPMNS, tangentParameters);
+
+        // first order perturbation theory: d lambda_i = (V^dagger dH V)_ii and dV = V X with
+        // X_ij = (V^dagger dH V)_ij / (lambda_j - lambda_i) off the diagonal
+        Tensor projected = Tensor::matmul(Tensor::transpose(eigenvectors.conj(), -2, -1),
+                                          Tensor::matmul(tangentHamiltonian, eigenvectors));
+        Tensor mixing = Tensor::div(projected, getEigenvalueGaps(eigenvalues)) -
+                        Tensor::diagEmbed(Tensor::diagonal(projected));
+
+        // phi = lambda L and U' = U V
+        phases = Tensor::scale(eigenvalues, _baseline);
+        tangentPhases = Tensor::scale(Tensor::diagonal(projected).real(), _baseline);
+        effectivePMNS = Tensor::matmul(_pmnsMatrix, eigenvectors);
+        tangentEffectivePMNS = Tensor::matmul(tangentPMNS, eigenvectors) +
+                               Tensor::matmul(_pmnsMatrix, Tensor::matmul(eigenvectors, mixing));
+    }
+
+    // w = exp(-i phi)
+    Tensor weights = Tensor::exp(Tensor::scale(phases, std::complex<float>(-1.0J)));
+    Tensor tangentWeights = Tensor::mul(Tensor::scale(weights, std::complex<float>(-1.0J)), tangentPhases);
+
+    // A = U'^* diag(w) U'^T and P = |A|^2
+    Tensor amplitudes = getAmplitudes(effectivePMNS, weights, effectivePMNS);
+    Tensor tangentAmplitudes = getAmplitudes(tangentEffectivePMNS, weights, effectivePMNS) +
+                               getAmplitudes(effectivePMNS, tangentWeights, effectivePMNS) +
+                               getAmplitudes(effectivePMNS, weights, tangentEffectivePMNS);
+    Tensor tangentProbs = Tensor::scale(Tensor::mul(amplitudes.conj(), tangentAmplitudes).real(), 2.0);
+
+    // {nParams, Nbatches, n, n} -> {Nbatches, n * n, nParams}
+    tangentProbs = Tensor::reshape(tangentProbs, {nParams, -1, _nGenerations * _nGenerations});
+    return Tensor::transpose(Tensor::transpose(tangentProbs, 0, 2), 0, 1);
+}
+
+Propagator Propagator::clone() const
+{
+    NT_PROFILE();
+
+    Propagator ret(*this);
+    // keep the history so that the copy's probabilities can still be differentiated with respect to whatever the
+    // PMNS matrix was built from, like they can for the masses which are shared
+    ret._pmnsMatrix = _pmnsMatrix.clone(/*keepHistory=*/true);
+
+    if (_matterSolver != nullptr)
+    {
+        ret._matterSolver = _matterSolver->clone();
+        ret._matterSolver->setPMNS(ret._pmnsMatrix);
+    }
+
+    return ret;
+}
+
+void Propagator::releaseWorkspace()
+{
+    NT_PROFILE();
+
+    workspace.release();
+}
+
+std::future<Tensor> Propagator::calculateProbsAsync(const Tensor &energies) const
+{
+    NT_PROFILE();
+
+    auto snapshot = std::make_shared<Propagator>(clone());
+
+    // if the snapshot held the last reference to the executor, the executor would get destroyed by its own worker
+    snapshot->_asyncExecutor.reset();
+
+    // gradient tracking is a per thread setting, so the caller's has to be carried over to the executor's thread
+    const bool gradEnabled = Tensor::isGradEnabled();
+
+    AsyncExecutor &executor = (_asyncExecutor != nullptr) ? *_asyncExecutor : getDefaultExecutor();
+    return executor.submit([snapshot, energies, gradEnabled]() {
+        std::optional<Tensor::NoGradGuard> noGrad;
+        if (!gradEnabled)
+        {
+            noGrad.emplace();
+        }
+        return snapshot->calculateProbs(energies);
+    });
+}
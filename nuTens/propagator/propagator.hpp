@@ -1,8 +1,11 @@
 #pragma once
 
+#include <future>
 #include <memory>
 #include <nuTens/propagator/base-matter-solver.hpp>
+#include <nuTens/propagator/probability-cache.hpp>
 #include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/async-executor.hpp>
 #include <vector>
 
 /// @file propagator.hpp
@@ -21,6 +24,19 @@ class Propagator
      * setMatterSolver(). calculateProbs() can then be used to calculate energy
      * dependent oscillation probabilities.
      *
+     * calculateProbs() is thread safe, so a single configured Propagator can be
+     * shared between any number of threads without any locking. The parameters
+     * are only ever read during the calculation, and if setUseWorkspace() is
+     * turned on the temporary tensors that it needs are taken from a workspace
+     * (a TensorArena) belonging to the calling thread. The setters are NOT
+     * thread safe and must not be called while other threads are calculating.
+     * If threads need different parameters, give each of them its own copy
+     * made using clone().
+     *
+     * By default, gradients of the probabilities are calculated using a hand
+     * written backward pass (see setAnalyticGradients()) rather than by
+     * recording every operation of the calculation.
+     *
      * (The specifics of this interface may change in the future)
      */
 
@@ -29,15 +45,174 @@ class Propagator
     /// @param nGenerations The number of generations the propagator should
     /// expect
     /// @param baseline The baseline to propagate over
-    Propagator(int nGenerations, float baseline) : _baseline(baseline), _nGenerations(nGenerations){};
+    Propagator(int nGenerations, float baseline) : _nGenerations(nGenerations), _baseline(baseline)
+    {
+        // precompile the indices used to build up the weight matrix so it doesn't have to be done on every call
+        for (int i = 0; i < nGenerations; i++)
+        {
+            _vectorIndices.push_back(Tensor::Index({Tensor::ellipsis, i}));
+            for (int j = 0; j < nGenerations; j++)
+            {
+                _matrixIndices.push_back(Tensor::Index({Tensor::ellipsis, i, j}));
+            }
+        }
+    };
 
     /// @brief Calculate the oscillation probabilities
+    /// @details Can be called from multiple threads at once. If a cache has been set up using setCacheSize(), the
+    /// result may be one that is shared with the cache, so must not be modified in place.
     /// @param energies The energies of the neutrinos
     [[nodiscard]] Tensor calculateProbs(const Tensor &energies) const;
 
+    /// @brief Start calculating the oscillation probabilities in the background
+    /// @details This lets the caller get on with e.g. preparing the next batch of energies while this one is being
+    /// calculated. The calculation uses a snapshot of the propagator taken when this is called, so the setters can
+    /// safely be used straight away. Gradient tracking is turned on or off for the calculation the same as it is on
+    /// the calling thread (see Tensor::NoGradGuard). The energies must not be modified in place until the result is
+    /// ready. If the executor's queue is full this waits for space before returning.
+    /// @param energies The energies of the neutrinos
+    /// @return A future that will hold the probabilities
+    [[nodiscard]] std::future<Tensor> calculateProbsAsync(const Tensor &energies) const;
+
+    /// @brief Calculate the oscillation probability of a single channel for each neutrino
+    /// @details Rather than the full {Nbatches, nGenerations, nGenerations} matrix of probabilities, this only works
+    /// out the one that is needed for each neutrino, using the rows of the (effective) PMNS matrix for its initial and
+    /// final flavour. In vacuum no {Nbatches, nGenerations, nGenerations} tensor is made at all; in matter the
+    /// eigenvectors still are but the amplitudes and probabilities are not. Gradients are found by recording the
+    /// operations as usual, rather than using the analytic backward pass. Can be called from multiple threads at once.
+    /// In vacuum the PMNS matrix can have a batch dimension of 1 or Nbatches, like for calculateProbs(); in matter it
+    /// must be 1.
+    /// @param energies The energies of the neutrinos, with shape {Nbatches, 1}
+    /// @param initialFlavours The flavour each neutrino was produced as, an integer tensor with shape {Nbatches}
+    /// @param finalFlavours The flavour each neutrino is detected as, an integer tensor with shape {Nbatches}
+    /// @return Tensor with shape {Nbatches}, where [b] is calculateProbs(energies)[b, initialFlavours[b],
+    /// finalFlavours[b]]
+    [[nodiscard]] Tensor calculateChannelProbs(const Tensor &energies, const Tensor &initialFlavours,
+                                               const Tensor &finalFlavours) const;
+
+    /// @brief Calculate the derivatives of every probability with respect to some parameters, for all energies at once
+    /// @details The parameters can be any tensors that the masses, PMNS matrix and matter solver parameters were
+    /// calculated from (or those tensors themselves), e.g. the mixing angles and mass splittings used to build them.
+    /// The derivatives of the masses etc. with respect to the parameters are found by differentiating through however
+    /// they were built, which is cheap as they are small. These are then pushed forward through the propagation
+    /// analytically (forward mode) for every energy in a single pass, rather than needing one backward() per
+    /// probability. Needs a matter solver that supports analytic gradients, or no matter solver. The energies are held
+    /// fixed.
+    /// @param energies The energies of the neutrinos, with shape {Nbatches, 1}
+    /// @param params The parameters, which should be real and require a gradient. Every element of each of them is
+    /// treated as a separate parameter.
+    /// @return Tensor with shape {Nbatches, nGenerations * nGenerations, nParams}, where [b, i * nGenerations + j, p]
+    /// is the derivative of calculateProbs(energies)[b, i, j] with respect to parameter p
+    [[nodiscard]] Tensor jacobian(const Tensor &energies, const std::vector<Tensor> &params) const;
+
+    /// @brief Get a copy of this propagator which can be modified independently of this one
+    /// @details Large tensors are shared with the copy rather than duplicated. Only the PMNS matrix, which can be
+    /// modified in place by setPMNS(), gets copied. The copy keeps its autograd history, so gradients of the copy's
+    /// probabilities still reach the parameters that the PMNS matrix and masses were built from.
+    [[nodiscard]] Propagator clone() const;
+
+    /// @brief Get the hit rate and memory use of the cache set up by setCacheSize()
+    /// @details All counters are 0 if there is no cache
+    [[nodiscard]] inline ProbabilityCache::Stats getCacheStats() const
+    {
+        return (_cache != nullptr) ? _cache->getStats() : ProbabilityCache::Stats();
+    }
+
+    /// @brief Drop everything held by the cache set up by setCacheSize()
+    inline void clearCache()
+    {
+        if (_cache != nullptr)
+        {
+            _cache->clear();
+        }
+    }
+
+    /// @brief Free the memory held by the calling thread's workspace
+    /// @details The workspace keeps hold of the memory of temporary tensors so it can be reused by later calls to
+    /// calculateProbs() on the same thread.
+    static void releaseWorkspace();
+
+    [[nodiscard]] inline int getNGenerations() const
+    {
+        return _nGenerations;
+    }
+
+    /// @brief Get the matter solver set by setMatterSolver(), or nullptr if propagating in vacuum
+    [[nodiscard]] inline std::shared_ptr<const BaseMatterSolver> getMatterSolver() const
+    {
+        return _matterSolver;
+    }
+
     /// @name Setters
     /// @{
 
+    /// @brief Set whether calculateProbs() should use a per-thread workspace for its temporary tensors
+    /// @details Off by default. Each thread's workspace keeps a buffer for every shape of temporary it has seen until
+    /// releaseWorkspace() is called on that thread, so this is best for repeated calls with the same energies. If a
+    /// TensorArena is already active when calculateProbs() is called, that is used instead.
+    inline void setUseWorkspace(bool useWorkspace)
+    {
+        _useWorkspace = useWorkspace;
+    }
+
+    /// @brief Set whether to use the analytic backward pass when calculating gradients
+    /// @details The analytic backward pass works out the derivatives of the probabilities with respect to the
+    /// energies, masses, PMNS matrix and matter solver parameters (e.g. the density) directly from the eigenvalues
+    /// and eigenvectors of the hamiltonian, so only a handful of tensors need to be kept for the backward pass instead
+    /// of every intermediate step. It is used in vacuum and with matter solvers that support it (see
+    /// BaseMatterSolver::supportsAnalyticGradients()), otherwise every operation is recorded as usual. Like any
+    /// eigenvector based derivative, it is not defined when two effective masses are exactly degenerate.
+    inline void setAnalyticGradients(bool analyticGradients)
+    {
+        _analyticGradients = analyticGradients;
+    }
+
+    /// @brief Set whether to do the calculation only once for each distinct energy
+    /// @details Useful when many neutrinos share the same energy, e.g. when the true energies are binned. The
+    /// distinct energies are found, calculateProbs() works out the probabilities for each of them (and
+    /// calculateChannelProbs() the effective masses and mixing), and the results are copied back out to every
+    /// neutrino. This gives the same probabilities, and the same gradients with respect to the oscillation parameters,
+    /// as without it. Skipped when the energies require a gradient, as finding the distinct values isn't
+    /// differentiable, when the masses, PMNS matrix or any matter solver parameter has a batch dimension bigger than
+    /// 1, as each neutrino then has its own inputs, and when every energy is different.
+    inline void setDeduplicateEnergies(bool deduplicateEnergies)
+    {
+        _deduplicateEnergies = deduplicateEnergies;
+    }
+
+    /// @brief Set how much memory calculateProbs() can use to remember its most recent results
+    /// @details Useful when the same probabilities get asked for again and again, e.g. by a minimiser's line search
+    /// or a profile likelihood scan. Results are looked up using the values of the masses, PMNS matrix, matter solver
+    /// parameters (see BaseMatterSolver::getParameters()) and energies, and which matter solver is being used, so the
+    /// cache never has to be cleared by hand after using the setters. A solver whose state isn't all in its parameters
+    /// should not be modified while a cache is in use. Results that need a gradient (when gradients are turned on and
+    /// any of the energies, masses, PMNS matrix or solver parameters require one) are always calculated from scratch
+    /// so that they are connected to the inputs. Copies made by clone() share the cache. See getCacheStats().
+    /// @param maxBytes The most memory the stored probabilities can take up, 0 to turn the cache off
+    inline void setCacheSize(size_t maxBytes)
+    {
+        if (maxBytes == 0)
+        {
+            _cache.reset();
+        }
+        else if (_cache != nullptr)
+        {
+            _cache->setMaxBytes(maxBytes);
+        }
+        else
+        {
+            _cache = std::make_shared<ProbabilityCache>(maxBytes);
+        }
+    }
+
+    /// @brief Set the executor that calculateProbsAsync() should use
+    /// @details If none is set, a shared executor with a single worker and a queue depth of 2 is used. The executor
+    /// can be shared between propagators.
+    inline void setAsyncExecutor(std::shared_ptr<AsyncExecutor> executor)
+    {
+        _asyncExecutor = std::move(executor);
+    }
+
     /// @brief Set a matter solver to use to deal with matter effects
     /// @param newSolver A derivative of BaseMatterSolver
     inline void setMatterSolver(std::shared_ptr<BaseMatterSolver> &newSolver)
@@ -107,11 +282,35 @@ class Propagator
     // values from massSolver
     [[nodiscard]] Tensor _calculateProbs(const Tensor &energies, const Tensor &masses, const Tensor &PMNS) const;
 
+    // Calculate for every energy, without deduplicating them
+    [[nodiscard]] Tensor _calculateProbsDirect(const Tensor &energies) const;
+
+    // Calculate using the analytic backward pass
+    [[nodiscard]] Tensor _calculateProbsAnalytic(const Tensor &energies) const;
+
+    // Whether a result calculated for these energies now would need to be connected to the autograd graph
+    [[nodiscard]] bool _needsGradient(const Tensor &energies) const;
+
+    // The masses, PMNS matrix and matter solver parameters
+    [[nodiscard]] std::vector<Tensor> _getInputs() const;
+
+    // Fingerprint everything that the probabilities at these energies depend on
+    [[nodiscard]] ProbabilityCache::Key _getCacheKey(const Tensor &energies) const;
+
   private:
     Tensor _pmnsMatrix;
     Tensor _masses;
     int _nGenerations;
     float _baseline;
+    bool _useWorkspace = false;
+    bool _analyticGradients = true;
+    bool _deduplicateEnergies = false;
+
+    // precompiled indices: {..., i} and {..., i, j} (at [i * _nGenerations + j])
+    std::vector<Tensor::Index> _vectorIndices;
+    std::vector<Tensor::Index> _matrixIndices;
 
     std::shared_ptr<BaseMatterSolver> _matterSolver;
+    std::shared_ptr<AsyncExecutor> _asyncExecutor;
+    std::shared_ptr<ProbabilityCache> _cache;
 };
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include <nuTens/rates/event-rate-calculator.hpp>
+#include <stdexcept>
+
+Tensor EventRateCalculator::calculateRates() const
+{
+    NT_PROFILE();
+
+    return Tensor::mul(calculateUnoscillatedRates(),
+                       _propagator->calculateChannelProbs(_energies, _initialFlavours, _finalFlavours));
+}
+
+Tensor EventRateCalculator::calculateUnoscillatedRates() const
+{
+    NT_PROFILE();
+
+    if (!_hasEvents)
+    {
+        NT_ERROR("EventRateCalculator::setEvents() must be called before calculating any rates");
+        throw std::logic_error("No events set in EventRateCalculator");
+    }
+
+    if (_hasStaticRates)
+    {
+        return _staticRates;
+    }
+
+    return multiplyFactors();
+}
+
+void EventRateCalculator::setEvents(const Tensor &energies, const Tensor &initialFlavours,
+                                    const Tensor &finalFlavours)
+{
+    NT_PROFILE();
+
+    const auto nEvents = static_cast<long int>(energies.getNumel());
+    if (initialFlavours.getNumel() != energies.getNumel() || finalFlavours.getNumel() != energies.getNumel())
+    {
+        NT_ERROR("Got {} energies but {} initial and {} final flavours", nEvents, initialFlavours.getNumel(),
+                 finalFlavours.getNumel());
+        throw std::invalid_argument("Mismatched event inputs passed to EventRateCalculator::setEvents()");
+    }
+
+    _nEvents = nEvents;
+    _energies = Tensor::reshape(energies, {nEvents, 1});
+
+    // the flavours are used as indices so need to be integers
+    _initialFlavours = Tensor::reshape(initialFlavours, {nEvents});
+    _finalFlavours = Tensor::reshape(finalFlavours, {nEvents});
+    if (_initialFlavours.getDType() != NTdtypes::kInt)
+    {
+        _initialFlavours.dType(NTdtypes::kInt);
+    }
+    if (_finalFlavours.getDType() != NTdtypes::kInt)
+    {
+        _finalFlavours.dType(NTdtypes::kInt);
+    }
+
+    _hasEvents = true;
+    for (Factor *factor : {&_flux, &_crossSection, &_efficiency, &_weights})
+    {
+        if (factor->isTabulated)
+        {
+            locate(*factor);
+        }
+    }
+
+    update();
+}
+
+void EventRateCalculator::setFlux(const Tensor &fluxes)
+{
+    setFactor(_flux, fluxes, /*byFinalFlavour=*/false);
+}
+
+void EventRateCalculator::setFlux(const Tensor &energies, const Tensor &fluxes)
+{
+    setTabulatedFactor(_flux, energies, fluxes, /*byFinalFlavour=*/false);
+}
+
+void EventRateCalculator::setCrossSection(const Tensor &crossSections)
+{
+    setFactor(_crossSection, crossSections, /*byFinalFlavour=*/true);
+}
+
+void EventRateCalculator::setCrossSection(const Tensor &energies, const Tensor &crossSections)
+{
+    setTabulatedFactor(_crossSection, energies, crossSections, /*byFinalFlavour=*/true);
+}
+
+void EventRateCalculator::setEfficiency(const Tensor &efficiencies)
+{
+    setFactor(_efficiency, efficiencies, /*byFinalFlavour=*/true);
+}
+
+void EventRateCalculator::setEfficiency(const Tensor &energies, const Tensor &efficiencies)
+{
+    setTabulatedFactor(_efficiency, energies, efficiencies, /*byFinalFlavour=*/true);
+}
+
+void EventRateCalculator::setWeights(const Tensor &weights)
+{
+    setFactor(_weights, weights, /*byFinalFlavour=*/false);
+}
+
+void EventRateCalculator::setFactor(Factor &factor, const Tensor &values, bool byFinalFlavour)
+{
+    NT_PROFILE();
+
+    factor = Factor();
+    factor.isSet = true;
+    factor.byFinalFlavour = byFinalFlavour;
+    factor.values = values;
+
+    update();
+}
+
+void EventRateCalculator::setTabulatedFactor(Factor &factor, const Tensor &energies, const Tensor &values,
+                                             bool byFinalFlavour)
+{
+    NT_PROFILE();
+
+    const std::vector<int> shape = values.getShape();
+    if (energies.getNdim() != 1 || energies.getShape()[0] < 2 || shape.empty() || shape.size() > 2 ||
+        shape.back() != energies.getShape()[0])
+    {
+        NT_ERROR("Tables should have at least 2 energies and shape {{nEnergies}} or {{nGenerations, nEnergies}}");
+        throw std::invalid_argument("Badly shaped table passed to EventRateCalculator");
+    }
+
+    factor = Factor();
+    factor.isSet = true;
+    factor.isTabulated = true;
+    factor.byFinalFlavour = byFinalFlavour;
+    factor.values = values;
+    factor.energies = energies;
+
+    if (_hasEvents)
+    {
+        locate(factor);
+    }
+
+    update();
+}
+
+void EventRateCalculator::locate(Factor &factor) const
+{
+    NT_PROFILE();
+
+    // only the values of the table are differentiated, not where the events fall in it
+    Tensor::NoGradGuard noGrad;
+
+    const long int nEnergies = factor.energies.getShape()[0];
+    Tensor energies = Tensor::reshape(_energies, {_nEvents});
+
+    // the interval each event is in, with the first and last intervals extending out past the ends of the table
+    Tensor intervals =
+        Tensor::bucketize(energies, factor.energies.getValues(Tensor::Index({Tensor::Slice{1, nEnergies - 1}})),
+                          /*right=*/true);
+    Tensor lower = Tensor::indexSelect(factor.energies.getValues(Tensor::Index({Tensor::Slice{0, nEnergies - 1}})),
+                                       0, intervals);
+    Tensor upper = Tensor::indexSelect(factor.energies.getValues(Tensor::Index({Tensor::Slice{1, nEnergies}})), 0,
+                                       intervals);
+
+    // the table is flat beyond its ends
+    Tensor zero = Tensor({0.0}, energies.getDType(), energies.getDevice(), /*requiresGrad=*/false);
+    Tensor one = Tensor({1.0}, energies.getDType(), energies.getDevice(), /*requiresGrad=*/false);
+    factor.fractions = Tensor::clamp(Tensor::div(energies - lower, upper - lower), zero, one);
+
+    if (factor.values.getNdim() == 1)
+    {
+        factor.lowerIndices = intervals;
+    }
+    else
+    {
+        // index into the flattened table, using the row for the flavour of each event
+        const Tensor &flavours = factor.byFinalFlavour ? _finalFlavours : _initialFlavours;
+        factor.lowerIndices = Tensor::scale(flavours, static_cast<float>(nEnergies)) + intervals;
+        factor.lowerIndices.dType(NTdtypes::kInt);
+    }
+}
+
+Tensor EventRateCalculator::evaluate(const Factor &factor) const
+{
+    NT_PROFILE();
+
+    Tensor values = Tensor::reshape(factor.values, {-1});
+    if (!factor.isTabulated)
+    {
+        return values;
+    }
+
+    // the value above each event is the next one along in the flattened table, which is always in the same row as the
+    // interval index never points at the last energy
+    const auto nValues = static_cast<long int>(values.getNumel());
+    Tensor lowerValues =
+        Tensor::indexSelect(values.getValues(Tensor::Index({Tensor::Slice{0, nValues - 1}})), 0, factor.lowerIndices);
+    Tensor upperValues =
+        Tensor::indexSelect(values.getValues(Tensor::Index({Tensor::Slice{1, nValues}})), 0, factor.lowerIndices);
+
+    return lowerValues + Tensor::mul(factor.fractions, upperValues - lowerValues);
+}
+
+Tensor EventRateCalculator::multiplyFactors() const
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    bool first = true;
+    for (const Factor *factor : {&_flux, &_crossSection, &_efficiency, &_weights})
+    {
+        if (!factor->isSet)
+        {
+            continue;
+        }
+
+        ret = first ? evaluate(*factor) : Tensor::mul(ret, evaluate(*factor));
+        first = false;
+    }
+
+    if (first)
+    {
+        ret = Tensor::ones({_nEvents}, _energies.getDType(), _energies.getDevice(), /*requiresGrad=*/false);
+    }
+
+    return ret;
+}
+
+void EventRateCalculator::update()
+{
+    NT_PROFILE();
+
+    _hasStaticRates = false;
+    _staticRates = Tensor();
+    if (!_hasEvents)
+    {
+        return;
+    }
+
+    bool needsGrad = false;
+    for (const Factor *factor : {&_flux, &_crossSection, &_efficiency, &_weights})
+    {
+        if (!factor->isSet)
+        {
+            continue;
+        }
+
+        if (!factor->isTabulated && static_cast<long int>(factor->values.getNumel()) != _nEvents)
+        {
+            NT_ERROR("Got {} values for an input that needs one per event, but there are {} events",
+                     factor->values.getNumel(), _nEvents);
+            throw std::invalid_argument("Wrong number of values passed to EventRateCalculator");
+        }
+
+        needsGrad = needsGrad || factor->values.getRequiresGrad();
+    }
+
+    // if nothing can change between calls, the product only needs working out once
+    if (!needsGrad)
+    {
+        _staticRates = multiplyFactors();
+        _hasStaticRates = true;
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+
+/*!
+ * @file event-rate-calculator.hpp
+ * @brief Defines a calculator of the expected rate of each event, including oscillations
+ */
+
+class EventRateCalculator
+{
+    /*!
+     * @class EventRateCalculator
+     * @brief Calculates flux x cross section x efficiency x weight x oscillation probability for a list of events
+     *
+     * Each event has a true energy, the flavour it was produced as and the flavour it interacts as. The flux, cross
+     * section and efficiency can each be given either as a value for every event, or as a table in energy which is
+     * linearly interpolated at the energy of each event. Tables can be the same for every event, or have one row per
+     * flavour, in which case the flux is looked up using the initial flavour and the cross section and efficiency
+     * using the final flavour.
+     *
+     * Where each event falls in each table is only worked out when the events or the table are set, so calculating
+     * the rates is just a few lookups and products on top of Propagator::calculateChannelProbs(), which only works out
+     * the one probability each event needs rather than the full {N, n, n} matrix. If none of the inputs require a
+     * gradient, the product of everything except the probability is also worked out up front. The rates are
+     * differentiable with respect to the oscillation parameters and to the values of any of the inputs (e.g. flux
+     * systematics), but not to the energies at which the tables are interpolated. Because of the work done up front,
+     * an input that is changed in place must be set again for the change to be seen.
+     *
+     * The Propagator is shared, not copied, so changes made to it using its setters are seen by the calculator. They
+     * must not be made while calculateRates() is running. calculateRates() itself can be called from multiple threads
+     * at once.
+     * \code{.cpp}
+     *   EventRateCalculator calculator(propagator);
+     *   calculator.setEvents(energies, initialFlavours, finalFlavours);
+     *   calculator.setFlux(fluxEnergies, fluxes);
+     *   calculator.setCrossSection(crossSectionEnergies, crossSections);
+     *   calculator.setWeights(exposureWeights);
+     *   Tensor rates = calculator.calculateRates();
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param propagator The (configured) propagator to calculate the probabilities with
+    explicit EventRateCalculator(std::shared_ptr<const Propagator> propagator) : _propagator(std::move(propagator))
+    {
+    }
+
+    /// @brief Calculate the expected rate of each event
+    /// @return Tensor with shape {nEvents}
+    [[nodiscard]] Tensor calculateRates() const;
+
+    /// @brief Calculate the rate of each event if there were no oscillations
+    /// @return Tensor with shape {nEvents}
+    [[nodiscard]] Tensor calculateUnoscillatedRates() const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set the events to calculate the rates of
+    /// @param energies The true energy of each event, with shape {nEvents, 1}
+    /// @param initialFlavours The flavour each neutrino was produced as, an integer tensor with shape {nEvents}
+    /// @param finalFlavours The flavour each neutrino interacts as, an integer tensor with shape {nEvents}
+    void setEvents(const Tensor &energies, const Tensor &initialFlavours, const Tensor &finalFlavours);
+
+    /// @brief Set the flux of each event
+    /// @param fluxes Tensor with shape {nEvents}
+    void setFlux(const Tensor &fluxes);
+
+    /// @brief Set the flux as a table in energy
+    /// @param energies The energies of the table, in ascending order, with shape {nEnergies}
+    /// @param fluxes The flux at each energy, with shape {nEnergies} or {nGenerations, nEnergies} if it depends on the
+    /// initial flavour
+    void setFlux(const Tensor &energies, const Tensor &fluxes);
+
+    /// @brief Set the cross section of each event
+    /// @param crossSections Tensor with shape {nEvents}
+    void setCrossSection(const Tensor &crossSections);
+
+    /// @brief Set the cross section as a table in energy
+    /// @param energies The energies of the table, in ascending order, with shape {nEnergies}
+    /// @param crossSections The cross section at each energy, with shape {nEnergies} or {nGenerations, nEnergies} if it
+    /// depends on the final flavour
+    void setCrossSection(const Tensor &energies, const Tensor &crossSections);
+
+    /// @brief Set the efficiency of each event
+    /// @param efficiencies Tensor with shape {nEvents}
+    void setEfficiency(const Tensor &efficiencies);
+
+    /// @brief Set the efficiency as a table in energy
+    /// @param energies The energies of the table, in ascending order, with shape {nEnergies}
+    /// @param efficiencies The efficiency at each energy, with shape {nEnergies} or {nGenerations, nEnergies} if it
+    /// depends on the final flavour
+    void setEfficiency(const Tensor &energies, const Tensor &efficiencies);
+
+    /// @brief Set an extra weight for each event, e.g. the exposure or the weight of a simulated event
+    /// @param weights Tensor with shape {nEvents}
+    void setWeights(const Tensor &weights);
+
+    /// @}
+
+  private:
+    // one of the factors that make up the unoscillated rate
+    struct Factor
+    {
+        bool isSet = false;
+        bool isTabulated = false;
+        bool byFinalFlavour = false;
+        Tensor values;
+        Tensor energies;
+
+        // where each event falls in the table: the flattened index of the table entry below it, and how far it is
+        // towards the next one
+        Tensor lowerIndices;
+        Tensor fractions;
+    };
+
+    void setFactor(Factor &factor, const Tensor &values, bool byFinalFlavour);
+    void setTabulatedFactor(Factor &factor, const Tensor &energies, const Tensor &values, bool byFinalFlavour);
+
+    // work out the lookups of a tabulated factor for the current events
+    void locate(Factor &factor) const;
+
+    // get the value of a factor for each event
+    [[nodiscard]] Tensor evaluate(const Factor &factor) const;
+
+    // product of the values of all of the factors that have been set
+    [[nodiscard]] Tensor multiplyFactors() const;
+
+    // recalculate whatever can be done up front after one of the inputs changes
+    void update();
+
+  private:
+    std::shared_ptr<const Propagator> _propagator;
+
+    bool _hasEvents = false;
+    long int _nEvents = 0;
+    Tensor _energies;
+    Tensor _initialFlavours;
+    Tensor _finalFlavours;
+
+    Factor _flux;
+    Factor _crossSection;
+    Factor _efficiency;
+    Factor _weights;
+
+    // product of all of the factors, if none of them need a gradient
+    bool _hasStaticRates = false;
+    Tensor _staticRates;
+};
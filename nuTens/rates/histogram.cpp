@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <nuTens/rates/histogram.hpp>
+#include <stdexcept>
+
+Histogram::Histogram(const std::vector<Tensor> &binEdges) : _binEdges(binEdges)
+{
+    NT_PROFILE();
+
+    if (binEdges.empty() || binEdges.size() > 3)
+    {
+        NT_ERROR("Histograms can have 1, 2 or 3 axes, not {}", binEdges.size());
+        throw std::invalid_argument("Wrong number of axes passed to Histogram");
+    }
+
+    for (const Tensor &edges : binEdges)
+    {
+        if (edges.getNdim() != 1 || edges.getShape()[0] < 2)
+        {
+            NT_ERROR("The bin edges of each axis should be 1-d with at least 2 values");
+            throw std::invalid_argument("Bad bin edges passed to Histogram");
+        }
+
+        const long int nBins = edges.getShape()[0] - 1;
+        _shape.push_back(nBins);
+        _flowShape.push_back(nBins + 2);
+    }
+
+    std::vector<Tensor::Index::entryType> entries;
+    for (long int nBins : _shape)
+    {
+        entries.emplace_back(Tensor::Slice{1, nBins + 1});
+    }
+    _binRange.emplace(entries);
+}
+
+void Histogram::setEvents(const std::vector<Tensor> &coordinates)
+{
+    NT_PROFILE();
+
+    if (coordinates.size() != _binEdges.size())
+    {
+        NT_ERROR("Got coordinates for {} axes, but the histogram has {}", coordinates.size(), _binEdges.size());
+        throw std::invalid_argument("Wrong number of coordinates passed to Histogram::setEvents()");
+    }
+
+    const auto nEvents = static_cast<long int>(coordinates[0].getNumel());
+    for (const Tensor &coordinate : coordinates)
+    {
+        if (static_cast<long int>(coordinate.getNumel()) != nEvents)
+        {
+            NT_ERROR("Every axis should have the same number of events, got {} and {}", nEvents,
+                     coordinate.getNumel());
+            throw std::invalid_argument("Mismatched coordinates passed to Histogram::setEvents()");
+        }
+    }
+
+    Tensor::NoGradGuard noGrad;
+
+    // with the lower edge included in each bin, the number of edges at or below a value is its bin along that axis
+    // counting the underflow as bin 0 and the overflow as bin nBins + 1. Combined in double precision, which is exact
+    // up to 2^53, then kept as 64 bit integers so that histograms with more than 2^31 bins don't overflow.
+    Tensor flatIndices;
+    long int stride = 1;
+    for (int axis = static_cast<int>(_binEdges.size()) - 1; axis >= 0; axis--)
+    {
+        Tensor bins = Tensor::bucketize(Tensor::reshape(coordinates[axis], {nEvents}), _binEdges[axis],
+                                        /*right=*/true);
+        bins.dType(NTdtypes::kDouble);
+
+        Tensor offsets = Tensor::scale(bins, static_cast<double>(stride));
+        flatIndices = (stride == 1) ? offsets : flatIndices + offsets;
+        stride *= _flowShape[axis];
+    }
+    flatIndices.dType(NTdtypes::kLong);
+
+    _flatIndices = flatIndices;
+    _nEvents = nEvents;
+    _hasEvents = true;
+}
+
+Tensor Histogram::fill(const Tensor &weights) const
+{
+    NT_PROFILE();
+
+    return fillWithFlow(weights).getValues(*_binRange);
+}
+
+Tensor Histogram::fillWithFlow(const Tensor &weights) const
+{
+    NT_PROFILE();
+
+    if (!_hasEvents)
+    {
+        NT_ERROR("Histogram::setEvents() must be called before filling the histogram");
+        throw std::logic_error("No events set in Histogram");
+    }
+
+    if (static_cast<long int>(weights.getNumel()) != _nEvents)
+    {
+        NT_ERROR("Got {} weights for {} events", weights.getNumel(), _nEvents);
+        throw std::invalid_argument("Wrong number of weights passed to Histogram");
+    }
+
+    long int nFlowBins = 1;
+    for (long int nBins : _flowShape)
+    {
+        nFlowBins *= nBins;
+    }
+
+    Tensor flatWeights = Tensor::reshape(weights, {_nEvents});
+    auto sumInto = [&](const Tensor &indices, const Tensor &values) {
+        return Tensor::indexAdd(
+            Tensor::zeros({nFlowBins}, weights.getDType(), weights.getDevice(), /*requiresGrad=*/false), 0, indices,
+            values);
+    };
+
+    size_t nParts = 1;
+    if (_threadPool != nullptr && _minEventsPerThread > 0)
+    {
+        nParts = std::clamp<size_t>(_nEvents / _minEventsPerThread, 1, _threadPool->getNThreads());
+    }
+
+    Tensor ret;
+    if (nParts == 1)
+    {
+        ret = sumInto(_flatIndices, flatWeights);
+    }
+    else
+    {
+        // each thread fills its own histogram so no two threads ever add to the same memory
+        std::vector<Tensor> partials(nParts);
+        _threadPool->parallelFor(nParts, [&](size_t part) {
+            const long int start = (_nEvents * static_cast<long int>(part)) / static_cast<long int>(nParts);
+            const long int stop = (_nEvents * static_cast<long int>(part + 1)) / static_cast<long int>(nParts);
+            const Tensor::Index range({Tensor::Slice{start, stop}});
+
+            partials[part] = sumInto(_flatIndices.getValues(range), flatWeights.getValues(range));
+        });
+
+        ret = partials[0];
+        for (size_t part = 1; part < nParts; part++)
+        {
+            ret = ret + partials[part];
+        }
+    }
+
+    return Tensor::reshape(ret, _flowShape);
+}
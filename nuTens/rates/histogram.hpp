@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <nuTens/utils/thread-pool.hpp>
+#include <optional>
+#include <vector>
+
+/*!
+ * @file histogram.hpp
+ * @brief Defines a weighted histogram of events with up to three axes
+ */
+
+class Histogram
+{
+    /*!
+     * @class Histogram
+     * @brief Sums the weights of events into bins, e.g. in reconstructed energy x cos(zenith) x sample
+     *
+     * The bin of each event is worked out once by setEvents(), after which fill() just adds each weight into its bin
+     * using Tensor::indexAdd(), so the rates from an EventRateCalculator can be binned every iteration of a fit
+     * without leaving c++. The result is differentiable with respect to the weights, the gradient of each weight
+     * being the gradient of the bin it went into.
+     *
+     * Bins include their lower edge but not their upper edge, and events outside the edges of any axis are counted
+     * in underflow or overflow bins, which are left out of fill() but can be got using fillWithFlow(). A categorical
+     * axis, like the sample an event was selected into, can be made using edges half way between the categories.
+     *
+     * If a ThreadPool is set, the events are split between the threads, each of which sums its share into its own
+     * histogram, and these are added up at the end. This avoids any contention between threads and gives the same
+     * result every time for the same number of threads.
+     * \code{.cpp}
+     *   Histogram histogram({recoEnergyEdges, cosZenithEdges});
+     *   histogram.setEvents({recoEnergies, cosZeniths});
+     *   Tensor binnedRates = histogram.fill(calculator.calculateRates());
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param binEdges The bin edges of each axis, in ascending order, each with shape {nBins + 1}
+    explicit Histogram(const std::vector<Tensor> &binEdges);
+
+    /// @brief Set the events to be histogrammed
+    /// @param coordinates The position of every event along each axis, each with nEvents values
+    void setEvents(const std::vector<Tensor> &coordinates);
+
+    /// @brief Sum the weights of the events into their bins
+    /// @param weights The weight of each event, with nEvents values
+    /// @return Tensor with shape {nBins of axis 0, nBins of axis 1, ...}
+    [[nodiscard]] Tensor fill(const Tensor &weights) const;
+
+    /// @brief Sum the weights of the events into their bins, keeping the underflow and overflow bins
+    /// @param weights The weight of each event, with nEvents values
+    /// @return Tensor with shape {nBins of axis 0 + 2, ...}, where along each axis the first bin is the underflow and
+    /// the last is the overflow
+    [[nodiscard]] Tensor fillWithFlow(const Tensor &weights) const;
+
+    /// @name Setters
+    /// @{
+
+    /// @brief Set a thread pool to split the events between
+    /// @details If not set, fill() runs on the calling thread
+    inline void setThreadPool(std::shared_ptr<ThreadPool> threadPool)
+    {
+        _threadPool = std::move(threadPool);
+    }
+
+    /// @brief Set the smallest number of events worth giving to a thread
+    inline void setMinEventsPerThread(long int minEventsPerThread)
+    {
+        _minEventsPerThread = minEventsPerThread;
+    }
+
+    /// @}
+
+    /// @name Getters
+    /// @{
+
+    /// @brief Get the number of bins along each axis, not including underflow and overflow
+    [[nodiscard]] inline const std::vector<long int> &getShape() const
+    {
+        return _shape;
+    }
+
+    [[nodiscard]] inline long int getNEvents() const
+    {
+        return _nEvents;
+    }
+
+    /// @}
+
+  private:
+    std::vector<Tensor> _binEdges;
+    std::vector<long int> _shape;
+    std::vector<long int> _flowShape;
+
+    // picks the bins out of the histogram including underflow and overflow
+    std::optional<Tensor::Index> _binRange;
+
+    bool _hasEvents = false;
+    long int _nEvents = 0;
+
+    // index of each event in the flattened histogram including underflow and overflow
+    Tensor _flatIndices;
+
+    std::shared_ptr<ThreadPool> _threadPool;
+    long int _minEventsPerThread = 65536;
+};
@@ -0,0 +1,29 @@
+#include <nuTens/rates/smearer.hpp>
+#include <stdexcept>
+
+Tensor Smearer::smear(const Tensor &trueValues) const
+{
+    NT_PROFILE();
+
+    return _response.apply(trueValues);
+}
+
+Tensor Smearer::smearProbs(const Tensor &probs) const
+{
+    NT_PROFILE();
+
+    const std::vector<int> shape = probs.getShape();
+    if (shape.size() != 3 || shape[0] != getNTrueBins())
+    {
+        NT_ERROR("Smearer with {} true energy bins needs probabilities with shape {{nTrueBins, n, n}}, got {} "
+                 "dimensions",
+                 getNTrueBins(), shape.size());
+        throw std::invalid_argument("Probabilities passed to Smearer::smearProbs() have the wrong shape");
+    }
+    const long int nChannels = static_cast<long int>(shape[1]) * shape[2];
+
+    // {nTrueBins, n, n} -> {n * n, nTrueBins} so that every channel is smeared in the same batch, then back again
+    Tensor channels = Tensor::transpose(Tensor::reshape(probs, {shape[0], nChannels}), 0, 1);
+    return Tensor::reshape(Tensor::transpose(_response.apply(channels), 0, 1),
+                           {getNRecoBins(), shape[1], shape[2]});
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <nuTens/tensors/banded-matrix.hpp>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <utility>
+
+/*!
+ * @file smearer.hpp
+ * @brief Defines a stage that applies a detector response to rates or probabilities binned in true energy
+ */
+
+class Smearer
+{
+    /*!
+     * @class Smearer
+     * @brief Moves rates or probabilities from true energy bins into reconstructed energy bins using a response matrix
+     *
+     * The response matrix has one row per reconstructed energy bin and one column per true energy bin, with [r, t]
+     * the fraction of events in true bin t that are reconstructed in bin r. Detector responses only move events
+     * between nearby bins, so the matrix is held as a BandedMatrix and the zeros far from the diagonal are never
+     * multiplied. Any number of histograms, or the full probability matrix from Propagator::calculateProbs(), are
+     * smeared together in one go. The result is differentiable with respect to the input, and to the response if its
+     * values require a gradient (e.g. for resolution systematics).
+     * \code{.cpp}
+     *   Smearer smearer(BandedMatrix::fromDense(response));
+     *   Tensor recoRates = smearer.smear(trueRates);
+     *   Tensor recoProbs = smearer.smearProbs(propagator.calculateProbs(binCentres));
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param response The response matrix, with shape {nRecoBins, nTrueBins}
+    explicit Smearer(BandedMatrix response) : _response(std::move(response))
+    {
+    }
+
+    /// @brief Smear a batch of histograms in true energy
+    /// @param trueValues Tensor with shape {..., nTrueBins}
+    /// @return Tensor with shape {..., nRecoBins}
+    [[nodiscard]] Tensor smear(const Tensor &trueValues) const;
+
+    /// @brief Smear the probabilities of every channel, as returned by Propagator::calculateProbs()
+    /// @param probs Tensor with shape {nTrueBins, nGenerations, nGenerations}, holding the probabilities at (or
+    /// averaged over) each true energy bin
+    /// @return Tensor with shape {nRecoBins, nGenerations, nGenerations}
+    [[nodiscard]] Tensor smearProbs(const Tensor &probs) const;
+
+    /// @name Getters
+    /// @{
+
+    [[nodiscard]] inline const BandedMatrix &getResponse() const
+    {
+        return _response;
+    }
+
+    [[nodiscard]] inline long int getNTrueBins() const
+    {
+        return _response.getNColumns();
+    }
+
+    [[nodiscard]] inline long int getNRecoBins() const
+    {
+        return _response.getNRows();
+    }
+
+    /// @}
+
+  private:
+    BandedMatrix _response;
+};
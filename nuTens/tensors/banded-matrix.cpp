@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <nuTens/tensors/banded-matrix.hpp>
+#include <stdexcept>
+
+// Only uses the generic Tensor interface so is shared by all tensor backends.
+
+BandedMatrix::BandedMatrix(const Tensor &values, const std::vector<long int> &firstColumns, long int nColumns)
+    : _values(values), _firstColumns(firstColumns), _nColumns(nColumns)
+{
+    NT_PROFILE();
+
+    const std::vector<int> shape = values.getShape();
+    if (shape.size() != 2 || shape[0] != static_cast<int>(firstColumns.size()))
+    {
+        NT_ERROR("BandedMatrix needs values with shape {{nRows, width}} and a first column for each row, got {} "
+                 "dimensions and {} first columns",
+                 shape.size(), firstColumns.size());
+        throw std::invalid_argument("Bad shape of values passed to BandedMatrix");
+    }
+
+    _nRows = shape[0];
+    _width = shape[1];
+
+    // 64 bit so that the indices of large matrices are exact
+    std::vector<std::int64_t> columnIndices;
+    columnIndices.reserve(_nRows * _width);
+    for (long int row = 0; row < _nRows; row++)
+    {
+        if (firstColumns[row] < 0 || firstColumns[row] + _width > nColumns)
+        {
+            NT_ERROR("Band of row {} of BandedMatrix starts at column {} so doesn't fit in {} columns", row,
+                     firstColumns[row], nColumns);
+            throw std::out_of_range("Band of BandedMatrix doesn't fit inside the matrix");
+        }
+
+        for (long int k = 0; k < _width; k++)
+        {
+            columnIndices.push_back(firstColumns[row] + k);
+        }
+    }
+
+    _columnIndices = Tensor::fromVector(columnIndices);
+}
+
+BandedMatrix BandedMatrix::fromDense(const Tensor &dense, double threshold)
+{
+    NT_PROFILE();
+
+    const std::vector<int> shape = dense.getShape();
+    if (shape.size() != 2)
+    {
+        NT_ERROR("BandedMatrix::fromDense() needs a 2-d matrix, got {} dimensions", shape.size());
+        throw std::invalid_argument("Matrix passed to BandedMatrix::fromDense() is not 2-d");
+    }
+    const long int nRows = shape[0];
+    const long int nColumns = shape[1];
+
+    // first and last column above the threshold in each row, rows with none are left empty
+    std::vector<long int> firstColumns(nRows, 0);
+    std::vector<long int> lastColumns(nRows, -1);
+    {
+        const Tensor::Accessor<double> values = dense.getAccessor<double>();
+        for (long int row = 0; row < nRows; row++)
+        {
+            for (long int column = 0; column < nColumns; column++)
+            {
+                if (std::abs(values(row, column)) > threshold)
+                {
+                    if (lastColumns[row] < 0)
+                    {
+                        firstColumns[row] = column;
+                    }
+                    lastColumns[row] = column;
+                }
+            }
+        }
+    }
+
+    long int width = 1;
+    for (long int row = 0; row < nRows; row++)
+    {
+        width = std::max(width, lastColumns[row] - firstColumns[row] + 1);
+    }
+    width = std::min(width, nColumns);
+
+    // slide bands that would hang off the end of the row back inside it
+    std::vector<std::int64_t> flatIndices;
+    flatIndices.reserve(nRows * width);
+    for (long int row = 0; row < nRows; row++)
+    {
+        firstColumns[row] = std::min(firstColumns[row], nColumns - width);
+        for (long int k = 0; k < width; k++)
+        {
+            flatIndices.push_back(row * nColumns + firstColumns[row] + k);
+        }
+    }
+
+    Tensor values = Tensor::reshape(
+        Tensor::indexSelect(Tensor::reshape(dense, {-1}), 0, Tensor::fromVector(flatIndices)), {nRows, width});
+    return {values, firstColumns, nColumns};
+}
+
+Tensor BandedMatrix::apply(const Tensor &vectors) const
+{
+    NT_PROFILE();
+
+    const std::vector<int> shape = vectors.getShape();
+    if (shape.empty() || shape.back() != _nColumns)
+    {
+        NT_ERROR("BandedMatrix with {} columns can't be applied to a tensor whose last dimension has size {}",
+                 _nColumns, shape.empty() ? 0 : shape.back());
+        throw std::invalid_argument("Tensor passed to BandedMatrix::apply() has the wrong size");
+    }
+
+    // {..., nColumns} -> {..., nRows, width}, the entries under the band of each row
+    std::vector<long int> bandShape(shape.begin(), shape.end() - 1);
+    bandShape.push_back(_nRows);
+    bandShape.push_back(_width);
+    Tensor band =
+        Tensor::reshape(Tensor::indexSelect(vectors, static_cast<int>(shape.size()) - 1, _columnIndices), bandShape);
+
+    return Tensor::mul(band, _values).sum({-1});
+}
+
+Tensor BandedMatrix::toDense() const
+{
+    NT_PROFILE();
+
+    std::vector<std::int64_t> flatIndices;
+    flatIndices.reserve(_nRows * _width);
+    for (long int row = 0; row < _nRows; row++)
+    {
+        for (long int k = 0; k < _width; k++)
+        {
+            flatIndices.push_back(row * _nColumns + _firstColumns[row] + k);
+        }
+    }
+
+    Tensor dense = Tensor::zeros({_nRows * _nColumns}, _values.getDType(), _values.getDevice(), /*requiresGrad=*/false);
+    return Tensor::reshape(Tensor::indexAdd(dense, 0, Tensor::fromVector(flatIndices), Tensor::reshape(_values, {-1})),
+                           {_nRows, _nColumns});
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <vector>
+
+/*!
+ * @file banded-matrix.hpp
+ * @brief Defines a sparse matrix whose non-zero entries lie in a band
+ */
+
+class BandedMatrix
+{
+    /*!
+     * @class BandedMatrix
+     * @brief Matrix that only stores a fixed width window of columns in each row, everything outside of which is zero
+     *
+     * Row i holds the values of columns firstColumns[i] to firstColumns[i] + width - 1, so the band can move along
+     * each row by any amount (it doesn't have to follow the diagonal) and the matrix doesn't have to be square. This
+     * suits e.g. detector response matrices, which only move events between nearby energy bins. Multiplying by a
+     * vector with apply() picks out the entries of the vector under the band of each row using
+     * Tensor::indexSelect(), then multiplies and sums along the band, so takes nRows x width operations instead of
+     * nRows x nColumns and never touches the zeros outside of it. The result is differentiable with respect to both
+     * the vector and the values of the matrix.
+     *
+     * The easiest way to make one is from a dense matrix using fromDense(), which finds the narrowest band that holds
+     * all of the non-zero entries:
+     * \code{.cpp}
+     *   BandedMatrix response = BandedMatrix::fromDense(denseResponse);
+     *   Tensor recoRates = response.apply(trueRates);
+     * \endcode
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param values The values in the band of each row, with shape {nRows, width}
+    /// @param firstColumns The column of the first value in each row, with nRows entries, each between 0 and
+    /// nColumns - width
+    /// @param nColumns The number of columns of the full matrix
+    BandedMatrix(const Tensor &values, const std::vector<long int> &firstColumns, long int nColumns);
+
+    /// @brief Make a banded matrix holding all entries of a dense matrix which are bigger than some threshold
+    /// @details The band is as narrow as it can be while holding every such entry, and its values are picked out of
+    /// the dense matrix so any gradient it needs is kept. Entries inside the band are kept even if they are below the
+    /// threshold.
+    /// @param dense The matrix, with shape {nRows, nColumns}
+    /// @param threshold Entries whose absolute value is no bigger than this are taken to be zero
+    [[nodiscard]] static BandedMatrix fromDense(const Tensor &dense, double threshold = 0.0);
+
+    /// @brief Multiply a batch of vectors by the matrix
+    /// @param vectors Tensor with shape {..., nColumns}
+    /// @return Tensor with shape {..., nRows}, where [..., i] = sum_j matrix[i, j] * vectors[..., j]
+    [[nodiscard]] Tensor apply(const Tensor &vectors) const;
+
+    /// @brief Get the full matrix, with zeros outside of the band
+    /// @return Tensor with shape {nRows, nColumns}
+    [[nodiscard]] Tensor toDense() const;
+
+    /// @name Getters
+    /// @{
+
+    /// @brief Get the values in the band of each row, with shape {nRows, width}
+    [[nodiscard]] inline const Tensor &getValues() const
+    {
+        return _values;
+    }
+
+    /// @brief Get the column of the first value in each row
+    [[nodiscard]] inline const std::vector<long int> &getFirstColumns() const
+    {
+        return _firstColumns;
+    }
+
+    [[nodiscard]] inline long int getNRows() const
+    {
+        return _nRows;
+    }
+
+    [[nodiscard]] inline long int getNColumns() const
+    {
+        return _nColumns;
+    }
+
+    [[nodiscard]] inline long int getWidth() const
+    {
+        return _width;
+    }
+
+    /// @}
+
+  private:
+    Tensor _values;
+    std::vector<long int> _firstColumns;
+    long int _nRows;
+    long int _nColumns;
+    long int _width;
+
+    // column of every stored value, row by row, as a 1-d integer tensor with nRows * width entries
+    Tensor _columnIndices;
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
 #if USE_PYTORCH
 #include <torch/torch.h>
 #endif
@@ -20,6 +25,7 @@ enum scalarType
     kDouble,
     kComplexFloat,
     kComplexDouble,
+    kLong, ///< 64 bit integers, which is what reductions like sum() of kInt tensors give
     kUninitScalar,
 };
 
@@ -31,18 +37,78 @@ enum deviceType
     kUninitDevice,
 };
 
+/// @brief Get the size in bytes of a single value of some scalarType
+/// @param type The type to get the size of
+inline size_t scalarTypeSize(scalarType type)
+{
+    switch (type)
+    {
+    case kInt:
+        return sizeof(int);
+    case kFloat:
+        return sizeof(float);
+    case kDouble:
+        return sizeof(double);
+    case kComplexFloat:
+        return sizeof(std::complex<float>);
+    case kComplexDouble:
+        return sizeof(std::complex<double>);
+    case kLong:
+        return sizeof(std::int64_t);
+    default:
+        return 0;
+    }
+}
+
+/// @brief Get the scalarType corresponding to the c++ type T
+template <typename T> constexpr scalarType scalarTypeOf()
+{
+    if constexpr (std::is_same_v<T, int>)
+    {
+        return kInt;
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        return kFloat;
+    }
+    else if constexpr (std::is_same_v<T, double>)
+    {
+        return kDouble;
+    }
+    else if constexpr (std::is_same_v<T, std::complex<float>>)
+    {
+        return kComplexFloat;
+    }
+    else if constexpr (std::is_same_v<T, std::complex<double>>)
+    {
+        return kComplexDouble;
+    }
+    else if constexpr (std::is_same_v<T, std::int64_t>)
+    {
+        return kLong;
+    }
+    else
+    {
+        static_assert(!std::is_same_v<T, T>, "No nuTens scalarType corresponds to this type");
+    }
+}
+
 #if USE_PYTORCH
 /// map between the data types used in nuTens and those used by pytorch
-const static std::map<scalarType, c10::ScalarType> scalarTypeMap = {{kFloat, torch::kFloat},
+const static std::map<scalarType, c10::ScalarType> scalarTypeMap = {{kInt, torch::kInt},
+                                                                    {kFloat, torch::kFloat},
                                                                     {kDouble, torch::kDouble},
                                                                     {kComplexFloat, torch::kComplexFloat},
-                                                                    {kComplexDouble, torch::kComplexDouble}};
+                                                                    {kComplexDouble, torch::kComplexDouble},
+                                                                    {kLong, torch::kLong}};
 
 /// inverse map between the data types used in nuTens and those used by pytorch
-const static std::map<c10::ScalarType, scalarType> invScalarTypeMap = {{torch::kFloat, kFloat},
+const static std::map<c10::ScalarType, scalarType> invScalarTypeMap = {{torch::kInt, kInt},
+                                                                       {torch::kFloat, kFloat},
                                                                        {torch::kDouble, kDouble},
                                                                        {torch::kComplexFloat, kComplexFloat},
-                                                                       {torch::kComplexDouble, kComplexDouble}};
+                                                                       {torch::kComplexDouble, kComplexDouble},
+                                                                       {torch::kLong, kLong}};
 
 // map between the device types used in nuTens and those used by pytorch
 const static std::map<deviceType, c10::DeviceType> deviceTypeMap = {{kCPU, torch::kCPU}, {kGPU, torch::kCUDA}};
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <nuTens/tensors/runtime-config.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// The parts of the runtime configuration that don't depend on the tensor library
+
+namespace
+{
+
+#if defined(__linux__)
+const std::string nodeDirectory = "/sys/devices/system/node/";
+
+// read the first line of a (sysfs) file, empty if it doesn't exist
+std::string readLine(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+#endif
+
+} // namespace
+
+std::vector<int> RuntimeConfig::parseCpuList(const std::string &cpuList)
+{
+    // a single cpu number, which has to make up the whole of the string
+    auto parseCpu = [&cpuList](const std::string &cpu) {
+        if (cpu.empty() || cpu.size() > 9 || cpu.find_first_not_of("0123456789") != std::string::npos)
+        {
+            NT_ERROR("Bad cpu \"{}\" in cpu list \"{}\"", cpu, cpuList);
+            throw std::invalid_argument("Malformed cpu list");
+        }
+        return std::stoi(cpu);
+    };
+
+    std::vector<int> ret;
+    std::stringstream stream(cpuList);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty())
+        {
+            continue;
+        }
+
+        const size_t dash = range.find('-');
+        const int first = parseCpu(range.substr(0, dash));
+        const int last = (dash == std::string::npos) ? first : parseCpu(range.substr(dash + 1));
+        if (last < first)
+        {
+            NT_ERROR("Range \"{}\" in cpu list \"{}\" runs backwards", range, cpuList);
+            throw std::invalid_argument("Malformed cpu list");
+        }
+
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            ret.push_back(cpu);
+        }
+    }
+
+    // ranges are allowed to overlap
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+
+    return ret;
+}
+
+std::vector<int> RuntimeConfig::getNumaNodes()
+{
+#if defined(__linux__)
+    std::vector<int> ret = parseCpuList(readLine(nodeDirectory + "online"));
+    if (!ret.empty())
+    {
+        return ret;
+    }
+#endif
+
+    // no NUMA information, treat the machine as a single node
+    return {0};
+}
+
+std::vector<int> RuntimeConfig::getNumaNodeCpus(int node)
+{
+#if defined(__linux__)
+    std::vector<int> nodeCpus = parseCpuList(readLine(nodeDirectory + "node" + std::to_string(node) + "/cpulist"));
+    if (!nodeCpus.empty() || getNumaNodes() != std::vector<int>{0})
+    {
+        return nodeCpus;
+    }
+#endif
+
+    // single node machine, the node has every cpu
+    if (node != 0)
+    {
+        return {};
+    }
+
+    std::vector<int> ret(std::max(std::thread::hardware_concurrency(), 1U));
+    for (size_t cpu = 0; cpu < ret.size(); cpu++)
+    {
+        ret[cpu] = static_cast<int>(cpu);
+    }
+    return ret;
+}
+
+std::vector<int> RuntimeConfig::getAllowedCpus()
+{
+    NT_PROFILE();
+
+    std::vector<int> ret;
+
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0)
+    {
+        // group the cpus by NUMA node so that neighbouring workers share a node
+        for (int node : getNumaNodes())
+        {
+            for (int cpu : getNumaNodeCpus(node))
+            {
+                const bool isAllowed = (cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &allowed);
+                if (isAllowed && std::find(ret.begin(), ret.end(), cpu) == ret.end())
+                {
+                    ret.push_back(cpu);
+                }
+            }
+        }
+
+        // anything that the NUMA information didn't mention
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed) && std::find(ret.begin(), ret.end(), cpu) == ret.end())
+            {
+                ret.push_back(cpu);
+            }
+        }
+    }
+#endif
+
+    if (ret.empty())
+    {
+        ret = getNumaNodeCpus(0);
+    }
+
+    return ret;
+}
+
+bool RuntimeConfig::pinCurrentThread(const std::vector<int> &cpus)
+{
+    NT_PROFILE();
+
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+
+    if (CPU_COUNT(&cpuSet) == 0 || pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+    {
+        NT_WARN("Failed to pin thread to {} cpus", cpus.size());
+        return false;
+    }
+
+    return true;
+#else
+    NT_WARN("Pinning threads to cpus is not supported on this platform");
+    return false;
+#endif
+}
+
+bool RuntimeConfig::pinCurrentThreadToNumaNode(int node)
+{
+    return pinCurrentThread(getNumaNodeCpus(node));
+}
+
+void RuntimeConfig::pinWorker(size_t workerIndex)
+{
+    static const std::vector<int> cpus = getAllowedCpus();
+
+    static_cast<void>(pinCurrentThread({cpus[workerIndex % cpus.size()]}));
+}
+
+int RuntimeConfig::getCurrentNumaNode()
+{
+#if defined(__linux__)
+    // work out which node each cpu belongs to once, as this gets called often
+    static const std::vector<int> cpuToNode = []() {
+        std::vector<int> ret;
+        for (int node : getNumaNodes())
+        {
+            for (int cpu : getNumaNodeCpus(node))
+            {
+                if (cpu >= static_cast<int>(ret.size()))
+                {
+                    ret.resize(cpu + 1, 0);
+                }
+                ret[cpu] = node;
+            }
+        }
+        return ret;
+    }();
+
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < static_cast<int>(cpuToNode.size()))
+    {
+        return cpuToNode[cpu];
+    }
+#endif
+
+    return getNumaNodes()[0];
+}
+
+std::string RuntimeConfig::toString()
+{
+    std::ostringstream stream;
+    stream << "RuntimeConfig: " << getIntraOpThreads() << " intra-op threads, " << getInterOpThreads()
+           << " inter-op threads, " << getNCpus() << " allowed cpus, " << getNNumaNodes() << " NUMA nodes";
+    return stream.str();
+}
+
+NumaReplicatedTensor::NumaReplicatedTensor(const Tensor &tensor) : _nodes(RuntimeConfig::getNumaNodes())
+{
+    NT_PROFILE();
+
+    // memory on a GPU doesn't belong to a NUMA node
+    if (_nodes.size() == 1 || tensor.getDevice() != NTdtypes::kCPU)
+    {
+        _nodes.resize(1);
+        _replicas.push_back(tensor);
+        return;
+    }
+
+    const Tensor::Buffer source = tensor.toBuffer();
+    const size_t nBytes = tensor.getNumel() * NTdtypes::scalarTypeSize(source.type);
+
+    _replicas.resize(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); i++)
+    {
+        // memory ends up on the node of the thread that first touches it, so each copy is allocated and filled by a
+        // thread on the node that it is meant for. This is done with a plain memcpy as the tensor library could split
+        // a copy between its own threads, which aren't pinned.
+        std::exception_ptr error;
+        std::thread copier([&, i]() {
+            try
+            {
+                static_cast<void>(RuntimeConfig::pinCurrentThreadToNumaNode(_nodes[i]));
+
+                void *data = std::malloc(std::max<size_t>(nBytes, 1));
+                if (data == nullptr)
+                {
+                    throw std::bad_alloc();
+                }
+                std::memcpy(data, source.data, nBytes);
+                _replicas[i] = Tensor::fromBuffer(data, source.shape, {}, source.type, std::free, NTdtypes::kCPU,
+                                                  tensor.getRequiresGrad());
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        });
+        copier.join();
+
+        if (error)
+        {
+            NT_ERROR("Failed to make the copy of a NumaReplicatedTensor for NUMA node {}", _nodes[i]);
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+const Tensor &NumaReplicatedTensor::get() const
+{
+    return get(RuntimeConfig::getCurrentNumaNode());
+}
+
+const Tensor &NumaReplicatedTensor::get(int node) const
+{
+    for (size_t i = 0; i < _nodes.size(); i++)
+    {
+        if (_nodes[i] == node)
+        {
+            return _replicas[i];
+        }
+    }
+
+    return _replicas[0];
+}
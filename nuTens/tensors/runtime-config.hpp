@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/instrumentation.hpp>
+#include <string>
+#include <vector>
+
+/*!
+ * @file runtime-config.hpp
+ * @brief Defines controls for how many threads nuTens uses, where they run and where their memory lives
+ */
+
+class RuntimeConfig
+{
+    /*!
+     * @class RuntimeConfig
+     * @brief Runtime control of threading, thread placement and NUMA memory placement
+     *
+     * The tensor library runs individual operations on a pool of "intra-op" threads, and independent operations on a
+     * pool of "inter-op" threads. The sizes of both can be set here. Threads created by nuTens (e.g. the workers of a
+     * ThreadPool) can be pinned to particular cores, e.g.
+     * \code{.cpp}
+     *   RuntimeConfig::setIntraOpThreads(1); // let the pool do the parallelism
+     *   auto pool = std::make_shared<ThreadPool>(RuntimeConfig::getNCpus(), RuntimeConfig::pinWorker);
+     * \endcode
+     *
+     * On machines with more than one NUMA node (e.g. dual socket machines), reading memory that lives on another node
+     * is much slower than reading local memory. Read-only tables that get used by threads on every node can be
+     * replicated onto each node using NumaReplicatedTensor.
+     *
+     * Thread placement and NUMA detection are only supported on linux. On other platforms the machine is treated as a
+     * single NUMA node and pinning does nothing.
+     */
+
+  public:
+    /// @name Thread counts
+    /// @{
+
+    /// @brief Set the number of threads the tensor library uses to parallelise a single operation
+    static void setIntraOpThreads(int nThreads);
+
+    /// @brief Get the number of threads the tensor library uses to parallelise a single operation
+    [[nodiscard]] static int getIntraOpThreads();
+
+    /// @brief Set the number of threads the tensor library uses to run independent operations at the same time
+    /// @details Can only be called once, before any inter-op parallel work has been done
+    static void setInterOpThreads(int nThreads);
+
+    /// @brief Get the number of threads the tensor library uses to run independent operations at the same time
+    [[nodiscard]] static int getInterOpThreads();
+
+    /// @}
+
+    /// @name Thread placement
+    /// @{
+
+    /// @brief Parse a linux style cpu list, e.g. "0-3,8,10-11" as used by sysfs and taskset
+    /// @return The cpus in increasing order, each only once even if ranges overlap
+    /// @throws std::invalid_argument If an entry isn't a non-negative number or a range "first-last" with first <= last
+    [[nodiscard]] static std::vector<int> parseCpuList(const std::string &cpuList);
+
+    /// @brief Get the cpus that the current process is allowed to run on, ordered by NUMA node
+    [[nodiscard]] static std::vector<int> getAllowedCpus();
+
+    /// @brief Get the number of cpus that the current process is allowed to run on
+    [[nodiscard]] static inline size_t getNCpus()
+    {
+        return getAllowedCpus().size();
+    }
+
+    /// @brief Pin the calling thread so that it only runs on the specified cpus
+    /// @return Whether the thread was pinned
+    static bool pinCurrentThread(const std::vector<int> &cpus);
+
+    /// @brief Pin the calling thread to the cpus of a NUMA node
+    /// @return Whether the thread was pinned
+    static bool pinCurrentThreadToNumaNode(int node);
+
+    /// @brief Pin the calling thread to the i'th allowed cpu (wrapping around if there are more workers than cpus)
+    /// @details Consecutive workers are packed onto the same NUMA node, designed to be passed as the workerInit of a
+    /// ThreadPool
+    static void pinWorker(size_t workerIndex);
+
+    /// @}
+
+    /// @name NUMA
+    /// @{
+
+    /// @brief Get the ids of the NUMA nodes in the machine
+    [[nodiscard]] static std::vector<int> getNumaNodes();
+
+    /// @brief Get the number of NUMA nodes in the machine
+    [[nodiscard]] static inline int getNNumaNodes()
+    {
+        return static_cast<int>(getNumaNodes().size());
+    }
+
+    /// @brief Get the cpus belonging to a NUMA node
+    [[nodiscard]] static std::vector<int> getNumaNodeCpus(int node);
+
+    /// @brief Get the NUMA node of the cpu that the calling thread is currently running on
+    [[nodiscard]] static int getCurrentNumaNode();
+
+    /// @}
+
+    /// @brief Print a summary of the current configuration to a string
+    [[nodiscard]] static std::string toString();
+};
+
+class NumaReplicatedTensor
+{
+    /*!
+     * @class NumaReplicatedTensor
+     * @brief Read-only tensor with a separate copy living on each NUMA node
+     *
+     * Each copy is made by a thread pinned to the node it is meant for. Memory is placed on the node of the thread
+     * that first writes to it, so each copy ends up local to the threads that read it using get().
+     * \code{.cpp}
+     *   NumaReplicatedTensor table(Tensor::load("flux-table.nttensor"));
+     *   ... // then on any worker thread
+     *   const Tensor &localTable = table.get();
+     * \endcode
+     * On machines with a single NUMA node, or for tensors that aren't on the CPU, no copy is made at all.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param tensor The tensor to replicate, it should not be modified afterwards
+    explicit NumaReplicatedTensor(const Tensor &tensor);
+
+    /// @brief Get the copy of the tensor living on the NUMA node of the calling thread
+    [[nodiscard]] const Tensor &get() const;
+
+    /// @brief Get the copy of the tensor living on a particular NUMA node
+    /// @param node The id of the node, if there is no copy for that node the first copy is returned
+    [[nodiscard]] const Tensor &get(int node) const;
+
+    /// @brief Get the number of copies
+    [[nodiscard]] inline size_t getNReplicas() const
+    {
+        return _replicas.size();
+    }
+
+  private:
+    std::vector<int> _nodes;
+    std::vector<Tensor> _replicas;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <nuTens/utils/instrumentation.hpp>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if USE_PYTORCH
+#include <torch/torch.h>
+#endif
+
+/*!
+ * @file tensor-arena.hpp
+ * @brief Defines a pool which allows the memory of short lived tensors to be recycled
+ */
+
+class TensorArena
+{
+    /*!
+     * @class TensorArena
+     * @brief Pool of tensor buffers which get recycled between tensors of the same shape, type and device
+     *
+     * Functions like calculateProbs() create lots of short lived temporary tensors with identical shapes every time
+     * they are called. While a TensorArena is active on a thread, the Tensor factory functions (Tensor::zeros(),
+     * Tensor::ones()) and the outputs of element-wise operations that don't need to be recorded by autograd will take
+     * their memory from the arena instead of asking the tensor library for a fresh allocation.
+     *
+     * A buffer is only ever handed out again once nothing outside of the arena refers to its memory any more, so
+     * tensors which are still in use (either directly or e.g. by the autograd graph) are never overwritten.
+     *
+     * Arenas are activated using a TensorArena::Scope:
+     * \code{.cpp}
+     *   TensorArena arena;
+     *   for (const Tensor &energies : batches)
+     *   {
+     *       TensorArena::Scope scope(arena);
+     *       Tensor probs = propagator.calculateProbs(energies);
+     *       ...
+     *   }
+     *   std::cout << arena.toString() << std::endl;
+     * \endcode
+     * Keeping the arena alive between calls allows buffers to be recycled across calls with the same shapes.
+     * Alternatively a Scope can be told to release everything it holds in bulk when it exits.
+     *
+     * A single TensorArena should only be active on one thread at a time.
+     */
+
+  public:
+    /// @struct Stats
+    /// @brief Counters describing how much work the arena has done
+    struct Stats
+    {
+        size_t nRequests = 0;      //!< Number of buffers requested from the arena
+        size_t hits = 0;           //!< Number of requests served by recycling an existing buffer
+        size_t misses = 0;         //!< Number of requests that required a fresh allocation
+        size_t bytesServed = 0;    //!< Total size of all buffers handed out by the arena
+        size_t bytesAllocated = 0; //!< Total size of all fresh allocations made by the arena
+    };
+
+    class Scope
+    {
+        /*!
+         * @class Scope
+         * @brief Activates a TensorArena on the current thread for as long as the Scope is alive
+         *
+         * Scopes can be nested, when a Scope exits the previously active arena (if any) becomes active again.
+         */
+
+      public:
+        /// @brief Constructor
+        /// @param arena The arena to activate
+        /// @param releaseOnExit Whether to release all of the buffers held by the arena when this scope exits
+        explicit Scope(TensorArena &arena, bool releaseOnExit = false)
+            : _arena(arena), _previous(_active), _releaseOnExit(releaseOnExit)
+        {
+            _active = &arena;
+        }
+
+        ~Scope()
+        {
+            _active = _previous;
+            if (_releaseOnExit)
+            {
+                _arena.release();
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        Scope(Scope &&) = delete;
+        Scope &operator=(Scope &&) = delete;
+
+      private:
+        TensorArena &_arena;
+        TensorArena *_previous;
+        bool _releaseOnExit;
+    };
+
+    TensorArena() = default;
+    ~TensorArena() = default;
+
+    TensorArena(const TensorArena &) = delete;
+    TensorArena &operator=(const TensorArena &) = delete;
+    TensorArena(TensorArena &&) = delete;
+    TensorArena &operator=(TensorArena &&) = delete;
+
+    /// @brief Get the arena that is currently active on this thread, nullptr if there is none
+    static inline TensorArena *getActive()
+    {
+        return _active;
+    }
+
+    /// @brief Drop all buffers held by the arena
+    /// @details Tensors that are still alive keep their memory, it just won't be recycled anymore
+    void release();
+
+    /// @brief Get the total size of the buffers currently held by the arena
+    [[nodiscard]] size_t getBytesHeld() const;
+
+    /// @brief Get the number of buffers currently held by the arena
+    [[nodiscard]] size_t getNBuffers() const;
+
+    /// @brief Get the counters describing the work done by this arena
+    [[nodiscard]] inline const Stats &getStats() const
+    {
+        return _stats;
+    }
+
+    /// @brief Reset the counters returned by getStats()
+    inline void resetStats()
+    {
+        _stats = Stats();
+    }
+
+    /// @brief Print a summary of the arena statistics to a string
+    [[nodiscard]] std::string toString() const;
+
+  private:
+    static inline thread_local TensorArena *_active = nullptr;
+
+    Stats _stats;
+
+    // ###################################################
+    // ########## Tensor library specific stuff ##########
+    // ###################################################
+
+#if USE_PYTORCH
+  public:
+    /// @brief Get a buffer with the requested shape and options
+    /// @details The contents of the returned tensor are uninitialised. The returned tensor never requires a gradient.
+    /// @param shape The shape of the buffer
+    /// @param options The options (dtype, device) of the buffer
+    [[nodiscard]] torch::Tensor acquire(c10::IntArrayRef shape, const torch::TensorOptions &options);
+
+  private:
+    /// buffers are binned by shape, scalar type, device type and device index
+    using keyType = std::tuple<std::vector<int64_t>, c10::ScalarType, c10::DeviceType, c10::DeviceIndex>;
+
+    std::map<keyType, std::vector<torch::Tensor>> _buffers;
+#endif
+};
@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <nuTens/tensors/tensor.hpp>
+#include <nuTens/utils/mapped-file.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Reading and writing of tensors, see nuTens/tensors/README.md for a description of the file format.
+// Only uses the generic Tensor interface so is shared by all tensor backends.
+
+namespace
+{
+
+constexpr char magic[8] = {'N', 'U', 'T', 'E', 'N', 'S', 'O', 'R'};
+constexpr uint32_t formatVersion = 1;
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+// size of the fixed part of the header, before the shape and strides
+constexpr size_t fixedHeaderSize = 40;
+
+// offset of the data from the start of the file is always a multiple of this
+constexpr uint64_t dataAlignment = 64;
+
+// the dtype codes used in the file are fixed by the format and so are kept separate from NTdtypes::scalarType
+uint32_t getDTypeCode(NTdtypes::scalarType type)
+{
+    switch (type)
+    {
+    case NTdtypes::kInt:
+        return 0;
+    case NTdtypes::kFloat:
+        return 1;
+    case NTdtypes::kDouble:
+        return 2;
+    case NTdtypes::kComplexFloat:
+        return 3;
+    case NTdtypes::kComplexDouble:
+        return 4;
+    case NTdtypes::kLong:
+        return 5;
+    default:
+        NT_ERROR("Tensor with data type {} can't be saved", static_cast<int>(type));
+        throw std::invalid_argument("Tensor data type can't be saved");
+    }
+}
+
+NTdtypes::scalarType getDTypeFromCode(uint32_t code)
+{
+    switch (code)
+    {
+    case 0:
+        return NTdtypes::kInt;
+    case 1:
+        return NTdtypes::kFloat;
+    case 2:
+        return NTdtypes::kDouble;
+    case 3:
+        return NTdtypes::kComplexFloat;
+    case 4:
+        return NTdtypes::kComplexDouble;
+    case 5:
+        return NTdtypes::kLong;
+    default:
+        NT_ERROR("Unknown data type code {} in tensor file", code);
+        throw std::runtime_error("Unknown data type in tensor file");
+    }
+}
+
+template <typename T> void writeValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> T readValue(const char *bytes)
+{
+    T ret;
+    std::memcpy(&ret, bytes, sizeof(T));
+    return ret;
+}
+
+struct Header
+{
+    NTdtypes::scalarType type;
+    std::vector<long int> shape;
+    std::vector<long int> strides;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+[[noreturn]] void badFile(const std::string &path, const std::string &what)
+{
+    NT_ERROR("Bad tensor file {}: {}", path, what);
+    throw std::runtime_error("Bad tensor file " + path + ": " + what);
+}
+
+// get the number of dimensions from the fixed part of the header, checking that it looks like a tensor file
+uint32_t readFixedHeader(const std::string &path, const char *bytes)
+{
+    if (std::memcmp(bytes, magic, sizeof(magic)) != 0)
+    {
+        badFile(path, "not a nuTens tensor file");
+    }
+
+    const auto version = readValue<uint32_t>(bytes + 8);
+    if (version != formatVersion)
+    {
+        badFile(path, "unsupported format version " + std::to_string(version));
+    }
+
+    if (readValue<uint32_t>(bytes + 12) != byteOrderMark)
+    {
+        badFile(path, "written on a machine with a different byte order");
+    }
+
+    return readValue<uint32_t>(bytes + 20);
+}
+
+// bytes must hold the fixed header followed by the shape and strides
+Header readHeader(const std::string &path, const char *bytes, uint64_t fileSize)
+{
+    Header ret;
+    const uint32_t nDims = readFixedHeader(path, bytes);
+
+    ret.type = getDTypeFromCode(readValue<uint32_t>(bytes + 16));
+    ret.dataOffset = readValue<uint64_t>(bytes + 24);
+    ret.dataSize = readValue<uint64_t>(bytes + 32);
+
+    ret.shape.resize(nDims);
+    ret.strides.resize(nDims);
+    for (uint32_t dim = 0; dim < nDims; dim++)
+    {
+        ret.shape[dim] = static_cast<long int>(readValue<int64_t>(bytes + fixedHeaderSize + 8 * dim));
+        ret.strides[dim] = static_cast<long int>(readValue<int64_t>(bytes + fixedHeaderSize + 8 * (nDims + dim)));
+    }
+
+    if (ret.dataOffset % dataAlignment != 0 || ret.dataOffset + ret.dataSize > fileSize)
+    {
+        badFile(path, "data is misaligned or truncated");
+    }
+
+    // make sure that no element described by the shape and strides lies outside of the data
+    const size_t elementSize = NTdtypes::scalarTypeSize(ret.type);
+    uint64_t lastElement = 0;
+    bool empty = false;
+    for (uint32_t dim = 0; dim < nDims; dim++)
+    {
+        if (ret.shape[dim] < 0 || ret.strides[dim] < 0)
+        {
+            badFile(path, "negative shape or stride");
+        }
+        empty = empty || (ret.shape[dim] == 0);
+        lastElement += static_cast<uint64_t>(std::max<long int>(ret.shape[dim] - 1, 0)) * ret.strides[dim];
+    }
+    if (!empty && (lastElement + 1) * elementSize > ret.dataSize)
+    {
+        badFile(path, "shape and strides don't fit inside the data");
+    }
+
+    return ret;
+}
+
+} // namespace
+
+void Tensor::save(const std::string &path) const
+{
+    NT_PROFILE();
+
+    const Buffer buffer = toBuffer();
+    const uint32_t nDims = buffer.shape.size();
+
+    uint64_t dataSize = NTdtypes::scalarTypeSize(buffer.type);
+    for (long int dimSize : buffer.shape)
+    {
+        dataSize *= dimSize;
+    }
+
+    const uint64_t headerSize = fixedHeaderSize + 16 * static_cast<uint64_t>(nDims);
+    const uint64_t dataOffset = ((headerSize + dataAlignment - 1) / dataAlignment) * dataAlignment;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        NT_ERROR("Could not open {} to save tensor", path);
+        throw std::runtime_error("Could not open file to save tensor: " + path);
+    }
+
+    file.write(magic, sizeof(magic));
+    writeValue<uint32_t>(file, formatVersion);
+    writeValue<uint32_t>(file, byteOrderMark);
+    writeValue<uint32_t>(file, getDTypeCode(buffer.type));
+    writeValue<uint32_t>(file, nDims);
+    writeValue<uint64_t>(file, dataOffset);
+    writeValue<uint64_t>(file, dataSize);
+    for (long int dimSize : buffer.shape)
+    {
+        writeValue<int64_t>(file, dimSize);
+    }
+    for (long int stride : buffer.strides)
+    {
+        writeValue<int64_t>(file, stride);
+    }
+
+    const std::vector<char> padding(dataOffset - headerSize, 0);
+    file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+    file.write(static_cast<const char *>(buffer.data), static_cast<std::streamsize>(dataSize));
+
+    if (!file)
+    {
+        NT_ERROR("Failed to write tensor to {}", path);
+        throw std::runtime_error("Failed to write tensor to file: " + path);
+    }
+}
+
+Tensor Tensor::load(const std::string &path, bool memoryMap, NTdtypes::deviceType device, bool requiresGrad)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+
+    if (memoryMap)
+    {
+        auto mappedFile = std::make_shared<MappedFile>(path);
+        const char *bytes = static_cast<const char *>(mappedFile->data());
+
+        if (mappedFile->size() < fixedHeaderSize ||
+            mappedFile->size() < fixedHeaderSize + 16 * static_cast<uint64_t>(readFixedHeader(path, bytes)))
+        {
+            badFile(path, "header is truncated");
+        }
+        const Header header = readHeader(path, bytes, mappedFile->size());
+
+        // the tensor keeps the mapping alive
+        ret = fromBuffer(static_cast<char *>(mappedFile->data()) + header.dataOffset, header.shape, header.strides,
+                         header.type, [mappedFile](void * /*data*/) mutable { mappedFile.reset(); });
+    }
+    else
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            NT_ERROR("Could not open {} to load tensor", path);
+            throw std::runtime_error("Could not open file to load tensor: " + path);
+        }
+        const auto fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        std::vector<char> headerBytes(fixedHeaderSize);
+        if (!file.read(headerBytes.data(), fixedHeaderSize))
+        {
+            badFile(path, "header is truncated");
+        }
+        headerBytes.resize(fixedHeaderSize + 16 * static_cast<size_t>(readFixedHeader(path, headerBytes.data())));
+        if (!file.read(headerBytes.data() + fixedHeaderSize,
+                       static_cast<std::streamsize>(headerBytes.size() - fixedHeaderSize)))
+        {
+            badFile(path, "header is truncated");
+        }
+        const Header header = readHeader(path, headerBytes.data(), fileSize);
+
+        // operator new[] gives memory aligned well enough for any of the scalar types
+        std::unique_ptr<char[]> data(new char[header.dataSize]);
+        file.seekg(static_cast<std::streamoff>(header.dataOffset));
+        if (!file.read(data.get(), static_cast<std::streamsize>(header.dataSize)))
+        {
+            badFile(path, "data is truncated");
+        }
+
+        ret = fromBuffer(data.get(), header.shape, header.strides, header.type,
+                         [](void *data) { delete[] static_cast<char *>(data); });
+        data.release();
+    }
+
+    if (device != NTdtypes::kCPU)
+    {
+        ret.device(device);
+    }
+    return ret.requiresGrad(requiresGrad);
+}
@@ -3,11 +3,17 @@
 #include <any>
 #include <cassert>
 #include <complex>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <nuTens/tensors/dtypes.hpp>
 #include <nuTens/utils/instrumentation.hpp>
 #include <nuTens/utils/logging.hpp>
+#include <optional>
+#include <stdexcept>
 #include <variant>
 #include <vector>
 
@@ -48,7 +54,220 @@ class Tensor
     using indexType = std::variant<int, std::string>;
 
     /// Container that holds all allowed types that can be returned by a tensor
-    using variantType = std::variant<int, float, double, std::complex<float>, std::complex<double>>;
+    using variantType = std::variant<int, float, double, std::complex<float>, std::complex<double>, std::int64_t>;
+
+    /// @brief Memory exported from a tensor using toBuffer()
+    struct Buffer
+    {
+        void *data = nullptr;           //!< Pointer to the first element
+        std::vector<long int> shape;    //!< Shape of the data
+        std::vector<long int> strides;  //!< Stride of each dimension, in number of elements
+        NTdtypes::scalarType type;      //!< Type of the elements
+        std::shared_ptr<void> owner;    //!< Keeps the memory alive for as long as any copy of the Buffer exists
+    };
+
+    template <typename T> class Accessor
+    {
+        /*!
+         * @class Accessor
+         * @brief Typed, read-only access to the values of a tensor held in contiguous CPU memory
+         *
+         * Obtained using Tensor::getAccessor(). Reading values through an Accessor is just a memory access, unlike
+         * getValue() which has to go through the tensor library (and create a new tensor) for every value. e.g.
+         * \code{.cpp}
+         *   Tensor::Accessor<float> probs = propagator.calculateProbs(energies).getAccessor<float>();
+         *   for (long int i = 0; i < nEnergies; i++)
+         *   {
+         *       float muSurvival = probs(i, 1, 1);
+         *   }
+         * \endcode
+         * The Accessor keeps the memory alive for as long as it exists. It will not see changes made to the tensor
+         * after it was created if the tensor had to be copied to make it contiguous, on the CPU and of type T.
+         */
+
+      public:
+        using iterator = const T *;
+
+        /// @brief Get the value at some index
+        /// @param indices One index for each dimension of the tensor
+        template <typename... Idx> [[nodiscard]] inline const T &operator()(Idx... indices) const
+        {
+            static_assert(std::conjunction_v<std::is_integral<Idx>...>, "Indices must be integers");
+            assert(sizeof...(Idx) == _buffer.shape.size());
+
+            long int offset = 0;
+            size_t dim = 0;
+            ((offset += static_cast<long int>(indices) * _buffer.strides[dim++]), ...);
+            return _data[offset];
+        }
+
+        /// @brief Get the value at some index, checking that the index is valid
+        /// @param indices One index for each dimension of the tensor
+        [[nodiscard]] inline const T &at(const std::vector<long int> &indices) const
+        {
+            if (indices.size() != _buffer.shape.size())
+            {
+                throw std::out_of_range("Wrong number of indices passed to Tensor::Accessor::at()");
+            }
+
+            long int offset = 0;
+            for (size_t dim = 0; dim < indices.size(); dim++)
+            {
+                if (indices[dim] < 0 || indices[dim] >= _buffer.shape[dim])
+                {
+                    throw std::out_of_range("Index out of range in Tensor::Accessor::at()");
+                }
+                offset += indices[dim] * _buffer.strides[dim];
+            }
+            return _data[offset];
+        }
+
+        /// @brief Get the value at some position in the flattened (row-major) tensor
+        [[nodiscard]] inline const T &operator[](size_t i) const
+        {
+            return _data[i];
+        }
+
+        /// @brief Get a pointer to the first value
+        [[nodiscard]] inline const T *data() const
+        {
+            return _data;
+        }
+
+        /// @brief Get the total number of values
+        [[nodiscard]] inline size_t size() const
+        {
+            return _size;
+        }
+
+        /// @brief Get the shape of the accessed tensor
+        [[nodiscard]] inline const std::vector<long int> &getShape() const
+        {
+            return _buffer.shape;
+        }
+
+        /// @brief Get the strides of the accessed tensor, in number of elements
+        [[nodiscard]] inline const std::vector<long int> &getStrides() const
+        {
+            return _buffer.strides;
+        }
+
+        /// @name Iterators
+        /// Iterate over all values in row-major order
+        /// @{
+        [[nodiscard]] inline iterator begin() const
+        {
+            return _data;
+        }
+        [[nodiscard]] inline iterator end() const
+        {
+            return _data + _size;
+        }
+        /// @}
+
+      private:
+        friend class Tensor;
+
+        explicit Accessor(Buffer buffer)
+            : _buffer(std::move(buffer)), _data(static_cast<const T *>(_buffer.data)), _size(1)
+        {
+            for (long int dimSize : _buffer.shape)
+            {
+                _size *= static_cast<size_t>(dimSize);
+            }
+        }
+
+        Buffer _buffer;
+        const T *_data;
+        size_t _size;
+    };
+
+    /// @brief A range of indices along one dimension of a tensor, equivalent to python's start:stop:step
+    struct Slice
+    {
+        std::optional<long int> start; //!< First index of the slice, defaults to the start of the dimension
+        std::optional<long int> stop;  //!< One past the last index of the slice, defaults to the end of the dimension
+        long int step = 1;             //!< Step between consecutive indices
+    };
+
+    /// @brief Tag type representing an ellipsis ("...") in an Index
+    struct EllipsisType
+    {
+    };
+
+    /// Ellipsis that can be used when building an Index, equivalent to "..." in python
+    static constexpr EllipsisType ellipsis{};
+
+    class Index
+    {
+        /*!
+         * @class Index
+         * @brief Precompiled set of indices used to access parts of a tensor
+         *
+         * Converting the std::vector<indexType> accepted by getValues() and setValue() into something the tensor
+         * library understands has to be done on every call. When the same indices get used over and over (e.g. inside
+         * the loops of a propagator) it is much cheaper to build an Index once and reuse it. For example
+         * \code{.cpp}
+         *   Tensor::Index idx({Tensor::ellipsis, 1, Tensor::Slice{0, 2}});
+         *   for (...)
+         *   {
+         *       Tensor values = tensor.getValues(idx);
+         *   }
+         * \endcode
+         * is equivalent to tensor[..., 1, 0:2] in python.
+         */
+
+      public:
+        /// The possible entries of an Index: a single integer, a Slice or an ellipsis
+        using entryType = std::variant<long int, Slice, EllipsisType>;
+
+        /// @brief Construct an index from a list of entries
+        /// @param entries The entries, one for each dimension being indexed (or ellipsis)
+        explicit Index(const std::vector<entryType> &entries);
+
+        /// @brief Build an index from the python-like format accepted by getValues()
+        /// @details Strings can be "..." or slices of the form "start:stop:step" where any part can be left empty
+        /// @param indices The indices to convert
+        static Index parse(const std::vector<indexType> &indices);
+
+        /// @brief Get the number of entries in this index
+        [[nodiscard]] size_t size() const;
+
+        // ###################################################
+        // ########## Tensor library specific stuff ##########
+        // ###################################################
+
+#if USE_PYTORCH
+      private:
+        friend class Tensor;
+        std::vector<at::indexing::TensorIndex> _indices;
+#endif
+    };
+
+    class NoGradGuard
+    {
+        /*!
+         * @class NoGradGuard
+         * @brief Turns off gradient tracking on the current thread for as long as it is alive
+         *
+         * Operations done while a NoGradGuard exists are not recorded for use in backward() so are cheaper, and their
+         * outputs can be safely written to from multiple threads at once. Only affects the thread that created it.
+         */
+
+      public:
+        NoGradGuard() = default;
+        ~NoGradGuard() = default;
+
+        NoGradGuard(const NoGradGuard &) = delete;
+        NoGradGuard &operator=(const NoGradGuard &) = delete;
+        NoGradGuard(NoGradGuard &&) = delete;
+        NoGradGuard &operator=(NoGradGuard &&) = delete;
+
+#if USE_PYTORCH
+      private:
+        torch::NoGradGuard _guard;
+#endif
+    };
 
     /// @name Constructors
     /// Use these methods to construct tensors
@@ -66,6 +285,30 @@ class Tensor
     Tensor(const std::vector<float> &values, NTdtypes::scalarType type = NTdtypes::kFloat,
            NTdtypes::deviceType device = NTdtypes::kCPU, bool requiresGrad = true);
 
+    /// @brief Construct a 1-d array holding a copy of some values, with the data type that matches T
+    /// @details Unlike the constructor above, which goes through floats, the values are kept exactly, so e.g. large
+    /// integer indices and doubles don't lose precision. T can be int, std::int64_t, float or double.
+    /// @arg values The values to include in the tensor
+    /// @arg device The device to put the tensor on
+    /// @arg requiresGrad Whether the tensor should require a gradient, only possible for floating point types
+    template <typename T>
+    static Tensor fromVector(const std::vector<T> &values, NTdtypes::deviceType device = NTdtypes::kCPU,
+                             bool requiresGrad = false);
+
+    /// @brief Construct a tensor which uses memory owned by someone else without copying it
+    /// @details The memory must stay valid until deleter is called, which happens once the returned tensor and all
+    /// tensors sharing its memory (e.g. views of it) have been destroyed.
+    /// @arg data Pointer to the first element
+    /// @arg shape The shape of the tensor
+    /// @arg strides The stride of each dimension, in number of elements. If empty the data is taken to be contiguous.
+    /// @arg type The data type of the elements
+    /// @arg deleter Called with data when the tensor library is done with the memory. Can be left empty if the memory
+    /// is guaranteed to outlive the tensor
+    /// @arg device The device that the memory lives on
+    static Tensor fromBuffer(void *data, const std::vector<long int> &shape, const std::vector<long int> &strides,
+                             NTdtypes::scalarType type, const std::function<void(void *)> &deleter = {},
+                             NTdtypes::deviceType device = NTdtypes::kCPU, bool requiresGrad = false);
+
     /// @brief Construct an identity tensor (has to be a 2d square tensor)
     /// @arg n The size of one of the sides of the tensor
     /// @arg type The data type of the tensor
@@ -154,12 +397,70 @@ class Tensor
     /// @arg t The tensor
     static Tensor exp(const Tensor &t);
 
+    /// @brief Element-wise natural logarithm
+    /// @arg t The tensor
+    static Tensor log(const Tensor &t);
+
+    /// @brief Element-wise clamp a tensor to lie between some bounds
+    /// @arg t The tensor
+    /// @arg lower The lower bounds, broadcastable to the shape of t
+    /// @arg upper The upper bounds, broadcastable to the shape of t
+    static Tensor clamp(const Tensor &t, const Tensor &lower, const Tensor &upper);
+
     /// @brief Get the transpose of a tensor
     /// @arg t The tensor
     /// @arg dim1 The first dimension to swap
     /// @arg dim2 The second dimension to swap
     static Tensor transpose(const Tensor &t, int dim1, int dim2);
 
+    /// @brief Get a tensor with the same values but a different shape
+    /// @arg t The tensor
+    /// @arg shape The new shape, one dimension can be -1 in which case its size is inferred
+    static Tensor reshape(const Tensor &t, const std::vector<long int> &shape);
+
+    /// @brief Join tensors together along an existing dimension
+    /// @arg tensors The tensors, which must have the same shape apart from in dimension dim
+    /// @arg dim The dimension to join them along
+    static Tensor cat(const std::vector<Tensor> &tensors, int dim = 0);
+
+    /// @brief Pick out entries of a tensor along one dimension
+    /// @arg t The tensor
+    /// @arg dim The dimension to pick along
+    /// @arg indices 1-d integer tensor of the indices to pick, which can be repeated and in any order
+    static Tensor indexSelect(const Tensor &t, int dim, const Tensor &indices);
+
+    /// @brief Add values into entries of a tensor picked out along one dimension
+    /// @details Entries of source with the same index are all added to the same entry, so this can be used to sum
+    /// values into bins. Differentiable with respect to both t and source.
+    /// @arg t The tensor to add to, which isn't modified
+    /// @arg dim The dimension to index along
+    /// @arg indices 1-d integer tensor of where in t each entry of source along dim should be added
+    /// @arg source The values to add, the same shape as t except along dim, where its size is the number of indices
+    /// @return The sum, with the same shape as t
+    static Tensor indexAdd(const Tensor &t, int dim, const Tensor &indices, const Tensor &source);
+
+    /// @brief Find which bucket each value falls into, given the boundaries between the buckets
+    /// @details The result for a value v is the number of boundaries b with b < v, or b <= v if right is true
+    /// @arg values The values to look up
+    /// @arg boundaries 1-d tensor of the boundaries, in ascending order
+    /// @arg right Whether a value equal to a boundary goes in the bucket to the right of it
+    /// @return Integer tensor with the same shape as values
+    static Tensor bucketize(const Tensor &values, const Tensor &boundaries, bool right = false);
+
+    /// @brief Find the distinct values in a tensor
+    /// @details Not differentiable. Indexing the result with inverseIndices using indexSelect() gives back the
+    /// flattened tensor.
+    /// @arg t The tensor
+    /// @arg inverseIndices Set to a 1-d integer tensor holding the position in the result of each element of t, in
+    /// row-major order
+    /// @return 1-d tensor of the distinct values, in ascending order
+    static Tensor unique(const Tensor &t, Tensor &inverseIndices);
+
+    /// @brief Insert a dimension of size 1 into a tensor
+    /// @arg t The tensor
+    /// @arg dim The position of the new dimension, negative values count from the end
+    static Tensor unsqueeze(const Tensor &t, int dim);
+
     /// @brief Scale a matrix by some scalar
     /// @arg s The scalar
     /// @arg t The tensor
@@ -226,6 +527,26 @@ class Tensor
     /// @param[out] eVecs The eigenvectors
     static void eig(const Tensor &t, Tensor &eVals, Tensor &eVecs);
 
+    /// @brief Get eigenvalues and vectors of a (batch of) hermitian matrices
+    /// @details Faster and more stable than eig() when the matrices are known to be hermitian. The eigenvalues are
+    /// real and in ascending order, and the eigenvectors form a unitary matrix.
+    /// @arg t The tensor, only the lower triangle of each matrix is used
+    /// @param[out] eVals The eigenvalues
+    /// @param[out] eVecs The eigenvectors, one per column
+    static void eigh(const Tensor &t, Tensor &eVals, Tensor &eVecs);
+
+    /// @brief Get the inverse of a (batch of) square matrices
+    /// @arg t The tensor
+    static Tensor inverse(const Tensor &t);
+
+    /// @brief Get the diagonals of a (batch of) matrices, i.e. over the last two dimensions
+    /// @arg t The tensor
+    static Tensor diagonal(const Tensor &t);
+
+    /// @brief Construct a (batch of) diagonal matrices from the values in the last dimension of a tensor
+    /// @arg t The tensor of diagonal values
+    static Tensor diagEmbed(const Tensor &t);
+
     /// @}
 
     /// @name Mathematical
@@ -293,6 +614,63 @@ class Tensor
     /// for this tensor after calling backward()
     [[nodiscard]] Tensor grad() const;
 
+    /// @brief Check whether operations on the current thread are being recorded for gradients, i.e. there is no
+    /// NoGradGuard alive
+    [[nodiscard]] static bool isGradEnabled();
+
+    /// @brief Calculate the gradients of a tensor with respect to some inputs
+    /// @details Unlike backward(), the gradients are returned rather than accumulated into grad() of the inputs
+    /// @arg output The tensor to differentiate
+    /// @arg inputs The tensors to get the gradients with respect to
+    /// @arg gradOutput Gradient of the output, for a non-scalar output this picks out which combination of its values
+    /// is differentiated (i.e. a vector-Jacobian product)
+    /// @arg retainGraph Whether to keep the graph around so that it can be differentiated again
+    /// @arg createGraph Whether to record the calculation of the gradients so they can themselves be differentiated
+    /// @return The gradient of each input, zeros if the output doesn't depend on it
+    static std::vector<Tensor> gradients(const Tensor &output, const std::vector<Tensor> &inputs,
+                                         const Tensor &gradOutput = Tensor(), bool retainGraph = false,
+                                         bool createGraph = false);
+
+    /// Function used by customGrad() to calculate the outputs. Gets the inputs and fills saved with whatever tensors
+    /// the backward function will need.
+    using forwardFnType =
+        std::function<std::vector<Tensor>(const std::vector<Tensor> &inputs, std::vector<Tensor> &saved)>;
+
+    /// Function used by customGrad() to calculate the gradients. Gets the tensors saved by the forward function and the
+    /// gradients of the outputs and returns the gradients of the inputs.
+    using backwardFnType =
+        std::function<std::vector<Tensor>(const std::vector<Tensor> &saved, const std::vector<Tensor> &gradOutputs)>;
+
+    /// @brief Calculate something using a hand written backward pass instead of recording every operation
+    /// @details forward is run with gradient tracking turned off, so nothing but the tensors it saves is kept alive for
+    /// the backward pass. When gradients are later needed, backward is called (also without tracking) and must return
+    /// one gradient per input, which can be an undefined Tensor if an input doesn't need one. Gradients follow the
+    /// tensor library's convention for complex numbers, i.e. dL/d(Re z) + i dL/d(Im z). For convenience, a returned
+    /// gradient may have the broadcast shape used in the calculation (it is summed down to the shape of the input),
+    /// may have the right number of elements but a different shape, and may be complex for a real input (only the real
+    /// part is used). If gradients of the gradients are asked for (e.g. when calculating a hessian using gradients()
+    /// with createGraph), forward is instead re-run with tracking turned on and differentiated as normal, so higher
+    /// derivatives are correct even though backward only gives first derivatives.
+    /// @arg inputs The tensors to calculate gradients with respect to
+    /// @arg forward Calculates the outputs
+    /// @arg backward Calculates the gradients of the inputs
+    /// @return The outputs of forward, connected to the inputs for the purpose of backward()
+    static std::vector<Tensor> customGrad(const std::vector<Tensor> &inputs, const forwardFnType &forward,
+                                          const backwardFnType &backward);
+
+    /// Function used by checkpoint() to calculate the outputs from the inputs
+    using checkpointFnType = std::function<std::vector<Tensor>(const std::vector<Tensor> &inputs)>;
+
+    /// @brief Calculate something without keeping any of its intermediate tensors for the backward pass
+    /// @details func is run with gradient tracking turned off, so only the inputs are kept alive. When gradients are
+    /// needed, func is run again with tracking turned on and the recorded calculation is differentiated, i.e. memory is
+    /// traded for the cost of running func a second time. func should only depend on its inputs, and give the same
+    /// result each time it is called.
+    /// @arg inputs The tensors to calculate gradients with respect to
+    /// @arg func Calculates the outputs
+    /// @return The outputs of func, connected to the inputs for the purpose of backward()
+    static std::vector<Tensor> checkpoint(const std::vector<Tensor> &inputs, const checkpointFnType &func);
+
     /// @}
 
     /// @name Trigonometric
@@ -326,16 +704,127 @@ class Tensor
     void setValue(const std::vector<int> &indices, float value);
     void setValue(const std::vector<int> &indices, std::complex<float> value);
 
+    /// @brief Set the values at a precompiled Index of the tensor
+    /// @arg index The index of the values to set
+    /// @arg value The value to set them to
+    void setValue(const Index &index, const Tensor &value);
+    void setValue(const Index &index, float value);
+    void setValue(const Index &index, std::complex<float> value);
+
     /// @brief Get the value at a certain entry in the tensor
     /// @param indices The index of the entry to get
     [[nodiscard]] Tensor getValues(const std::vector<indexType> &indices) const;
 
+    /// @brief Get the values at a precompiled Index of the tensor
+    /// @param index The index of the values to get
+    [[nodiscard]] Tensor getValues(const Index &index) const;
+
     /// @brief Get the value at a certain entry in the tensor as an std::variant
     /// @details This mainly exists so we can get the values of a tensor in python as pybind11 DOES NOT like templated
     /// functions If using the c++ interface it is probably easier, faster and safer to use the templated getValue()
     /// function.
     [[nodiscard]] variantType getVariantValue(const std::vector<int> &indices) const;
 
+    /// @brief Get a deep copy of this tensor with its own memory
+    /// @details By default the copy starts a new autograd history, i.e. it is a leaf which requires a gradient if this
+    /// tensor does.
+    /// @param keepHistory Instead record the copy like any other operation, so that gradients of anything calculated
+    /// from it flow back through to whatever this tensor was calculated from
+    [[nodiscard]] Tensor clone(bool keepHistory = false) const;
+
+    /// @brief Get a pointer to the first element of the tensor
+    /// @details No copy is made, so the layout of the memory is described by getShape() and getStrides() and it may
+    /// live on a GPU. Use toBuffer() to get memory that is guaranteed to be contiguous and on the CPU.
+    [[nodiscard]] void *dataPtr();
+    [[nodiscard]] const void *dataPtr() const;
+
+    /// @brief Export the values of this tensor as contiguous memory on the CPU
+    /// @details This is free if the tensor is already contiguous and on the CPU, otherwise a single copy is made. The
+    /// returned Buffer keeps the memory alive for as long as it exists.
+    [[nodiscard]] Buffer toBuffer() const;
+
+    /// @name Serialisation
+    /// Read and write tensors using the simple binary format described in nuTens/tensors/README.md
+    /// @{
+
+    /// @brief Write the values of this tensor to a file
+    /// @param path The file to write to, any existing file is overwritten
+    void save(const std::string &path) const;
+
+    /// @brief Read a tensor from a file written by save()
+    /// @details When memory mapping, pages of the file are only read when they are first touched and are shared with
+    /// every other process that maps the same file, so large tables can be loaded cheaply by many workers. Writing to
+    /// a memory mapped tensor is allowed, but only modifies a private copy of the affected pages and never the file.
+    /// @param path The file to read
+    /// @param memoryMap Whether to map the file into memory instead of reading it into freshly allocated memory
+    /// @param device The device to put the tensor on, anything other than the CPU requires a copy
+    /// @param requiresGrad Whether the loaded tensor should require a gradient
+    static Tensor load(const std::string &path, bool memoryMap = true, NTdtypes::deviceType device = NTdtypes::kCPU,
+                       bool requiresGrad = false);
+
+    /// @}
+
+    /// @name Bulk Access
+    /// Get all of the values of a tensor at once. These cost at most one copy of the tensor (plus a conversion if it
+    /// is not already of type T) rather than one call to the tensor library per value like getValue().
+    /// @{
+
+    /// @brief Copy all values of the tensor, in row-major order, into some memory
+    /// @param dst Where to copy the values to
+    /// @param size The number of values that dst can hold, must be at least getNumel()
+    template <typename T> void copyTo(T *dst, size_t size) const
+    {
+        NT_PROFILE();
+
+        const Buffer buffer = toBufferAs<T>();
+        const size_t numel = getNumel();
+        if (size < numel)
+        {
+            NT_ERROR("Trying to copy {} values into memory that can only hold {}", numel, size);
+            throw std::out_of_range("Destination of Tensor::copyTo() is too small");
+        }
+
+        std::memcpy(dst, buffer.data, numel * sizeof(T));
+    }
+
+    /// @brief Get all values of the tensor, in row-major order, as a vector
+    template <typename T> [[nodiscard]] std::vector<T> toVector() const
+    {
+        NT_PROFILE();
+
+        std::vector<T> ret(getNumel());
+        copyTo<T>(ret.data(), ret.size());
+        return ret;
+    }
+
+    /// @brief Get an Accessor to read the values of the tensor
+    template <typename T> [[nodiscard]] Accessor<T> getAccessor() const
+    {
+        NT_PROFILE();
+
+        return Accessor<T>(toBufferAs<T>());
+    }
+
+    /// @}
+
+    /// @brief Check whether the elements of the tensor are laid out contiguously in memory
+    [[nodiscard]] bool isContiguous() const;
+
+    /// @brief Get the stride of each dimension of the tensor, in number of elements
+    [[nodiscard]] std::vector<long int> getStrides() const;
+
+    /// @brief Get the data type of the tensor
+    [[nodiscard]] NTdtypes::scalarType getDType() const;
+
+    /// @brief Get the device that the tensor lives on
+    [[nodiscard]] NTdtypes::deviceType getDevice() const;
+
+    /// @brief Get whether the tensor requires a gradient, i.e. whether operations on it are being recorded
+    [[nodiscard]] bool getRequiresGrad() const;
+
+    /// @brief Get the total number of elements in the tensor
+    [[nodiscard]] size_t getNumel() const;
+
     /// @brief Get the number of dimensions in the tensor
     [[nodiscard]] size_t getNdim() const;
 
@@ -349,6 +838,19 @@ class Tensor
     static std::string getTensorLibrary();
 
   private:
+    /// Same as toBuffer() but also converts the values to type T if needed
+    template <typename T> [[nodiscard]] Buffer toBufferAs() const
+    {
+        if (getDType() == NTdtypes::scalarTypeOf<T>())
+        {
+            return toBuffer();
+        }
+
+        Tensor converted = *this;
+        converted.dType(NTdtypes::scalarTypeOf<T>());
+        return converted.toBuffer();
+    }
+
     bool _hasBatchDim = false;
     NTdtypes::scalarType _dType;
     NTdtypes::deviceType _device;
@@ -369,6 +871,15 @@ class Tensor
         return _tensor.index(convertIndices(indices)).item<T>();
     }
 
+    /// @brief Get the value at a precompiled Index of the tensor
+    /// @arg index The index of the value to get
+    template <typename T> inline T getValue(const Index &index) const
+    {
+        NT_PROFILE();
+
+        return _tensor.index(index._indices).item<T>();
+    }
+
     /// Get the value of a size 0 tensor (scalar)
     template <typename T> inline T getValue() const
     {
@@ -412,35 +923,10 @@ class Tensor
         return indicesVec;
     }
 
-    /// Utility function to convert from a vector of ints to a vector of a10 tensor indices, which is needed for
-    /// accessing values of a tensor.
-    [[nodiscard]] static inline std::vector<at::indexing::TensorIndex> convertIndices(
-        const std::vector<Tensor::indexType> &indices)
-    {
-        NT_PROFILE();
-
-        std::vector<at::indexing::TensorIndex> indicesVec;
-        for (const Tensor::indexType &i : indices)
-        {
-            if (const int *index = std::get_if<int>(&i))
-            {
-                indicesVec.push_back(at::indexing::TensorIndex(*index));
-            }
-            else if (const std::string *index = std::get_if<std::string>(&i))
-            {
-                indicesVec.push_back(at::indexing::TensorIndex((*index).c_str()));
-            }
-            else
-            {
-                assert(false && "ERROR: Unsupported index type");
-                throw;
-            }
-        }
-
-        return indicesVec;
-    }
-
   private:
     torch::Tensor _tensor;
+
+    // torch::autograd::Function used to implement customGrad()
+    struct CustomGradFunction;
 #endif
 };
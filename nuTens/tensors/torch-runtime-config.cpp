@@ -0,0 +1,47 @@
+#include <nuTens/tensors/runtime-config.hpp>
+#include <stdexcept>
+
+void RuntimeConfig::setIntraOpThreads(int nThreads)
+{
+    NT_PROFILE();
+
+    if (nThreads < 1)
+    {
+        NT_ERROR("Invalid number of intra-op threads: {}", nThreads);
+        throw std::invalid_argument("Number of intra-op threads must be at least 1");
+    }
+
+    at::set_num_threads(nThreads);
+}
+
+int RuntimeConfig::getIntraOpThreads()
+{
+    return at::get_num_threads();
+}
+
+void RuntimeConfig::setInterOpThreads(int nThreads)
+{
+    NT_PROFILE();
+
+    if (nThreads < 1)
+    {
+        NT_ERROR("Invalid number of inter-op threads: {}", nThreads);
+        throw std::invalid_argument("Number of inter-op threads must be at least 1");
+    }
+
+    // pytorch only allows this to be set once, before the inter-op pool has been started
+    try
+    {
+        at::set_num_interop_threads(nThreads);
+    }
+    catch (const c10::Error &error)
+    {
+        NT_ERROR("Could not set the number of inter-op threads: {}", error.what_without_backtrace());
+        throw std::runtime_error("Number of inter-op threads can only be set once, before any inter-op work is done");
+    }
+}
+
+int RuntimeConfig::getInterOpThreads()
+{
+    return at::get_num_interop_threads();
+}
@@ -0,0 +1,80 @@
+#include <nuTens/tensors/tensor-arena.hpp>
+#include <sstream>
+
+torch::Tensor TensorArena::acquire(c10::IntArrayRef shape, const torch::TensorOptions &options)
+{
+    NT_PROFILE();
+
+    // there's only one cpu so don't let differences between "no index" and "index 0" split the pool
+    const c10::Device device = options.device();
+    const c10::DeviceIndex deviceIndex = device.is_cpu() ? 0 : device.index();
+
+    std::vector<torch::Tensor> &buffers =
+        _buffers[keyType(shape.vec(), options.dtype().toScalarType(), device.type(), deviceIndex)];
+
+    _stats.nRequests++;
+
+    for (const torch::Tensor &buffer : buffers)
+    {
+        // if the arena holds the only reference to the memory then nothing else (user code, views, the autograd
+        // graph...) can see it any more and it's safe to hand out again
+        if (buffer.storage().use_count() == 1)
+        {
+            _stats.hits++;
+            _stats.bytesServed += buffer.nbytes();
+
+            // hand out a detached alias so that the returned tensor starts out with a fresh autograd history
+            return buffer.detach();
+        }
+    }
+
+    torch::Tensor buffer = at::empty(shape, options.requires_grad(false));
+    buffers.push_back(buffer);
+
+    _stats.misses++;
+    _stats.bytesServed += buffer.nbytes();
+    _stats.bytesAllocated += buffer.nbytes();
+
+    return buffer.detach();
+}
+
+void TensorArena::release()
+{
+    NT_PROFILE();
+
+    _buffers.clear();
+}
+
+size_t TensorArena::getBytesHeld() const
+{
+    size_t ret = 0;
+    for (const auto &[key, buffers] : _buffers)
+    {
+        for (const torch::Tensor &buffer : buffers)
+        {
+            ret += buffer.nbytes();
+        }
+    }
+
+    return ret;
+}
+
+size_t TensorArena::getNBuffers() const
+{
+    size_t ret = 0;
+    for (const auto &[key, buffers] : _buffers)
+    {
+        ret += buffers.size();
+    }
+
+    return ret;
+}
+
+std::string TensorArena::toString() const
+{
+    std::ostringstream stream;
+    stream << "TensorArena: " << _stats.nRequests << " requests, " << _stats.hits << " hits, " << _stats.misses
+           << " misses, " << _stats.bytesServed << " bytes served, " << _stats.bytesAllocated << " bytes allocated, "
+           << getBytesHeld() << " bytes held in " << getNBuffers() << " buffers";
+    return stream.str();
+}
@@ -1,5 +1,80 @@
 
+#include <nuTens/tensors/tensor-arena.hpp>
 #include <nuTens/tensors/tensor.hpp>
+#include <stdexcept>
+
+namespace
+{
+/// Get the TensorArena that the output of an operation on t1 and t2 should be written into.
+/// out= variants of operations can't be recorded by autograd so this only returns the active arena if no gradient needs
+/// to be tracked, otherwise (or if no arena is active) returns nullptr.
+TensorArena *getOutputArena(const torch::Tensor &t1, const torch::Tensor &t2)
+{
+    TensorArena *arena = TensorArena::getActive();
+    if (arena == nullptr || (torch::GradMode::is_enabled() && (t1.requires_grad() || t2.requires_grad())))
+    {
+        return nullptr;
+    }
+
+    return arena;
+}
+
+/// Get a buffer from the active TensorArena to hold the output of a broadcasted element-wise operation on t1 and t2.
+/// If promoteIntegral is set, integer results are promoted to the default floating point type (as in division).
+torch::Tensor getElementwiseOutput(TensorArena &arena, const torch::Tensor &t1, const torch::Tensor &t2,
+                                   bool promoteIntegral = false)
+{
+    c10::ScalarType outType = at::result_type(t1, t2);
+    if (promoteIntegral && c10::isIntegralType(outType, /*includeBool=*/true))
+    {
+        outType = c10::typeMetaToScalarType(at::get_default_dtype());
+    }
+
+    return arena.acquire(at::infer_size(t1.sizes(), t2.sizes()), t1.options().dtype(outType));
+}
+
+/// Convert a python style slice string "start:stop:step" to a Tensor::Slice, any of the parts can be left empty
+Tensor::Slice parseSlice(const std::string &str)
+{
+    std::vector<std::optional<long int>> parts;
+    size_t begin = 0;
+    while (true)
+    {
+        size_t end = str.find(':', begin);
+        std::string part = str.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+
+        try
+        {
+            parts.push_back(part.empty() ? std::nullopt : std::optional<long int>(std::stol(part)));
+        }
+        catch (const std::exception &)
+        {
+            NT_ERROR("Invalid index string: \"{}\"", str);
+            throw std::invalid_argument("Invalid index string: \"" + str + "\"");
+        }
+
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    if (parts.size() < 2 || parts.size() > 3)
+    {
+        NT_ERROR("Invalid index string: \"{}\", should be \"...\" or of the form \"start:stop:step\"", str);
+        throw std::invalid_argument("Invalid index string: \"" + str + "\"");
+    }
+
+    Tensor::Slice slice{parts[0], parts[1]};
+    if (parts.size() == 3 && parts[2].has_value())
+    {
+        slice.step = parts[2].value();
+    }
+
+    return slice;
+}
+} // namespace
 
 std::string Tensor::getTensorLibrary()
 {
@@ -19,6 +94,66 @@ Tensor::Tensor(const std::vector<float> &values, NTdtypes::scalarType type, NTdt
     _device = device;
 }
 
+template <typename T>
+Tensor Tensor::fromVector(const std::vector<T> &values, NTdtypes::deviceType device, bool requiresGrad)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::tensor(values, torch::TensorOptions()
+                                            .dtype(NTdtypes::scalarTypeMap.at(NTdtypes::scalarTypeOf<T>()))
+                                            .device(NTdtypes::deviceTypeMap.at(device))
+                                            .requires_grad(requiresGrad)));
+    return ret;
+}
+
+template Tensor Tensor::fromVector<int>(const std::vector<int> &, NTdtypes::deviceType, bool);
+template Tensor Tensor::fromVector<std::int64_t>(const std::vector<std::int64_t> &, NTdtypes::deviceType, bool);
+template Tensor Tensor::fromVector<float>(const std::vector<float> &, NTdtypes::deviceType, bool);
+template Tensor Tensor::fromVector<double>(const std::vector<double> &, NTdtypes::deviceType, bool);
+
+Tensor Tensor::fromBuffer(void *data, const std::vector<long int> &shape, const std::vector<long int> &strides,
+                          NTdtypes::scalarType type, const std::function<void(void *)> &deleter,
+                          NTdtypes::deviceType device, bool requiresGrad)
+{
+    NT_PROFILE();
+
+    std::vector<long int> bufferStrides = strides;
+    if (bufferStrides.empty())
+    {
+        // contiguous, row-major
+        bufferStrides.resize(shape.size());
+        long int stride = 1;
+        for (size_t i = shape.size(); i-- > 0;)
+        {
+            bufferStrides[i] = stride;
+            stride *= shape[i];
+        }
+    }
+    else if (bufferStrides.size() != shape.size())
+    {
+        NT_ERROR("Got {} strides for a buffer with {} dimensions", bufferStrides.size(), shape.size());
+        throw std::invalid_argument("Number of strides does not match the number of dimensions");
+    }
+
+    torch::TensorOptions options = torch::TensorOptions()
+                                       .dtype(NTdtypes::scalarTypeMap.at(type))
+                                       .device(NTdtypes::deviceTypeMap.at(device))
+                                       .requires_grad(requiresGrad);
+
+    Tensor ret;
+    if (deleter)
+    {
+        ret.setTensor(
+            torch::from_blob(data, c10::IntArrayRef(shape), c10::IntArrayRef(bufferStrides), deleter, options));
+    }
+    else
+    {
+        ret.setTensor(torch::from_blob(data, c10::IntArrayRef(shape), c10::IntArrayRef(bufferStrides), options));
+    }
+    return ret;
+}
+
 Tensor Tensor::eye(int n, NTdtypes::scalarType type, NTdtypes::deviceType device, bool requiresGrad)
 {
     NT_PROFILE();
@@ -67,10 +202,22 @@ Tensor Tensor::ones(const std::vector<long int> &shape, NTdtypes::scalarType typ
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(torch::ones(c10::IntArrayRef(shape), torch::TensorOptions()
-                                                           .dtype(NTdtypes::scalarTypeMap.at(type))
-                                                           .device(NTdtypes::deviceTypeMap.at(device))
-                                                           .requires_grad(requiresGrad)));
+    if (TensorArena *arena = TensorArena::getActive())
+    {
+        torch::Tensor buffer = arena->acquire(c10::IntArrayRef(shape), torch::TensorOptions()
+                                                                           .dtype(NTdtypes::scalarTypeMap.at(type))
+                                                                           .device(NTdtypes::deviceTypeMap.at(device)));
+        buffer.fill_(1);
+        buffer.set_requires_grad(requiresGrad);
+        ret.setTensor(buffer);
+    }
+    else
+    {
+        ret.setTensor(torch::ones(c10::IntArrayRef(shape), torch::TensorOptions()
+                                                               .dtype(NTdtypes::scalarTypeMap.at(type))
+                                                               .device(NTdtypes::deviceTypeMap.at(device))
+                                                               .requires_grad(requiresGrad)));
+    }
     ret._dType = type;
     ret._device = device;
     return ret;
@@ -82,7 +229,22 @@ Tensor Tensor::zeros(const std::vector<long int> &shape, NTdtypes::scalarType ty
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(torch::zeros(c10::IntArrayRef(shape), NTdtypes::scalarTypeMap.at(type)));
+    if (TensorArena *arena = TensorArena::getActive())
+    {
+        torch::Tensor buffer = arena->acquire(c10::IntArrayRef(shape), torch::TensorOptions()
+                                                                           .dtype(NTdtypes::scalarTypeMap.at(type))
+                                                                           .device(NTdtypes::deviceTypeMap.at(device)));
+        buffer.zero_();
+        buffer.set_requires_grad(requiresGrad);
+        ret.setTensor(buffer);
+    }
+    else
+    {
+        ret.setTensor(torch::zeros(c10::IntArrayRef(shape), torch::TensorOptions()
+                                                                .dtype(NTdtypes::scalarTypeMap.at(type))
+                                                                .device(NTdtypes::deviceTypeMap.at(device))
+                                                                .requires_grad(requiresGrad)));
+    }
     ret._dType = type;
     ret._device = device;
     return ret;
@@ -127,12 +289,73 @@ Tensor &Tensor::addBatchDim()
     return *this;
 }
 
+Tensor::Index::Index(const std::vector<entryType> &entries)
+{
+    NT_PROFILE();
+
+    _indices.reserve(entries.size());
+    for (const entryType &entry : entries)
+    {
+        if (const long int *index = std::get_if<long int>(&entry))
+        {
+            _indices.emplace_back(static_cast<int64_t>(*index));
+        }
+        else if (const Slice *slice = std::get_if<Slice>(&entry))
+        {
+            _indices.emplace_back(at::indexing::Slice(static_cast<int64_t>(slice->start.value_or(0)),
+                                                      static_cast<int64_t>(slice->stop.value_or(at::indexing::INDEX_MAX)),
+                                                      static_cast<int64_t>(slice->step)));
+        }
+        else
+        {
+            _indices.emplace_back(at::indexing::Ellipsis);
+        }
+    }
+}
+
+Tensor::Index Tensor::Index::parse(const std::vector<indexType> &indices)
+{
+    NT_PROFILE();
+
+    std::vector<entryType> entries;
+    entries.reserve(indices.size());
+    for (const indexType &index : indices)
+    {
+        if (const int *integer = std::get_if<int>(&index))
+        {
+            entries.emplace_back(static_cast<long int>(*integer));
+        }
+        else if (std::get<std::string>(index) == "...")
+        {
+            entries.emplace_back(ellipsis);
+        }
+        else
+        {
+            entries.emplace_back(parseSlice(std::get<std::string>(index)));
+        }
+    }
+
+    return Index(entries);
+}
+
+size_t Tensor::Index::size() const
+{
+    return _indices.size();
+}
+
 Tensor Tensor::getValues(const std::vector<Tensor::indexType> &indices) const
 {
     NT_PROFILE();
 
+    return getValues(Index::parse(indices));
+}
+
+Tensor Tensor::getValues(const Tensor::Index &index) const
+{
+    NT_PROFILE();
+
     Tensor ret;
-    ret.setTensor(_tensor.index(convertIndices(indices)));
+    ret.setTensor(_tensor.index(index._indices));
     return ret;
 }
 
@@ -157,6 +380,9 @@ Tensor::variantType Tensor::getVariantValue(const std::vector<int> &indices) con
     case NTdtypes::kComplexDouble:
         return (std::complex<double>)_tensor.index(convertIndices(indices)).item<c10::complex<double>>();
 
+    case NTdtypes::kLong:
+        return _tensor.index(convertIndices(indices)).item<std::int64_t>();
+
     default:
         NT_ERROR("Invalid dtype has been set for this tensor: {}", _dType);
         NT_ERROR("{}:{}", __FILE__, __LINE__);
@@ -175,7 +401,28 @@ void Tensor::setValue(const std::vector<Tensor::indexType> &indices, const Tenso
 {
     NT_PROFILE();
 
-    _tensor.index_put_(convertIndices(indices), value._tensor);
+    setValue(Index::parse(indices), value);
+}
+
+void Tensor::setValue(const Tensor::Index &index, const Tensor &value)
+{
+    NT_PROFILE();
+
+    _tensor.index_put_(index._indices, value._tensor);
+}
+
+void Tensor::setValue(const Tensor::Index &index, float value)
+{
+    NT_PROFILE();
+
+    _tensor.index_put_(index._indices, value);
+}
+
+void Tensor::setValue(const Tensor::Index &index, std::complex<float> value)
+{
+    NT_PROFILE();
+
+    _tensor.index_put_(index._indices, c10::complex<float>(value.real(), value.imag()));
 }
 
 void Tensor::setValue(const std::vector<int> &indices, float value)
@@ -192,11 +439,108 @@ void Tensor::setValue(const std::vector<int> &indices, std::complex<float> value
     _tensor.index_put_(convertIndices(indices), c10::complex<float>(value.real(), value.imag()));
 }
 
+Tensor Tensor::clone(bool keepHistory) const
+{
+    NT_PROFILE();
+
+    // nothing to copy
+    if (!_tensor.defined())
+    {
+        return *this;
+    }
+
+    Tensor ret;
+    if (keepHistory)
+    {
+        ret.setTensor(_tensor.clone());
+    }
+    else
+    {
+        ret.setTensor(_tensor.detach().clone().requires_grad_(_tensor.requires_grad()));
+    }
+    ret._hasBatchDim = _hasBatchDim;
+    return ret;
+}
+
+void *Tensor::dataPtr()
+{
+    NT_PROFILE();
+
+    return _tensor.data_ptr();
+}
+
+const void *Tensor::dataPtr() const
+{
+    NT_PROFILE();
+
+    return _tensor.data_ptr();
+}
+
+Tensor::Buffer Tensor::toBuffer() const
+{
+    NT_PROFILE();
+
+    // all of these are no-ops if the tensor is already in the right state
+    // n.b. conj() and negation can be lazy in pytorch so need to make sure they actually get applied to the memory
+    auto owner = std::make_shared<Tensor>();
+    owner->setTensor(_tensor.detach().to(torch::kCPU).resolve_conj().resolve_neg().contiguous());
+
+    Buffer ret;
+    ret.data = owner->dataPtr();
+    ret.shape = owner->_tensor.sizes().vec();
+    ret.strides = owner->_tensor.strides().vec();
+    ret.type = owner->getDType();
+    ret.owner = owner;
+    return ret;
+}
+
+bool Tensor::isContiguous() const
+{
+    NT_PROFILE();
+
+    return _tensor.is_contiguous();
+}
+
+std::vector<long int> Tensor::getStrides() const
+{
+    NT_PROFILE();
+
+    return _tensor.strides().vec();
+}
+
+NTdtypes::scalarType Tensor::getDType() const
+{
+    NT_PROFILE();
+
+    return NTdtypes::invScalarTypeMap.at(_tensor.scalar_type());
+}
+
+NTdtypes::deviceType Tensor::getDevice() const
+{
+    NT_PROFILE();
+
+    return NTdtypes::invDeviceTypeMap.at(_tensor.device().type());
+}
+
+bool Tensor::getRequiresGrad() const
+{
+    NT_PROFILE();
+
+    return _tensor.requires_grad();
+}
+
+size_t Tensor::getNumel() const
+{
+    NT_PROFILE();
+
+    return _tensor.numel();
+}
+
 size_t Tensor::getNdim() const
 {
     NT_PROFILE();
 
-    return _tensor._dimI();
+    return _tensor.dim();
 }
 
 int Tensor::getBatchDim() const
@@ -241,7 +585,15 @@ Tensor Tensor::mul(const Tensor &t1, const Tensor &t2)
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(torch::mul(t1._tensor, t2._tensor));
+    if (TensorArena *arena = getOutputArena(t1._tensor, t2._tensor))
+    {
+        torch::Tensor out = getElementwiseOutput(*arena, t1._tensor, t2._tensor);
+        ret.setTensor(torch::mul_out(out, t1._tensor, t2._tensor));
+    }
+    else
+    {
+        ret.setTensor(torch::mul(t1._tensor, t2._tensor));
+    }
     return ret;
 }
 
@@ -250,7 +602,15 @@ Tensor Tensor::div(const Tensor &t1, const Tensor &t2)
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(torch::div(t1._tensor, t2._tensor));
+    if (TensorArena *arena = getOutputArena(t1._tensor, t2._tensor))
+    {
+        torch::Tensor out = getElementwiseOutput(*arena, t1._tensor, t2._tensor, /*promoteIntegral=*/true);
+        ret.setTensor(torch::div_out(out, t1._tensor, t2._tensor));
+    }
+    else
+    {
+        ret.setTensor(torch::div(t1._tensor, t2._tensor));
+    }
     return ret;
 }
 
@@ -277,7 +637,33 @@ Tensor Tensor::exp(const Tensor &t)
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(torch::exp(t._tensor));
+    if (TensorArena *arena = getOutputArena(t._tensor, t._tensor))
+    {
+        torch::Tensor out = arena->acquire(t._tensor.sizes(), t._tensor.options());
+        ret.setTensor(torch::exp_out(out, t._tensor));
+    }
+    else
+    {
+        ret.setTensor(torch::exp(t._tensor));
+    }
+    return ret;
+}
+
+Tensor Tensor::log(const Tensor &t)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::log(t._tensor));
+    return ret;
+}
+
+Tensor Tensor::clamp(const Tensor &t, const Tensor &lower, const Tensor &upper)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::clamp(t._tensor, lower._tensor, upper._tensor));
     return ret;
 }
 
@@ -290,6 +676,82 @@ Tensor Tensor::transpose(const Tensor &t, int dim1, int dim2)
     return ret;
 }
 
+Tensor Tensor::reshape(const Tensor &t, const std::vector<long int> &shape)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::reshape(t._tensor, shape));
+    return ret;
+}
+
+Tensor Tensor::cat(const std::vector<Tensor> &tensors, int dim)
+{
+    NT_PROFILE();
+
+    std::vector<torch::Tensor> torchTensors;
+    torchTensors.reserve(tensors.size());
+    for (const Tensor &tensor : tensors)
+    {
+        torchTensors.push_back(tensor._tensor);
+    }
+
+    Tensor ret;
+    ret.setTensor(torch::cat(torchTensors, dim));
+    return ret;
+}
+
+Tensor Tensor::indexSelect(const Tensor &t, int dim, const Tensor &indices)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::index_select(t._tensor, dim, indices._tensor));
+    return ret;
+}
+
+Tensor Tensor::indexAdd(const Tensor &t, int dim, const Tensor &indices, const Tensor &source)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::index_add(t._tensor, dim, indices._tensor, source._tensor));
+    return ret;
+}
+
+Tensor Tensor::bucketize(const Tensor &values, const Tensor &boundaries, bool right)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::bucketize(values._tensor, boundaries._tensor, /*out_int32=*/true, right));
+    return ret;
+}
+
+Tensor Tensor::unique(const Tensor &t, Tensor &inverseIndices)
+{
+    NT_PROFILE();
+
+    const auto result =
+        torch::_unique2(t._tensor, /*sorted=*/true, /*return_inverse=*/true, /*return_counts=*/false);
+
+    // torch gives 64 bit indices, which nuTens doesn't have a type for
+    inverseIndices.setTensor(torch::reshape(std::get<1>(result), {-1}).to(torch::kInt));
+
+    Tensor ret;
+    ret.setTensor(std::get<0>(result));
+    return ret;
+}
+
+Tensor Tensor::unsqueeze(const Tensor &t, int dim)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::unsqueeze(t._tensor, dim));
+    return ret;
+}
+
 Tensor Tensor::scale(const Tensor &t, float s)
 {
     NT_PROFILE();
@@ -398,6 +860,42 @@ void Tensor::eig(const Tensor &t, Tensor &eVals, Tensor &eVecs)
     eVecs._tensor = std::get<0>(ret);
 }
 
+void Tensor::eigh(const Tensor &t, Tensor &eVals, Tensor &eVecs)
+{
+    NT_PROFILE();
+
+    auto ret = torch::linalg_eigh(t._tensor);
+    eVals.setTensor(std::get<0>(ret));
+    eVecs.setTensor(std::get<1>(ret));
+}
+
+Tensor Tensor::inverse(const Tensor &t)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::linalg_inv(t._tensor));
+    return ret;
+}
+
+Tensor Tensor::diagonal(const Tensor &t)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::diagonal(t._tensor, 0, -2, -1));
+    return ret;
+}
+
+Tensor Tensor::diagEmbed(const Tensor &t)
+{
+    NT_PROFILE();
+
+    Tensor ret;
+    ret.setTensor(torch::diag_embed(t._tensor));
+    return ret;
+}
+
 Tensor Tensor::real() const
 {
     NT_PROFILE();
@@ -465,7 +963,15 @@ Tensor Tensor::operator+(const Tensor &rhs) const
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(_tensor + rhs._tensor);
+    if (TensorArena *arena = getOutputArena(_tensor, rhs._tensor))
+    {
+        torch::Tensor out = getElementwiseOutput(*arena, _tensor, rhs._tensor);
+        ret.setTensor(torch::add_out(out, _tensor, rhs._tensor));
+    }
+    else
+    {
+        ret.setTensor(_tensor + rhs._tensor);
+    }
     return ret;
 }
 
@@ -474,7 +980,15 @@ Tensor Tensor::operator-(const Tensor &rhs) const
     NT_PROFILE();
 
     Tensor ret;
-    ret.setTensor(_tensor - rhs._tensor);
+    if (TensorArena *arena = getOutputArena(_tensor, rhs._tensor))
+    {
+        torch::Tensor out = getElementwiseOutput(*arena, _tensor, rhs._tensor);
+        ret.setTensor(torch::sub_out(out, _tensor, rhs._tensor));
+    }
+    else
+    {
+        ret.setTensor(_tensor - rhs._tensor);
+    }
     return ret;
 }
 
@@ -530,6 +1044,318 @@ Tensor Tensor::grad() const
     return ret;
 }
 
+bool Tensor::isGradEnabled()
+{
+    NT_PROFILE();
+
+    return torch::GradMode::is_enabled();
+}
+
+std::vector<Tensor> Tensor::gradients(const Tensor &output, const std::vector<Tensor> &inputs, const Tensor &gradOutput,
+                                      bool retainGraph, bool createGraph)
+{
+    NT_PROFILE();
+
+    // the tensor library refuses to differentiate with respect to tensors that don't require a gradient
+    torch::autograd::variable_list differentiable;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (inputs[i]._tensor.requires_grad())
+        {
+            differentiable.push_back(inputs[i]._tensor);
+            positions.push_back(i);
+        }
+    }
+
+    std::vector<Tensor> ret(inputs.size());
+    if (output._tensor.requires_grad() && !differentiable.empty())
+    {
+        torch::autograd::variable_list gradOutputs;
+        if (gradOutput._tensor.defined())
+        {
+            gradOutputs.push_back(gradOutput._tensor);
+        }
+
+        torch::autograd::variable_list grads = torch::autograd::grad({output._tensor}, differentiable, gradOutputs,
+                                                                     retainGraph, createGraph, /*allow_unused=*/true);
+        for (size_t i = 0; i < grads.size(); i++)
+        {
+            if (grads[i].defined())
+            {
+                ret[positions[i]].setTensor(grads[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (!ret[i]._tensor.defined())
+        {
+            ret[i].setTensor(torch::zeros_like(inputs[i]._tensor));
+        }
+    }
+
+    return ret;
+}
+
+namespace
+{
+// keeps the user supplied backward function (and what is needed to tidy up the gradients it returns) alive inside the
+// autograd graph
+struct CustomGradState : public torch::CustomClassHolder
+{
+    Tensor::forwardFnType forward;
+    Tensor::backwardFnType backward;
+    std::vector<std::vector<int64_t>> inputShapes;
+    std::vector<bool> inputIsComplex;
+};
+} // namespace
+
+struct Tensor::CustomGradFunction : public torch::autograd::Function<Tensor::CustomGradFunction>
+{
+    static torch::autograd::variable_list forward(torch::autograd::AutogradContext *ctx, at::TensorList inputs,
+                                                  const Tensor::forwardFnType &forwardFn,
+                                                  const Tensor::backwardFnType &backwardFn)
+    {
+        auto state = c10::make_intrusive<CustomGradState>();
+        state->forward = forwardFn;
+        state->backward = backwardFn;
+
+        std::vector<Tensor> nuInputs(inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            nuInputs[i].setTensor(inputs[i]);
+            state->inputShapes.push_back(inputs[i].sizes().vec());
+            state->inputIsComplex.push_back(inputs[i].is_complex());
+        }
+
+        std::vector<Tensor> saved;
+        std::vector<Tensor> outputs = forwardFn(nuInputs, saved);
+
+        // the inputs are kept as well in case forward needs to be re-run for higher derivatives, they're referenced by
+        // the graph anyway so this doesn't keep anything extra alive
+        torch::autograd::variable_list savedTensors(inputs.begin(), inputs.end());
+        savedTensors.reserve(inputs.size() + saved.size());
+        for (const Tensor &tensor : saved)
+        {
+            savedTensors.push_back(tensor._tensor);
+        }
+        ctx->save_for_backward(savedTensors);
+        ctx->saved_data["state"] = c10::IValue::make_capsule(std::move(state));
+
+        torch::autograd::variable_list ret;
+        ret.reserve(outputs.size());
+        for (const Tensor &output : outputs)
+        {
+            ret.push_back(output._tensor);
+        }
+        return ret;
+    }
+
+    static torch::autograd::variable_list backward(torch::autograd::AutogradContext *ctx,
+                                                   torch::autograd::variable_list gradOutputs)
+    {
+        const auto *state = static_cast<const CustomGradState *>(ctx->saved_data["state"].toCapsule().get());
+        const size_t nInputs = state->inputShapes.size();
+        const torch::autograd::variable_list savedVariables = ctx->get_saved_variables();
+
+        // the backward pass is being recorded so that it can be differentiated again, the hand written one only
+        // gives first derivatives so differentiate a recorded re-run of forward instead
+        if (torch::GradMode::is_enabled())
+        {
+            return recordedBackward(*state, savedVariables, gradOutputs);
+        }
+
+        std::vector<Tensor> saved(savedVariables.size() - nInputs);
+        for (size_t i = 0; i < saved.size(); i++)
+        {
+            saved[i].setTensor(savedVariables[nInputs + i]);
+        }
+
+        std::vector<Tensor> grads(gradOutputs.size());
+        for (size_t i = 0; i < gradOutputs.size(); i++)
+        {
+            if (gradOutputs[i].defined())
+            {
+                grads[i].setTensor(gradOutputs[i]);
+            }
+        }
+
+        std::vector<Tensor> inputGrads = state->backward(saved, grads);
+        if (inputGrads.size() != state->inputShapes.size())
+        {
+            NT_ERROR("Custom backward function returned {} gradients for {} inputs", inputGrads.size(),
+                     state->inputShapes.size());
+            throw std::runtime_error("Custom backward function returned the wrong number of gradients");
+        }
+
+        // one per input tensor, then nothing for the forward and backward functions
+        torch::autograd::variable_list ret(inputGrads.size() + 2);
+        for (size_t i = 0; i < inputGrads.size(); i++)
+        {
+            torch::Tensor grad = inputGrads[i]._tensor;
+            if (!grad.defined())
+            {
+                continue;
+            }
+
+            if (grad.is_complex() && !state->inputIsComplex[i])
+            {
+                grad = at::real(grad);
+            }
+
+            const std::vector<int64_t> &shape = state->inputShapes[i];
+            if (grad.sizes() != c10::IntArrayRef(shape))
+            {
+                grad = at::is_expandable_to(shape, grad.sizes()) ? at::sum_to(grad, shape) : grad.reshape(shape);
+            }
+
+            ret[i] = grad;
+        }
+
+        return ret;
+    }
+
+  private:
+    static torch::autograd::variable_list recordedBackward(const CustomGradState &state,
+                                                           const torch::autograd::variable_list &savedVariables,
+                                                           const torch::autograd::variable_list &gradOutputs)
+    {
+        const size_t nInputs = state.inputShapes.size();
+
+        std::vector<Tensor> inputs(nInputs);
+        torch::autograd::variable_list differentiable;
+        std::vector<size_t> positions;
+        for (size_t i = 0; i < nInputs; i++)
+        {
+            inputs[i].setTensor(savedVariables[i]);
+            if (savedVariables[i].requires_grad())
+            {
+                differentiable.push_back(savedVariables[i]);
+                positions.push_back(i);
+            }
+        }
+
+        std::vector<Tensor> unused;
+        std::vector<Tensor> outputs = state.forward(inputs, unused);
+
+        torch::autograd::variable_list torchOutputs;
+        torch::autograd::variable_list torchGradOutputs;
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            if (outputs[i]._tensor.requires_grad() && gradOutputs[i].defined())
+            {
+                torchOutputs.push_back(outputs[i]._tensor);
+                torchGradOutputs.push_back(gradOutputs[i]);
+            }
+        }
+
+        torch::autograd::variable_list ret(nInputs + 2);
+        if (torchOutputs.empty() || differentiable.empty())
+        {
+            return ret;
+        }
+
+        torch::autograd::variable_list grads =
+            torch::autograd::grad(torchOutputs, differentiable, torchGradOutputs, /*retain_graph=*/true,
+                                  /*create_graph=*/true, /*allow_unused=*/true);
+        for (size_t i = 0; i < grads.size(); i++)
+        {
+            ret[positions[i]] = grads[i];
+        }
+
+        return ret;
+    }
+};
+
+std::vector<Tensor> Tensor::customGrad(const std::vector<Tensor> &inputs, const forwardFnType &forward,
+                                       const backwardFnType &backward)
+{
+    NT_PROFILE();
+
+    std::vector<torch::Tensor> torchInputs;
+    torchInputs.reserve(inputs.size());
+    for (const Tensor &input : inputs)
+    {
+        torchInputs.push_back(input._tensor);
+    }
+
+    torch::autograd::variable_list outputs =
+        CustomGradFunction::apply(at::TensorList(torchInputs), forward, backward);
+
+    std::vector<Tensor> ret(outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+        ret[i].setTensor(outputs[i]);
+    }
+    return ret;
+}
+
+std::vector<Tensor> Tensor::checkpoint(const std::vector<Tensor> &inputs, const checkpointFnType &func)
+{
+    NT_PROFILE();
+
+    auto forward = [func](const std::vector<Tensor> &in, std::vector<Tensor> &saved) -> std::vector<Tensor> {
+        saved = in;
+        return func(in);
+    };
+
+    auto backward = [func](const std::vector<Tensor> &saved,
+                           const std::vector<Tensor> &gradOutputs) -> std::vector<Tensor> {
+        torch::AutoGradMode enableGrad(true);
+
+        // re-run on copies of the inputs which aren't connected to anything, so that the recording stops here
+        std::vector<Tensor> inputs(saved.size());
+        torch::autograd::variable_list differentiable;
+        std::vector<size_t> positions;
+        for (size_t i = 0; i < saved.size(); i++)
+        {
+            inputs[i].setTensor(saved[i]._tensor.detach());
+            if (saved[i]._tensor.requires_grad())
+            {
+                inputs[i]._tensor.requires_grad_(true);
+                differentiable.push_back(inputs[i]._tensor);
+                positions.push_back(i);
+            }
+        }
+
+        std::vector<Tensor> outputs = func(inputs);
+
+        torch::autograd::variable_list torchOutputs;
+        torch::autograd::variable_list torchGradOutputs;
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            if (outputs[i]._tensor.requires_grad() && gradOutputs[i]._tensor.defined())
+            {
+                torchOutputs.push_back(outputs[i]._tensor);
+                torchGradOutputs.push_back(gradOutputs[i]._tensor);
+            }
+        }
+
+        std::vector<Tensor> ret(saved.size());
+        if (torchOutputs.empty() || differentiable.empty())
+        {
+            return ret;
+        }
+
+        torch::autograd::variable_list grads =
+            torch::autograd::grad(torchOutputs, differentiable, torchGradOutputs, /*retain_graph=*/false,
+                                  /*create_graph=*/false, /*allow_unused=*/true);
+        for (size_t i = 0; i < grads.size(); i++)
+        {
+            if (grads[i].defined())
+            {
+                ret[positions[i]].setTensor(grads[i]);
+            }
+        }
+
+        return ret;
+    };
+
+    return customGrad(inputs, forward, backward);
+}
+
 Tensor Tensor::sin(const Tensor &t)
 {
     NT_PROFILE();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <nuTens/utils/bounded-queue.hpp>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * @file async-executor.hpp
+ * @brief Defines an executor that runs tasks in the background with a limited queue depth
+ */
+
+class AsyncExecutor
+{
+    /*!
+     * @class AsyncExecutor
+     * @brief Runs tasks on background threads, making submitters wait when too much work is queued up
+     *
+     * Tasks are run in the order they are submitted by a fixed number of worker threads. At most queueDepth tasks can
+     * be waiting to start at any one time, after that submit() blocks until a worker frees up a slot. This stops a
+     * fast producer (e.g. a loop reading batches of events) from running arbitrarily far ahead of the computation and
+     * filling up memory with batches waiting to be processed.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param nThreads The number of worker threads
+    /// @param queueDepth The maximum number of tasks that can be waiting to start
+    explicit AsyncExecutor(size_t nThreads = 1, size_t queueDepth = 2) : _queue(queueDepth)
+    {
+        nThreads = nThreads > 0 ? nThreads : 1;
+        _threads.reserve(nThreads);
+        for (size_t i = 0; i < nThreads; i++)
+        {
+            _threads.emplace_back([this]() {
+                while (std::optional<taskType> task = _queue.pop())
+                {
+                    (*task)();
+                }
+            });
+        }
+    }
+
+    /// @brief Destructor, waits for all submitted tasks to finish
+    ~AsyncExecutor()
+    {
+        _queue.close();
+        for (std::thread &thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    AsyncExecutor(const AsyncExecutor &) = delete;
+    AsyncExecutor &operator=(const AsyncExecutor &) = delete;
+    AsyncExecutor(AsyncExecutor &&) = delete;
+    AsyncExecutor &operator=(AsyncExecutor &&) = delete;
+
+    /// @brief Queue up a task, waiting for space in the queue if it is full
+    /// @param func The task to run
+    /// @return A future which will hold the result of the task (or any exception it threw)
+    template <typename F> std::future<std::invoke_result_t<F>> submit(F &&func)
+    {
+        using resultType = std::invoke_result_t<F>;
+
+        // std::function needs to be copyable but packaged_task isn't
+        auto task = std::make_shared<std::packaged_task<resultType()>>(std::forward<F>(func));
+        std::future<resultType> ret = task->get_future();
+
+        if (!_queue.push([task]() { (*task)(); }))
+        {
+            throw std::runtime_error("Can't submit a task to an AsyncExecutor that is shutting down");
+        }
+
+        return ret;
+    }
+
+    /// @brief Get the number of tasks waiting to start
+    [[nodiscard]] inline size_t getNQueued() const
+    {
+        return _queue.size();
+    }
+
+    /// @brief Get the maximum number of tasks that can be waiting to start
+    [[nodiscard]] inline size_t getQueueDepth() const
+    {
+        return _queue.getCapacity();
+    }
+
+  private:
+    using taskType = std::function<void()>;
+
+    BoundedQueue<taskType> _queue;
+    std::vector<std::thread> _threads;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/*!
+ * @file bounded-queue.hpp
+ * @brief Defines a thread safe queue with a maximum size
+ */
+
+template <typename T> class BoundedQueue
+{
+    /*!
+     * @class BoundedQueue
+     * @brief Thread safe first-in-first-out queue which can only hold a limited number of items
+     *
+     * push() blocks while the queue is full, so a producer that gets too far ahead of its consumers is made to wait
+     * for them (back-pressure) rather than piling up an unlimited amount of work. pop() blocks while the queue is
+     * empty. Once close() has been called no more items can be pushed, and pop() returns an empty optional as soon as
+     * the queue has been drained, which lets consumers know that they can stop.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param capacity The maximum number of items the queue can hold at once, must be at least 1
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+    BoundedQueue(BoundedQueue &&) = delete;
+    BoundedQueue &operator=(BoundedQueue &&) = delete;
+    ~BoundedQueue() = default;
+
+    /// @brief Add an item to the back of the queue, waiting for space if the queue is full
+    /// @return false if the queue was closed, in which case the item is dropped
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+        if (_closed)
+        {
+            return false;
+        }
+
+        _items.push_back(std::move(item));
+        lock.unlock();
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /// @brief Add an item to the back of the queue if there is space, without waiting
+    /// @return Whether the item was added
+    bool tryPush(T &item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_closed || _items.size() >= _capacity)
+        {
+            return false;
+        }
+
+        _items.push_back(std::move(item));
+        lock.unlock();
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /// @brief Take the item from the front of the queue, waiting for one if the queue is empty
+    /// @return The item, or nothing if the queue has been closed and there are no items left
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this]() { return _closed || !_items.empty(); });
+        if (_items.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::optional<T> ret(std::move(_items.front()));
+        _items.pop_front();
+        lock.unlock();
+        _notFull.notify_one();
+        return ret;
+    }
+
+    /// @brief Stop any more items from being added and wake up everyone waiting on the queue
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _notFull.notify_all();
+        _notEmpty.notify_all();
+    }
+
+    /// @brief Get the number of items currently in the queue
+    [[nodiscard]] size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+    /// @brief Get the maximum number of items the queue can hold
+    [[nodiscard]] inline size_t getCapacity() const
+    {
+        return _capacity;
+    }
+
+    /// @brief Check whether close() has been called
+    [[nodiscard]] bool isClosed() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _closed;
+    }
+
+  private:
+    const size_t _capacity;
+    std::deque<T> _items;
+    bool _closed = false;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _notFull;
+    std::condition_variable _notEmpty;
+};
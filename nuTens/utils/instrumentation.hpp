@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -113,9 +114,12 @@ class ProfileWriter
     }
 
     /// @brief Write out the results of a profiled function
+    /// @details Can be called from multiple threads at once
     /// @param[in] result The result to write
     void writeProfile(const ProfileResult &result)
     {
+        std::lock_guard<std::mutex> lock(_mutex);
+
         if (_profileCount++ > 0)
         {
             _outputStream << ",";
@@ -163,6 +167,7 @@ class ProfileWriter
     std::string _name;
     std::ofstream _outputStream;
     uint _profileCount{0};
+    std::mutex _mutex;
 };
 
 class InstrumentationTimer
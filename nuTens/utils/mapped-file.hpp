@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <nuTens/utils/logging.hpp>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*!
+ * @file mapped-file.hpp
+ * @brief Defines a read-only view of a file that has been mapped into memory
+ */
+
+class MappedFile
+{
+    /*!
+     * @class MappedFile
+     * @brief Maps a whole file into memory for as long as the object is alive
+     *
+     * The mapping is private and copy-on-write. Pages are loaded lazily and, as long as nobody writes to them, are
+     * shared by the page cache between every process that maps the same file. Writing to the mapped memory is allowed
+     * but only ever modifies a private copy of the affected pages, never the file itself.
+     */
+
+  public:
+    /// @brief Map a file into memory
+    /// @param path The file to map
+    explicit MappedFile(const std::string &path) : _path(path)
+    {
+#if defined(_WIN32)
+        _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+        if (_file == INVALID_HANDLE_VALUE)
+        {
+            fail("could not open file");
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(_file, &fileSize))
+        {
+            fail("could not get size of file");
+        }
+        _size = static_cast<size_t>(fileSize.QuadPart);
+
+        if (_size > 0)
+        {
+            _mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            if (_mapping == nullptr)
+            {
+                fail("could not create file mapping");
+            }
+
+            _data = MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+            if (_data == nullptr)
+            {
+                fail("could not map view of file");
+            }
+        }
+#else
+        _fd = ::open(path.c_str(), O_RDONLY);
+        if (_fd < 0)
+        {
+            fail("could not open file");
+        }
+
+        struct stat fileStat
+        {
+        };
+        if (::fstat(_fd, &fileStat) != 0)
+        {
+            fail("could not get size of file");
+        }
+        _size = static_cast<size_t>(fileStat.st_size);
+
+        // mmap refuses zero length mappings
+        if (_size > 0)
+        {
+            _data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+            if (_data == MAP_FAILED) // NOLINT
+            {
+                _data = nullptr;
+                fail("could not map file");
+            }
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        ::close(_fd);
+        _fd = -1;
+#endif
+    }
+
+    ~MappedFile()
+    {
+        unmap();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+
+    /// @brief Get a pointer to the start of the mapped file
+    [[nodiscard]] inline void *data() const
+    {
+        return _data;
+    }
+
+    /// @brief Get the size of the mapped file in bytes
+    [[nodiscard]] inline size_t size() const
+    {
+        return _size;
+    }
+
+    /// @brief Get the path of the mapped file
+    [[nodiscard]] inline const std::string &getPath() const
+    {
+        return _path;
+    }
+
+  private:
+    void unmap()
+    {
+#if defined(_WIN32)
+        if (_data != nullptr)
+        {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping != nullptr)
+        {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(_file);
+        }
+        _mapping = nullptr;
+        _file = INVALID_HANDLE_VALUE;
+#else
+        if (_data != nullptr)
+        {
+            ::munmap(_data, _size);
+        }
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        _fd = -1;
+#endif
+        _data = nullptr;
+    }
+
+    [[noreturn]] void fail(const std::string &what)
+    {
+        unmap();
+        NT_ERROR("MappedFile: {}: {}", what, _path);
+        throw std::runtime_error("MappedFile: " + what + ": " + _path);
+    }
+
+    std::string _path;
+    void *_data = nullptr;
+    size_t _size = 0;
+
+#if defined(_WIN32)
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
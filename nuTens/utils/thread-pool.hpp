@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * @file thread-pool.hpp
+ * @brief Defines a work-stealing pool of threads
+ */
+
+class ThreadPool
+{
+    /*!
+     * @class ThreadPool
+     * @brief Work-stealing pool of worker threads
+     *
+     * Every worker has its own queue of tasks. Workers take tasks from the front of their own queue and, once that is
+     * empty, steal from the back of the other workers' queues. This keeps neighbouring tasks (which tend to touch
+     * neighbouring memory) on the same worker while still balancing the load when some tasks take longer than others.
+     *
+     * The easiest way to use the pool is parallelFor():
+     * \code{.cpp}
+     *   ThreadPool pool;
+     *   pool.parallelFor(nChunks, [&](size_t chunk) { processChunk(chunk); });
+     * \endcode
+     * The calling thread helps to process tasks while it waits, so parallelFor() can safely be called from inside a
+     * task that is itself running on the pool.
+     */
+
+  public:
+    /// @brief Constructor
+    /// @param nThreads The number of worker threads, if 0 uses one per hardware thread
+    /// @param workerInit If set, each worker calls this with its index (in [0, nThreads)) before running any tasks.
+    /// Can be used to e.g. pin the workers to particular cores using RuntimeConfig::pinWorker().
+    explicit ThreadPool(size_t nThreads = 0, std::function<void(size_t)> workerInit = {})
+        : _workerInit(std::move(workerInit))
+    {
+        if (nThreads == 0)
+        {
+            nThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        for (size_t i = 0; i < nThreads; i++)
+        {
+            _queues.push_back(std::make_unique<WorkQueue>());
+        }
+
+        _threads.reserve(nThreads);
+        for (size_t i = 0; i < nThreads; i++)
+        {
+            _threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    /// @brief Destructor, finishes any tasks that are still queued then stops the workers
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+
+        for (std::thread &thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    /// @brief Get the number of worker threads in the pool
+    [[nodiscard]] inline size_t getNThreads() const
+    {
+        return _threads.size();
+    }
+
+    /// @brief Queue up a single task to be run by the pool
+    /// @param func The task to run
+    /// @return A future which will hold the result of the task (or any exception it threw)
+    template <typename F> std::future<std::invoke_result_t<F>> submit(F &&func)
+    {
+        using resultType = std::invoke_result_t<F>;
+
+        // std::function needs to be copyable but packaged_task isn't
+        auto task = std::make_shared<std::packaged_task<resultType()>>(std::forward<F>(func));
+        std::future<resultType> ret = task->get_future();
+
+        push(_nextQueue++ % _queues.size(), [task]() { (*task)(); });
+        return ret;
+    }
+
+    /// @brief Call func(i) for every i in [0, nTasks) using the pool, and wait for all of them to finish
+    /// @details Contiguous ranges of i are handed to the same worker. If any of the calls throw, the first exception is
+    /// rethrown here once all the calls have finished.
+    /// @param nTasks The number of tasks
+    /// @param func The function to call
+    template <typename F> void parallelFor(size_t nTasks, const F &func)
+    {
+        if (nTasks == 0)
+        {
+            return;
+        }
+
+        // shared with the tasks so that it stays alive until the last of them has finished with it
+        auto state = std::make_shared<ForState>();
+        state->remaining = nTasks;
+
+        const size_t nQueues = _queues.size();
+        for (size_t i = 0; i < nTasks; i++)
+        {
+            push((i * nQueues) / nTasks, [state, &func, i]() {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->error)
+                    {
+                        state->error = std::current_exception();
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (--state->remaining == 0)
+                {
+                    state->done.notify_all();
+                }
+            });
+        }
+
+        // help out rather than just sitting around waiting
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                if (state->remaining == 0)
+                {
+                    break;
+                }
+            }
+
+            if (!runPendingTask(_workerIndex))
+            {
+                // everything left is already being worked on
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->done.wait(lock, [&state]() { return state->remaining == 0; });
+                break;
+            }
+        }
+
+        if (state->error)
+        {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+  private:
+    using taskType = std::function<void()>;
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<taskType> tasks;
+    };
+
+    struct ForState
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining = 0;
+        std::exception_ptr error;
+    };
+
+    void push(size_t queue, taskType task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _nPending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+            _queues[queue]->tasks.push_back(std::move(task));
+        }
+        _wake.notify_one();
+    }
+
+    // take a task from the front of our own queue, or failing that the back of someone else's, and run it
+    bool runPendingTask(size_t ownQueue)
+    {
+        taskType task;
+        const size_t nQueues = _queues.size();
+        for (size_t offset = 0; offset < nQueues && !task; offset++)
+        {
+            WorkQueue &queue = *_queues[(ownQueue + offset) % nQueues];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+
+            if (offset == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+        }
+
+        if (!task)
+        {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _nPending--;
+        }
+        task();
+        return true;
+    }
+
+    void workerLoop(size_t index)
+    {
+        _workerIndex = index;
+
+        if (_workerInit)
+        {
+            _workerInit(index);
+        }
+
+        while (true)
+        {
+            if (runPendingTask(index))
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            _wake.wait(lock, [this]() { return _stop || _nPending > 0; });
+            if (_stop && _nPending == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    std::function<void(size_t)> _workerInit;
+    std::vector<std::unique_ptr<WorkQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    size_t _nPending = 0;
+    bool _stop = false;
+
+    std::atomic<size_t> _nextQueue{0};
+
+    // the queue belonging to the current thread, threads outside the pool just start looking from the first one
+    static inline thread_local size_t _workerIndex = 0;
+};
@@ -1,31 +1,60 @@
 // pybind11 stuff
 #include <pybind11/complex.h>
+#include <pybind11/functional.h>
 #include <pybind11/operators.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <chrono>
+#include <future>
 #include <vector>
 
 // nuTens stuff
+#include <nuTens/fitting/curvature.hpp>
+#include <nuTens/fitting/fitter.hpp>
+#include <nuTens/fitting/grid-scan.hpp>
+#include <nuTens/fitting/hmc-sampler.hpp>
+#include <nuTens/fitting/likelihood.hpp>
+#include <nuTens/fitting/minimiser.hpp>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/io/event-file.hpp>
+#include <nuTens/io/streaming-reweighter.hpp>
 #include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/layered-propagator.hpp>
+#include <nuTens/propagator/probability-interpolant.hpp>
 #include <nuTens/propagator/propagator.hpp>
+#include <nuTens/rates/event-rate-calculator.hpp>
+#include <nuTens/rates/histogram.hpp>
+#include <nuTens/rates/smearer.hpp>
+#include <nuTens/tensors/banded-matrix.hpp>
 #include <nuTens/tensors/dtypes.hpp>
+#include <nuTens/tensors/runtime-config.hpp>
 #include <nuTens/tensors/tensor.hpp>
 
 namespace py = pybind11;
 
 void initTensor(py::module & /*m*/);
+void initTensorBuffers(py::class_<Tensor> & /*tensorClass*/, py::module & /*m_tensor*/);
 void initPropagator(py::module & /*m*/);
 void initDtypes(py::module & /*m*/);
+void initRuntime(py::module & /*m*/);
+void initFitting(py::module & /*m*/);
+void initRates(py::module & /*m*/);
+void initIO(py::module & /*m*/);
 
 // initialise the top level module "_pyNuTens"
 // NOLINTNEXTLINE
 PYBIND11_MODULE(_pyNuTens, m)
 {
     m.doc() = "Library to calculate neutrino oscillations";
+    // dtypes need to be registered first as they're used as default arguments
+    initDtypes(m);
     initTensor(m);
     initPropagator(m);
-    initDtypes(m);
+    initRuntime(m);
+    initFitting(m);
+    initRates(m);
+    initIO(m);
 
 #ifdef VERSION_INFO
     m.attr("__version__") = Py_STRINGIFY(VERSION_INFO);
@@ -38,7 +67,9 @@ void initTensor(py::module &m)
 {
     auto m_tensor = m.def_submodule("tensor");
 
-    py::class_<Tensor>(m_tensor, "Tensor")
+    auto tensorClass = py::class_<Tensor>(m_tensor, "Tensor", py::buffer_protocol());
+
+    tensorClass
         .def(py::init()) // <- default constructor
         .def(py::init<std::vector<float>, NTdtypes::scalarType, NTdtypes::deviceType, bool>())
 
@@ -65,12 +96,24 @@ void initTensor(py::module &m)
              "Set a value at a specific index of this tensor")
         .def("set_value", py::overload_cast<const std::vector<int> &, std::complex<float>>(&Tensor::setValue),
              "Set a value at a specific index of this tensor")
+        .def("set_value", py::overload_cast<const Tensor::Index &, const Tensor &>(&Tensor::setValue),
+             "Set the values at a precompiled index of this tensor")
+        .def("set_value", py::overload_cast<const Tensor::Index &, float>(&Tensor::setValue),
+             "Set the values at a precompiled index of this tensor")
+        .def("set_value", py::overload_cast<const Tensor::Index &, std::complex<float>>(&Tensor::setValue),
+             "Set the values at a precompiled index of this tensor")
 
         // getters
         .def("get_shape", &Tensor::getShape, "Get the shape of this tensor")
-        .def("get_values", &Tensor::getValues, "Get the subset of values in this tensor at a specified location")
+        .def("get_values", py::overload_cast<const std::vector<Tensor::indexType> &>(&Tensor::getValues, py::const_),
+             "Get the subset of values in this tensor at a specified location")
+        .def("get_values", py::overload_cast<const Tensor::Index &>(&Tensor::getValues, py::const_),
+             "Get the subset of values in this tensor at a precompiled index")
         .def("get_value", &Tensor::getVariantValue, "Get the data stored at a particular index of the tensor")
 
+        // serialisation
+        .def("save", &Tensor::save, py::arg("path"), "Write this tensor to a file that can be read using load()")
+
         // complex number stuff
         .def("real", &Tensor::real, "Get real part of a complex tensor")
         .def("imag", &Tensor::imag, "Get imaginary part of a complex tensor")
@@ -88,12 +131,37 @@ void initTensor(py::module &m)
 
     ; // end of Tensor non-static functions
 
+    initTensorBuffers(tensorClass, m_tensor);
+
+    py::class_<Tensor::Index>(m_tensor, "Index")
+        .def(py::init(&Tensor::Index::parse),
+             "Precompile a set of indices (ints, \"...\" or \"start:stop:step\" strings) to be reused")
+        .def("__len__", &Tensor::Index::size);
+
+    py::class_<BandedMatrix>(m_tensor, "BandedMatrix")
+        .def(py::init<const Tensor &, const std::vector<long int> &, long int>(), py::arg("values"),
+             py::arg("first_columns"), py::arg("n_columns"),
+             "Make a matrix from the values in the band of each row and the column that each band starts at")
+        .def_static("from_dense", &BandedMatrix::fromDense, py::arg("dense"), py::arg("threshold") = 0.0,
+                    "Make a banded matrix holding all entries of a dense matrix bigger than the threshold")
+        .def("apply", &BandedMatrix::apply, py::arg("vectors"), py::call_guard<py::gil_scoped_release>(),
+             "Multiply a batch of vectors, with the columns along the last dimension, by the matrix")
+        .def("to_dense", &BandedMatrix::toDense, "Get the full matrix, with zeros outside of the band")
+        .def("get_values", &BandedMatrix::getValues, "Get the values in the band of each row")
+        .def("get_first_columns", &BandedMatrix::getFirstColumns, "Get the column that the band of each row starts at")
+        .def("get_n_rows", &BandedMatrix::getNRows, "Get the number of rows")
+        .def("get_n_columns", &BandedMatrix::getNColumns, "Get the number of columns")
+        .def("get_width", &BandedMatrix::getWidth, "Get the number of values stored in each row");
+
     // Tensor creation functions
     m_tensor.def("eye", &Tensor::eye, "Create a tensor initialised with an identity matrix");
     m_tensor.def("rand", &Tensor::rand, "Create a tensor initialised with random values");
     m_tensor.def("diag", &Tensor::diag, "Create a tensor with specified values along the diagonal");
     m_tensor.def("ones", &Tensor::ones, "Create a tensor initialised with ones");
     m_tensor.def("zeros", &Tensor::zeros, "Create a tensor initialised with zeros");
+    m_tensor.def("load", &Tensor::load, py::arg("path"), py::arg("memory_map") = true,
+                 py::arg("device") = NTdtypes::kCPU, py::arg("requires_grad") = false,
+                 "Read a tensor from a file written by Tensor.save(), optionally memory mapping it");
 
     // maffs
     m_tensor.def("matmul", &Tensor::matmul, "Matrix multiplication");
@@ -118,14 +186,145 @@ void initTensor(py::module &m)
     // tuple of values
 }
 
+// get the python buffer format string corresponding to a nuTens scalar type
+std::string getBufferFormat(NTdtypes::scalarType type)
+{
+    switch (type)
+    {
+    case NTdtypes::kInt:
+        return py::format_descriptor<int>::format();
+    case NTdtypes::kFloat:
+        return py::format_descriptor<float>::format();
+    case NTdtypes::kDouble:
+        return py::format_descriptor<double>::format();
+    case NTdtypes::kComplexFloat:
+        return py::format_descriptor<std::complex<float>>::format();
+    case NTdtypes::kComplexDouble:
+        return py::format_descriptor<std::complex<double>>::format();
+    case NTdtypes::kLong:
+        return py::format_descriptor<std::int64_t>::format();
+    default:
+        throw py::type_error("Tensor has a type that can't be exported to a python buffer");
+    }
+}
+
+// get the nuTens scalar type corresponding to a python buffer
+NTdtypes::scalarType getBufferType(const py::buffer_info &info)
+{
+    for (NTdtypes::scalarType type : {NTdtypes::kInt, NTdtypes::kFloat, NTdtypes::kDouble, NTdtypes::kComplexFloat,
+                                      NTdtypes::kComplexDouble, NTdtypes::kLong})
+    {
+        if (info.format == getBufferFormat(type))
+        {
+            return type;
+        }
+    }
+
+    // different platforms can use different format characters for the same integer type
+    if (info.item_type_is_equivalent_to<int>())
+    {
+        return NTdtypes::kInt;
+    }
+    if (info.item_type_is_equivalent_to<std::int64_t>())
+    {
+        return NTdtypes::kLong;
+    }
+
+    throw py::type_error("Buffers with format \"" + info.format + "\" can't be used to construct a Tensor");
+}
+
+void initTensorBuffers(py::class_<Tensor> &tensorClass, py::module &m_tensor)
+{
+    // lets python view the memory of contiguous cpu tensors without copying e.g. using numpy.asarray(tensor)
+    tensorClass.def_buffer([](Tensor &tensor) -> py::buffer_info {
+        if (tensor.getDevice() != NTdtypes::kCPU || !tensor.isContiguous())
+        {
+            throw py::buffer_error("Only contiguous tensors that live on the cpu can be viewed as a buffer");
+        }
+
+        const auto itemSize = (py::ssize_t)NTdtypes::scalarTypeSize(tensor.getDType());
+        std::vector<py::ssize_t> strides;
+        for (long int stride : tensor.getStrides())
+        {
+            strides.push_back(stride * itemSize);
+        }
+
+        const std::vector<int> shape = tensor.getShape();
+        return py::buffer_info(tensor.dataPtr(), itemSize, getBufferFormat(tensor.getDType()), (py::ssize_t)shape.size(),
+                               std::vector<py::ssize_t>(shape.begin(), shape.end()), strides);
+    });
+
+    // wraps python memory (e.g. a numpy array) in a tensor without copying
+    m_tensor.def(
+        "from_buffer",
+        [](const py::buffer &buffer, bool requiresGrad) {
+            // the buffer_info holds on to the python buffer, so the memory stays valid until the tensor is deleted
+            auto info = std::make_shared<py::buffer_info>(buffer.request());
+
+            std::vector<long int> strides;
+            for (py::ssize_t stride : info->strides)
+            {
+                if (stride % info->itemsize != 0)
+                {
+                    throw py::value_error("Buffer strides must be a multiple of the item size");
+                }
+                strides.push_back(stride / info->itemsize);
+            }
+
+            return Tensor::fromBuffer(
+                info->ptr, std::vector<long int>(info->shape.begin(), info->shape.end()), strides, getBufferType(*info),
+                [info](void * /*data*/) mutable {
+                    py::gil_scoped_acquire gil;
+                    info.reset();
+                },
+                NTdtypes::kCPU, requiresGrad);
+        },
+        py::arg("buffer"), py::arg("requires_grad") = false,
+        "Create a tensor that uses the memory of a python buffer (e.g. a numpy array) without copying it");
+}
+
 void initPropagator(py::module &m)
 {
     auto m_propagator = m.def_submodule("propagator");
 
-    py::class_<Propagator>(m_propagator, "Propagator")
+    py::class_<std::shared_future<Tensor>>(m_propagator, "TensorFuture")
+        .def(
+            "get", [](const std::shared_future<Tensor> &future) { return future.get(); },
+            py::call_guard<py::gil_scoped_release>(), "Wait for the result and return it")
+        .def(
+            "ready",
+            [](const std::shared_future<Tensor> &future) {
+                return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            },
+            "Check whether the result is available yet");
+
+    // held by a shared_ptr so that it can be shared with e.g. an EventRateCalculator, and changes made to it are seen
+    py::class_<Propagator, std::shared_ptr<Propagator>>(m_propagator, "Propagator")
         .def(py::init<int, float>())
-        .def("calculate_probabilities", &Propagator::calculateProbs,
-             "Calculate the oscillation probabilities for neutrinos of specified energies")
+        .def("calculate_probabilities", &Propagator::calculateProbs, py::call_guard<py::gil_scoped_release>(),
+             "Calculate the oscillation probabilities for neutrinos of specified energies. Thread safe.")
+        .def("calculate_channel_probabilities", &Propagator::calculateChannelProbs, py::arg("energies"),
+             py::arg("initial_flavours"), py::arg("final_flavours"), py::call_guard<py::gil_scoped_release>(),
+             "Calculate the probability of just one channel for each neutrino. Thread safe.")
+        .def("clone", &Propagator::clone, "Get a copy of this propagator that can be modified independently")
+        .def("jacobian", &Propagator::jacobian,
+             "Get the derivatives of every probability with respect to a list of parameter tensors, with shape "
+             "[n_energies, n_generations * n_generations, n_params]")
+        .def(
+            "calculate_probabilities_async",
+            [](const Propagator &propagator, const Tensor &energies) {
+                return propagator.calculateProbsAsync(energies).share();
+            },
+            py::call_guard<py::gil_scoped_release>(),
+            "Start calculating the oscillation probabilities in the background, returns a TensorFuture")
+        .def("set_analytic_gradients", &Propagator::setAnalyticGradients,
+             "Set whether to use the analytic backward pass when calculating gradients")
+        .def("set_deduplicate_energies", &Propagator::setDeduplicateEnergies,
+             "Set whether to do the calculation only once for each distinct energy")
+        .def("set_cache_size", &Propagator::setCacheSize, py::arg("max_bytes"),
+             "Set how much memory can be used to remember recent results of calculate_probabilities, 0 turns it off")
+        .def("get_cache_stats", &Propagator::getCacheStats, "Get the hit rate and memory use of the result cache")
+        .def("clear_cache", &Propagator::clearCache, "Drop everything held by the result cache")
         .def("set_matter_solver", &Propagator::setMatterSolver,
              "Set the matter effect solver that the propagator should use")
         .def("set_masses", &Propagator::setMasses, "Set the neutrino mass state eigenvalues")
@@ -136,11 +335,61 @@ void initPropagator(py::module &m)
         .def("set_PMNS", py::overload_cast<const std::vector<int> &, std::complex<float>>(&Propagator::setPMNS),
              "Set the PMNS matrix that the propagator should use");
 
+    py::class_<ProbabilityCache::Stats>(m_propagator, "ProbabilityCacheStats")
+        .def_readonly("hits", &ProbabilityCache::Stats::hits, "Number of lookups that found a stored result")
+        .def_readonly("misses", &ProbabilityCache::Stats::misses, "Number of lookups that had to be calculated")
+        .def_readonly("bypassed", &ProbabilityCache::Stats::bypassed,
+                      "Number of calculations that skipped the cache because gradients were needed")
+        .def_readonly("evictions", &ProbabilityCache::Stats::evictions,
+                      "Number of results dropped to stay within the memory limit")
+        .def_readonly("n_entries", &ProbabilityCache::Stats::nEntries, "Number of results currently stored")
+        .def_readonly("bytes", &ProbabilityCache::Stats::bytes, "Total size of the stored results")
+        .def_readonly("max_bytes", &ProbabilityCache::Stats::maxBytes, "Most memory the stored results can take up")
+        .def("get_hit_rate", &ProbabilityCache::Stats::getHitRate, "Get the fraction of lookups that hit");
+
+    py::class_<LayeredPropagator>(m_propagator, "LayeredPropagator")
+        .def(py::init<int>())
+        .def("calculate_probabilities", &LayeredPropagator::calculateProbs, py::call_guard<py::gil_scoped_release>(),
+             "Calculate the oscillation probabilities for neutrinos of specified energies crossing all the layers")
+        .def("set_layers", py::overload_cast<const std::vector<float> &, const Tensor &>(&LayeredPropagator::setLayers),
+             py::arg("lengths"), py::arg("densities"), "Set the length and electron density of each layer")
+        .def("set_layers",
+             py::overload_cast<const std::vector<float> &, const std::vector<float> &>(&LayeredPropagator::setLayers),
+             py::arg("lengths"), py::arg("densities"), "Set the length and electron density of each layer")
+        .def("set_checkpoint_interval", &LayeredPropagator::setCheckpointInterval,
+             "Set the number of layers per checkpointed segment, trading memory for recomputation when calculating "
+             "gradients. 0 turns checkpointing off")
+        .def("set_masses", &LayeredPropagator::setMasses, "Set the neutrino mass state eigenvalues")
+        .def("set_PMNS", &LayeredPropagator::setPMNS, "Set the PMNS matrix that the propagator should use")
+        .def("get_n_layers", &LayeredPropagator::getNLayers, "Get the number of layers");
+
+    py::class_<ProbabilityInterpolant>(m_propagator, "ProbabilityInterpolant")
+        .def(py::init<const Propagator &, float, float, float, int, int>(), py::arg("propagator"),
+             py::arg("min_energy"), py::arg("max_energy"), py::arg("tolerance"), py::arg("n_initial_points") = 16,
+             py::arg("max_points_per_channel") = 4096, py::call_guard<py::gil_scoped_release>(),
+             "Build a table of the probabilities of the propagator, refining the energy grid of each channel until "
+             "the interpolation error is below the tolerance")
+        .def("calculate_probabilities", &ProbabilityInterpolant::calculateProbs,
+             py::call_guard<py::gil_scoped_release>(), "Interpolate the probabilities of every channel")
+        .def("calculate_channel_probabilities", &ProbabilityInterpolant::calculateChannelProbs,
+             py::call_guard<py::gil_scoped_release>(), py::arg("energies"), py::arg("initial_flavours"),
+             py::arg("final_flavours"), "Interpolate the probability of a single channel for each neutrino")
+        .def("get_n_points", &ProbabilityInterpolant::getNPoints, py::arg("initial_flavour"),
+             py::arg("final_flavour"), "Get the number of points in the grid of one channel")
+        .def("is_converged", &ProbabilityInterpolant::isConverged,
+             "Check whether every interval met the tolerance without running out of points")
+        .def("get_tolerance", &ProbabilityInterpolant::getTolerance, "Get the interpolation tolerance")
+        .def("get_min_energy", &ProbabilityInterpolant::getMinEnergy, "Get the lowest energy in the table")
+        .def("get_max_energy", &ProbabilityInterpolant::getMaxEnergy, "Get the highest energy in the table");
+
     py::class_<BaseMatterSolver, std::shared_ptr<BaseMatterSolver>>(m_propagator, "BaseSolver");
 
     py::class_<ConstDensityMatterSolver, std::shared_ptr<ConstDensityMatterSolver>, BaseMatterSolver>(
         m_propagator, "ConstDensitySolver")
-        .def(py::init<int, float>());
+        .def(py::init<int, float>())
+        .def("set_density", &ConstDensityMatterSolver::setDensity,
+             "Set the electron density using a tensor, e.g. to get gradients with respect to it")
+        .def("get_density", &ConstDensityMatterSolver::getDensity, "Get the tensor holding the electron density");
 }
 
 void initDtypes(py::module &m)
@@ -153,6 +402,7 @@ void initDtypes(py::module &m)
         .value("double", NTdtypes::scalarType::kDouble)
         .value("complex_float", NTdtypes::scalarType::kComplexFloat)
         .value("complex_double", NTdtypes::scalarType::kComplexDouble)
+        .value("long", NTdtypes::scalarType::kLong)
 
         ;
 
@@ -161,4 +411,345 @@ void initDtypes(py::module &m)
         .value("gpu", NTdtypes::deviceType::kGPU)
 
         ;
-}
\ No newline at end of file
+}
+
+void initRuntime(py::module &m)
+{
+    auto m_runtime = m.def_submodule("runtime");
+
+    // thread counts
+    m_runtime.def("set_intra_op_threads", &RuntimeConfig::setIntraOpThreads,
+                  "Set the number of threads used to parallelise a single tensor operation");
+    m_runtime.def("get_intra_op_threads", &RuntimeConfig::getIntraOpThreads,
+                  "Get the number of threads used to parallelise a single tensor operation");
+    m_runtime.def("set_inter_op_threads", &RuntimeConfig::setInterOpThreads,
+                  "Set the number of threads used to run independent tensor operations at once, can only be set once");
+    m_runtime.def("get_inter_op_threads", &RuntimeConfig::getInterOpThreads,
+                  "Get the number of threads used to run independent tensor operations at once");
+
+    // thread placement
+    m_runtime.def("get_allowed_cpus", &RuntimeConfig::getAllowedCpus,
+                  "Get the cpus this process may run on, ordered by NUMA node");
+    m_runtime.def("pin_current_thread", &RuntimeConfig::pinCurrentThread, py::arg("cpus"),
+                  "Pin the calling thread to a set of cpus");
+    m_runtime.def("pin_current_thread_to_numa_node", &RuntimeConfig::pinCurrentThreadToNumaNode, py::arg("node"),
+                  "Pin the calling thread to the cpus of a NUMA node");
+
+    // NUMA
+    m_runtime.def("get_numa_nodes", &RuntimeConfig::getNumaNodes, "Get the ids of the NUMA nodes in the machine");
+    m_runtime.def("get_numa_node_cpus", &RuntimeConfig::getNumaNodeCpus, py::arg("node"),
+                  "Get the cpus belonging to a NUMA node");
+    m_runtime.def("get_current_numa_node", &RuntimeConfig::getCurrentNumaNode,
+                  "Get the NUMA node that the calling thread is running on");
+    m_runtime.def("summary", &RuntimeConfig::toString, "Get a summary of the runtime configuration");
+
+    py::class_<NumaReplicatedTensor>(m_runtime, "NumaReplicatedTensor")
+        .def(py::init<const Tensor &>(), "Make a copy of a read-only tensor on each NUMA node")
+        .def("get", py::overload_cast<>(&NumaReplicatedTensor::get, py::const_), py::return_value_policy::copy,
+             "Get the copy on the NUMA node of the calling thread")
+        .def("get", py::overload_cast<int>(&NumaReplicatedTensor::get, py::const_), py::return_value_policy::copy,
+             "Get the copy on a particular NUMA node")
+        .def("__len__", &NumaReplicatedTensor::getNReplicas);
+}
+
+void initFitting(py::module &m)
+{
+    auto m_fitting = m.def_submodule("fitting");
+
+    py::class_<Curvature>(m_fitting, "Curvature")
+        .def_static("hessian", &Curvature::hessian, py::arg("value"), py::arg("params"),
+                    "Get the hessian of a scalar with respect to a list of parameter tensors")
+        .def_static("fisher", py::overload_cast<const Tensor &, const Tensor &>(&Curvature::fisher),
+                    py::arg("jacobian"), py::arg("inverse_variances"),
+                    "Get the fisher information from the derivatives of some predictions")
+        .def_static(
+            "fisher",
+            py::overload_cast<const Propagator &, const Tensor &, const std::vector<Tensor> &, const Tensor &>(
+                &Curvature::fisher),
+            py::arg("propagator"), py::arg("energies"), py::arg("params"), py::arg("inverse_variances"),
+            "Get the fisher information of the oscillation probabilities calculated by a propagator")
+        .def_static("covariance", &Curvature::covariance, py::arg("information"),
+                    "Get the covariance matrix of the parameters from a hessian or fisher information matrix");
+
+    py::class_<Minimiser::Result>(m_fitting, "MinimiserResult")
+        .def_readonly("params", &Minimiser::Result::params, "The parameters with the lowest value found")
+        .def_readonly("value", &Minimiser::Result::value, "The lowest value found")
+        .def_readonly("n_iterations", &Minimiser::Result::nIterations, "The number of iterations run")
+        .def_readonly("n_evaluations", &Minimiser::Result::nEvaluations,
+                      "The number of times the function was evaluated")
+        .def_readonly("converged", &Minimiser::Result::converged, "Whether a convergence criterion was met");
+
+    py::class_<Minimiser>(m_fitting, "Minimiser")
+        .def("minimise", &Minimiser::minimise, py::arg("objective"), py::arg("start"),
+             "Find the minimum of a function of a 1-d parameter tensor that returns a scalar tensor")
+        .def("set_bounds", &Minimiser::setBounds, py::arg("lower"), py::arg("upper"),
+             "Set box constraints on the parameters")
+        .def("set_scales", &Minimiser::setScales, "Set the typical size of a step in each parameter")
+        .def("set_max_iterations", &Minimiser::setMaxIterations, "Set the maximum number of iterations")
+        .def("set_gradient_tolerance", &Minimiser::setGradientTolerance,
+             "Stop once the largest component of the projected gradient falls below this")
+        .def("set_value_tolerance", &Minimiser::setValueTolerance,
+             "Stop once a step changes the value by less than this fraction of the value");
+
+    py::class_<AdamMinimiser, Minimiser>(m_fitting, "AdamMinimiser")
+        .def(py::init())
+        .def("set_learning_rate", &AdamMinimiser::setLearningRate, "Set the size of the steps")
+        .def("set_decay_rates", &AdamMinimiser::setDecayRates, py::arg("beta1"), py::arg("beta2"),
+             "Set the decay rates of the running averages of the gradient and of its square");
+
+    py::class_<LBFGSMinimiser, Minimiser>(m_fitting, "LBFGSMinimiser")
+        .def(py::init())
+        .def("set_history_size", &LBFGSMinimiser::setHistorySize,
+             "Set the number of previous iterations used to approximate the inverse hessian");
+
+    py::class_<OscillationParameters> oscillationParameters(m_fitting, "OscillationParameters");
+    py::enum_<OscillationParameters::Index>(oscillationParameters, "Index")
+        .value("theta12", OscillationParameters::kTheta12)
+        .value("theta13", OscillationParameters::kTheta13)
+        .value("theta23", OscillationParameters::kTheta23)
+        .value("delta_cp", OscillationParameters::kDeltaCP)
+        .value("dm2_21", OscillationParameters::kDm2_21)
+        .value("dm2_31", OscillationParameters::kDm2_31)
+        .value("n_params", OscillationParameters::kNParams);
+    oscillationParameters
+        .def_static("build_PMNS", &OscillationParameters::buildPMNS, "Build the PMNS matrix from the parameters")
+        .def_static("build_masses", &OscillationParameters::buildMasses,
+                    "Build the neutrino masses from the parameters")
+        .def_static("apply", &OscillationParameters::apply, py::arg("params"), py::arg("propagator"),
+                    "Set the PMNS matrix and masses of a propagator from the parameters")
+        .def_static("get_default_lower_bounds", &OscillationParameters::getDefaultLowerBounds,
+                    "Get the default lower bounds to use when fitting")
+        .def_static("get_default_upper_bounds", &OscillationParameters::getDefaultUpperBounds,
+                    "Get the default upper bounds to use when fitting");
+
+    auto likelihoodClass = py::class_<BinnedLikelihood>(m_fitting, "BinnedLikelihood");
+
+    py::enum_<BinnedLikelihood::Statistic>(likelihoodClass, "Statistic")
+        .value("poisson", BinnedLikelihood::kPoisson)
+        .value("barlow_beeston_lite", BinnedLikelihood::kBarlowBeestonLite)
+        .value("chi2", BinnedLikelihood::kChi2);
+
+    likelihoodClass
+        .def(py::init<BinnedLikelihood::Statistic>(), py::arg("statistic") = BinnedLikelihood::kPoisson)
+        .def("negative_log_likelihood", &BinnedLikelihood::negativeLogLikelihood, py::arg("prediction"),
+             "Get the negative log likelihood of the data given some predicted counts")
+        .def_static("gaussian_penalty", &BinnedLikelihood::gaussianPenalty, py::arg("values"), py::arg("centres"),
+                    py::arg("widths"), "Get sum((values - centres)^2 / 2 widths^2)")
+        .def("set_data", &BinnedLikelihood::setData, py::arg("observed_counts"), "Set the observed counts")
+        .def("set_mc_variances", &BinnedLikelihood::setMCVariances, py::arg("variances"),
+             "Set the variance of the prediction due to the limited size of the simulation, e.g. sum of weights^2")
+        .def("set_statistic", &BinnedLikelihood::setStatistic, "Set the test statistic to calculate")
+        .def("get_statistic", &BinnedLikelihood::getStatistic, "Get the test statistic being calculated");
+
+    py::class_<Fitter>(m_fitting, "Fitter")
+        .def(py::init<const Propagator &>())
+        .def("set_data", &Fitter::setData, py::arg("energies"), py::arg("unoscillated_counts"),
+             py::arg("observed_counts"), "Set the binned counts to fit to")
+        .def("set_penalties", &Fitter::setPenalties, py::arg("centres"), py::arg("widths"),
+             "Add gaussian penalties on the parameters")
+        .def("get_likelihood", &Fitter::getLikelihood, py::return_value_policy::reference_internal,
+             "Get the likelihood used to compare the prediction to the data")
+        .def("get_prediction", &Fitter::getPrediction, "Get the expected counts for some parameters")
+        .def("negative_log_likelihood", &Fitter::negativeLogLikelihood,
+             "Get the negative log likelihood of the data for some parameters")
+        .def("fit", &Fitter::fit, py::arg("minimiser"), py::arg("start"), py::call_guard<py::gil_scoped_release>(),
+             "Find the parameters that best fit the data");
+
+    py::class_<HMCSampler::Result>(m_fitting, "HMCResult")
+        .def_readonly("samples", &HMCSampler::Result::samples, "The samples, shape [n_samples, n_chains, n_params]")
+        .def_readonly("log_densities", &HMCSampler::Result::logDensities, "The log density of each sample")
+        .def_readonly("acceptance_rates", &HMCSampler::Result::acceptanceRates,
+                      "The fraction of proposals accepted after warmup, for each chain")
+        .def_readonly("step_sizes", &HMCSampler::Result::stepSizes, "The tuned step size of each chain")
+        .def_readonly("inverse_mass_matrix", &HMCSampler::Result::inverseMassMatrix,
+                      "The diagonal of the tuned inverse mass matrix")
+        .def_readonly("n_evaluations", &HMCSampler::Result::nEvaluations,
+                      "The number of times the log density was evaluated");
+
+    py::class_<HMCSampler>(m_fitting, "HMCSampler")
+        .def(py::init<HMCSampler::logDensityFnType, int>(), py::arg("log_density"), py::arg("n_params"))
+        .def("sample", &HMCSampler::sample, py::arg("initial_states"), py::arg("n_warmup"), py::arg("n_samples"),
+             "Run the chains, starting from initial states with shape [n_chains, n_params]")
+        .def("set_n_leapfrog_steps", &HMCSampler::setNLeapfrogSteps,
+             "Set the number of leapfrog steps in each trajectory")
+        .def("set_initial_step_size", &HMCSampler::setInitialStepSize,
+             "Set the step size that each chain starts warmup with")
+        .def("set_target_acceptance", &HMCSampler::setTargetAcceptance,
+             "Set the acceptance rate that the step sizes are tuned to get")
+        .def("set_adapt_mass_matrix", &HMCSampler::setAdaptMassMatrix,
+             "Set whether to estimate the mass matrix during warmup")
+        .def("set_seed", &HMCSampler::setSeed, "Set the seed of the random number generator");
+
+    py::class_<GridScan> gridScan(m_fitting, "GridScan");
+    py::class_<GridScan::Axis>(gridScan, "Axis")
+        .def(py::init<OscillationParameters::Index, std::vector<float>>(), py::arg("parameter"), py::arg("values"))
+        .def_readwrite("parameter", &GridScan::Axis::parameter, "Which parameter the axis scans")
+        .def_readwrite("values", &GridScan::Axis::values, "The values the parameter takes");
+
+    gridScan.def(py::init<const Propagator &, std::vector<GridScan::Axis>>(), py::arg("propagator"), py::arg("axes"))
+        .def("set_data", &GridScan::setData, py::arg("energies"), py::arg("unoscillated_counts"),
+             py::arg("observed_counts"), "Set the binned counts to compare to")
+        .def("scan", &GridScan::scan, py::arg("nominal"), py::call_guard<py::gil_scoped_release>(),
+             "Calculate the negative log likelihood at every point of the grid")
+        .def_static("to_delta_chi2", &GridScan::toDeltaChi2, py::arg("negative_log_likelihoods"),
+                    "Convert the result of scan() into the chi squared difference to the best point")
+        .def("get_likelihood", &GridScan::getLikelihood, py::return_value_policy::reference_internal,
+             "Get the likelihood used to compare the prediction to the data")
+        .def(
+            "set_n_threads",
+            [](GridScan &scan, size_t nThreads) { scan.setThreadPool(std::make_shared<ThreadPool>(nThreads)); },
+            py::arg("n_threads"), "Split the grid points between a new pool of threads, 0 means one per core")
+        .def("set_batch_size", &GridScan::setBatchSize,
+             "Set the most grid points to send through the propagator together, 0 means no limit")
+        .def("get_shape", &GridScan::getShape, "Get the number of values along each axis");
+}
+
+void initRates(py::module &m)
+{
+    auto m_rates = m.def_submodule("rates");
+
+    py::class_<EventRateCalculator>(m_rates, "EventRateCalculator")
+        .def(py::init([](std::shared_ptr<Propagator> propagator) {
+                 return EventRateCalculator(std::move(propagator));
+             }),
+             py::arg("propagator"), "Make a calculator which shares the propagator, so changes made to it are seen")
+        .def("calculate_rates", &EventRateCalculator::calculateRates, py::call_guard<py::gil_scoped_release>(),
+             "Calculate the expected rate of each event, including oscillations")
+        .def("calculate_unoscillated_rates", &EventRateCalculator::calculateUnoscillatedRates,
+             "Calculate the rate of each event if there were no oscillations")
+        .def("set_events", &EventRateCalculator::setEvents, py::arg("energies"), py::arg("initial_flavours"),
+             py::arg("final_flavours"), "Set the true energy, initial flavour and final flavour of each event")
+        .def("set_flux", py::overload_cast<const Tensor &>(&EventRateCalculator::setFlux), py::arg("fluxes"),
+             "Set the flux of each event")
+        .def("set_flux", py::overload_cast<const Tensor &, const Tensor &>(&EventRateCalculator::setFlux),
+             py::arg("energies"), py::arg("fluxes"),
+             "Set the flux as a table in energy, optionally one row per flavour")
+        .def("set_cross_section", py::overload_cast<const Tensor &>(&EventRateCalculator::setCrossSection),
+             py::arg("cross_sections"), "Set the cross section of each event")
+        .def("set_cross_section",
+             py::overload_cast<const Tensor &, const Tensor &>(&EventRateCalculator::setCrossSection),
+             py::arg("energies"), py::arg("cross_sections"),
+             "Set the cross section as a table in energy, optionally one row per flavour")
+        .def("set_efficiency", py::overload_cast<const Tensor &>(&EventRateCalculator::setEfficiency),
+             py::arg("efficiencies"), "Set the efficiency of each event")
+        .def("set_efficiency", py::overload_cast<const Tensor &, const Tensor &>(&EventRateCalculator::setEfficiency),
+             py::arg("energies"), py::arg("efficiencies"),
+             "Set the efficiency as a table in energy, optionally one row per flavour")
+        .def("set_weights", &EventRateCalculator::setWeights, py::arg("weights"),
+             "Set an extra weight for each event, e.g. the exposure");
+
+    py::class_<Histogram>(m_rates, "Histogram")
+        .def(py::init<const std::vector<Tensor> &>(), py::arg("bin_edges"),
+             "Make a histogram with 1 to 3 axes from the bin edges of each axis")
+        .def("set_events", &Histogram::setEvents, py::arg("coordinates"),
+             "Set the position of every event along each axis")
+        .def("fill", &Histogram::fill, py::arg("weights"), py::call_guard<py::gil_scoped_release>(),
+             "Sum the weights of the events into their bins")
+        .def("fill_with_flow", &Histogram::fillWithFlow, py::arg("weights"), py::call_guard<py::gil_scoped_release>(),
+             "Sum the weights of the events into their bins, keeping the underflow and overflow bins")
+        .def(
+            "set_n_threads",
+            [](Histogram &histogram, size_t nThreads) {
+                histogram.setThreadPool(std::make_shared<ThreadPool>(nThreads));
+            },
+            py::arg("n_threads"), "Split the events between a new pool of threads, 0 means one per core")
+        .def("set_min_events_per_thread", &Histogram::setMinEventsPerThread,
+             "Set the smallest number of events worth giving to a thread")
+        .def("get_shape", &Histogram::getShape, "Get the number of bins along each axis");
+
+    py::class_<Smearer>(m_rates, "Smearer")
+        .def(py::init<BandedMatrix>(), py::arg("response"),
+             "Make a smearer from a response matrix with one row per reco bin and one column per true bin")
+        .def("smear", &Smearer::smear, py::arg("true_values"), py::call_guard<py::gil_scoped_release>(),
+             "Smear a batch of histograms in true energy into reconstructed energy")
+        .def("smear_probabilities", &Smearer::smearProbs, py::arg("probs"), py::call_guard<py::gil_scoped_release>(),
+             "Smear the probabilities of every channel, with true energy bins along the first dimension")
+        .def("get_response", &Smearer::getResponse, "Get the response matrix")
+        .def("get_n_true_bins", &Smearer::getNTrueBins, "Get the number of true energy bins")
+        .def("get_n_reco_bins", &Smearer::getNRecoBins, "Get the number of reconstructed energy bins");
+}
+
+void initIO(py::module &m)
+{
+    auto m_io = m.def_submodule("io");
+
+    py::class_<EventChunk>(m_io, "EventChunk")
+        .def(py::init<>())
+        .def_readwrite("energies", &EventChunk::energies, "True neutrino energy of each event")
+        .def_readwrite("cos_zeniths", &EventChunk::cosZeniths, "Cosine of the true zenith angle of each event")
+        .def_readwrite("initial_flavours", &EventChunk::initialFlavours, "Flavour each neutrino was produced as")
+        .def_readwrite("final_flavours", &EventChunk::finalFlavours, "Flavour each neutrino interacted as")
+        .def_readwrite("samples", &EventChunk::samples, "Sample each event was selected into")
+        .def_readwrite("weights", &EventChunk::weights, "Weights of each event, with shape [n_events, n_weights]")
+        .def_readonly("block", &EventChunk::block, "The block of the file the events came from")
+        .def_readonly("n_events", &EventChunk::nEvents, "The number of events in the chunk");
+
+    py::class_<EventFileWriter>(m_io, "EventFileWriter")
+        .def(py::init<const std::string &, long int, long int>(), py::arg("path"), py::arg("n_weights") = 1,
+             py::arg("block_size") = 1 << 20, "Open a new event file to write to")
+        .def("write", &EventFileWriter::write, py::arg("events"), py::call_guard<py::gil_scoped_release>(),
+             "Add some events to the file")
+        .def("close", &EventFileWriter::close, py::call_guard<py::gil_scoped_release>(),
+             "Write any buffered events and the index of the blocks, and close the file");
+
+    py::class_<EventFileReader>(m_io, "EventFileReader")
+        .def(py::init<const std::string &>(), py::arg("path"), "Map an event file into memory to read it")
+        .def(
+            "set_selection",
+            [](EventFileReader &reader, const std::vector<int> &initialFlavours, const std::vector<int> &finalFlavours,
+               const std::vector<int> &samples) {
+                reader.setSelection({initialFlavours, finalFlavours, samples});
+            },
+            py::arg("initial_flavours") = std::vector<int>{}, py::arg("final_flavours") = std::vector<int>{},
+            py::arg("samples") = std::vector<int>{}, "Set which events to read, an empty list selects every value")
+        .def("next", &EventFileReader::next, py::call_guard<py::gil_scoped_release>(),
+             "Read the next block with any selected events, or None once every block has been read")
+        .def("rewind", &EventFileReader::rewind, "Go back to the first block")
+        .def("read_block", &EventFileReader::readBlock, py::arg("block"), py::call_guard<py::gil_scoped_release>(),
+             "Read the selected events of a particular block")
+        .def("get_selected_blocks", &EventFileReader::getSelectedBlocks,
+             "Get the blocks that might hold some selected events")
+        .def("get_n_events", &EventFileReader::getNEvents, "Get the total number of events in the file")
+        .def("get_n_weights", &EventFileReader::getNWeights, "Get the number of weights of each event")
+        .def("get_n_blocks", &EventFileReader::getNBlocks, "Get the number of blocks in the file")
+        .def("__iter__",
+             [](EventFileReader &reader) -> EventFileReader & {
+                 reader.rewind();
+                 return reader;
+             },
+             py::return_value_policy::reference_internal)
+        .def("__next__", [](EventFileReader &reader) {
+            std::optional<EventChunk> chunk = reader.next();
+            if (!chunk)
+            {
+                throw py::stop_iteration();
+            }
+            return *chunk;
+        });
+    py::class_<StreamingReweighter::Stats>(m_io, "StreamingReweighterStats")
+        .def_readonly("n_chunks", &StreamingReweighter::Stats::nChunks, "The number of blocks processed")
+        .def_readonly("n_events", &StreamingReweighter::Stats::nEvents, "The number of events processed")
+        .def_readonly("read_seconds", &StreamingReweighter::Stats::readSeconds,
+                      "Time spent by the reader thread getting blocks from the file")
+        .def_readonly("propagate_seconds", &StreamingReweighter::Stats::propagateSeconds,
+                      "Time spent working out and applying the probabilities")
+        .def_readonly("wait_seconds", &StreamingReweighter::Stats::waitSeconds,
+                      "Time spent by the propagation waiting for blocks to be read")
+        .def_readonly("write_seconds", &StreamingReweighter::Stats::writeSeconds,
+                      "Time spent by the writer thread writing blocks to the output file")
+        .def_readonly("total_seconds", &StreamingReweighter::Stats::totalSeconds, "Time taken by the whole run")
+        .def("get_events_per_second", &StreamingReweighter::Stats::getEventsPerSecond,
+             "Get the number of events processed per second over the whole run");
+
+    py::class_<StreamingReweighter>(m_io, "StreamingReweighter")
+        .def(py::init([](std::shared_ptr<Propagator> propagator) {
+                 return StreamingReweighter(std::move(propagator));
+             }),
+             py::arg("propagator"), "Make a reweighter which shares the propagator, so changes made to it are seen")
+        .def("run", &StreamingReweighter::run, py::arg("reader"), py::arg("output_path"),
+             py::call_guard<py::gil_scoped_release>(),
+             "Multiply the weights of the selected events by their oscillation probabilities, writing them to a new "
+             "event file")
+        .def("set_queue_depth", &StreamingReweighter::setQueueDepth,
+             "Set the number of blocks that can be waiting between each stage");
+}
@@ -0,0 +1,201 @@
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test that the analytic backward pass of the Propagator gives the same probabilities and
+    gradients (with respect to the energies, masses, PMNS matrix and density) as recording
+    every operation, and that Propagator::jacobian() agrees with calculating the gradient of
+    each probability separately, both in vacuum and in constant density matter
+*/
+
+using namespace Testing;
+
+namespace
+{
+
+struct Gradients
+{
+    Tensor probabilities;
+    Tensor energies;
+    Tensor masses;
+    Tensor PMNS;
+    Tensor density;
+};
+
+// build the PMNS matrix from angles = {theta12, theta13, theta23, deltaCP} so that it can be differentiated
+Tensor buildPMNS(const Tensor &angles)
+{
+    Tensor sines = Tensor::sin(angles);
+    Tensor cosines = Tensor::cos(angles);
+    Tensor s12 = sines.getValues({0});
+    Tensor c12 = cosines.getValues({0});
+    Tensor s13 = sines.getValues({1});
+    Tensor c13 = cosines.getValues({1});
+    Tensor s23 = sines.getValues({2});
+    Tensor c23 = cosines.getValues({2});
+    Tensor phase = cosines.getValues({3}) + Tensor::scale(sines.getValues({3}), std::complex<float>(0.0, 1.0));
+    Tensor s13Phase = Tensor::mul(s13, phase);
+
+    Tensor PMNS = Tensor::zeros({1, 3, 3}, NTdtypes::kComplexFloat).requiresGrad(false);
+    PMNS.setValue(Tensor::Index({0, 0, 0}), Tensor::mul(c12, c13));
+    PMNS.setValue(Tensor::Index({0, 0, 1}), Tensor::mul(s12, c13));
+    PMNS.setValue(Tensor::Index({0, 0, 2}), Tensor::mul(s13, phase.conj()));
+    PMNS.setValue(Tensor::Index({0, 1, 0}), -Tensor::mul(s12, c23) - Tensor::mul(Tensor::mul(c12, s23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 1, 1}), Tensor::mul(c12, c23) - Tensor::mul(Tensor::mul(s12, s23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 1, 2}), Tensor::mul(s23, c13));
+    PMNS.setValue(Tensor::Index({0, 2, 0}), Tensor::mul(s12, s23) - Tensor::mul(Tensor::mul(c12, c23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 2, 1}), -Tensor::mul(c12, s23) - Tensor::mul(Tensor::mul(s12, c23), s13Phase));
+    PMNS.setValue(Tensor::Index({0, 2, 2}), Tensor::mul(c23, c13));
+
+    return PMNS;
+}
+
+// build the masses {0, sqrt(dm2_21), sqrt(dm2_31)} from massSplittings = {dm2_21, dm2_31}
+Tensor buildMasses(const Tensor &massSplittings)
+{
+    Tensor masses = Tensor::zeros({1, 3}, NTdtypes::kFloat).requiresGrad(false);
+    masses.setValue(Tensor::Index({0, Tensor::Slice{1, 3}}), Tensor::pow(massSplittings, 0.5));
+    return masses.hasBatchDim(true);
+}
+
+// calculate the gradients of sum(probabilities * lossWeights) using fresh copies of the inputs
+Gradients getGradients(bool analytic, bool matter, const Tensor &energiesIn, const Tensor &massesIn,
+                       const Tensor &PMNSIn, const Tensor &lossWeights)
+{
+    Gradients ret;
+
+    Tensor energies = energiesIn.clone().requiresGrad(true);
+    Tensor masses = massesIn.clone().requiresGrad(true);
+    Tensor PMNS = PMNSIn.clone().requiresGrad(true);
+    Tensor density = Tensor({2.6}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+
+    Propagator propagator(3, 1300.0);
+    propagator.setAnalyticGradients(analytic);
+    propagator.setMasses(masses);
+    propagator.setPMNS(PMNS);
+
+    if (matter)
+    {
+        auto constDensitySolver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+        constDensitySolver->setDensity(density);
+
+        std::shared_ptr<BaseMatterSolver> solver = constDensitySolver;
+        propagator.setMatterSolver(solver);
+    }
+
+    ret.probabilities = propagator.calculateProbs(energies);
+    Tensor::mul(ret.probabilities, lossWeights).sum().backward();
+
+    ret.energies = energies.grad();
+    ret.masses = masses.grad();
+    ret.PMNS = PMNS.grad();
+    if (matter)
+    {
+        ret.density = density.grad();
+    }
+
+    return ret;
+}
+
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("analytic-gradients-test");
+
+    NT_PROFILE();
+
+    const float threshold = 0.001;
+
+    Tensor angles = Tensor({0.59, 0.15, 0.84, 1.2}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor massSplittings = Tensor({7.4e-5, 2.5e-3}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor masses = buildMasses(massSplittings);
+    Tensor PMNS = buildPMNS(angles);
+    Tensor energies = Tensor::scale(Tensor::rand({32, 1}, NTdtypes::kFloat).requiresGrad(false), 4.0) +
+                      Tensor({0.5}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor lossWeights = Tensor::rand({32, 3, 3}, NTdtypes::kFloat).requiresGrad(false);
+
+    for (bool matter : {false, true})
+    {
+        const std::string name = matter ? "constant density" : "vacuum";
+        std::cout << "######## " << name << " ########" << std::endl;
+
+        const Gradients analytic = getGradients(true, matter, energies, masses, PMNS, lossWeights);
+        const Gradients recorded = getGradients(false, matter, energies, masses, PMNS, lossWeights);
+
+        std::cout << "analytic mass gradients: " << std::endl << analytic.masses << std::endl;
+        std::cout << "recorded mass gradients: " << std::endl << recorded.masses << std::endl;
+
+        TEST_EXPECTED(1.0 + tensorDiff(analytic.probabilities, recorded.probabilities), 1.0,
+                      "probabilities in " + name, threshold)
+        TEST_EXPECTED(1.0 + tensorDiff(analytic.energies, recorded.energies), 1.0,
+                      "energy gradients in " + name, threshold)
+        TEST_EXPECTED(1.0 + tensorDiff(analytic.masses, recorded.masses), 1.0, "mass gradients in " + name,
+                      threshold)
+        TEST_EXPECTED(1.0 + tensorDiff(analytic.PMNS, recorded.PMNS), 1.0, "PMNS gradients in " + name, threshold)
+
+        if (matter)
+        {
+            TEST_EXPECTED(1.0 + tensorDiff(analytic.density, recorded.density), 1.0, "density gradient", threshold)
+        }
+    }
+
+    // check the jacobian with respect to the angles, mass splittings and density against one backward pass per
+    // probability for a couple of the energies
+    for (bool matter : {false, true})
+    {
+        const std::string name = matter ? "constant density" : "vacuum";
+
+        Tensor fitAngles = angles.clone().requiresGrad(true);
+        Tensor fitMassSplittings = massSplittings.clone().requiresGrad(true);
+        Tensor density = Tensor({2.6}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+        const std::vector<Tensor> params = {fitAngles, fitMassSplittings, density};
+
+        Tensor fitMasses = buildMasses(fitMassSplittings);
+        Tensor fitPMNS = buildPMNS(fitAngles);
+
+        Propagator propagator(3, 1300.0);
+        propagator.setAnalyticGradients(false);
+        propagator.setMasses(fitMasses);
+        propagator.setPMNS(fitPMNS);
+        if (matter)
+        {
+            auto constDensitySolver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+            constDensitySolver->setDensity(density);
+
+            std::shared_ptr<BaseMatterSolver> solver = constDensitySolver;
+            propagator.setMatterSolver(solver);
+        }
+
+        const Tensor jacobian = propagator.jacobian(energies, params);
+        const Tensor probabilities = propagator.calculateProbs(energies);
+
+        for (int batch : {0, 31})
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    std::vector<Tensor> gradients =
+                        Tensor::gradients(probabilities.getValues({batch, i, j}), params, Tensor(), true);
+
+                    Tensor expected = Tensor::zeros({7}, NTdtypes::kFloat).requiresGrad(false);
+                    expected.setValue(Tensor::Index({Tensor::Slice{0, 4}}), gradients[0]);
+                    expected.setValue(Tensor::Index({Tensor::Slice{4, 6}}), gradients[1]);
+                    expected.setValue(Tensor::Index({Tensor::Slice{6, 7}}), gradients[2]);
+
+                    const std::string channel = std::to_string(i) + std::to_string(j);
+                    TEST_EXPECTED(1.0 + tensorDiff(jacobian.getValues({batch, i * 3 + j}), expected), 1.0,
+                                  "jacobian for channel " + channel + " in " + name, threshold)
+                }
+            }
+        }
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,127 @@
+#include <memory>
+#include <nuTens/fitting/curvature.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the hessian and fisher information calculations. First check the hessian of a simple
+    function against the known answer, then use a chi squared built from two flavour oscillation
+    probabilities, whose hessian at the true parameters should be equal to the fisher information
+    J^T W J. This is done with and without the analytic backward pass of the propagator, which
+    checks that differentiating through the analytic gradients gives the right second derivatives.
+*/
+
+using namespace Testing;
+
+namespace
+{
+
+// build a two flavour propagator from params = {theta, dm2, density}
+Propagator buildPropagator(const std::vector<Tensor> &params, bool matter, bool analytic)
+{
+    Tensor PMNS = Tensor::zeros({1, 2, 2}, NTdtypes::kComplexFloat).requiresGrad(false);
+    Tensor sine = Tensor::sin(params[0]);
+    Tensor cosine = Tensor::cos(params[0]);
+    PMNS.setValue(Tensor::Index({0, 0, 0}), cosine);
+    PMNS.setValue(Tensor::Index({0, 0, 1}), sine);
+    PMNS.setValue(Tensor::Index({0, 1, 0}), -sine);
+    PMNS.setValue(Tensor::Index({0, 1, 1}), cosine);
+
+    Tensor masses = Tensor::zeros({1, 2}, NTdtypes::kFloat).requiresGrad(false);
+    masses.setValue(Tensor::Index({0, Tensor::Slice{1, 2}}), Tensor::pow(params[1], 0.5));
+
+    Propagator propagator(2, 1300.0);
+    propagator.setAnalyticGradients(analytic);
+    propagator.setPMNS(PMNS);
+    propagator.setMasses(masses.hasBatchDim(true));
+
+    if (matter)
+    {
+        auto constDensitySolver = std::make_shared<ConstDensityMatterSolver>(2, 2.6);
+        constDensitySolver->setDensity(params[2]);
+
+        std::shared_ptr<BaseMatterSolver> solver = constDensitySolver;
+        propagator.setMatterSolver(solver);
+    }
+
+    return propagator;
+}
+
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("curvature-test");
+
+    NT_PROFILE();
+
+    const float threshold = 0.01;
+
+    // f(x, y) = x^2 y + y^3 has hessian {{2y, 2x}, {2x, 6y}}
+    Tensor x = Tensor({1.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Tensor y = Tensor({2.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Tensor function = (Tensor::mul(Tensor::pow(x, 2.0), y) + Tensor::pow(y, 3.0)).sum();
+
+    Tensor hessian = Curvature::hessian(function, {x, y});
+    TEST_EXPECTED(hessian.getValue<float>({0, 0}), 4.0, "d2f/dx2", threshold)
+    TEST_EXPECTED(hessian.getValue<float>({0, 1}), 2.0, "d2f/dxdy", threshold)
+    TEST_EXPECTED(hessian.getValue<float>({1, 0}), 2.0, "d2f/dydx", threshold)
+    TEST_EXPECTED(hessian.getValue<float>({1, 1}), 12.0, "d2f/dy2", threshold)
+
+    Tensor energies = Tensor::scale(Tensor::rand({16, 1}, NTdtypes::kFloat).requiresGrad(false), 4.0) +
+                      Tensor({0.5}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor inverseVariances = Tensor::rand({16, 2, 2}, NTdtypes::kFloat).requiresGrad(false);
+
+    for (bool matter : {false, true})
+    {
+        const std::string name = matter ? "constant density" : "vacuum";
+
+        // the "data" to fit to, calculated at the true parameters
+        const std::vector<Tensor> trueParams = {Tensor({0.6}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                                                Tensor({2.5e-3}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                                                Tensor({2.6}, NTdtypes::kFloat, NTdtypes::kCPU, false)};
+        Tensor data = buildPropagator(trueParams, matter, false).calculateProbs(energies);
+
+        Tensor fisher;
+        for (bool analytic : {false, true})
+        {
+            std::vector<Tensor> params;
+            for (const Tensor &param : trueParams)
+            {
+                params.push_back(param.clone().requiresGrad(true));
+            }
+            if (!matter)
+            {
+                params.pop_back();
+            }
+
+            Propagator propagator = buildPropagator(params, matter, analytic);
+
+            Tensor residuals = propagator.calculateProbs(energies) - data;
+            Tensor chi2 = Tensor::scale(Tensor::mul(Tensor::mul(residuals, residuals), inverseVariances).sum(), 0.5);
+            Tensor chi2Hessian = Curvature::hessian(chi2, params);
+
+            if (!analytic)
+            {
+                fisher = Curvature::fisher(propagator, energies, params, inverseVariances);
+                std::cout << "fisher information in " << name << ": " << std::endl << fisher << std::endl;
+            }
+
+            std::cout << "chi2 hessian in " << name << (analytic ? " (analytic)" : " (recorded)") << ": " << std::endl
+                      << chi2Hessian << std::endl;
+
+            // at the true parameters the residuals vanish and the hessian is exactly J^T W J
+            TEST_EXPECTED(1.0 + tensorDiff(chi2Hessian, fisher), 1.0,
+                          "chi2 hessian in " + name + (analytic ? " with analytic gradients" : ""), threshold)
+        }
+
+        Tensor covariance = Curvature::covariance(fisher);
+        TEST_EXPECTED(1.0 + tensorDiff(Tensor::matmul(covariance, fisher),
+                                       Tensor::eye(static_cast<int>(fisher.getShape()[0]), NTdtypes::kFloat)),
+                      1.0, "covariance times fisher in " + name, threshold)
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
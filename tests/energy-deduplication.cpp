@@ -0,0 +1,189 @@
+#include <memory>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test that working out the probabilities once for each distinct energy gives the same
+    probabilities, single channel probabilities and gradients with respect to the oscillation
+    parameters as doing every energy separately, in vacuum and in matter, for energies with lots
+    of repeats in no particular order. When each neutrino has its own PMNS matrix the energies
+    can't be merged, so repeated (or all equal) energies should still give each neutrino its own
+    probabilities.
+*/
+
+using namespace Testing;
+
+namespace
+{
+const int nEvents = 60;
+const int nDistinct = 7;
+
+struct Result
+{
+    Tensor probs;
+    Tensor channelProbs;
+    Tensor probsGradient;
+    Tensor channelProbsGradient;
+};
+
+Result calculate(bool matter, bool deduplicate, const Tensor &energies, const Tensor &initialFlavours,
+                 const Tensor &finalFlavours)
+{
+    Result ret;
+
+    for (bool channel : {false, true})
+    {
+        Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+        Propagator propagator(3, 1.0);
+        OscillationParameters::apply(params, propagator);
+        propagator.setDeduplicateEnergies(deduplicate);
+        if (matter)
+        {
+            std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+            propagator.setMatterSolver(solver);
+        }
+
+        // weight the probabilities differently so that the gradient depends on where each one ends up
+        if (channel)
+        {
+            ret.channelProbs = propagator.calculateChannelProbs(energies, initialFlavours, finalFlavours);
+            Tensor::mul(ret.channelProbs, Tensor::reshape(energies, {nEvents})).sum().backward();
+            ret.channelProbsGradient = params.grad();
+        }
+        else
+        {
+            // each row of probabilities sums to 1, so the channels need weighting differently too
+            Tensor channelFactors = Tensor::reshape(
+                Tensor({1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                {1, 3, 3});
+            ret.probs = propagator.calculateProbs(energies);
+            Tensor::mul(Tensor::mul(ret.probs, Tensor::reshape(energies, {nEvents, 1, 1})), channelFactors)
+                .sum()
+                .backward();
+            ret.probsGradient = params.grad();
+        }
+    }
+
+    return ret;
+}
+
+// probabilities and channel probabilities in vacuum with a different PMNS matrix for each neutrino
+void calculateBatched(bool deduplicate, const Tensor &energies, const Tensor &initialFlavours,
+                      const Tensor &finalFlavours, Tensor &probs, Tensor &channelProbs)
+{
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Propagator propagator(3, 1.0);
+    OscillationParameters::apply(params, propagator);
+    propagator.setDeduplicateEnergies(deduplicate);
+
+    std::vector<Tensor> eventPMNS;
+    for (int i = 0; i < nEvents; i++)
+    {
+        Tensor eventParams = Tensor({0.59, 0.15, 0.6F + 0.01F * (float)i, 1.2, 0.1, 4.0}, NTdtypes::kFloat,
+                                    NTdtypes::kCPU, false);
+        eventPMNS.push_back(OscillationParameters::buildPMNS(eventParams));
+    }
+    Tensor batchedPMNS = Tensor::cat(eventPMNS, 0);
+    propagator.setPMNS(batchedPMNS);
+
+    probs = propagator.calculateProbs(energies);
+    channelProbs = propagator.calculateChannelProbs(energies, initialFlavours, finalFlavours);
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("energy-deduplication-test");
+
+    NT_PROFILE();
+
+    std::vector<float> energyValues(nEvents);
+    std::vector<float> initialValues(nEvents);
+    std::vector<float> finalValues(nEvents);
+    for (int i = 0; i < nEvents; i++)
+    {
+        energyValues[i] = 0.5 + 0.7 * (float)((i * 5) % nDistinct);
+        initialValues[i] = (float)(i % 3);
+        finalValues[i] = (float)((i / 3) % 3);
+    }
+    Tensor energies = Tensor::reshape(Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEvents, 1});
+    Tensor initialFlavours = Tensor(initialValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+    Tensor finalFlavours = Tensor(finalValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+
+    for (bool matter : {false, true})
+    {
+        const std::string name = matter ? "matter" : "vacuum";
+
+        const Result expected = calculate(matter, false, energies, initialFlavours, finalFlavours);
+        const Result deduplicated = calculate(matter, true, energies, initialFlavours, finalFlavours);
+
+        for (int i = 0; i < nEvents; i++)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                for (int b = 0; b < 3; b++)
+                {
+                    // shifted by 1 so that probabilities near 0 are compared sensibly
+                    TEST_EXPECTED(1.0 + deduplicated.probs.getValue<float>({i, a, b}),
+                                  1.0 + expected.probs.getValue<float>({i, a, b}),
+                                  name + " probability " + std::to_string(i) + ", " + std::to_string(a) + ", " +
+                                      std::to_string(b),
+                                  0.00001)
+                }
+            }
+
+            TEST_EXPECTED(1.0 + deduplicated.channelProbs.getValue<float>({i}),
+                          1.0 + expected.channelProbs.getValue<float>({i}),
+                          name + " channel probability " + std::to_string(i), 0.00001)
+        }
+
+        for (int p = 0; p < OscillationParameters::kNParams; p++)
+        {
+            TEST_EXPECTED(1.0 + deduplicated.probsGradient.getValue<float>({p}),
+                          1.0 + expected.probsGradient.getValue<float>({p}),
+                          name + " gradient of parameter " + std::to_string(p), 0.0001)
+            TEST_EXPECTED(1.0 + deduplicated.channelProbsGradient.getValue<float>({p}),
+                          1.0 + expected.channelProbsGradient.getValue<float>({p}),
+                          name + " channel gradient of parameter " + std::to_string(p), 0.0001)
+        }
+    }
+
+    // repeated energies, and the same energy for every neutrino
+    Tensor sameEnergies = Tensor::ones({nEvents, 1}, NTdtypes::kFloat).requiresGrad(false);
+    for (bool same : {false, true})
+    {
+        const std::string name = same ? "batched PMNS same energy" : "batched PMNS";
+        const Tensor &batchedEnergies = same ? sameEnergies : energies;
+
+        Tensor expectedProbs;
+        Tensor expectedChannelProbs;
+        calculateBatched(false, batchedEnergies, initialFlavours, finalFlavours, expectedProbs, expectedChannelProbs);
+        Tensor probs;
+        Tensor channelProbs;
+        calculateBatched(true, batchedEnergies, initialFlavours, finalFlavours, probs, channelProbs);
+
+        TEST_EXPECTED(probs.getShape() == expectedProbs.getShape(), true, name + " probability shape", 0.0)
+        for (int i = 0; i < nEvents; i++)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                for (int b = 0; b < 3; b++)
+                {
+                    TEST_EXPECTED(1.0 + probs.getValue<float>({i, a, b}),
+                                  1.0 + expectedProbs.getValue<float>({i, a, b}),
+                                  name + " probability " + std::to_string(i) + ", " + std::to_string(a) + ", " +
+                                      std::to_string(b),
+                                  0.00001)
+                }
+            }
+
+            TEST_EXPECTED(1.0 + channelProbs.getValue<float>({i}), 1.0 + expectedChannelProbs.getValue<float>({i}),
+                          name + " channel probability " + std::to_string(i), 0.00001)
+        }
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <nuTens/io/event-file.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the event files by writing some events sorted by sample in small blocks, reading them all
+    back and checking that nothing has changed, then reading them back with selections on the sample,
+    which should skip the blocks of the other samples, and on the flavour, which has to pick the
+    selected events out of every block.
+*/
+
+using namespace Testing;
+
+namespace
+{
+const int nEvents = 1000;
+const int nSamples = 3;
+const long int blockSize = 64;
+
+float energyOf(int i)
+{
+    return 0.1F + 0.01F * (float)i;
+}
+
+int sampleOf(int i)
+{
+    return i * nSamples / nEvents;
+}
+
+int finalFlavourOf(int i)
+{
+    return i % 3;
+}
+
+int initialFlavourOf(int i)
+{
+    return (i / 7) % 2;
+}
+
+float weightOf(int i)
+{
+    return (float)(i % 5);
+}
+
+// events [begin, end)
+EventChunk makeEvents(int begin, int end)
+{
+    std::vector<float> energies;
+    std::vector<float> cosZeniths;
+    std::vector<float> initialFlavours;
+    std::vector<float> finalFlavours;
+    std::vector<float> samples;
+    std::vector<float> weights;
+    for (int i = begin; i < end; i++)
+    {
+        energies.push_back(energyOf(i));
+        cosZeniths.push_back(-1.0F + 2.0F * (float)i / (float)nEvents);
+        initialFlavours.push_back((float)initialFlavourOf(i));
+        finalFlavours.push_back((float)finalFlavourOf(i));
+        samples.push_back((float)sampleOf(i));
+        weights.push_back(weightOf(i));
+        weights.push_back(1.0F);
+    }
+
+    EventChunk ret;
+    ret.energies = Tensor(energies, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    ret.cosZeniths = Tensor(cosZeniths, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    ret.initialFlavours = Tensor(initialFlavours, NTdtypes::kInt, NTdtypes::kCPU, false);
+    ret.finalFlavours = Tensor(finalFlavours, NTdtypes::kInt, NTdtypes::kCPU, false);
+    ret.samples = Tensor(samples, NTdtypes::kInt, NTdtypes::kCPU, false);
+    ret.weights = Tensor::reshape(Tensor(weights, NTdtypes::kFloat, NTdtypes::kCPU, false), {end - begin, 2});
+    return ret;
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("event-file-test");
+
+    NT_PROFILE();
+
+    const std::string path = "event-file-test.events";
+
+    {
+        // uneven writes so that events have to be carried over between blocks
+        EventFileWriter writer(path, /*nWeights=*/2, blockSize);
+        writer.write(makeEvents(0, 300));
+        writer.write(makeEvents(300, nEvents));
+        writer.close();
+    }
+
+    EventFileReader reader(path);
+    TEST_EXPECTED(reader.getNEvents(), nEvents, "number of events", 0.0)
+    TEST_EXPECTED(reader.getNWeights(), 2, "number of weights", 0.0)
+    TEST_EXPECTED(reader.getNBlocks(), (nEvents + blockSize - 1) / blockSize, "number of blocks", 0.0)
+
+    // everything should come back in the order it was written
+    int event = 0;
+    while (std::optional<EventChunk> chunk = reader.next())
+    {
+        for (int i = 0; i < chunk->nEvents; i++, event++)
+        {
+            const std::string name = "event " + std::to_string(event);
+            TEST_EXPECTED(chunk->energies.getValue<float>({i}), energyOf(event), name + " energy", 0.00001)
+            TEST_EXPECTED(chunk->initialFlavours.getValue<int>({i}), initialFlavourOf(event),
+                          name + " initial flavour", 0.0)
+            TEST_EXPECTED(chunk->finalFlavours.getValue<int>({i}), finalFlavourOf(event), name + " final flavour", 0.0)
+            TEST_EXPECTED(chunk->samples.getValue<int>({i}), sampleOf(event), name + " sample", 0.0)
+            TEST_EXPECTED(chunk->weights.getValue<float>({i, 0}), weightOf(event), name + " weight", 0.0)
+        }
+    }
+    TEST_EXPECTED(event, nEvents, "number of events read", 0.0)
+
+    // blocks that only hold other samples should be skipped, and the rest have every event returned
+    for (int sample = 0; sample < nSamples; sample++)
+    {
+        EventFileReader::Selection selection;
+        selection.samples = {sample};
+        reader.setSelection(selection);
+
+        int nExpected = 0;
+        float expectedWeight = 0.0;
+        size_t nExpectedBlocks = 0;
+        for (int i = 0; i < nEvents; i++)
+        {
+            if (sampleOf(i) == sample)
+            {
+                nExpected++;
+                expectedWeight += weightOf(i);
+                if (i % blockSize == 0 || sampleOf(i - 1) != sample)
+                {
+                    nExpectedBlocks++;
+                }
+            }
+        }
+
+        const std::string name = "sample " + std::to_string(sample);
+        TEST_EXPECTED(reader.getSelectedBlocks().size(), nExpectedBlocks, name + " number of blocks", 0.0)
+
+        int nRead = 0;
+        float totalWeight = 0.0;
+        while (std::optional<EventChunk> chunk = reader.next())
+        {
+            nRead += (int)chunk->nEvents;
+            totalWeight += Tensor::indexSelect(chunk->weights, 1, Tensor({0.0}, NTdtypes::kInt, NTdtypes::kCPU, false))
+                               .sum()
+                               .getValue<float>();
+            TEST_EXPECTED(chunk->samples.sum().getValue<int>(), sample * (int)chunk->nEvents,
+                          name + " only has selected events", 0.0)
+        }
+        TEST_EXPECTED(nRead, nExpected, name + " number of events", 0.0)
+        TEST_EXPECTED(totalWeight, expectedWeight, name + " total weight", 0.00001)
+    }
+
+    // every block has some of each flavour, so the selected events have to be picked out
+    EventFileReader::Selection selection;
+    selection.finalFlavours = {2};
+    selection.initialFlavours = {1};
+    reader.setSelection(selection);
+    TEST_EXPECTED(reader.getSelectedBlocks().size(), reader.getNBlocks(), "flavour number of blocks", 0.0)
+
+    int nExpected = 0;
+    float expectedEnergy = 0.0;
+    for (int i = 0; i < nEvents; i++)
+    {
+        if (finalFlavourOf(i) == 2 && initialFlavourOf(i) == 1)
+        {
+            nExpected++;
+            expectedEnergy += energyOf(i);
+        }
+    }
+
+    int nRead = 0;
+    float totalEnergy = 0.0;
+    while (std::optional<EventChunk> chunk = reader.next())
+    {
+        nRead += (int)chunk->nEvents;
+        totalEnergy += chunk->energies.sum().getValue<float>();
+        TEST_EXPECTED(chunk->finalFlavours.sum().getValue<int>(), 2 * (int)chunk->nEvents,
+                      "flavour only has selected final flavours", 0.0)
+        TEST_EXPECTED(chunk->initialFlavours.sum().getValue<int>(), (int)chunk->nEvents,
+                      "flavour only has selected initial flavours", 0.0)
+    }
+    TEST_EXPECTED(nRead, nExpected, "flavour number of events", 0.0)
+    TEST_EXPECTED(totalEnergy, expectedEnergy, "flavour total energy", 0.0001)
+
+    std::remove(path.c_str());
+
+    NT_PROFILE_ENDSESSION();
+}
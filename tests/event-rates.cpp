@@ -0,0 +1,155 @@
+#include <memory>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/rates/event-rate-calculator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the event rate calculator. Check that the single channel probabilities match the full
+    probability matrix in vacuum and in matter, and with a PMNS matrix for each event, that the
+    rates using tabulated and per-event inputs match the same products worked out by hand, and
+    that the gradient with respect to the per-event weights is right.
+*/
+
+using namespace Testing;
+
+namespace
+{
+// linear interpolation, flat beyond the ends of the table
+float interpolate(const std::vector<float> &energies, const std::vector<float> &values, float energy)
+{
+    if (energy <= energies.front())
+    {
+        return values.front();
+    }
+    for (size_t i = 1; i < energies.size(); i++)
+    {
+        if (energy < energies[i])
+        {
+            const float fraction = (energy - energies[i - 1]) / (energies[i] - energies[i - 1]);
+            return values[i - 1] + fraction * (values[i] - values[i - 1]);
+        }
+    }
+    return values.back();
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("event-rates-test");
+
+    NT_PROFILE();
+
+    // energies going past both ends of the tables, and every channel
+    const int nEvents = 45;
+    std::vector<float> energyValues(nEvents);
+    std::vector<float> initialValues(nEvents);
+    std::vector<float> finalValues(nEvents);
+    for (int i = 0; i < nEvents; i++)
+    {
+        energyValues[i] = 0.2 + 6.0 * (float)i / (float)(nEvents - 1);
+        initialValues[i] = (float)(i % 3);
+        finalValues[i] = (float)((i / 3) % 3);
+    }
+    Tensor energies = Tensor::reshape(Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEvents, 1});
+    Tensor initialFlavours = Tensor(initialValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+    Tensor finalFlavours = Tensor(finalValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    auto propagator = std::make_shared<Propagator>(3, 1.0);
+    OscillationParameters::apply(params, *propagator);
+
+    for (bool matter : {false, true})
+    {
+        const std::string name = matter ? "matter" : "vacuum";
+        if (matter)
+        {
+            std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+            propagator->setMatterSolver(solver);
+        }
+
+        Tensor probs = propagator->calculateProbs(energies);
+        Tensor channelProbs = propagator->calculateChannelProbs(energies, initialFlavours, finalFlavours);
+        for (int i = 0; i < nEvents; i++)
+        {
+            const float expected = probs.getValue<float>({i, (int)initialValues[i], (int)finalValues[i]});
+            TEST_EXPECTED(channelProbs.getValue<float>({i}), expected,
+                          name + " channel probability of event " + std::to_string(i), 0.0001)
+        }
+    }
+
+    // in vacuum every event can have its own PMNS matrix
+    Propagator batchedPropagator(3, 1.0);
+    OscillationParameters::apply(params, batchedPropagator);
+    std::vector<Tensor> eventPMNS;
+    for (int i = 0; i < nEvents; i++)
+    {
+        Tensor eventParams = Tensor({0.59, 0.15, 0.6F + 0.01F * (float)i, 1.2, 0.1, 4.0}, NTdtypes::kFloat,
+                                    NTdtypes::kCPU, false);
+        eventPMNS.push_back(OscillationParameters::buildPMNS(eventParams));
+    }
+    Tensor batchedPMNS = Tensor::cat(eventPMNS, 0);
+    batchedPropagator.setPMNS(batchedPMNS);
+
+    Tensor batchedProbs = batchedPropagator.calculateProbs(energies);
+    Tensor batchedChannelProbs = batchedPropagator.calculateChannelProbs(energies, initialFlavours, finalFlavours);
+    for (int i = 0; i < nEvents; i++)
+    {
+        const float expected = batchedProbs.getValue<float>({i, (int)initialValues[i], (int)finalValues[i]});
+        TEST_EXPECTED(batchedChannelProbs.getValue<float>({i}), expected,
+                      "batched PMNS channel probability of event " + std::to_string(i), 0.0001)
+    }
+
+    // flux depends on the initial flavour, the cross section is the same for every flavour
+    const std::vector<float> tableEnergies = {0.5, 1.0, 2.0, 4.0, 5.0};
+    const std::vector<std::vector<float>> fluxRows = {
+        {1.0, 3.0, 2.0, 1.0, 0.5}, {10.0, 30.0, 20.0, 10.0, 5.0}, {0.1, 0.2, 0.3, 0.2, 0.1}};
+    const std::vector<float> crossSectionValues = {0.1, 0.4, 1.0, 2.0, 2.5};
+
+    std::vector<float> flatFluxes;
+    for (const std::vector<float> &row : fluxRows)
+    {
+        flatFluxes.insert(flatFluxes.end(), row.begin(), row.end());
+    }
+    std::vector<float> efficiencyValues(nEvents);
+    std::vector<float> weightValues(nEvents);
+    for (int i = 0; i < nEvents; i++)
+    {
+        efficiencyValues[i] = 0.5 + 0.01 * (float)i;
+        weightValues[i] = 2.0 + (float)(i % 5);
+    }
+
+    Tensor weights = Tensor(weightValues, NTdtypes::kFloat, NTdtypes::kCPU, true);
+
+    EventRateCalculator calculator(propagator);
+    calculator.setEvents(energies, initialFlavours, finalFlavours);
+    calculator.setFlux(Tensor(tableEnergies, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                       Tensor::reshape(Tensor(flatFluxes, NTdtypes::kFloat, NTdtypes::kCPU, false), {3, 5}));
+    calculator.setCrossSection(Tensor(tableEnergies, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                               Tensor(crossSectionValues, NTdtypes::kFloat, NTdtypes::kCPU, false));
+    calculator.setEfficiency(Tensor(efficiencyValues, NTdtypes::kFloat, NTdtypes::kCPU, false));
+    calculator.setWeights(weights);
+
+    Tensor rates = calculator.calculateRates();
+    Tensor channelProbs = propagator->calculateChannelProbs(energies, initialFlavours, finalFlavours);
+
+    rates.sum().backward();
+    Tensor weightGradients = weights.grad();
+
+    for (int i = 0; i < nEvents; i++)
+    {
+        const float unoscillated = interpolate(tableEnergies, fluxRows[(int)initialValues[i]], energyValues[i]) *
+                                   interpolate(tableEnergies, crossSectionValues, energyValues[i]) *
+                                   efficiencyValues[i] * weightValues[i];
+        const float expected = unoscillated * channelProbs.getValue<float>({i});
+        const std::string event = "event " + std::to_string(i);
+
+        TEST_EXPECTED(rates.getValue<float>({i}), expected, "rate of " + event, 0.0001)
+        TEST_EXPECTED(weightGradients.getValue<float>({i}), expected / weightValues[i], "weight gradient of " + event,
+                      0.0001)
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
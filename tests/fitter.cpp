@@ -0,0 +1,103 @@
+#include <nuTens/fitting/fitter.hpp>
+#include <nuTens/fitting/minimiser.hpp>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the built in fitter. First minimise a simple bowl with both minimisers, including with
+    a bound that cuts off the true minimum, then fit theta23 and dm2_31 to muon neutrino
+    disappearance and electron neutrino appearance counts generated at known parameters and
+    check that the fit gets back to them.
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("fitter-test");
+
+    NT_PROFILE();
+
+    AdamMinimiser adam;
+    adam.setMaxIterations(5000);
+    adam.setLearningRate(0.01);
+
+    LBFGSMinimiser lbfgs;
+
+    // f(x) = (x0 - 1)^2 + 10 (x1 + 2)^2, with x1 kept above -1
+    Tensor centre = Tensor({1.0, -2.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor weights = Tensor({1.0, 10.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    auto bowl = [&](const Tensor &x) { return Tensor::mul(Tensor::pow(x - centre, 2.0), weights).sum(); };
+    Tensor bowlStart = Tensor({3.0, 3.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    for (Minimiser *minimiser : std::vector<Minimiser *>{&adam, &lbfgs})
+    {
+        const std::string name = (minimiser == &adam) ? "adam" : "lbfgs";
+        const float threshold = (minimiser == &adam) ? 0.02 : 0.001;
+
+        minimiser->setBounds(Tensor({-10.0, -10.0}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                             Tensor({10.0, 10.0}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+        Minimiser::Result result = minimiser->minimise(bowl, bowlStart);
+        std::cout << name << " bowl minimum: " << result.params << std::endl;
+        TEST_EXPECTED(result.params.getValue<float>({0}), 1.0, name + " bowl x0", threshold)
+        TEST_EXPECTED(result.params.getValue<float>({1}), -2.0, name + " bowl x1", threshold)
+
+        minimiser->setBounds(Tensor({-10.0, -1.0}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                             Tensor({10.0, 10.0}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+        result = minimiser->minimise(bowl, bowlStart);
+        std::cout << name << " bounded bowl minimum: " << result.params << std::endl;
+        TEST_EXPECTED(result.params.getValue<float>({0}), 1.0, name + " bounded bowl x0", threshold)
+        TEST_EXPECTED(result.params.getValue<float>({1}), -1.0, name + " bounded bowl x1", threshold)
+    }
+
+    // fit to counts generated at the true parameters
+    const int nBins = 50;
+    Tensor energies = Tensor::zeros({nBins, 1}, NTdtypes::kFloat).requiresGrad(false);
+    for (int i = 0; i < nBins; i++)
+    {
+        energies.setValue({i, 0}, 0.5 + 4.5 * (float)i / (float)(nBins - 1));
+    }
+
+    // muons produced, detected as electrons or muons
+    Tensor unoscillatedCounts = Tensor::zeros({nBins, 3, 3}, NTdtypes::kFloat).requiresGrad(false);
+    unoscillatedCounts.setValue(Tensor::Index({Tensor::Slice{}, 1, 0}), 200.0);
+    unoscillatedCounts.setValue(Tensor::Index({Tensor::Slice{}, 1, 1}), 1000.0);
+
+    Tensor trueParams = Tensor({0.59, 0.15, 0.65, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor startParams = Tensor({0.59, 0.15, 0.6, 1.2, 0.1, 3.6}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    Propagator propagator(3, 1.0);
+    Fitter fitter(propagator);
+    fitter.setData(energies, unoscillatedCounts, unoscillatedCounts);
+    Tensor observedCounts = fitter.getPrediction(trueParams);
+    fitter.setData(energies, unoscillatedCounts, observedCounts);
+
+    // only fit theta23 (in the lower octant) and dm2_31, by fixing everything else to its true value
+    Tensor lower = Tensor({0.59, 0.15, 0.0, 1.2, 0.1, 1.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor upper = Tensor({0.59, 0.15, 0.785, 1.2, 0.1, 10.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    for (Minimiser *minimiser : std::vector<Minimiser *>{&adam, &lbfgs})
+    {
+        const std::string name = (minimiser == &adam) ? "adam" : "lbfgs";
+        const float threshold = (minimiser == &adam) ? 0.02 : 0.002;
+
+        minimiser->setBounds(lower, upper);
+        minimiser->setScales(Tensor({1.0, 1.0, 0.1, 1.0, 1.0, 0.5}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+        Minimiser::Result result = fitter.fit(*minimiser, startParams);
+
+        std::cout << name << " best fit: " << result.params << std::endl;
+        std::cout << name << " iterations: " << result.nIterations << ", evaluations: " << result.nEvaluations
+                  << std::endl;
+
+        TEST_EXPECTED(result.params.getValue<float>({OscillationParameters::kTheta23}), 0.65,
+                      name + " fitted theta23", threshold)
+        TEST_EXPECTED(result.params.getValue<float>({OscillationParameters::kDm2_31}), 4.0,
+                      name + " fitted dm2_31", threshold)
+        TEST_EXPECTED(result.params.getValue<float>({OscillationParameters::kTheta12}), 0.59,
+                      name + " fixed theta12", 0.00001)
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,117 @@
+#include <memory>
+#include <nuTens/fitting/fitter.hpp>
+#include <nuTens/fitting/grid-scan.hpp>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the grid scan. Counts are generated at one point of a dm2_31 x theta23 x deltaCP grid, then
+    every point of the scan is checked against the likelihood from a Fitter at the same parameters,
+    in vacuum and in matter, with and without threads and with batches of different sizes. The
+    best point should be the one the counts were generated at, where the delta chi2 is 0.
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("grid-scan-test");
+
+    NT_PROFILE();
+
+    const int nBins = 30;
+    Tensor energies = Tensor::zeros({nBins, 1}, NTdtypes::kFloat).requiresGrad(false);
+    for (int i = 0; i < nBins; i++)
+    {
+        energies.setValue({i, 0}, 0.5 + 4.5 * (float)i / (float)(nBins - 1));
+    }
+
+    // muons produced, detected as electrons or muons
+    Tensor unoscillatedCounts = Tensor::zeros({nBins, 3, 3}, NTdtypes::kFloat).requiresGrad(false);
+    unoscillatedCounts.setValue(Tensor::Index({Tensor::Slice{}, 1, 0}), 200.0);
+    unoscillatedCounts.setValue(Tensor::Index({Tensor::Slice{}, 1, 1}), 1000.0);
+
+    const std::vector<float> dm2Values = {3.6, 4.0, 4.4};
+    const std::vector<float> theta23Values = {0.6, 0.65, 0.7, 0.75};
+    const std::vector<float> deltaCPValues = {-1.5, 0.1};
+
+    // the counts are generated at dm2_31 = 4.0, theta23 = 0.7, deltaCP = 0.1
+    Tensor trueParams = Tensor({0.59, 0.15, 0.7, 0.1, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    Propagator vacuumPropagator(3, 295.0);
+    Propagator matterPropagator(3, 1300.0);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(3, 2.8);
+    matterPropagator.setMatterSolver(solver);
+
+    for (Propagator *propagator : std::vector<Propagator *>{&vacuumPropagator, &matterPropagator})
+    {
+        const std::string name = (propagator == &vacuumPropagator) ? "vacuum" : "matter";
+
+        Fitter fitter(*propagator);
+        fitter.setData(energies, unoscillatedCounts, unoscillatedCounts);
+        Tensor observedCounts = fitter.getPrediction(trueParams);
+        fitter.setData(energies, unoscillatedCounts, observedCounts);
+
+        // the mass axis is put between the two mixing axes to check the results end up in the right places
+        GridScan scan(*propagator, {{OscillationParameters::kTheta23, theta23Values},
+                                    {OscillationParameters::kDm2_31, dm2Values},
+                                    {OscillationParameters::kDeltaCP, deltaCPValues}});
+        scan.setData(energies, unoscillatedCounts, observedCounts);
+
+        const std::vector<long int> shape = scan.getShape();
+        TEST_EXPECTED(shape.size(), 3, name + " number of axes", 0.0)
+        TEST_EXPECTED(shape[0], theta23Values.size(), name + " theta23 axis size", 0.0)
+        TEST_EXPECTED(shape[1], dm2Values.size(), name + " dm2_31 axis size", 0.0)
+        TEST_EXPECTED(shape[2], deltaCPValues.size(), name + " deltaCP axis size", 0.0)
+
+        for (long int batchSize : {0L, 2L, 1L})
+        {
+            for (bool useThreads : {false, true})
+            {
+                const std::string config =
+                    name + " batch " + std::to_string(batchSize) + (useThreads ? " threaded" : " serial");
+
+                scan.setBatchSize(batchSize);
+                scan.setThreadPool(useThreads ? std::make_shared<ThreadPool>(3) : nullptr);
+                const Tensor nll = scan.scan(trueParams);
+
+                for (size_t i = 0; i < theta23Values.size(); i++)
+                {
+                    for (size_t j = 0; j < dm2Values.size(); j++)
+                    {
+                        for (size_t k = 0; k < deltaCPValues.size(); k++)
+                        {
+                            Tensor params = Tensor({0.59, 0.15, theta23Values[i], deltaCPValues[k], 0.1, dm2Values[j]},
+                                                   NTdtypes::kFloat, NTdtypes::kCPU, false);
+                            const float expected = fitter.negativeLogLikelihood(params).getValue<float>();
+                            TEST_EXPECTED(
+                                nll.getValue<float>({(int)i, (int)j, (int)k}), expected,
+                                config + " nll at " + std::to_string(i) + ", " + std::to_string(j) + ", " +
+                                    std::to_string(k),
+                                1e-4)
+                        }
+                    }
+                }
+            }
+        }
+
+        const Tensor deltaChi2 = GridScan::toDeltaChi2(scan.scan(trueParams));
+        TEST_EXPECTED(deltaChi2.getValue<float>({2, 1, 1}), 0.0, name + " delta chi2 at true point", 1e-5)
+        for (size_t i = 0; i < theta23Values.size(); i++)
+        {
+            for (size_t j = 0; j < dm2Values.size(); j++)
+            {
+                for (size_t k = 0; k < deltaCPValues.size(); k++)
+                {
+                    TEST_EXPECTED(deltaChi2.getValue<float>({(int)i, (int)j, (int)k}) >= 0.0, true,
+                                  name + " delta chi2 not negative", 0.0)
+                }
+            }
+        }
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,144 @@
+#include <memory>
+#include <nuTens/rates/histogram.hpp>
+#include <random>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the histogram by filling a 2d histogram of random events, some of which fall outside the
+    edges, and comparing each bin to the same sum done by hand, both on one thread and split between
+    threads. Also check that the gradient of each weight is the gradient of the bin it went into, and
+    that a 3d histogram with a categorical axis counts the right number of events.
+*/
+
+using namespace Testing;
+
+namespace
+{
+// bin along one axis, or -1 if outside the edges
+int findBin(const std::vector<float> &edges, float value)
+{
+    for (size_t i = 0; i + 1 < edges.size(); i++)
+    {
+        if (value >= edges[i] && value < edges[i + 1])
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("histogram-test");
+
+    NT_PROFILE();
+
+    const int nEvents = 2000;
+    const std::vector<float> energyEdges = {0.5, 1.0, 2.0, 3.0, 5.0};
+    const std::vector<float> cosZenithEdges = {-1.0, -0.3, 0.2, 1.0};
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> energyDistribution(0.0, 6.0);
+    std::uniform_real_distribution<float> cosZenithDistribution(-1.2, 1.2);
+    std::uniform_real_distribution<float> weightDistribution(0.0, 2.0);
+
+    std::vector<float> energyValues(nEvents);
+    std::vector<float> cosZenithValues(nEvents);
+    std::vector<float> weightValues(nEvents);
+    std::vector<float> sampleValues(nEvents);
+    for (int i = 0; i < nEvents; i++)
+    {
+        energyValues[i] = energyDistribution(generator);
+        cosZenithValues[i] = cosZenithDistribution(generator);
+        weightValues[i] = weightDistribution(generator);
+        sampleValues[i] = (float)(i % 2);
+    }
+
+    // the sums done by hand
+    const int nEnergyBins = (int)energyEdges.size() - 1;
+    const int nCosZenithBins = (int)cosZenithEdges.size() - 1;
+    std::vector<float> expected(nEnergyBins * nCosZenithBins, 0.0);
+    std::vector<int> eventBins(nEvents);
+    int nInside = 0;
+    for (int i = 0; i < nEvents; i++)
+    {
+        const int energyBin = findBin(energyEdges, energyValues[i]);
+        const int cosZenithBin = findBin(cosZenithEdges, cosZenithValues[i]);
+        eventBins[i] = (energyBin < 0 || cosZenithBin < 0) ? -1 : energyBin * nCosZenithBins + cosZenithBin;
+        if (eventBins[i] >= 0)
+        {
+            expected[eventBins[i]] += weightValues[i];
+            nInside++;
+        }
+    }
+
+    Tensor energies = Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor cosZeniths = Tensor(cosZenithValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    Histogram histogram({Tensor(energyEdges, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                         Tensor(cosZenithEdges, NTdtypes::kFloat, NTdtypes::kCPU, false)});
+    histogram.setEvents({energies, cosZeniths});
+
+    for (bool threaded : {false, true})
+    {
+        const std::string name = threaded ? "threaded" : "serial";
+        if (threaded)
+        {
+            histogram.setThreadPool(std::make_shared<ThreadPool>(4));
+            histogram.setMinEventsPerThread(100);
+        }
+
+        Tensor weights = Tensor(weightValues, NTdtypes::kFloat, NTdtypes::kCPU, true);
+        Tensor binned = histogram.fill(weights);
+
+        // loss = sum_b binned_b * (b + 1), so the gradient of each weight is its bin number + 1 or 0 if outside
+        std::vector<float> binFactorValues(nEnergyBins * nCosZenithBins);
+        for (size_t bin = 0; bin < binFactorValues.size(); bin++)
+        {
+            binFactorValues[bin] = (float)bin + 1.0F;
+        }
+        Tensor binFactors = Tensor::reshape(Tensor(binFactorValues, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                                            {nEnergyBins, nCosZenithBins});
+        Tensor::mul(binned, binFactors).sum().backward();
+        Tensor gradients = weights.grad();
+
+        for (int energyBin = 0; energyBin < nEnergyBins; energyBin++)
+        {
+            for (int cosZenithBin = 0; cosZenithBin < nCosZenithBins; cosZenithBin++)
+            {
+                TEST_EXPECTED(binned.getValue<float>({energyBin, cosZenithBin}),
+                              expected[energyBin * nCosZenithBins + cosZenithBin],
+                              name + " bin " + std::to_string(energyBin) + ", " + std::to_string(cosZenithBin),
+                              0.0001)
+            }
+        }
+
+        for (int i = 0; i < nEvents; i++)
+        {
+            const float expectedGradient = (eventBins[i] < 0) ? 0.0 : (float)eventBins[i] + 1.0F;
+            TEST_EXPECTED(1.0 + gradients.getValue<float>({i}), 1.0 + expectedGradient,
+                          name + " gradient of weight " + std::to_string(i), 0.00001)
+        }
+
+        // nothing gets lost in the underflow and overflow bins
+        float totalWeight = 0.0;
+        for (float weight : weightValues)
+        {
+            totalWeight += weight;
+        }
+        TEST_EXPECTED(histogram.fillWithFlow(weights).sum().getValue<float>(), totalWeight,
+                      name + " total including flow", 0.0001)
+    }
+
+    // with a categorical sample axis, every event inside the other two axes should be counted once
+    Histogram histogram3d({Tensor(energyEdges, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                           Tensor(cosZenithEdges, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                           Tensor({-0.5, 0.5, 1.5}, NTdtypes::kFloat, NTdtypes::kCPU, false)});
+    histogram3d.setEvents({energies, cosZeniths, Tensor(sampleValues, NTdtypes::kFloat, NTdtypes::kCPU, false)});
+    Tensor counts = histogram3d.fill(Tensor::ones({nEvents}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+    TEST_EXPECTED(counts.sum().getValue<float>(), (float)nInside, "3d histogram count", 0.00001)
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,79 @@
+#include <nuTens/fitting/hmc-sampler.hpp>
+#include <random>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the hamiltonian monte carlo sampler by sampling a gaussian whose widths differ by a
+    factor of 100, which needs the mass matrix adaptation to sample efficiently, and checking
+    the means and variances of the samples
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("hmc-test");
+
+    NT_PROFILE();
+
+    const std::vector<float> means = {1.0, -2.0};
+    const std::vector<float> sigmas = {1.0, 0.01};
+    const int nChains = 8;
+
+    Tensor meanTensor = Tensor(means, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor sigmaTensor = Tensor(sigmas, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    auto logDensity = [&](const Tensor &params) {
+        Tensor pulls = Tensor::div(params - meanTensor, sigmaTensor);
+        return Tensor::scale(Tensor::mul(pulls, pulls).sum({1}), -0.5);
+    };
+
+    // start the chains spread out around the peak
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> uniform(-1.0, 1.0);
+    Tensor initialStates = Tensor::zeros({nChains, 2}, NTdtypes::kFloat).requiresGrad(false);
+    for (int chain = 0; chain < nChains; chain++)
+    {
+        for (int param = 0; param < 2; param++)
+        {
+            initialStates.setValue({chain, param}, means[param] + 2.0F * sigmas[param] * uniform(generator));
+        }
+    }
+
+    HMCSampler sampler(logDensity, 2);
+    sampler.setNLeapfrogSteps(10);
+    HMCSampler::Result result = sampler.sample(initialStates, 1000, 1000);
+
+    std::cout << "evaluations: " << result.nEvaluations << std::endl;
+    std::cout << "inverse mass matrix: " << result.inverseMassMatrix[0] << ", " << result.inverseMassMatrix[1]
+              << std::endl;
+
+    for (int chain = 0; chain < nChains; chain++)
+    {
+        std::cout << "chain " << chain << ": step size " << result.stepSizes[chain] << ", acceptance rate "
+                  << result.acceptanceRates[chain] << std::endl;
+
+        TEST_EXPECTED(result.acceptanceRates[chain], 0.8, "acceptance rate of chain " + std::to_string(chain), 0.2)
+    }
+
+    const float nTotal = 1000.0 * nChains;
+    Tensor sampleMeans = Tensor::scale(result.samples.sum({0, 1}), 1.0 / nTotal);
+    Tensor deviations = result.samples - sampleMeans;
+    Tensor sampleVariances = Tensor::scale(Tensor::mul(deviations, deviations).sum({0, 1}), 1.0 / nTotal);
+
+    for (int param = 0; param < 2; param++)
+    {
+        const std::string name = "parameter " + std::to_string(param);
+        const float mean = sampleMeans.getValue<float>({param});
+        const float variance = sampleVariances.getValue<float>({param});
+        const float sigma2 = sigmas[param] * sigmas[param];
+        std::cout << name << ": mean " << mean << ", variance " << variance << std::endl;
+
+        // the mean should be within a small fraction of the width of the peak
+        TEST_EXPECTED(1.0 + (mean - means[param]) / sigmas[param], 1.0, "mean of " + name, 0.1)
+        TEST_EXPECTED(variance / sigma2, 1.0, "variance of " + name, 0.15)
+        TEST_EXPECTED(result.inverseMassMatrix[param] / sigma2, 1.0, "inverse mass of " + name, 0.5)
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
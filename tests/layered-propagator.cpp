@@ -0,0 +1,97 @@
+#include <cmath>
+#include <memory>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/layered-propagator.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the LayeredPropagator. A single layer should give the same probabilities as a Propagator
+    with a constant density matter solver, splitting a layer in two should change nothing, and
+    checkpointing should give the same probabilities and gradients as recording every layer.
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("layered-propagator-test");
+
+    NT_PROFILE();
+
+    const float threshold = 0.001;
+    const float theta = 0.6;
+
+    Tensor PMNS = Tensor::ones({1, 2, 2}, NTdtypes::kComplexFloat).requiresGrad(false);
+    PMNS.setValue({0, 0, 0}, std::cos(theta));
+    PMNS.setValue({0, 0, 1}, std::sin(theta));
+    PMNS.setValue({0, 1, 0}, -std::sin(theta));
+    PMNS.setValue({0, 1, 1}, std::cos(theta));
+
+    Tensor masses = Tensor({0.0, 0.05}, NTdtypes::kFloat).addBatchDim().requiresGrad(false);
+
+    Tensor energies = Tensor::scale(Tensor::rand({64, 1}, NTdtypes::kFloat).requiresGrad(false), 4.0) +
+                      Tensor({0.5}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    // a single layer against Propagator
+    Propagator propagator(2, 6000.0);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(2, 4.5);
+    propagator.setMasses(masses);
+    propagator.setPMNS(PMNS);
+    propagator.setMatterSolver(solver);
+    Tensor expected = propagator.calculateProbs(energies);
+
+    LayeredPropagator layeredPropagator(2);
+    layeredPropagator.setMasses(masses);
+    layeredPropagator.setPMNS(PMNS);
+    layeredPropagator.setLayers({6000.0}, std::vector<float>{4.5});
+    TEST_EXPECTED(1.0 + tensorDiff(layeredPropagator.calculateProbs(energies), expected), 1.0,
+                  "single layer probabilities", threshold)
+
+    // the same layer split in two
+    layeredPropagator.setLayers({2500.0, 3500.0}, std::vector<float>{4.5, 4.5});
+    TEST_EXPECTED(1.0 + tensorDiff(layeredPropagator.calculateProbs(energies), expected), 1.0,
+                  "split layer probabilities", threshold)
+
+    // lots of layers, with and without checkpointing
+    const int nLayers = 25;
+    std::vector<float> lengths(nLayers);
+    std::vector<float> densityValues(nLayers);
+    for (int i = 0; i < nLayers; i++)
+    {
+        lengths[i] = 500.0;
+        densityValues[i] = 3.0 + 10.0 * std::sin(M_PI * (float)i / (float)(nLayers - 1));
+    }
+
+    Tensor lossWeights = Tensor::rand({64, 2, 2}, NTdtypes::kFloat).requiresGrad(false);
+    Tensor probabilities[2];
+    Tensor densityGradients[2];
+    Tensor massGradients[2];
+    for (int checkpointed : {0, 1})
+    {
+        Tensor densities = Tensor(densityValues, NTdtypes::kFloat, NTdtypes::kCPU, true);
+        Tensor fitMasses = masses.clone().requiresGrad(true);
+
+        layeredPropagator.setMasses(fitMasses);
+        layeredPropagator.setLayers(lengths, densities);
+        layeredPropagator.setCheckpointInterval(checkpointed == 1 ? 5 : 0);
+
+        probabilities[checkpointed] = layeredPropagator.calculateProbs(energies);
+        Tensor::mul(probabilities[checkpointed], lossWeights).sum().backward();
+        densityGradients[checkpointed] = densities.grad();
+        massGradients[checkpointed] = fitMasses.grad();
+    }
+
+    std::cout << "density gradients: " << std::endl << densityGradients[0] << std::endl;
+    std::cout << "checkpointed density gradients: " << std::endl << densityGradients[1] << std::endl;
+
+    TEST_EXPECTED(1.0 + tensorDiff(probabilities[1], probabilities[0]), 1.0, "checkpointed probabilities",
+                  threshold)
+    TEST_EXPECTED(1.0 + tensorDiff(densityGradients[1], densityGradients[0]), 1.0, "checkpointed density gradients",
+                  threshold)
+    TEST_EXPECTED(1.0 + tensorDiff(massGradients[1], massGradients[0]), 1.0, "checkpointed mass gradients",
+                  threshold)
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,137 @@
+#include <cmath>
+#include <nuTens/fitting/curvature.hpp>
+#include <nuTens/fitting/likelihood.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the binned likelihoods by comparing their values and gradients to the same sums worked
+    out by hand, with the Barlow-Beeston-lite scale factors found by minimising the likelihood of
+    each bin numerically. Also check the hessian of the Poisson likelihood, which needs the second
+    derivatives of the fused gradient, and the gaussian penalty.
+*/
+
+using namespace Testing;
+
+namespace
+{
+const std::vector<float> observedValues = {0.0, 3.0, 10.0, 25.0, 7.0, 1.0};
+const std::vector<float> predictionValues = {0.5, 4.0, 8.0, 30.0, 7.0, 2.0};
+const std::vector<float> varianceValues = {0.0, 1.0, 4.0, 20.0, 0.5, 0.3};
+
+// -ln L of one bin, with the prediction scaled by beta and the constraint on beta
+double barlowBeestonBin(double n, double mu, double variance, double beta)
+{
+    const double scaled = beta * mu;
+    double ret = scaled - n + (n > 0.0 ? n * std::log(n / scaled) : 0.0);
+    if (variance > 0.0)
+    {
+        ret += (beta - 1.0) * (beta - 1.0) * mu * mu / (2.0 * variance);
+    }
+    return ret;
+}
+
+// the same with beta minimised using newton's method
+double profiledBarlowBeestonBin(double n, double mu, double variance)
+{
+    if (variance <= 0.0)
+    {
+        return barlowBeestonBin(n, mu, variance, 1.0);
+    }
+
+    double beta = 1.0;
+    for (int i = 0; i < 100; i++)
+    {
+        const double firstDerivative = mu - n / beta + (beta - 1.0) * mu * mu / variance;
+        const double secondDerivative = n / (beta * beta) + mu * mu / variance;
+        beta -= firstDerivative / secondDerivative;
+    }
+    return barlowBeestonBin(n, mu, variance, beta);
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("likelihood-test");
+
+    NT_PROFILE();
+
+    const int nBins = (int)observedValues.size();
+    Tensor observed = Tensor(observedValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Tensor variances = Tensor(varianceValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    for (BinnedLikelihood::Statistic statistic :
+         {BinnedLikelihood::kPoisson, BinnedLikelihood::kBarlowBeestonLite, BinnedLikelihood::kChi2})
+    {
+        const std::string name = (statistic == BinnedLikelihood::kPoisson)             ? "poisson"
+                                 : (statistic == BinnedLikelihood::kBarlowBeestonLite) ? "barlow beeston lite"
+                                                                                       : "chi2";
+
+        BinnedLikelihood likelihood(statistic);
+        likelihood.setData(observed);
+        likelihood.setMCVariances(variances);
+
+        Tensor prediction = Tensor(predictionValues, NTdtypes::kFloat, NTdtypes::kCPU, true);
+        Tensor value = likelihood.negativeLogLikelihood(prediction);
+        value.backward();
+        Tensor gradients = prediction.grad();
+
+        double expectedValue = 0.0;
+        for (int bin = 0; bin < nBins; bin++)
+        {
+            const double n = observedValues[bin];
+            const double mu = predictionValues[bin];
+            const double variance = varianceValues[bin];
+
+            double expectedGradient = 0.0;
+            if (statistic == BinnedLikelihood::kPoisson)
+            {
+                expectedValue += barlowBeestonBin(n, mu, 0.0, 1.0);
+                expectedGradient = 1.0 - n / mu;
+            }
+            else if (statistic == BinnedLikelihood::kBarlowBeestonLite)
+            {
+                expectedValue += profiledBarlowBeestonBin(n, mu, variance);
+                const double step = 1e-4 * mu;
+                expectedGradient = (profiledBarlowBeestonBin(n, mu + step, variance) -
+                                    profiledBarlowBeestonBin(n, mu - step, variance)) /
+                                   (2.0 * step);
+            }
+            else
+            {
+                const double totalVariance = mu + variance;
+                expectedValue += (n - mu) * (n - mu) / (2.0 * totalVariance);
+                expectedGradient =
+                    -(n - mu) / totalVariance - (n - mu) * (n - mu) / (2.0 * totalVariance * totalVariance);
+            }
+
+            // shifted by 1 so that gradients near 0 are compared sensibly
+            TEST_EXPECTED(1.0 + gradients.getValue<float>({bin}), 1.0 + expectedGradient,
+                          name + " gradient of bin " + std::to_string(bin), 0.001)
+        }
+
+        TEST_EXPECTED(value.getValue<float>(), expectedValue, name + " value", 0.0001)
+    }
+
+    // the poisson likelihood has d^2/dmu^2 = n / mu^2 on the diagonal and nothing off it
+    BinnedLikelihood poisson;
+    poisson.setData(observed);
+    Tensor prediction = Tensor(predictionValues, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Tensor hessian = Curvature::hessian(poisson.negativeLogLikelihood(prediction), {prediction});
+    for (int i = 0; i < nBins; i++)
+    {
+        for (int j = 0; j < nBins; j++)
+        {
+            const double expected = (i == j) ? observedValues[i] / (predictionValues[i] * predictionValues[i]) : 0.0;
+            TEST_EXPECTED(1.0 + hessian.getValue<float>({i, j}), 1.0 + expected,
+                          "poisson hessian " + std::to_string(i) + ", " + std::to_string(j), 0.0001)
+        }
+    }
+
+    Tensor penalty = BinnedLikelihood::gaussianPenalty(Tensor({1.0, 2.0}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                                                       Tensor({0.0, 3.0}, NTdtypes::kFloat, NTdtypes::kCPU, false),
+                                                       Tensor({0.5, 2.0}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+    TEST_EXPECTED(penalty.getValue<float>(), 0.5 * (4.0 + 0.25), "gaussian penalty", 0.00001)
+
+    NT_PROFILE_ENDSESSION();
+}
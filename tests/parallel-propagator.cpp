@@ -0,0 +1,86 @@
+#include <cmath>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/parallel-propagator.hpp>
+
+/*
+    Test that splitting the energies into chunks and running them on a thread pool gives the same
+    results as running them all through the Propagator in one go
+*/
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("parallel-propagator-test");
+
+    NT_PROFILE();
+
+    const float theta = 0.6;
+
+    Tensor masses = Tensor({0.1, 0.5}, NTdtypes::kFloat).addBatchDim().requiresGrad(false);
+
+    Tensor PMNS = Tensor::ones({1, 2, 2}, NTdtypes::kComplexFloat).requiresGrad(false);
+    PMNS.setValue({0, 0, 0}, std::cos(theta));
+    PMNS.setValue({0, 0, 1}, std::sin(theta));
+    PMNS.setValue({0, 1, 0}, -std::sin(theta));
+    PMNS.setValue({0, 1, 1}, std::cos(theta));
+
+    auto propagator = std::make_shared<Propagator>(2, 295.0);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(2, 2.6);
+    propagator->setPMNS(PMNS);
+    propagator->setMasses(masses);
+    propagator->setMatterSolver(solver);
+
+    // deliberately not a multiple of the chunk size so the last chunk is smaller than the rest
+    Tensor energies = Tensor::scale(Tensor::rand({5000, 1}, NTdtypes::kFloat).requiresGrad(false), 10.0) +
+                      Tensor({0.1}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    const Tensor expected = propagator->calculateProbs(energies);
+
+    ParallelPropagator parallelPropagator(propagator, std::make_shared<ThreadPool>(4), 256);
+    const Tensor probs = parallelPropagator.calculateProbs(energies);
+
+    if ((probs.getShape() != expected.getShape()) || (probs != expected))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: ParallelPropagator gives different probabilities to Propagator" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // no energies should give an empty {0, n, n} tensor rather than an undefined one
+    const Tensor noEnergies = Tensor::zeros({0, 1}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    const Tensor noProbs = parallelPropagator.calculateProbs(noEnergies);
+    if (noProbs.getShape() != std::vector<int>{0, 2, 2})
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: ParallelPropagator with no energies should give probabilities with shape {0, 2, 2}"
+                  << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // exceptions thrown by a task should make it out of the pool
+    bool caught = false;
+    try
+    {
+        parallelPropagator.getThreadPool()->parallelFor(16, [](size_t i) {
+            if (i == 7)
+            {
+                throw std::runtime_error("task 7 failed");
+            }
+        });
+    }
+    catch (const std::runtime_error &)
+    {
+        caught = true;
+    }
+
+    if (!caught)
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: exception thrown inside ThreadPool::parallelFor() was lost" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,105 @@
+#include <memory>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the result cache of the propagator: repeated energies should hit it and give the same
+    probabilities, changing a parameter in place or the density should miss it, calculations that
+    need a gradient should skip it and still give gradients, and the least recently used results
+    should be dropped once it is full.
+*/
+
+using namespace Testing;
+
+namespace
+{
+const int nEnergies = 50;
+
+Tensor makeEnergies(float offset)
+{
+    std::vector<float> values(nEnergies);
+    for (int i = 0; i < nEnergies; i++)
+    {
+        values[i] = offset + 0.1F * (float)i;
+    }
+    return Tensor::reshape(Tensor(values, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEnergies, 1});
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("probability-cache-test");
+
+    NT_PROFILE();
+
+    // room for two results but not three
+    const size_t resultBytes = nEnergies * 3 * 3 * sizeof(float);
+
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Propagator propagator(3, 295.0);
+    OscillationParameters::apply(params, propagator);
+    auto solver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+    std::shared_ptr<BaseMatterSolver> baseSolver = solver;
+    propagator.setMatterSolver(baseSolver);
+    propagator.setCacheSize(2 * resultBytes + resultBytes / 2);
+
+    const Tensor energies = makeEnergies(0.5);
+
+    // the parameters require a gradient, so with gradients turned on the cache is skipped and the gradient still
+    // makes it back to them
+    Tensor probs = propagator.calculateProbs(energies);
+    TEST_EXPECTED(propagator.getCacheStats().bypassed, 1, "bypassed with gradients", 0.0)
+    TEST_EXPECTED(probs.getRequiresGrad(), true, "bypassed result requires gradient", 0.0)
+    Tensor::indexSelect(Tensor::reshape(probs, {nEnergies, 9}), 1,
+                        Tensor({4.0}, NTdtypes::kInt, NTdtypes::kCPU, false))
+        .sum()
+        .backward();
+    TEST_EXPECTED(params.grad().abs().sum().getValue<float>() > 0.0, true, "gradient through bypass", 0.0)
+
+    {
+        // but they can be cached while gradients are turned off
+        Tensor::NoGradGuard noGrad;
+
+        const Tensor first = propagator.calculateProbs(energies);
+        const Tensor second = propagator.calculateProbs(makeEnergies(0.5));
+        ProbabilityCache::Stats stats = propagator.getCacheStats();
+        TEST_EXPECTED(stats.misses, 1, "misses after repeat", 0.0)
+        TEST_EXPECTED(stats.hits, 1, "hits after repeat", 0.0)
+        TEST_EXPECTED(stats.nEntries, 1, "entries after repeat", 0.0)
+        TEST_EXPECTED(stats.bytes, resultBytes, "bytes after repeat", 0.0)
+
+        for (int i = 0; i < nEnergies; i++)
+        {
+            TEST_EXPECTED(1.0 + second.getValue<float>({i, 1, 0}), 1.0 + first.getValue<float>({i, 1, 0}),
+                          "cached probability " + std::to_string(i), 0.0)
+        }
+
+        // changing an element of the PMNS matrix in place has to be noticed
+        propagator.setPMNS({0, 0, 1}, 0.3F);
+        static_cast<void>(propagator.calculateProbs(energies));
+        TEST_EXPECTED(propagator.getCacheStats().misses, 2, "misses after changing PMNS", 0.0)
+
+        // and so does changing the density, which is only held by the solver
+        solver->setDensity(Tensor({3.0}, NTdtypes::kFloat, NTdtypes::kCPU, false));
+        static_cast<void>(propagator.calculateProbs(energies));
+        stats = propagator.getCacheStats();
+        TEST_EXPECTED(stats.misses, 3, "misses after changing density", 0.0)
+
+        // only room for two, so the first result should have been dropped
+        TEST_EXPECTED(stats.nEntries, 2, "entries when full", 0.0)
+        TEST_EXPECTED(stats.evictions, 1, "evictions when full", 0.0)
+        TEST_EXPECTED(stats.bytes <= stats.maxBytes, true, "bytes within limit", 0.0)
+
+        // the most recent result is still there
+        static_cast<void>(propagator.calculateProbs(energies));
+        TEST_EXPECTED(propagator.getCacheStats().hits, 2, "hits after changing density", 0.0)
+    }
+
+    propagator.clearCache();
+    TEST_EXPECTED(1.0 + propagator.getCacheStats().nEntries, 1.0, "entries after clearing", 0.0)
+
+    NT_PROFILE_ENDSESSION();
+}
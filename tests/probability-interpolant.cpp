@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/probability-interpolant.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the probability interpolant by building a table for a matter propagator and checking that
+    the interpolated probabilities stay close to the calculated ones at energies between the grid
+    points, that the single channel probabilities agree with the full ones, and that energies
+    outside of the table are clamped to its ends.
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("probability-interpolant-test");
+
+    NT_PROFILE();
+
+    const float minEnergy = 0.2;
+    const float maxEnergy = 5.0;
+    const float tolerance = 0.001;
+
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Propagator propagator(3, 295.0);
+    OscillationParameters::apply(params, propagator);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+    propagator.setMatterSolver(solver);
+
+    const ProbabilityInterpolant interpolant(propagator, minEnergy, maxEnergy, tolerance);
+    TEST_EXPECTED(interpolant.isConverged(), true, "converged", 0.0)
+    TEST_EXPECTED(interpolant.getNGenerations(), 3, "number of generations", 0.0)
+
+    // the error is only checked at the middle of each interval, so allow a bit more elsewhere
+    const int nEnergies = 2000;
+    std::vector<float> energyValues(nEnergies);
+    std::vector<float> initialValues(nEnergies);
+    std::vector<float> finalValues(nEnergies);
+    for (int i = 0; i < nEnergies; i++)
+    {
+        energyValues[i] = minEnergy + (maxEnergy - minEnergy) * ((float)i + 0.37F) / (float)nEnergies;
+        initialValues[i] = (float)(i % 3);
+        finalValues[i] = (float)((i / 3) % 3);
+    }
+    Tensor energies = Tensor::reshape(Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEnergies, 1});
+
+    const Tensor expected = propagator.calculateProbs(energies);
+    const Tensor interpolated = interpolant.calculateProbs(energies);
+    const Tensor channelProbs =
+        interpolant.calculateChannelProbs(energies, Tensor(initialValues, NTdtypes::kInt, NTdtypes::kCPU, false),
+                                          Tensor(finalValues, NTdtypes::kInt, NTdtypes::kCPU, false));
+
+    float maxError = 0.0;
+    for (int i = 0; i < nEnergies; i++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            for (int b = 0; b < 3; b++)
+            {
+                maxError = std::max(maxError, std::abs(interpolated.getValue<float>({i, a, b}) -
+                                                       expected.getValue<float>({i, a, b})));
+            }
+        }
+
+        // shifted by 1 so that probabilities near 0 are compared sensibly
+        TEST_EXPECTED(1.0 + channelProbs.getValue<float>({i}),
+                      1.0 + interpolated.getValue<float>({i, (int)initialValues[i], (int)finalValues[i]}),
+                      "channel probability " + std::to_string(i), 0.00001)
+    }
+    TEST_EXPECTED(maxError < 3.0 * tolerance, true, "maximum interpolation error", 0.0)
+
+    // the coarse starting grid can't follow the oscillations at low energy, so should have been refined
+    TEST_EXPECTED(interpolant.getNPoints(1, 1) > 16, true, "grid refined", 0.0)
+
+    // energies outside of the table get the probabilities at its ends
+    Tensor outside = Tensor::reshape(Tensor({0.05, 50.0}, NTdtypes::kFloat, NTdtypes::kCPU, false), {2, 1});
+    Tensor ends = Tensor::reshape(Tensor({minEnergy, maxEnergy}, NTdtypes::kFloat, NTdtypes::kCPU, false), {2, 1});
+    const Tensor outsideProbs = interpolant.calculateProbs(outside);
+    const Tensor endProbs = interpolant.calculateProbs(ends);
+    for (int i = 0; i < 2; i++)
+    {
+        TEST_EXPECTED(1.0 + outsideProbs.getValue<float>({i, 1, 1}), 1.0 + endProbs.getValue<float>({i, 1, 1}),
+                      "clamped energy " + std::to_string(i), 0.00001)
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <thread>
+#include <vector>
+
+/*
+    Test that a single Propagator can be shared between many threads and still give the same
+    results as when it's only used by one, that asynchronous calculations give the same results
+    and gradients as synchronous ones (and none when the caller has turned gradients off), and
+    that clones can be modified independently
+*/
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("propagator-threads-test");
+
+    NT_PROFILE();
+
+    const int nThreads = 8;
+    const int nCalls = 20;
+    const float theta = 0.3;
+
+    Tensor masses = Tensor({0.1, 0.5}, NTdtypes::kFloat).addBatchDim().requiresGrad(false);
+
+    Tensor PMNS = Tensor::ones({1, 2, 2}, NTdtypes::kComplexFloat).requiresGrad(false);
+    PMNS.setValue({0, 0, 0}, std::cos(theta));
+    PMNS.setValue({0, 0, 1}, std::sin(theta));
+    PMNS.setValue({0, 1, 0}, -std::sin(theta));
+    PMNS.setValue({0, 1, 1}, std::cos(theta));
+
+    Propagator propagator(2, 295.0);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(2, 2.6);
+    propagator.setPMNS(PMNS);
+    propagator.setMasses(masses);
+    propagator.setMatterSolver(solver);
+
+    Tensor energies = Tensor::scale(Tensor::rand({64, 1}, NTdtypes::kFloat).requiresGrad(false), 10.0) +
+                      Tensor({0.1}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+
+    const Tensor expected = propagator.calculateProbs(energies);
+
+    std::atomic<int> nBad{0};
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (int t = 0; t < nThreads; t++)
+    {
+        threads.emplace_back([&]() {
+            for (int call = 0; call < nCalls; call++)
+            {
+                if (propagator.calculateProbs(energies) != expected)
+                {
+                    nBad++;
+                }
+            }
+        });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (nBad > 0)
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: " << nBad << " calls to calculateProbs() from multiple threads gave different results to a ";
+        std::cerr << "single thread" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // a pipeline of asynchronous calculations, the queue is only one deep so submitting has to wait for the worker
+    propagator.setAsyncExecutor(std::make_shared<AsyncExecutor>(1, 1));
+    std::vector<std::future<Tensor>> futures;
+    for (int call = 0; call < nCalls; call++)
+    {
+        futures.push_back(propagator.calculateProbsAsync(energies));
+    }
+
+    for (std::future<Tensor> &future : futures)
+    {
+        if (future.get() != expected)
+        {
+            std::cerr << std::endl;
+            std::cerr << "ERROR: calculateProbsAsync() gave different results to calculateProbs()" << std::endl;
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+
+    // gradients of asynchronous results should get back to the parameters that the PMNS matrix was built from, the
+    // sum of the probabilities is always 1 so sum their squares instead
+    Tensor syncParams = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Tensor asyncParams = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, true);
+    Propagator syncPropagator(3, 295.0);
+    Propagator asyncPropagator(3, 295.0);
+    OscillationParameters::apply(syncParams, syncPropagator);
+    OscillationParameters::apply(asyncParams, asyncPropagator);
+
+    Tensor::pow(syncPropagator.calculateProbs(energies), 2.0).sum().backward();
+    std::future<Tensor> asyncProbs = asyncPropagator.calculateProbsAsync(energies);
+    Tensor::pow(asyncProbs.get(), 2.0).sum().backward();
+
+    const float angleGradient = syncParams.grad().getValue<float>({OscillationParameters::kTheta23});
+    const float gradientDiff = (syncParams.grad() - asyncParams.grad()).abs().sum().getValue<float>();
+    if (std::abs(angleGradient) == 0.0 || gradientDiff > 1e-4 * syncParams.grad().abs().sum().getValue<float>())
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: gradients through calculateProbsAsync() don't match those through calculateProbs()"
+                  << std::endl;
+        std::cerr << "sync: " << syncParams.grad() << std::endl;
+        std::cerr << "async: " << asyncParams.grad() << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // with gradients turned off by the caller, the asynchronous calculation shouldn't record anything either
+    {
+        Tensor::NoGradGuard noGrad;
+        const Tensor noGradProbs = asyncPropagator.calculateProbsAsync(energies).get();
+        if (noGradProbs.getRequiresGrad())
+        {
+            std::cerr << std::endl;
+            std::cerr << "ERROR: calculateProbsAsync() recorded gradients under a NoGradGuard" << std::endl;
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+
+    // modifying a clone should leave the original alone
+    Propagator cloned = propagator.clone();
+    cloned.setPMNS({0, 0, 1}, 0.0);
+    cloned.setPMNS({0, 1, 0}, 0.0);
+
+    if ((propagator.calculateProbs(energies) != expected) || (cloned.calculateProbs(energies) == expected))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: modifying a cloned propagator affected the original" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
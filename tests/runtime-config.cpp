@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <nuTens/tensors/runtime-config.hpp>
+#include <stdexcept>
+#include <string>
+#include <tests/test-utils.hpp>
+#include <vector>
+
+/*
+    Test the runtime configuration. Well formed cpu lists, including ones with overlapping
+    ranges, should be parsed into each cpu once in increasing order, and malformed ones should be
+    rejected. A NumaReplicatedTensor should have a copy for every NUMA node holding the same
+    values as the original, and fall back to the first copy for nodes it doesn't know.
+*/
+
+using namespace Testing;
+
+namespace
+{
+// whether parsing a cpu list throws std::invalid_argument
+bool isRejected(const std::string &cpuList)
+{
+    try
+    {
+        static_cast<void>(RuntimeConfig::parseCpuList(cpuList));
+    }
+    catch (const std::invalid_argument &)
+    {
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("runtime-config-test");
+
+    NT_PROFILE();
+
+    TEST_EXPECTED(RuntimeConfig::parseCpuList("") == std::vector<int>{}, true, "empty cpu list", 0.0)
+    TEST_EXPECTED(RuntimeConfig::parseCpuList("0-3,8,10-11") == (std::vector<int>{0, 1, 2, 3, 8, 10, 11}), true,
+                  "cpu list with ranges", 0.0)
+    TEST_EXPECTED(RuntimeConfig::parseCpuList("7") == std::vector<int>{7}, true, "single cpu", 0.0)
+
+    // overlapping and out of order ranges give each cpu once, in order
+    TEST_EXPECTED(RuntimeConfig::parseCpuList("4-6,0-2,1-5,5") == (std::vector<int>{0, 1, 2, 3, 4, 5, 6}), true,
+                  "overlapping cpu list", 0.0)
+    TEST_EXPECTED(RuntimeConfig::parseCpuList("3,3,3") == std::vector<int>{3}, true, "repeated cpu", 0.0)
+
+    const std::vector<std::string> malformedLists = {"a", "1-", "-3", "3-1", "1-2-3", "0,x", "2.5", "1 - 2",
+                                                     "99999999999"};
+    for (const std::string &malformed : malformedLists)
+    {
+        TEST_EXPECTED(isRejected(malformed), true, "malformed cpu list \"" + malformed + "\"", 0.0)
+    }
+
+    // the allowed cpus are listed once each
+    std::vector<int> allowed = RuntimeConfig::getAllowedCpus();
+    TEST_EXPECTED(!allowed.empty(), true, "some allowed cpus", 0.0)
+    std::sort(allowed.begin(), allowed.end());
+    TEST_EXPECTED(std::adjacent_find(allowed.begin(), allowed.end()) == allowed.end(), true, "allowed cpus unique",
+                  0.0)
+
+    // every node should get a copy with the same values, and unknown nodes the first copy
+    Tensor table = Tensor({1.0, 2.0, 3.0, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    NumaReplicatedTensor replicated(table);
+    const std::vector<int> nodes = RuntimeConfig::getNumaNodes();
+    TEST_EXPECTED(replicated.getNReplicas(), nodes.size(), "number of replicas", 0.0)
+    for (int node : nodes)
+    {
+        TEST_EXPECTED(replicated.get(node).toVector<float>() == table.toVector<float>(), true,
+                      "values of replica on node " + std::to_string(node), 0.0)
+    }
+    TEST_EXPECTED(&replicated.get(-1) == &replicated.get(nodes[0]), true, "replica of unknown node", 0.0)
+    TEST_EXPECTED(replicated.get().toVector<float>() == table.toVector<float>(), true, "replica of current node", 0.0)
+
+    NT_PROFILE_ENDSESSION();
+}
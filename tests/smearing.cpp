@@ -0,0 +1,155 @@
+#include <cmath>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/propagator/propagator.hpp>
+#include <nuTens/rates/smearer.hpp>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the banded matrix and smearer using a gaussian response matrix that isn't square and
+    whose band drifts away from the diagonal: the band found from the dense matrix should be
+    narrow and give back the same matrix, smearing should agree with the dense matrix product for
+    a batch of histograms and for the full probability matrix, and the gradient with respect to
+    the true rates should be the column sums of the response weighted by the gradient of the output.
+*/
+
+using namespace Testing;
+
+namespace
+{
+const int nTrue = 40;
+const int nReco = 30;
+const int nBatch = 4;
+
+// fraction of true bin t reconstructed in bin r, zero more than a few bins from the mean
+float responseOf(int r, int t)
+{
+    const float mean = 0.7F * (float)t + 1.0F;
+    const float distance = ((float)r - mean) / 1.2F;
+    return std::abs(distance) < 3.0F ? std::exp(-0.5F * distance * distance) : 0.0F;
+}
+
+float trueRateOf(int b, int t)
+{
+    return 1.0F + (float)((b * 7 + t * 3) % 11);
+}
+
+float outputWeightOf(int r)
+{
+    return 0.5F + 0.1F * (float)r;
+}
+} // namespace
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("smearing-test");
+
+    NT_PROFILE();
+
+    std::vector<float> responseValues;
+    for (int r = 0; r < nReco; r++)
+    {
+        for (int t = 0; t < nTrue; t++)
+        {
+            responseValues.push_back(responseOf(r, t));
+        }
+    }
+    Tensor dense = Tensor::reshape(Tensor(responseValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nReco, nTrue});
+
+    const Smearer smearer(BandedMatrix::fromDense(dense));
+    const BandedMatrix &response = smearer.getResponse();
+    TEST_EXPECTED(response.getNRows(), nReco, "number of rows", 0.0)
+    TEST_EXPECTED(response.getNColumns(), nTrue, "number of columns", 0.0)
+    TEST_EXPECTED(response.getWidth() < nTrue / 2, true, "band is narrow", 0.0)
+
+    const Tensor roundTrip = response.toDense();
+    for (int r = 0; r < nReco; r++)
+    {
+        for (int t = 0; t < nTrue; t++)
+        {
+            TEST_EXPECTED(1.0 + roundTrip.getValue<float>({r, t}), 1.0 + responseOf(r, t),
+                          "dense entry " + std::to_string(r) + ", " + std::to_string(t), 0.0)
+        }
+    }
+
+    // a batch of histograms in true energy
+    std::vector<float> trueValues;
+    for (int b = 0; b < nBatch; b++)
+    {
+        for (int t = 0; t < nTrue; t++)
+        {
+            trueValues.push_back(trueRateOf(b, t));
+        }
+    }
+    Tensor trueRates = Tensor::reshape(Tensor(trueValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nBatch, nTrue});
+    trueRates.requiresGrad(true);
+
+    std::vector<float> outputWeights;
+    for (int r = 0; r < nReco; r++)
+    {
+        outputWeights.push_back(outputWeightOf(r));
+    }
+
+    Tensor recoRates = smearer.smear(trueRates);
+    Tensor::mul(recoRates, Tensor(outputWeights, NTdtypes::kFloat, NTdtypes::kCPU, false)).sum().backward();
+    const Tensor gradient = trueRates.grad();
+
+    for (int b = 0; b < nBatch; b++)
+    {
+        for (int r = 0; r < nReco; r++)
+        {
+            float expected = 0.0;
+            for (int t = 0; t < nTrue; t++)
+            {
+                expected += responseOf(r, t) * trueRateOf(b, t);
+            }
+            TEST_EXPECTED(1.0 + recoRates.getValue<float>({b, r}), 1.0 + expected,
+                          "reco rate " + std::to_string(b) + ", " + std::to_string(r), 0.00001)
+        }
+
+        for (int t = 0; t < nTrue; t++)
+        {
+            float expected = 0.0;
+            for (int r = 0; r < nReco; r++)
+            {
+                expected += responseOf(r, t) * outputWeightOf(r);
+            }
+            TEST_EXPECTED(1.0 + gradient.getValue<float>({b, t}), 1.0 + expected,
+                          "gradient " + std::to_string(b) + ", " + std::to_string(t), 0.00001)
+        }
+    }
+
+    // probabilities at the centre of each true energy bin
+    std::vector<float> energyValues;
+    for (int t = 0; t < nTrue; t++)
+    {
+        energyValues.push_back(0.2F + 0.1F * (float)t);
+    }
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    Propagator propagator(3, 295.0);
+    OscillationParameters::apply(params, propagator);
+    const Tensor probs = propagator.calculateProbs(
+        Tensor::reshape(Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nTrue, 1}));
+    const Tensor recoProbs = smearer.smearProbs(probs);
+
+    for (int r = 0; r < nReco; r++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            for (int b = 0; b < 3; b++)
+            {
+                float expected = 0.0;
+                for (int t = 0; t < nTrue; t++)
+                {
+                    expected += responseOf(r, t) * probs.getValue<float>({t, a, b});
+                }
+                TEST_EXPECTED(1.0 + recoProbs.getValue<float>({r, a, b}), 1.0 + expected,
+                              "smeared probability " + std::to_string(r) + ", " + std::to_string(a) + ", " +
+                                  std::to_string(b),
+                              0.00001)
+            }
+        }
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <memory>
+#include <nuTens/fitting/oscillation-parameters.hpp>
+#include <nuTens/io/streaming-reweighter.hpp>
+#include <nuTens/propagator/const-density-solver.hpp>
+#include <stdexcept>
+#include <string>
+#include <tests/test-utils.hpp>
+
+/*
+    Test the streaming reweighter by writing a file of events in small blocks, reweighting it, and
+    checking that every weight of every event in the output has been multiplied by the probability
+    of its channel from the full probability matrix, with the other columns unchanged. Then check
+    that only the selected events are reweighted when the reader has a selection, and that a run
+    that fails part way through throws and doesn't leave an output file behind.
+*/
+
+using namespace Testing;
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("streaming-reweighter-test");
+
+    NT_PROFILE();
+
+    const std::string inputPath = "streaming-reweighter-test-input.events";
+    const std::string outputPath = "streaming-reweighter-test-output.events";
+
+    const int nEvents = 500;
+    const long int blockSize = 48;
+    std::vector<float> energyValues(nEvents);
+    std::vector<float> cosZenithValues(nEvents);
+    std::vector<float> initialValues(nEvents);
+    std::vector<float> finalValues(nEvents);
+    std::vector<float> sampleValues(nEvents);
+    std::vector<float> weightValues;
+    for (int i = 0; i < nEvents; i++)
+    {
+        energyValues[i] = 0.2 + 6.0 * (float)i / (float)(nEvents - 1);
+        cosZenithValues[i] = -1.0 + 2.0 * (float)((i * 7) % nEvents) / (float)nEvents;
+        initialValues[i] = (float)(i % 3);
+        finalValues[i] = (float)((i / 3) % 3);
+        sampleValues[i] = (float)(i * 2 / nEvents);
+        weightValues.push_back(1.0 + (float)(i % 4));
+        weightValues.push_back(0.5);
+    }
+
+    {
+        EventChunk events;
+        events.energies = Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+        events.cosZeniths = Tensor(cosZenithValues, NTdtypes::kFloat, NTdtypes::kCPU, false);
+        events.initialFlavours = Tensor(initialValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+        events.finalFlavours = Tensor(finalValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+        events.samples = Tensor(sampleValues, NTdtypes::kInt, NTdtypes::kCPU, false);
+        events.weights = Tensor::reshape(Tensor(weightValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEvents, 2});
+
+        EventFileWriter writer(inputPath, /*nWeights=*/2, blockSize);
+        writer.write(events);
+        writer.close();
+    }
+
+    Tensor params = Tensor({0.59, 0.15, 0.8, 1.2, 0.1, 4.0}, NTdtypes::kFloat, NTdtypes::kCPU, false);
+    auto propagator = std::make_shared<Propagator>(3, 295.0);
+    OscillationParameters::apply(params, *propagator);
+    std::shared_ptr<BaseMatterSolver> solver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+    propagator->setMatterSolver(solver);
+
+    Tensor probs = propagator->calculateProbs(
+        Tensor::reshape(Tensor(energyValues, NTdtypes::kFloat, NTdtypes::kCPU, false), {nEvents, 1}));
+
+    StreamingReweighter reweighter(propagator);
+    reweighter.setQueueDepth(1);
+
+    EventFileReader reader(inputPath);
+    StreamingReweighter::Stats stats = reweighter.run(reader, outputPath);
+    TEST_EXPECTED(stats.nEvents, nEvents, "number of events reweighted", 0.0)
+    TEST_EXPECTED(stats.nChunks, (nEvents + blockSize - 1) / blockSize, "number of chunks reweighted", 0.0)
+
+    {
+        EventFileReader output(outputPath);
+        TEST_EXPECTED(output.getNEvents(), nEvents, "number of events written", 0.0)
+        TEST_EXPECTED(output.getBlockSize(), blockSize, "block size of output", 0.0)
+
+        int event = 0;
+        while (std::optional<EventChunk> chunk = output.next())
+        {
+            for (int i = 0; i < chunk->nEvents; i++, event++)
+            {
+                const std::string name = "event " + std::to_string(event);
+                const float prob =
+                    probs.getValue<float>({event, (int)initialValues[event], (int)finalValues[event]});
+
+                // shifted by 1 so that probabilities near 0 are compared sensibly
+                TEST_EXPECTED(1.0 + chunk->weights.getValue<float>({i, 0}), 1.0 + weightValues[2 * event] * prob,
+                              name + " first weight", 0.0001)
+                TEST_EXPECTED(1.0 + chunk->weights.getValue<float>({i, 1}), 1.0 + weightValues[2 * event + 1] * prob,
+                              name + " second weight", 0.0001)
+                TEST_EXPECTED(chunk->cosZeniths.getValue<float>({i}), cosZenithValues[event], name + " cos zenith",
+                              0.0)
+                TEST_EXPECTED(chunk->samples.getValue<int>({i}), (int)sampleValues[event], name + " sample", 0.0)
+            }
+        }
+        TEST_EXPECTED(event, nEvents, "number of events read back", 0.0)
+    }
+
+    // only the events of sample 1 should make it to the output
+    EventFileReader::Selection selection;
+    selection.samples = {1};
+    reader.setSelection(selection);
+    stats = reweighter.run(reader, outputPath);
+
+    int nExpected = 0;
+    for (float sample : sampleValues)
+    {
+        nExpected += (sample == 1.0F) ? 1 : 0;
+    }
+    TEST_EXPECTED(stats.nEvents, nExpected, "number of selected events reweighted", 0.0)
+    TEST_EXPECTED(EventFileReader(outputPath).getNEvents(), nExpected, "number of selected events written", 0.0)
+
+    // the matter solver can't take a batched PMNS matrix, so the propagation fails on the first block
+    auto badPropagator = std::make_shared<Propagator>(3, 295.0);
+    OscillationParameters::apply(params, *badPropagator);
+    Tensor singlePMNS = OscillationParameters::buildPMNS(params);
+    Tensor batchedPMNS = Tensor::cat({singlePMNS, singlePMNS}, 0);
+    badPropagator->setPMNS(batchedPMNS);
+    std::shared_ptr<BaseMatterSolver> badSolver = std::make_shared<ConstDensityMatterSolver>(3, 2.6);
+    badPropagator->setMatterSolver(badSolver);
+
+    StreamingReweighter badReweighter(badPropagator);
+    reader.setSelection(EventFileReader::Selection());
+    reader.rewind();
+    bool threw = false;
+    try
+    {
+        static_cast<void>(badReweighter.run(reader, outputPath));
+    }
+    catch (const std::invalid_argument &)
+    {
+        threw = true;
+    }
+    TEST_EXPECTED(threw, true, "failed run throws", 0.0)
+
+    std::FILE *partialOutput = std::fopen(outputPath.c_str(), "rb");
+    TEST_EXPECTED(partialOutput == nullptr, true, "output of failed run removed", 0.0)
+    if (partialOutput != nullptr)
+    {
+        std::fclose(partialOutput);
+    }
+
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+
+    NT_PROFILE_ENDSESSION();
+}
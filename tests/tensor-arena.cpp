@@ -0,0 +1,82 @@
+#include <nuTens/tensors/tensor-arena.hpp>
+#include <nuTens/tensors/tensor.hpp>
+
+/*
+    Test that the TensorArena recycles memory of tensors that are no longer used, and never
+    hands out memory that is still in use
+*/
+
+int main()
+{
+    NT_PROFILE_BEGINSESSION("tensor-arena-test");
+
+    NT_PROFILE();
+
+    TensorArena arena;
+
+    // tensor that we keep hold of between iterations, its memory should never be recycled
+    Tensor kept;
+
+    for (int i = 0; i < 5; i++)
+    {
+        TensorArena::Scope scope(arena);
+
+        Tensor ones = Tensor::ones({3, 3}, NTdtypes::kFloat).requiresGrad(false);
+        Tensor zeros = Tensor::zeros({3, 3}, NTdtypes::kFloat).requiresGrad(false);
+        Tensor sum = ones + zeros;
+
+        // recycled memory should still be initialised properly
+        if ((zeros.getValue<float>({1, 1}) != 0.0) || (sum.getValue<float>({2, 2}) != 1.0))
+        {
+            std::cerr << std::endl;
+            std::cerr << "ERROR: recycled tensor has bad values on iteration " << i << std::endl;
+            std::cerr << "zeros: " << zeros << std::endl;
+            std::cerr << "sum: " << sum << std::endl;
+            std::cerr << std::endl;
+            return 1;
+        }
+
+        if (i == 0)
+        {
+            kept = ones;
+        }
+    }
+
+    std::cout << arena.toString() << std::endl;
+
+    const TensorArena::Stats &stats = arena.getStats();
+
+    // first iteration needs 3 fresh buffers, the kept tensor needs one more on the second iteration, everything after
+    // that should be recycled
+    if ((stats.nRequests != 15) || (stats.misses != 4) || (stats.hits != 11))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: unexpected number of arena hits/misses" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    if (kept.getValue<float>({0, 0}) != 1.0)
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: tensor that was still in use got overwritten by the arena" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // scope that releases everything when it exits
+    {
+        TensorArena::Scope scope(arena, /*releaseOnExit=*/true);
+        Tensor ones = Tensor::ones({3, 3}, NTdtypes::kFloat).requiresGrad(false);
+    }
+
+    if (arena.getBytesHeld() != 0)
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: arena still holds " << arena.getBytesHeld() << " bytes after release" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    NT_PROFILE_ENDSESSION();
+}
@@ -1,4 +1,5 @@
 
+#include <cstdio>
 #include <nuTens/tensors/dtypes.hpp>
 #include <nuTens/tensors/tensor.hpp>
 
@@ -17,7 +18,8 @@ int main()
 
     std::cout << "########################################" << std::endl;
     std::cout << "Float: " << std::endl;
-    Tensor tensorFloat = Tensor::zeros({3, 3}, NTdtypes::kDouble).dType(NTdtypes::kFloat).device(NTdtypes::kCPU);
+    Tensor tensorFloat =
+        Tensor::zeros({3, 3}, NTdtypes::kDouble, NTdtypes::kCPU, false).dType(NTdtypes::kFloat).device(NTdtypes::kCPU);
     tensorFloat.setValue({0, 0}, 0.0);
     tensorFloat.setValue({0, 1}, 1.0);
     tensorFloat.setValue({0, 2}, 2.0);
@@ -33,6 +35,19 @@ int main()
     std::cout << "Middle value: " << tensorFloat.getValue<float>({1, 1}) << std::endl;
     std::cout << "tensorFloat({'...', 1}) = " << tensorFloat.getValues({1, "..."}) << std::endl;
 
+    // precompiled indices should give the same result as the python-like ones
+    Tensor::Index rowIndex({1, Tensor::ellipsis});
+    Tensor::Index sliceIndex({Tensor::Slice{0, 3, 2}, 1});
+    if ((tensorFloat.getValues(rowIndex) != tensorFloat.getValues({1, "..."})) ||
+        (tensorFloat.getValues(sliceIndex) != tensorFloat.getValues({"0:3:2", 1})) ||
+        (tensorFloat.getValue<float>(Tensor::Index({2, 1})) != 7.0))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: precompiled Tensor::Index gives different values to python-like indices" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
     Tensor realSquared = Tensor::matmul(tensorFloat, tensorFloat);
     std::cout << "Squared: " << std::endl;
     std::cout << realSquared << std::endl;
@@ -98,6 +113,86 @@ int main()
         return 1;
     }
 
+    // summing integers gives 64 bit integers
+    Tensor intSum = Tensor(twos).dType(NTdtypes::kInt).sum();
+    if ((intSum.getDType() != NTdtypes::kLong) || (intSum.getValue<int>() != 2 * (int)twos.getNumel()))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: unexpected sum of integer tensor: " << intSum << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // fromVector() keeps the values and type exactly, unlike going through floats
+    const std::vector<std::int64_t> bigIndices = {0, 16777217, 4294967297};
+    const std::vector<double> preciseValues = {0.1, 1.0 + 1e-12};
+    if ((Tensor::fromVector(bigIndices).getDType() != NTdtypes::kLong) ||
+        (Tensor::fromVector(bigIndices).toVector<std::int64_t>() != bigIndices) ||
+        (Tensor::fromVector(preciseValues).toVector<double>() != preciseValues))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: tensor made using fromVector() doesn't hold the exact values" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // ######### test wrapping and exporting external memory ###########
+    std::vector<float> external = {0.0, 1.0, 2.0, 3.0, 4.0, 5.0};
+    Tensor wrapped = Tensor::fromBuffer(external.data(), {2, 3}, {}, NTdtypes::kFloat);
+
+    // wrapped tensor should see changes to the external memory as nothing was copied
+    external[4] = 40.0;
+    std::cout << "wrapped external buffer: " << std::endl << wrapped << std::endl;
+    if ((wrapped.getValue<float>({0, 1}) != 1.0) || (wrapped.getValue<float>({1, 1}) != 40.0) ||
+        (wrapped.dataPtr() != external.data()))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: tensor created with fromBuffer() does not share memory with the buffer" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // transposed tensor isn't contiguous so exporting it has to make a copy
+    Tensor::Buffer exported = Tensor::transpose(wrapped, 0, 1).toBuffer();
+    if ((exported.shape != std::vector<long int>{3, 2}) || (static_cast<float *>(exported.data)[1] != 3.0))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: unexpected layout of buffer exported by toBuffer()" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // ######### test bulk readback ###########
+    std::vector<double> asVector = Tensor::transpose(wrapped, 0, 1).toVector<double>();
+    Tensor::Accessor<float> accessor = wrapped.getAccessor<float>();
+    if ((asVector != std::vector<double>{0.0, 3.0, 1.0, 40.0, 2.0, 5.0}) || (accessor(1, 1) != 40.0) ||
+        (accessor.at({0, 2}) != 2.0) || (accessor.size() != 6))
+    {
+        std::cerr << std::endl;
+        std::cerr << "ERROR: unexpected values read back using toVector() or getAccessor()" << std::endl;
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    // ######### test saving and loading ###########
+    Tensor toSave = Tensor::transpose(wrapped, 0, 1).dType(NTdtypes::kComplexDouble);
+    toSave.save("tensor-basic-test.nttensor");
+    for (bool memoryMap : {true, false})
+    {
+        Tensor loaded = Tensor::load("tensor-basic-test.nttensor", memoryMap);
+        if ((loaded.getShape() != toSave.getShape()) || (loaded.getDType() != NTdtypes::kComplexDouble) ||
+            (loaded.toVector<std::complex<double>>() != toSave.toVector<std::complex<double>>()))
+        {
+            std::cerr << std::endl;
+            std::cerr << "ERROR: loaded tensor doesn't match saved tensor, memoryMap = " << memoryMap << std::endl;
+            std::cerr << "saved: " << toSave << std::endl;
+            std::cerr << "loaded: " << loaded << std::endl;
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+    std::remove("tensor-basic-test.nttensor");
+
     // ######### test some of the basic autograd functionality ###########
 
     // first just a simple test of scaling by a constant factor
@@ -117,7 +212,7 @@ int main()
         return 1;
     }
 
-    Tensor complexGradTest = Tensor::zeros({2, 2}, NTdtypes::kComplexFloat);
+    Tensor complexGradTest = Tensor::zeros({2, 2}, NTdtypes::kComplexFloat, NTdtypes::kCPU, false);
     complexGradTest.setValue({0, 0}, std::complex<float>(0.0 + 0.0J));
     complexGradTest.setValue({0, 1}, std::complex<float>(0.0 + 1.0J));
     complexGradTest.setValue({1, 0}, std::complex<float>(1.0 + 0.0J));
@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include <iostream>
+#include <nuTens/tensors/tensor.hpp>
 
 // Some helpful utility functions for testing
 
@@ -16,6 +17,13 @@ float relativeDiff(float f1, float f2)
     return std::abs((f1 - f2) / f1);
 }
 
+// Get the relative difference between two tensors, summed over all elements:
+//   sum | t1 - t2 | / sum | t2 |
+float tensorDiff(const Tensor &t1, const Tensor &t2)
+{
+    return (t1 - t2).abs().sum().getValue<float>() / t2.abs().sum().getValue<float>();
+}
+
 } // namespace Testing
 
 // ###########################